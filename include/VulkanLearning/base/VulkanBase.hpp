@@ -35,11 +35,14 @@
 
 #include "Vertex.hpp"
 #include "Camera.hpp"
+#include "Frustum.hpp"
 #include "Inputs.hpp"
 #include "Window.hpp"
 #include "UI.hpp"
 #include "model/ModelObj.hpp"
 #include "FpsCounter.hpp"
+#include "ThreadPool.hpp"
+#include "MeshOptimizer.hpp"
 
 #include "VulkanDebug.hpp"
 #include "VulkanDevice.hpp"
@@ -138,6 +141,7 @@ namespace VulkanLearning {
                 m_ui.freeResources();
 
                 vkDestroyCommandPool(m_device.getLogicalDevice(), m_device.getCommandPool(), nullptr);
+                m_device.destroySamplers();
 
                 vkDestroyDevice(m_device.getLogicalDevice(), nullptr);
 
@@ -191,6 +195,7 @@ namespace VulkanLearning {
                 createSurface();
                 createDevice();
                 createSwapChain();
+                m_device.setSwapChainImageCount(static_cast<uint32_t>(m_swapChain.getImages().size()));
                 createRenderPass();
                 createColorResources();
                 createDepthResources();
@@ -336,6 +341,7 @@ namespace VulkanLearning {
                 cleanupSwapChain();
 
                 m_swapChain.create();
+                m_device.setSwapChainImageCount(static_cast<uint32_t>(m_swapChain.getImages().size()));
 
                 createRenderPass();
                 createColorResources();
@@ -349,6 +355,19 @@ namespace VulkanLearning {
                 m_ui.resize(m_swapChain.getExtent().width, m_swapChain.getExtent().height);
             }
 
+            // Examples re-recording their command buffers call this first, so the previous ones aren't leaked
+            void freeCommandBuffers() {
+                if (m_commandBuffers.empty()) {
+                    return;
+                }
+                vkFreeCommandBuffers(
+                        m_device.getLogicalDevice(), 
+                        m_device.getCommandPool(), 
+                        static_cast<uint32_t>(m_commandBuffers.size()), 
+                        m_commandBuffers.data()->getCommandBufferPointer());
+                m_commandBuffers.clear();
+            }
+
             virtual void cleanupSwapChain() {
                 m_colorImageResource.cleanup();
                 m_depthImageResource.cleanup();
@@ -357,11 +376,7 @@ namespace VulkanLearning {
                     vkDestroyFramebuffer(m_device.getLogicalDevice(), m_framebuffers[i], nullptr);
                 }
 
-                vkFreeCommandBuffers(
-                        m_device.getLogicalDevice(), 
-                        m_device.getCommandPool(), 
-                        static_cast<uint32_t>(m_commandBuffers.size()), 
-                        m_commandBuffers.data()->getCommandBufferPointer());
+                freeCommandBuffers();
 
                 vkDestroyRenderPass(m_device.getLogicalDevice(), m_renderPass.getRenderPass(), nullptr);
 
@@ -394,7 +409,8 @@ namespace VulkanLearning {
                 m_device.pickPhysicalDevice(
                         m_instance->getInstance(), 
                         m_surface.getSurface(), 
-                        deviceExtensions);
+                        deviceExtensions,
+                        m_instance->hasPhysicalDeviceProperties2());
 
                 checkAndEnableFeatures();
 
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+#include "VulkanglTFModel.hpp"
+
+namespace VulkanLearning {
+
+    /*
+       Skins all skinned glTF meshes of a model once per frame in a compute pass. Joint matrices of
+       every skin share one storage buffer, so there is no per mesh joint limit, and the skinned
+       vertices go to a copy of the model's vertex buffer that every later pass binds instead.
+       Skinned positions stay in mesh space, pipelines apply the node matrix as for static meshes.
+       */
+    class VulkanComputeSkinning {
+        private:
+            struct PushConstants {
+                uint32_t firstVertex;
+                uint32_t vertexCount;
+                uint32_t jointOffset;
+                uint32_t vertexStride;
+            };
+
+            // One dispatch per skinned primitive
+            struct Job {
+                PushConstants pushConstants;
+                Node* node;
+            };
+
+            VulkanDevice* m_device;
+            VulkanglTFModel* m_model = nullptr;
+
+            std::vector<Job> m_jobs;
+            std::vector<Node*> m_skinnedNodes;
+            std::vector<uint32_t> m_jointOffsets;
+            uint32_t m_jointCount = 0;
+            uint32_t m_frameCount = 0;
+            // Joint matrices of one frame, padded to the storage buffer offset alignment
+            VkDeviceSize m_frameSize = 0;
+
+            // Host visible, one region per frame in flight so the CPU never writes what the GPU reads
+            VulkanBuffer m_jointBuffer;
+            VulkanBuffer m_vertexBuffer;
+
+            VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+            VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> m_descriptorSets;
+            VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+        public:
+            VulkanComputeSkinning(VulkanDevice* device);
+            ~VulkanComputeSkinning();
+
+            // The model's vertex buffer must not use compact vertices. A frameCount of 0 uses
+            // the model's node transform frame count, one per swap chain image by default
+            void create(VulkanglTFModel* model, uint32_t frameCount = 0);
+            void cleanup();
+
+            // Writes the joint matrices of the current node transforms into the frame's region
+            void update(uint32_t frame);
+            // Records the skinning pass, must be outside of a render pass
+            void dispatch(VkCommandBuffer commandBuffer, uint32_t frame);
+            // Binds the skinned vertices and the model's index buffer for model.draw
+            void bindBuffers(VkCommandBuffer commandBuffer);
+
+            uint32_t getJointCount();
+            VkBuffer getVertexBuffer();
+    };
+}
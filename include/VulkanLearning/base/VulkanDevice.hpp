@@ -4,6 +4,7 @@
 
 #include <iostream>
 
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -28,6 +29,13 @@ namespace VulkanLearning {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
 
+    // Enabled only if the device supports them, see VulkanDevice::isExtensionEnabled.
+    // VK_EXT_memory_budget also needs VK_KHR_get_physical_device_properties2 on the instance
+    const std::vector<const char*> optionalDeviceExtensions = {
+        VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+        VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+    };
+
     class VulkanDevice {
         private:
             VkPhysicalDevice m_physicalDevice;
@@ -38,6 +46,7 @@ namespace VulkanLearning {
 
 
             std::vector<const char*> m_deviceExtensions; 
+            std::vector<const char*> m_enabledOptionalExtensions;
             VkSampleCountFlagBits m_msaaSamples;
             uint32_t m_msaaSamplesMax;
 
@@ -45,12 +54,22 @@ namespace VulkanLearning {
 
             VkCommandPool m_commandPool = VK_NULL_HANDLE;
 
+            // Set by VulkanBase whenever the swap chain is created, 0 without one
+            uint32_t m_swapChainImageCount = 0;
+
+            // Null unless the instance was created with VK_KHR_get_physical_device_properties2
+            PFN_vkGetPhysicalDeviceMemoryProperties2KHR m_getMemoryProperties2 = nullptr;
+
+            // Samplers handed out by getSampler, shared by all copies of the device
+            struct SamplerCache;
+            std::shared_ptr<SamplerCache> m_samplerCache;
+
         public:
             VkPhysicalDeviceFeatures features;
             VkPhysicalDeviceFeatures enabledFeatures = {};
             VkPhysicalDeviceProperties properties;
 
-            VulkanDevice() {};
+            VulkanDevice();
             VulkanDevice(VkInstance instance, 
                     VkSurfaceKHR surface,
                     const std::vector<const char*> deviceExtensions,
@@ -67,10 +86,27 @@ namespace VulkanLearning {
             VkQueue getPresentQueue();
             VkSampleCountFlagBits getMsaaSamples();
             size_t getMinUniformBufferOffsetAlignment();
+            size_t getMinStorageBufferOffsetAlignment();
             QueueFamilyIndices getQueueFamilyIndices();
             VkCommandPool getCommandPool();
-
-            void pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::vector<const char*> deviceExtensions);
+            bool isExtensionEnabled(const char* extension);
+            // Per frame resources of command buffers recorded per swap chain image need this many copies
+            uint32_t getSwapChainImageCount();
+            void setSwapChainImageCount(uint32_t imageCount);
+
+            // Sampler with the state of samplerInfo (pNext is not supported), created on first use and
+            // shared with everyone asking for the same state. The device owns it, never destroy it yourself
+            VkSampler getSampler(const VkSamplerCreateInfo& samplerInfo);
+            uint32_t getSamplerCount();
+            // Destroys the cached samplers, called right before the logical device goes away
+            void destroySamplers();
+
+            // Bytes of device local memory this process may use and already uses, from VK_EXT_memory_budget.
+            // Without the extension the budget is the size of the device local heaps and usage is 0
+            VkDeviceSize getDeviceLocalBudget(VkDeviceSize* usage = nullptr);
+
+            // physicalDeviceProperties2 tells if the instance enabled VK_KHR_get_physical_device_properties2
+            void pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::vector<const char*> deviceExtensions, bool physicalDeviceProperties2 = false);
             void createLogicalDevice(VkSurfaceKHR surface, bool enableValidationLayers, const std::vector<const char*> validationLayers);
 
             SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface); 
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+#include "VulkanglTFModel.hpp"
+
+namespace VulkanLearning {
+
+    /*
+       GPU driven rendering of a model: primitives, node transforms and bounds live in storage buffers,
+       a compute pass culls every primitive against the frustum and writes the indirect draws.
+       Each alpha mode is one batch, drawn with a single indirect count call (VK_KHR_draw_indirect_count),
+       a multi draw indirect call or, without multiDrawIndirect, one indirect call per primitive.
+       Materials aren't bound per draw. When drawIndirectFirstInstance is supported, firstInstance holds the
+       mesh's transform slot as in VulkanglTFModel::draw, so shaders find the node transform with gl_InstanceIndex.
+       */
+    class VulkanIndirectRenderer {
+        private:
+            enum Batch { BatchOpaque = 0, BatchMask = 1, BatchBlend = 2, BatchCount = 3 };
+
+            struct ObjectData {
+                glm::vec4 boundsMin;
+                glm::vec4 boundsMax;
+                uint32_t firstIndex;
+                uint32_t indexCount;
+                uint32_t transformIndex;
+                uint32_t batch;
+                // Position of the draw inside its batch when the commands aren't compacted
+                uint32_t batchSlot;
+                // Mesh::transformSlot, written as firstInstance
+                uint32_t transformSlot;
+                uint32_t padding[2];
+            };
+
+            struct UniformData {
+                glm::vec4 frustumPlanes[6];
+                // First draw of every batch in the draw buffer
+                uint32_t batchOffsets[4];
+                uint32_t objectCount;
+                uint32_t compact;
+                uint32_t firstInstance;
+                uint32_t padding;
+            };
+
+            VulkanDevice* m_device;
+            VulkanglTFModel* m_model = nullptr;
+
+            uint32_t m_objectCount = 0;
+            uint32_t m_batchOffsets[BatchCount + 1] = {};
+            std::vector<Node*> m_transformNodes;
+
+            VulkanBuffer m_uniformBuffer;
+            VulkanBuffer m_objectBuffer;
+            // World matrices of the mesh nodes, host visible so animated nodes can be updated every frame
+            VulkanBuffer m_transformBuffer;
+            // VkDrawIndexedIndirectCommand per object, grouped by batch
+            VulkanBuffer m_drawBuffer;
+            // Visible draws per batch, cleared before every culling pass
+            VulkanBuffer m_countBuffer;
+
+            VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+            VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+            VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+            VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+            PFN_vkCmdDrawIndexedIndirectCountKHR m_vkCmdDrawIndexedIndirectCountKHR = nullptr;
+
+        public:
+            VulkanIndirectRenderer(VulkanDevice* device);
+            ~VulkanIndirectRenderer();
+
+            void create(VulkanglTFModel* model);
+            void cleanup();
+
+            // Frustum planes are extracted from viewProjection, in the space of the node matrices
+            void update(const glm::mat4& viewProjection);
+            // Copies the current node matrices, only needed when nodes have moved
+            void updateTransforms();
+
+            // Records the culling pass, must be outside of a render pass
+            void dispatch(VkCommandBuffer commandBuffer);
+            // One indirect call per batch selected by renderFlags, all batches without flags
+            void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0);
+
+            VkBuffer getObjectBuffer();
+            VkBuffer getTransformBuffer();
+            uint32_t getObjectCount();
+            bool usesDrawIndirectCount();
+    };
+}
@@ -20,6 +20,7 @@ namespace VulkanLearning {
             const char* m_appName;
             bool m_enableValidationLayers;
             const std::vector<const char*> m_validationLayers;
+            bool m_physicalDeviceProperties2 = false;
 
         public:
             VulkanInstance(
@@ -30,6 +31,9 @@ namespace VulkanLearning {
             ~VulkanInstance();
 
             inline VkInstance getInstance() { return m_instance; }
+            // Set if VK_KHR_get_physical_device_properties2 was enabled, device extensions that
+            // depend on it can only be used then
+            inline bool hasPhysicalDeviceProperties2() { return m_physicalDeviceProperties2; }
 
         private:
             void create();
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "ktx.h"
+
+#include "VulkanDevice.hpp"
+
+namespace VulkanLearning {
+
+    /*
+       Basis Universal textures (ETC1S or UASTC in a KTX2 file) are transcoded on load to a block
+       compressed format the device can sample with linear filtering. UASTC prefers ASTC 4x4, BC7
+       and ETC2, ETC1S prefers ETC2, BC1/BC3 and BC7, both fall back to RGBA8. KTX2 files that
+       aren't supercompressed with Basis keep their own format.
+       */
+
+    // Format a Basis Universal texture is transcoded to on this device
+    ktx_transcode_fmt_e getKtxTranscodeTarget(VulkanDevice* device, ktxTexture2* texture);
+
+    // Transcodes in place if needed, may be called from any thread. format is set to the format
+    // the image has to be created with, KTX1 files don't carry one and get fallbackFormat
+    ktxResult prepareKtxTexture(VulkanDevice* device, ktxTexture* texture, VkFormat fallbackFormat, VkFormat& format);
+
+    // Copy regions of all levels of the first layer and face, relative to ktxTexture_GetData
+    std::vector<VkBufferImageCopy> getKtxLevelRegions(ktxTexture* texture);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+#include "VulkanglTFModel.hpp"
+
+namespace VulkanLearning {
+
+    /*
+       Frustum and normal cone culling of a model's meshlets on core Vulkan compute.
+       Visible meshlets are compacted into an index buffer with one region per primitive,
+       each region is drawn with its own indirect draw so materials are bound as usual.
+       */
+    class VulkanMeshletCulling {
+        private:
+            struct UniformData {
+                glm::vec4 frustumPlanes[6];
+                glm::vec4 cameraPosition;
+                uint32_t meshletCount;
+                uint32_t coneCulling;
+            };
+
+            VulkanDevice* m_device;
+            VulkanglTFModel* m_model = nullptr;
+
+            VulkanBuffer m_uniformBuffer;
+            // Compacted indices, written by the compute pass and bound as index buffer
+            VulkanBuffer m_indexBuffer;
+            // One VkDrawIndexedIndirectCommand per primitive, reset from m_resetBuffer every frame
+            VulkanBuffer m_drawBuffer;
+            VulkanBuffer m_resetBuffer;
+
+            VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+            VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+            VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+            VkPipelineLayout m_pipelineLayout = VK_NULL_HANDLE;
+            VkPipeline m_pipeline = VK_NULL_HANDLE;
+
+        public:
+            bool coneCulling = true;
+
+            VulkanMeshletCulling(VulkanDevice* device);
+            ~VulkanMeshletCulling();
+
+            // The model must have been loaded with FileLoadingFlags::BuildMeshlets
+            void create(VulkanglTFModel* model);
+            void cleanup();
+
+            // Frustum planes are extracted from viewProjection, both in the model's space
+            void update(const glm::mat4& viewProjection, glm::vec3 cameraPosition);
+
+            // Records the culling pass, must be outside of a render pass
+            void dispatch(VkCommandBuffer commandBuffer);
+            // Draws the visible meshlets with the model's vertex buffer
+            void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+    };
+}
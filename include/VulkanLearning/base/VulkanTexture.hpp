@@ -11,6 +11,7 @@
 #include "VulkanBuffer.hpp"
 #include "VulkanCommandBuffer.hpp"
 #include "VulkanImageResource.hpp"
+#include "VulkanTextureBatch.hpp"
 
 namespace VulkanLearning {
 
@@ -56,13 +57,26 @@ namespace VulkanLearning {
                     VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                     bool forceLinear = false);
 
+            // Uploads an already loaded ktx texture, the caller keeps ownership of it
+            void loadFromKTXTexture(
+                    ktxTexture* ktxTexture,
+                    VkFormat format,
+                    VulkanDevice* device,
+                    VkQueue copyQueue,
+                    VkImageUsageFlags imageUsageFlag = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    bool forceLinear = false,
+                    VulkanTextureBatch* uploadBatch = nullptr);
+
+            // Mips are generated through the given batch, or through a local one flushed before returning
             void loadFromFile(
                     std::string filename,
                     VkFormat format,
                     VulkanDevice* device,
                     VkQueue copyQueue,
                     VkImageUsageFlags imageUsageFlag = VK_IMAGE_USAGE_SAMPLED_BIT,
-                    VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                    VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    VulkanTextureBatch* uploadBatch = nullptr);
 
             void loadFromBuffer(
                     void* buffer,
@@ -77,9 +91,6 @@ namespace VulkanLearning {
                     VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
         private:
-            void generateMipmaps(VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
-            void transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-            void copyBufferToImage(VulkanBuffer buffer, uint32_t width, uint32_t height);
             void createSampler();
     };
 
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+
+namespace VulkanLearning {
+
+    /*
+       Records the uploads and mip chain generation of many textures into a single command buffer
+       that is submitted once with a single fence. Mips are generated level by level across all
+       images so each level only needs one barrier call. Formats that can't be blitted into are
+       downsampled with a compute shader instead, or on the CPU as a last resort.
+       Pending uploads are flushed early once their staging data exceeds the flush threshold,
+       so the staging memory peaks at about one threshold instead of the whole scene.
+       */
+    class VulkanTextureBatch {
+        private:
+            struct Upload {
+                VkImage image;
+                VkFormat format;
+                uint32_t width;
+                uint32_t height;
+                uint32_t mipLevels;
+                // Levels already contained in the staging data, the remaining ones are generated
+                uint32_t providedLevels;
+                bool useCompute;
+                VkImageLayout finalLayout;
+                VulkanBuffer stagingBuffer;
+                std::vector<VkBufferImageCopy> copyRegions;
+            };
+
+            VulkanDevice* m_device;
+            VkQueue m_queue;
+            std::vector<Upload> m_uploads;
+            VkDeviceSize m_flushThreshold;
+            VkDeviceSize m_pendingSize = 0;
+
+            // Compute downsampler, only created if an image needs it
+            VkDescriptorSetLayout m_computeSetLayout = VK_NULL_HANDLE;
+            VkPipelineLayout m_computePipelineLayout = VK_NULL_HANDLE;
+            VkPipeline m_computePipeline = VK_NULL_HANDLE;
+            VkSampler m_computeSampler = VK_NULL_HANDLE;
+
+            void prepareComputePipeline();
+            void queueUpload(
+                    VkImage image,
+                    VkFormat format,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t mipLevels,
+                    uint32_t providedLevels,
+                    bool useCompute,
+                    const void* data,
+                    VkDeviceSize size,
+                    const std::vector<VkBufferImageCopy>& copyRegions,
+                    VkImageLayout finalLayout);
+            void addCpuMipmaps(
+                    VkImage image,
+                    VkFormat format,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t mipLevels,
+                    const void* data,
+                    VkImageLayout finalLayout);
+
+        public:
+            // A threshold of 0 disables the early flushes
+            VulkanTextureBatch(VulkanDevice* device, VkQueue queue, VkDeviceSize flushThreshold = 64 * 1024 * 1024);
+            ~VulkanTextureBatch();
+
+            bool canBlit(VkFormat format);
+            bool canComputeMipmaps(VkFormat format);
+            // 8 bit RGBA formats can always be downsampled on the CPU, sRGB ones are filtered in linear space
+            bool canCpuMipmaps(VkFormat format);
+
+            // Number of levels that can be generated for the format, 1 if neither path supports it
+            uint32_t getMipLevels(VkFormat format, uint32_t width, uint32_t height);
+            // Usage flags the image must be created with to be generated by this batch
+            VkImageUsageFlags getImageUsage(VkFormat format, uint32_t mipLevels);
+
+            // Uploads level 0 from data and generates the remaining mip levels
+            void add(
+                    VkImage image,
+                    VkFormat format,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t mipLevels,
+                    const void* data,
+                    VkDeviceSize size,
+                    VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+            // Uploads all levels described by the copy regions (e.g. from a ktx file), nothing is generated
+            void add(
+                    VkImage image,
+                    VkFormat format,
+                    uint32_t width,
+                    uint32_t height,
+                    uint32_t mipLevels,
+                    const void* data,
+                    VkDeviceSize size,
+                    const std::vector<VkBufferImageCopy>& copyRegions,
+                    VkImageLayout finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+            inline size_t getUploadCount() { return m_uploads.size(); }
+            inline VkDeviceSize getPendingSize() { return m_pendingSize; }
+
+            // Records everything added so far, submits it and waits on a single fence
+            void flush();
+    };
+}
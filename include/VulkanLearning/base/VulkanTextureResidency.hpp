@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+
+namespace VulkanLearning {
+
+    /*
+       Decides how many top mip levels of each texture are kept in device memory. Every frame the
+       renderer reports the finest level each texture needs (from its footprint on screen), update
+       then picks new resident levels: textures needing finer levels get them back, and while the
+       resident bytes exceed the budget the least recently used textures lose their top level,
+       first the levels nobody asked for, then the ones in use. The last levels up to tailSize
+       texels are never evicted so everything can always be sampled. Only bookkeeping happens
+       here, the caller recreates the images whose resident level update reports as changed.
+       */
+    class VulkanTextureResidency {
+        private:
+            struct Entry {
+                uint32_t mipLevels;
+                // Tightly packed bytes of each level
+                std::vector<VkDeviceSize> levelSizes;
+                // Coarsest level the texture may be trimmed to
+                uint32_t tailLevel;
+                uint32_t residentLevel;
+                // Finest level asked for during lastUsedFrame
+                uint32_t requiredLevel;
+                uint64_t lastUsedFrame = 0;
+                bool used = false;
+            };
+
+            VulkanDevice* m_device;
+            std::vector<Entry> m_entries;
+            uint64_t m_frame = 1;
+
+            VkDeviceSize m_residentBytes = 0;
+            VkDeviceSize m_budget = 0;
+            VkDeviceSize m_evictedBytes = 0;
+            VkDeviceSize m_reloadedBytes = 0;
+
+            VkDeviceSize getLevelBytes(const Entry& entry, uint32_t firstLevel);
+            bool isRecent(const Entry& entry);
+            VkDeviceSize queryBudget();
+
+        public:
+            // Bytes all managed textures may take, 0 derives it from the device local memory budget
+            VkDeviceSize budget = 0;
+            // Share of the device local budget given to textures when budget is 0
+            float budgetShare = 0.5f;
+            // Bytes reloaded per update, more requests wait for the next frames
+            VkDeviceSize reloadBudget = 32 * 1024 * 1024;
+            // Frames a texture counts as in use after it was last asked for
+            uint32_t retainFrames = 60;
+            // Levels up to this many texels per side always stay resident
+            uint32_t tailSize = 64;
+
+            VulkanTextureResidency(VulkanDevice* device);
+
+            // The format must be known to tools::getFormatBlock. Returns the index of the texture
+            uint32_t add(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+            // Level a new texture should be created with, its tail
+            uint32_t getInitialLevel(uint32_t index);
+
+            // Asks for the levels from requiredLevel down during the current frame
+            void use(uint32_t index, uint32_t requiredLevel);
+
+            // Picks the new resident levels and starts the next frame. Returns the textures whose
+            // resident level changed, getResidentLevel is their new first level
+            std::vector<uint32_t> update();
+
+            uint32_t getResidentLevel(uint32_t index);
+            uint32_t getTextureCount();
+            VkDeviceSize getResidentBytes();
+            // Budget the last update worked with
+            VkDeviceSize getBudget();
+            // Totals since the textures were added
+            VkDeviceSize getEvictedBytes();
+            VkDeviceSize getReloadedBytes();
+    };
+}
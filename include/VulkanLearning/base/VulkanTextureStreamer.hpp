@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+
+namespace VulkanLearning {
+
+    /*
+       Uploads the mip chains of many images a little at a time, the smallest pending level of any
+       image first, so every image gets a coarse version almost immediately and sharpens over the
+       next frames. Each update records at most uploadBudget bytes of copies into one submission,
+       large levels are split into bands of rows (rows of blocks for BC formats). A level becomes
+       resident once the submission that completed it has finished, update reports the images
+       whose resident level changed so their views can be recreated from getResidentLevel.
+       */
+    class VulkanTextureStreamer {
+        private:
+            struct Stream {
+                VkImage image;
+                uint32_t width;
+                uint32_t height;
+                uint32_t mipLevels;
+                // Texel block, 4x4 for BC formats, rows below are rows of blocks
+                uint32_t blockExtent;
+                uint32_t blockSize;
+                // Tightly packed levels, either owned or kept alive by the caller
+                std::vector<uint8_t> storage;
+                const uint8_t* data = nullptr;
+                std::vector<VkDeviceSize> levelOffsets;
+                // Levels not recorded yet, the next one is pendingLevels - 1
+                uint32_t pendingLevels;
+                // Rows of the next level recorded by earlier updates
+                uint32_t uploadedRows = 0;
+                // Lowest level recorded completely and lowest level the GPU has finished, mipLevels if none
+                uint32_t recordedLevel;
+                uint32_t residentLevel;
+            };
+
+            VulkanDevice* m_device;
+            VkQueue m_queue;
+
+            std::vector<Stream> m_streams;
+            // Levels handed over by loader threads, moved into the streams by update
+            struct Provided {
+                uint32_t index;
+                std::vector<uint8_t> storage;
+                const uint8_t* data;
+            };
+            std::mutex m_mutex;
+            std::vector<Provided> m_provided;
+
+            VkCommandPool m_commandPool = VK_NULL_HANDLE;
+            VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+            VkFence m_fence = VK_NULL_HANDLE;
+            bool m_submitted = false;
+            // Streams that complete a level with the submission in flight
+            std::vector<uint32_t> m_completing;
+            VulkanBuffer m_stagingBuffer;
+            VkDeviceSize m_stagingSize = 0;
+
+            VkDeviceSize m_pendingBytes = 0;
+            VkDeviceSize m_lastUploadBytes = 0;
+
+            void prepare(VkDeviceSize stagingSize);
+            void collectProvided();
+            VkDeviceSize getRowSize(const Stream& stream, uint32_t level);
+            uint32_t getRowCount(const Stream& stream, uint32_t level);
+            VkDeviceSize getLevelSize(const Stream& stream, uint32_t level);
+            void record();
+
+        public:
+            // Bytes copied per update, a single row larger than this is still uploaded on its own
+            VkDeviceSize uploadBudget = 8 * 1024 * 1024;
+
+            VulkanTextureStreamer(VulkanDevice* device, VkQueue queue);
+            ~VulkanTextureStreamer();
+            void cleanup();
+
+            // The image must have been created with all levels and transfer destination usage, its
+            // levels stay undefined until they are streamed. The format must be known to
+            // tools::getFormatBlock. Returns the index of the stream
+            uint32_t add(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+            // Hands over the tightly packed levels, from level 0 down, may be called from any thread.
+            // The external variant doesn't copy, data must stay valid until the stream is complete
+            void provide(uint32_t index, std::vector<uint8_t>&& levels);
+            void provideExternal(uint32_t index, const uint8_t* levels);
+
+            // Applies the finished submission and records the next one, never waits for the GPU.
+            // Returns the streams whose resident level changed since the last call
+            std::vector<uint32_t> update();
+
+            // Lowest level that can be sampled, mipLevels while nothing has arrived yet
+            uint32_t getResidentLevel(uint32_t index);
+            bool isComplete();
+            // Bytes not uploaded yet, of the levels provided so far
+            VkDeviceSize getPendingBytes();
+            VkDeviceSize getLastUploadBytes();
+    };
+}
@@ -59,6 +59,10 @@ namespace VulkanLearning {
                 VkPipelineStageFlags dstStageMask,
                 VkImageSubresourceRange subresourceRange);
 
+        // Texel block of the formats images are uploaded in from tightly packed levels, 1x1 for
+        // uncompressed ones. Returns false for formats that aren't handled
+        bool getFormatBlock(VkFormat format, uint32_t& blockExtent, uint32_t& blockSize);
+
     }
 }
 
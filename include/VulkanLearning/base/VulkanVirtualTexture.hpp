@@ -0,0 +1,215 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+#include "ThreadPool.hpp"
+
+namespace VulkanLearning {
+
+    /*
+       Software virtual texturing on core Vulkan, no sparse residency needed. Textures are placed
+       in one large virtual texture made of fixed size pages, each texture in a square of pages
+       aligned to its size, so down to the level where it fits a single page no page is shared.
+       Only the pages the camera needs are kept in a physical atlas of RGBA8 pages with a border
+       for filtering, an indirection texture with one texel per virtual page and level tells
+       shaders where a page is, or where its closest resident parent is while it's missing.
+
+       A feedback pass renders the page each pixel needs into a small R32_UINT target, which is
+       copied to host memory. Every frame in flight has its own target and copy, update hands the
+       copy of a finished frame to a worker thread that collects the requested pages. The pages of
+       the previous result are uploaded coarsest first without waiting for the GPU, evicting the
+       least recently requested ones once the atlas is full. The coarsest page of every texture
+       stays resident so there is always something to sample.
+
+       virtualTexture.glsl has the matching sampling and feedback functions.
+       */
+    class VulkanVirtualTexture {
+        public:
+            // Uniform block of virtualTexture.glsl
+            struct ShaderData {
+                // Virtual texels per side at level 0, page size, border, physical page size
+                glm::vec4 virtualSize;
+                // Atlas texels per side, level count, log2 of the feedback downscale, unused
+                glm::vec4 atlasSize;
+            };
+
+            // Pushed per draw: uv offset (xy) and scale (zw) in the virtual texture, and the
+            // coarsest level the texture has its own pages for
+            struct TextureInfo {
+                glm::vec4 transform;
+                uint32_t maxLevel;
+            };
+
+        private:
+            struct Texture {
+                // Tightly packed RGBA8 levels, kept alive by the caller
+                const uint8_t* levels;
+                std::vector<size_t> levelOffsets;
+                uint32_t width;
+                uint32_t height;
+                uint32_t mipLevels;
+                // Position and side of its square in level 0 pages
+                uint32_t pageX;
+                uint32_t pageY;
+                uint32_t pageCount;
+                uint32_t maxLevel;
+            };
+
+            // Feedback target and its copy in host memory, one per frame in flight
+            struct FeedbackFrame {
+                VkImage image = VK_NULL_HANDLE;
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                VkImageView view = VK_NULL_HANDLE;
+                VkImage depthImage = VK_NULL_HANDLE;
+                VkDeviceMemory depthMemory = VK_NULL_HANDLE;
+                VkImageView depthView = VK_NULL_HANDLE;
+                VkFramebuffer framebuffer = VK_NULL_HANDLE;
+                VulkanBuffer readbackBuffer;
+            };
+
+            // Page uploads take turns, a submission is only reused once its fence signaled
+            struct Upload {
+                VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+                VkFence fence = VK_NULL_HANDLE;
+                VulkanBuffer stagingBuffer;
+            };
+            static const uint32_t kUploadCount = 2;
+
+            // Physical page, key of the virtual page it holds
+            struct Slot {
+                uint32_t page = kInvalidPage;
+                uint64_t lastUsedFrame = 0;
+                // The coarsest page of a texture is never evicted
+                bool locked = false;
+            };
+
+            static const uint32_t kInvalidPage = 0xffffffff;
+
+            VulkanDevice* m_device;
+            VkQueue m_queue;
+
+            std::vector<Texture> m_textures;
+            // Texture owning each level 0 page, -1 for unused space
+            std::vector<int32_t> m_pageOwners;
+            uint32_t m_levelCount = 0;
+
+            std::vector<Slot> m_slots;
+            std::vector<uint32_t> m_freeSlots;
+            std::unordered_map<uint32_t, uint32_t> m_residentPages;
+            // Indirection texels of all levels back to back, one RGBA8 (x, y, level, 1) per page
+            std::vector<uint32_t> m_pageTable;
+            std::vector<size_t> m_pageTableOffsets;
+            uint64_t m_frame = 1;
+
+            VkImage m_atlasImage = VK_NULL_HANDLE;
+            VkDeviceMemory m_atlasMemory = VK_NULL_HANDLE;
+            VkImageView m_atlasView = VK_NULL_HANDLE;
+            VkImage m_indirectionImage = VK_NULL_HANDLE;
+            VkDeviceMemory m_indirectionMemory = VK_NULL_HANDLE;
+            VkImageView m_indirectionView = VK_NULL_HANDLE;
+            VkSampler m_atlasSampler = VK_NULL_HANDLE;
+            VkSampler m_indirectionSampler = VK_NULL_HANDLE;
+            VulkanBuffer m_uniformBuffer;
+
+            // Feedback targets at a fraction of the screen, copied into their readback buffer by endFeedbackPass
+            VkExtent2D m_feedbackExtent{};
+            VkRenderPass m_feedbackRenderPass = VK_NULL_HANDLE;
+            std::vector<FeedbackFrame> m_feedbackFrames;
+
+            // Decodes feedback copies, one at a time, into m_requests
+            std::unique_ptr<ThreadPool> m_feedbackWorker;
+            std::mutex m_requestMutex;
+            std::vector<uint32_t> m_requests;
+            bool m_requestsReady = false;
+            bool m_decoding = false;
+
+            VkCommandPool m_commandPool = VK_NULL_HANDLE;
+            std::vector<Upload> m_uploads;
+            uint32_t m_nextUpload = 0;
+
+            uint32_t m_requestedPageCount = 0;
+            uint32_t m_lastUploadCount = 0;
+            uint64_t m_uploadedPages = 0;
+            uint64_t m_evictedPages = 0;
+
+            uint32_t getPhysicalPageSize();
+            // Pages are keyed as level << 28 | y << 14 | x, as written by the feedback shader
+            static uint32_t pageKey(uint32_t level, uint32_t x, uint32_t y);
+            int32_t getPageOwner(uint32_t key);
+            void createImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageUsageFlags usage,
+                    VkImageAspectFlags aspect, VkImage& image, VkDeviceMemory& memory, VkImageView& view);
+            void createFeedbackTarget(uint32_t width, uint32_t height);
+            void destroyFeedbackTarget();
+            void decodeFeedback(std::vector<uint32_t> feedback);
+            // Copies the page with its border into dst, edges of the texture are clamped
+            void buildPage(uint32_t key, uint8_t* dst);
+            bool allocateSlot(uint32_t& slot);
+            void rebuildPageTable();
+            void upload(const std::vector<std::pair<uint32_t, uint32_t>>& pages);
+
+        public:
+            // Texels per page side without the border, and the border on each side
+            uint32_t pageSize = 128;
+            uint32_t pageBorder = 4;
+            // Level 0 pages per side of the virtual texture, a power of two up to 16384
+            uint32_t virtualPageCount = 256;
+            // Physical pages per side of the atlas, up to 256
+            uint32_t atlasPageCount = 16;
+            // The feedback target is the screen divided by this
+            uint32_t feedbackDivisor = 8;
+            // Pages uploaded per update
+            uint32_t pageUploadBudget = 32;
+            // Feedback targets, one per command buffer that records a feedback pass. 0 takes the
+            // swap chain image count
+            uint32_t feedbackFrameCount = 0;
+
+            VulkanVirtualTexture(VulkanDevice* device, VkQueue queue);
+            ~VulkanVirtualTexture();
+            void cleanup();
+
+            // Places a texture given as tightly packed RGBA8 levels from level 0 down, before create.
+            // The data must stay valid while the virtual texture exists. Returns the texture index
+            uint32_t addTexture(const uint8_t* levels, uint32_t width, uint32_t height, uint32_t mipLevels);
+            TextureInfo getTextureInfo(uint32_t index);
+
+            // Creates the atlas, the indirection texture and the feedback targets for a screen of
+            // width x height, and uploads the coarsest page of every texture
+            void create(uint32_t width, uint32_t height);
+            // Recreates the feedback targets after the swap chain changed, the device must be idle
+            void resize(uint32_t width, uint32_t height);
+
+            // Feedback pass with an R32_UINT color and a depth attachment, cleared to no request.
+            // endFeedbackPass ends the render pass and records the copy to host memory. frame picks
+            // the target, a command buffer always records the same one
+            VkRenderPass getFeedbackRenderPass();
+            VkExtent2D getFeedbackExtent();
+            void beginFeedbackPass(VkCommandBuffer commandBuffer, uint32_t frame);
+            void endFeedbackPass(VkCommandBuffer commandBuffer, uint32_t frame);
+
+            // Sampled by virtualTexture.glsl, valid from create on and never replaced
+            VkDescriptorImageInfo getAtlasDescriptor();
+            VkDescriptorImageInfo getIndirectionDescriptor();
+            VkDescriptorBufferInfo getUniformDescriptor();
+
+            // Uploads the pages of the last decoded feedback and starts decoding the copy of frame.
+            // Call once per frame after the fence of frame's last submission signaled, uploads are
+            // submitted to the queue without waiting. Returns true if pages were uploaded
+            bool update(uint32_t frame);
+
+            uint32_t getResidentPageCount();
+            uint32_t getPhysicalPageCount();
+            // Distinct pages of the last decoded feedback
+            uint32_t getRequestedPageCount();
+            uint32_t getLastUploadCount();
+            uint64_t getUploadedPageCount();
+            uint64_t getEvictedPageCount();
+    };
+}
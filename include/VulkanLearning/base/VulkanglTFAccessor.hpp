@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Forward declared for the same reason as in VulkanglTFImageLoader.hpp
+namespace tinygltf {
+    class Model;
+    struct Accessor;
+    struct Scene;
+}
+
+namespace VulkanLearning {
+
+    /*
+       Decodes glTF accessors straight into pre-sized arrays owned by the caller. Byte strides,
+       normalized integer components and sparse substitutions are resolved here so the loaders
+       only ever see floats and 32 bit indices.
+       */
+
+    // Writes min(accessor components, dstComponents) floats per element to dst, one element every
+    // dstStride bytes. Components past the accessor's are left untouched so callers can prefill defaults.
+    bool readAccessor(
+            const tinygltf::Model& model,
+            const tinygltf::Accessor& accessor,
+            float* dst,
+            size_t dstStride,
+            uint32_t dstComponents,
+            size_t* decodedBytes = nullptr);
+
+    // Widens any index type to 32 bits and adds vertexOffset to every index
+    bool readIndices(
+            const tinygltf::Model& model,
+            const tinygltf::Accessor& accessor,
+            uint32_t* dst,
+            uint32_t vertexOffset,
+            size_t* decodedBytes = nullptr);
+
+    // Vertex and index totals of all indexed primitives reachable from the scene, meshes
+    // referenced by several nodes are counted once per node like the loaders duplicate them
+    void getSceneGeometrySize(
+            const tinygltf::Model& model,
+            const tinygltf::Scene& scene,
+            size_t& vertexCount,
+            size_t& indexCount);
+}
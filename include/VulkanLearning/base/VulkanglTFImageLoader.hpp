@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+
+// tiny_gltf.h isn't included here: it carries its implementation, which the one file defining
+// TINYGLTF_IMPLEMENTATION must only see once
+namespace tinygltf {
+    struct Image;
+    struct Texture;
+}
+
+namespace VulkanLearning {
+
+    /*
+       Image loader callback for tinygltf that only keeps the encoded bytes (and skips ktx files),
+       the actual decoding is done later with decodeImageData so it can run on worker threads
+       */
+    bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData);
+
+    // KTX1 or KTX2 file, the latter possibly embedded with KHR_texture_basisu
+    bool isKtxImage(const tinygltf::Image& image);
+
+    // Image of a texture, the KHR_texture_basisu source is preferred when there is one
+    int getTextureSource(const tinygltf::Texture& texture);
+
+    // Thread safe, each call only touches the given image
+    void decodeImageData(tinygltf::Image* image, int imageIndex, const std::string& path);
+}
@@ -8,11 +8,20 @@
 #include <glm/ext/vector_float3.hpp>
 #include <glm/gtx/hash.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <memory>
 
 #define TINYGLTF_NO_STB_IMAGE_WRITE
 #include "tiny_gltf.h"
 
 #include "VulkanBase.hpp"
+#include "VulkanglTFImageLoader.hpp"
+#include "VulkanglTFAccessor.hpp"
+#include "MeshOptimizer.hpp"
+#include "TransformHierarchy.hpp"
+#include "AnimationCompression.hpp"
+#include "AssetCache.hpp"
 
 namespace VulkanLearning {
 
@@ -22,7 +31,7 @@ namespace VulkanLearning {
     };
 
     extern VkDescriptorSetLayout descriptorSetLayoutImage;
-    extern VkDescriptorSetLayout descriptorSetLayoutUbo;
+    extern VkDescriptorSetLayout descriptorSetLayoutNodeTransforms;
 
     extern VkMemoryPropertyFlags memoryPropertyFlags;
     extern uint32_t descriptorBindingFlags;
@@ -35,6 +44,7 @@ namespace VulkanLearning {
         VkImageLayout imageLayout;
         VkDeviceMemory deviceMemory;
         VkImageView view;
+        VkFormat format;
         uint32_t width, height;
         uint32_t mipLevels;
         uint32_t layerCount;
@@ -42,7 +52,17 @@ namespace VulkanLearning {
         VkSampler sampler;
         void updateDescriptor();
         void destroy();
-        void fromglTFImage(tinygltf::Image& gltfImage, std::string path, VulkanDevice* device, VkQueue copyQueue);
+        // Records the upload into uploadBatch if given, otherwise the texture is uploaded before returning
+        void fromglTFImage(tinygltf::Image& gltfImage, std::string path, VulkanDevice* device, VkQueue copyQueue, VulkanTextureBatch* uploadBatch = nullptr);
+        // Same for a ktx texture loaded and transcoded by prepareKtxTexture, the caller keeps ownership of it
+        void fromKtxTexture(ktxTexture* ktxTexture, VkFormat format, VulkanDevice* device, VkQueue copyQueue, VulkanTextureBatch* uploadBatch = nullptr);
+        // Same for a complete mip chain already in memory, e.g. mapped from the asset cache
+        void fromPixels(const void* data, VkDeviceSize size, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, const std::vector<VkBufferImageCopy>& regions, VulkanDevice* device, VkQueue copyQueue, VulkanTextureBatch* uploadBatch = nullptr);
+        // Device local image of the current size and mip count, and the view and sampler for it
+        void createImage(VkFormat format, VkImageUsageFlags usage);
+        void createSampler();
+        // Views the levels from baseMipLevel down, replacing the current view and descriptor
+        void createView(uint32_t baseMipLevel = 0);
     };
 
     struct Material {
@@ -66,6 +86,8 @@ namespace VulkanLearning {
 
         Material(VulkanDevice* device) : device(device) {};
         void createDescriptorSet(VkDescriptorPool descriptorPool, VkDescriptorSetLayout descriptorSetLayout, uint32_t descriptorBindingFlags);
+        // Writes the current texture descriptors, command buffers using the set must be recorded again
+        void updateDescriptorSet(uint32_t descriptorBindingFlags);
     };
 
     struct Primitive {
@@ -83,6 +105,26 @@ namespace VulkanLearning {
             float radius;
         } dimensions;
 
+        // Level of detail chain stored after the full index range, lods[0] is the full resolution
+        struct Lod {
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            // Simplification error relative to dimensions.radius
+            float error;
+        };
+        std::vector<Lod> lods;
+        uint32_t currentLod = 0;
+        // Result of the last VulkanglTFModel::updateVisibility, invisible primitives aren't drawn
+        bool visible = true;
+        // RenderFlags pass bit matching the material's alpha mode, resolved once at load
+        uint32_t renderPass = 0;
+
+        // Meshlets of the full resolution range and the indirect draw they are compacted into
+        uint32_t firstMeshlet = 0;
+        uint32_t meshletCount = 0;
+        uint32_t meshletDrawIndex = 0;
+        uint32_t meshletFirstIndex = 0;
+
         void setDimensions(glm::vec3 min, glm::vec3 max);
         Primitive(uint32_t firstIndex, uint32_t indexCount, Material& material) : firstIndex(firstIndex), indexCount(indexCount), material(material) {};
     };
@@ -93,19 +135,13 @@ namespace VulkanLearning {
         std::vector<Primitive*> primitives;
         std::string name;
 
-        struct UniformBuffer {
-            VulkanBuffer buffer;
-            VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
-        } uniformBuffer;
+        // Index of the mesh matrix in the model's node transform buffer, drawn as the first instance
+        uint32_t transformSlot = 0;
 
-        struct UniformBlock {
-            glm::mat4 matrix;
-            glm::mat4 jointMatrix[64]{};
-            float jointCount{ 0 };
-        } uniformBlock;
-       
-        Mesh(VulkanDevice* device, glm::mat4 matrix);
-        ~Mesh();
+        // Maps quantized positions back to model space, identity unless compact vertices are used
+        glm::mat4 dequantization = glm::mat4(1.0f);
+
+        Mesh(VulkanDevice* device);
     };
 
     struct Skin {
@@ -124,12 +160,15 @@ namespace VulkanLearning {
         Mesh* mesh;
         Skin* skin;
         int32_t skinIndex = -1;
+        // Load time values, once the node is in a hierarchy the current ones live there
         glm::vec3 translation{};
         glm::vec3 scale{1.0f};
         glm::quat rotation{};
+        TransformHierarchy* hierarchy = nullptr;
+        uint32_t transformIndex = 0;
         glm::mat4 localMatrix();
+        // Cached world matrix when the node is in a hierarchy, as of its last update
         glm::mat4 getMatrix();
-        void update();
         ~Node();
     };
 
@@ -144,7 +183,26 @@ namespace VulkanLearning {
         enum InterpolationType { LINEAR, STEP, CUBICSPLINE };
         InterpolationType interpolation;
         std::vector<float> inputs;
-        std::vector<glm::vec4> outputsVec4;
+        // Keyframe values, components floats per key; cubic spline tangents are kept in their own arrays
+        uint32_t components = 4;
+        std::vector<float> values;
+        std::vector<float> inTangents;
+        std::vector<float> outTangents;
+        // Key of the last sample, playback moving forward finds its next key in constant time
+        uint32_t cursor = 0;
+        // Set when compressed, values are then replaced by three 16 bit words per key:
+        // smallest three for rotations, positions within quantizationRange otherwise
+        bool quantized = false;
+        std::vector<uint16_t> quantizedValues;
+        AnimationCompression::QuantizationRange quantizationRange{};
+
+        bool hasKeys() const;
+        // Bytes held by the key times and values
+        size_t memorySize() const;
+        // Index of the key starting the interval containing time, clamped to the key range
+        uint32_t findKey(float time);
+        // Interpolated value, quaternions are slerped and normalized when rotation is set
+        glm::vec4 sample(float time, bool rotation);
     };
 
     struct Animation {
@@ -174,12 +232,89 @@ namespace VulkanLearning {
         static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);    
     };
 
+    /*
+       24 byte layout used with FileLoadingFlags::CompactVertices for static meshes:
+       snorm16 positions relative to the mesh bounds (w holds the tangent handedness),
+       octahedral snorm16 normals and tangents, half float uvs and unorm8 colors.
+       Joints and weights are not stored.
+       */
+    struct CompactVertex {
+        glm::uint64 pos;
+        glm::uint normal;
+        glm::uint tangent;
+        glm::uint uv;
+        glm::uint color;
+        static VkVertexInputBindingDescription vertexInputBindingDescription;
+        static std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
+        static VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo;
+        static VkVertexInputBindingDescription inputBindingDescription(uint32_t binding);
+        static VkVertexInputAttributeDescription inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component);
+        static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components);
+        static VkPipelineVertexInputStateCreateInfo* getPipelineVertexInputState(const std::vector<VertexComponent> components);
+    };
+
+    /*
+       Material factors as shaders read them from a storage buffer (std430), see VulkanglTFModel::getMaterialData.
+       Textures can't vary per instance, they come from the material bound for the draw
+       */
+    struct MaterialData {
+        glm::vec4 baseColorFactor = glm::vec4(1.0f);
+        float metallicFactor = 1.0f;
+        float roughnessFactor = 1.0f;
+        float alphaCutoff = 1.0f;
+        // Material::AlphaMode
+        uint32_t alphaMode = 0;
+    };
+
+    /*
+       Per instance data of VulkanglTFModel::drawInstanced, read from an instance rate vertex
+       stream at binding 1: the model matrix on four consecutive locations, a factor multiplied
+       with the base color, then the index of the instance's MaterialData in the table the
+       shader reads, so every instance can use its own material.
+       */
+    struct InstanceData {
+        glm::mat4 matrix = glm::mat4(1.0f);
+        glm::vec4 baseColorFactor = glm::vec4(1.0f);
+        uint32_t materialIndex = 0;
+        uint32_t padding[3] = {};
+        static VkVertexInputBindingDescription inputBindingDescription(uint32_t binding);
+        static std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions(uint32_t binding, uint32_t firstLocation);
+    };
+
+    // Meshlet as read by meshletCull.comp, indices are expanded to absolute vertex indices
+    struct MeshletData {
+        // Bounding sphere center (xyz) and radius (w)
+        glm::vec4 sphere;
+        // Normal cone axis (xyz) and cutoff (w), see MeshOptimizer::MeshletBounds
+        glm::vec4 cone;
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        uint32_t drawIndex;
+        uint32_t padding;
+    };
+
     enum FileLoadingFlags {
         None = 0x00000000,
         PreTransformVertices = 0x00000001,
         PreMultiplyVertexColors = 0x00000002,
         FlipY = 0x00000004,
-        DontLoadImages = 0x00000008
+        DontLoadImages = 0x00000008,
+        CompactVertices = 0x00000010,
+        SeparatePositions = 0x00000020,
+        OptimizeMeshes = 0x00000040,
+        GenerateLods = 0x00000080,
+        BuildMeshlets = 0x00000100,
+        CompressAnimations = 0x00000200,
+        UseAssetCache = 0x00000400,
+        StreamTextures = 0x00000800,
+        CompressTextures = 0x00001000,
+        ManageTextureResidency = 0x00002000
+    };
+
+    // Vertex streams bound by VulkanglTFModel::bindBuffers, in this order from binding 0
+    enum VertexStreamFlags {
+        AttributeStream = 0x00000001,
+        PositionStream = 0x00000002
     };
 
     enum RenderFlags {
@@ -195,6 +330,63 @@ namespace VulkanLearning {
             Texture emptyTexture;
             void createEmptyTexture(VkQueue trasferQueue);
 
+            // Texture as stored in the asset cache, levels are tightly packed from offset.
+            // No mip levels means the image is loaded from its source file
+            struct CookedTexture {
+                uint32_t width;
+                uint32_t height;
+                uint32_t mipLevels;
+                uint32_t format;
+                uint64_t offset;
+                uint64_t size;
+            };
+            // Final ranges of a primitive in the order loadNode creates them, lods index cookedLods
+            struct CookedPrimitive {
+                uint32_t firstIndex;
+                uint32_t indexCount;
+                uint32_t firstVertex;
+                uint32_t vertexCount;
+                glm::vec3 min;
+                glm::vec3 max;
+                uint32_t firstLod;
+                uint32_t lodCount;
+            };
+            // Geometry section of the asset cache
+            struct CookedGeometry {
+                uint32_t compactVertices;
+                uint32_t vertexStride;
+                uint64_t vertexCount;
+                uint64_t indexCount;
+                uint64_t vertexOffset;
+                uint64_t indexOffset;
+                glm::vec4 dequantization;
+            };
+            std::vector<CookedTexture> cookedTextures;
+            // Set while loading from the asset cache, loadNode then takes the ranges from here
+            std::vector<CookedPrimitive> cookedPrimitives;
+            std::vector<Primitive::Lod> cookedLods;
+            size_t nextCookedPrimitive = 0;
+
+            uint64_t getAssetCacheKey(const std::string& filename, uint32_t fileLoadingFlags, float scale);
+            // Reads the tables of a cache file, false if it's stale, from another key or damaged
+            bool readAssetCache(const AssetCache::MappedFile& file, uint64_t key, CookedGeometry& geometry, std::vector<glm::mat4>& meshDequantizations);
+            // Appends the geometry and the tables, false if an image couldn't be cooked
+            bool writeAssetCache(AssetCache::Writer& writer, const tinygltf::Model& gltfModel, const CookedGeometry& geometry, const void* vertexData, const void* indexData);
+            void loadCookedImages(tinygltf::Model& gltfModel, const AssetCache::MappedFile& file, VulkanDevice* device, VkQueue transferQueue);
+
+            // Loader threads and uploads of FileLoadingFlags::StreamTextures, alive until every level is resident
+            struct TextureStreaming;
+            std::unique_ptr<TextureStreaming> textureStreaming;
+            void streamImages(tinygltf::Model& gltfModel, VulkanDevice* device, VkQueue transferQueue);
+            void streamCookedImages(tinygltf::Model& gltfModel, VulkanDevice* device, VkQueue transferQueue);
+
+            // Residency manager and cache mapping of FileLoadingFlags::ManageTextureResidency
+            struct TextureResidency;
+            std::unique_ptr<TextureResidency> textureResidency;
+            void loadResidentCookedImages(tinygltf::Model& gltfModel, VulkanDevice* device, VkQueue transferQueue);
+            // Recreates the image of a cooked texture with the levels from firstLevel down
+            void loadResidentLevels(Texture& texture, const CookedTexture& cooked, uint32_t firstLevel, VulkanTextureBatch& uploadBatch);
+
         public:
             VulkanDevice* device;
             VkDescriptorPool descriptorPool;
@@ -209,12 +401,47 @@ namespace VulkanLearning {
                 VulkanBuffer buffer;
             } indices;
 
+            // Tightly packed positions only, vec3 or the CompactVertex position with compact vertices.
+            // Uploaded with FileLoadingFlags::SeparatePositions for passes that don't need attributes
+            struct Positions {
+                VulkanBuffer buffer;
+            } positions;
+
+            // Built with FileLoadingFlags::BuildMeshlets for pre-transformed models, culled by VulkanMeshletCulling
+            struct Meshlets {
+                uint32_t count = 0;
+                // Primitives with meshlets, each one gets an indirect draw
+                uint32_t drawCount = 0;
+                uint32_t indexCount = 0;
+                // MeshletData storage buffer
+                VulkanBuffer buffer;
+                // Triangle lists of all meshlets, back to back
+                VulkanBuffer indices;
+            } meshlets;
+            uint32_t maxMeshletVertices = 64;
+            uint32_t maxMeshletTriangles = 124;
        
             std::vector<Node*> nodes;
             std::vector<Node*> linearNodes;
+            // Local and world transforms of all nodes, parents first
+            TransformHierarchy transforms;
 
             std::vector<Skin*> skins;
 
+            // Node matrix times dequantization of every mesh node, indexed by Mesh::transformSlot
+            std::vector<glm::mat4> nodeMatrices;
+            // Host visible storage buffer holding nodeMatrices once per frame, so a frame is never written
+            // while the GPU may still read it. By default there is one frame per swap chain image and the
+            // image index is the frame, as for the command buffers recorded per image
+            struct NodeTransforms {
+                VulkanBuffer buffer;
+                // 0 picks the device's swap chain image count when loading
+                uint32_t frameCount = 0;
+                // Bytes per frame, padded to the storage buffer offset alignment
+                VkDeviceSize frameSize = 0;
+                std::vector<VkDescriptorSet> descriptorSets;
+            } nodeTransforms;
+
             std::vector<Texture> textures;
             std::vector<Material> materials;
             std::vector<Animation> animations;
@@ -230,24 +457,126 @@ namespace VulkanLearning {
             bool metallicRoughnessWorkflow = true;
             bool buffersBound = false;
             std::string path;
-
-            VulkanglTFModel() {};
+            // Worker threads used to decode images, 0 uses all hardware threads
+            uint32_t imageLoadingThreadCount = 0;
+            // Prints load timings and statistics to the console
+            bool verbose = false;
+            // Source bytes read from vertex and index accessors by the last load
+            size_t decodedAccessorBytes = 0;
+            // Set if the vertex buffer holds CompactVertex instead of Vertex
+            bool compactVertices = false;
+            // Offset (xyz) and scale (w) of quantized positions when they were pre-transformed,
+            // otherwise every mesh carries its own dequantization matrix
+            glm::vec4 dequantization = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+            // Set if the position stream was uploaded
+            bool separatePositions = false;
+            // Set by FileLoadingFlags::OptimizeMeshes, primitives are reordered as they are loaded
+            bool optimizeMeshes = false;
+            // Post-transform cache statistics summed over the optimized primitives
+            MeshOptimizer::VertexCacheStatistics cacheStatisticsBefore;
+            MeshOptimizer::VertexCacheStatistics cacheStatisticsAfter;
+            // Set by FileLoadingFlags::GenerateLods, every triangle list primitive gets up to maxLodCount levels
+            bool generateLods = false;
+            uint32_t maxLodCount = 5;
+            // Triangles drawn with the LODs picked by the last selectLods call
+            size_t selectedTriangleCount = 0;
+            // Maximum per component error of the keys removed by FileLoadingFlags::CompressAnimations
+            float animationTolerance = 0.0001f;
+            // Largest deviation from the source keys after compression, in radians for rotations
+            float animationMaxVectorError = 0.0f;
+            float animationMaxRotationError = 0.0f;
+            // Directory of the files written by FileLoadingFlags::UseAssetCache, next to the model if empty
+            std::string assetCachePath;
+            // Set if the last load was served from the asset cache
+            bool loadedFromAssetCache = false;
+            // Set by FileLoadingFlags::StreamTextures, textures start out as the empty texture and get
+            // their smallest levels first, see updateTextureStreaming
+            bool streamTextures = false;
+            // Bytes per updateTextureStreaming call
+            VkDeviceSize textureStreamingBudget = 8 * 1024 * 1024;
+            // Set by FileLoadingFlags::CompressTextures together with UseAssetCache, images are cooked
+            // to BC7
+            bool compressTextures = false;
+            // Cooks opaque color images to BC1 instead, half the size of BC7 at a lower quality
+            bool compressColorToBC1 = false;
+            // Cooks normal maps to BC5 instead, same size as BC7 with better X and Y. BC5 drops Z, only
+            // set this if the shaders sampling the normal map rebuild it as sqrt(1 - dot(n.xy, n.xy))
+            bool compressNormalMapsToBC5 = false;
+            // Set by FileLoadingFlags::ManageTextureResidency on a warm asset cache load, cooked textures
+            // start with their smallest levels and the top ones are loaded and evicted to stay within
+            // textureResidencyBudget, see updateTextureUsage and updateTextureResidency
+            bool manageTextureResidency = false;
+            // Bytes of texture levels kept resident, 0 takes half of the device local memory budget
+            VkDeviceSize textureResidencyBudget = 0;
+            // Primitives inside and outside the frustum of the last updateVisibility call
+            uint32_t visiblePrimitiveCount = 0;
+            uint32_t culledPrimitiveCount = 0;
+
+            // Pipeline vertex input state for the position stream alone
+            VkVertexInputBindingDescription positionInputBindingDescription{};
+            VkVertexInputAttributeDescription positionInputAttributeDescription{};
+            VkPipelineVertexInputStateCreateInfo positionInputStateCreateInfo{};
+
+            // Pipeline vertex input state for the vertex components followed by InstanceData
+            std::array<VkVertexInputBindingDescription, 2> instancedInputBindingDescriptions{};
+            std::vector<VkVertexInputAttributeDescription> instancedInputAttributeDescriptions;
+            VkPipelineVertexInputStateCreateInfo instancedInputStateCreateInfo{};
+
+            VulkanglTFModel();
             ~VulkanglTFModel();
 
             void loadNode(Node* parent, const tinygltf::Node& node, uint32_t nodeIndex, const tinygltf::Model& model, std::vector<uint32_t>& indexBuffer, std::vector<Vertex>& vertexBuffer, float globalscale);
             void loadSkins(tinygltf::Model& gltfModel);
-            void loadImages(tinygltf::Model& gltfModel, VulkanDevice* device, VkQueue transferQueue);
+            // Images are also cooked into cookWriter with their full mip chain if given
+            void loadImages(tinygltf::Model& gltfModel, VulkanDevice* device, VkQueue transferQueue, AssetCache::Writer* cookWriter = nullptr);
             void loadMaterials(tinygltf::Model& gltfModel);
             void loadAnimations(tinygltf::Model& gltfModel);
+            // Drops keys within tolerance of their interpolation and quantizes the rest, cubic splines are kept as is
+            void compressAnimations(float tolerance);
+            void buildMeshlets(const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer);
             void loadFromFile(std::string filename, VulkanDevice* device, VkQueue transferQueue, uint32_t fileLoadingFlags = FileLoadingFlags::None, float scale = 1.0f);
-            void bindBuffers(VkCommandBuffer commandBuffer);
+            // Uploads the next part of the streamed textures and switches the views of the ones that got
+            // new levels. Call once per frame while the device is idle, true if the material descriptor
+            // sets changed and command buffers have to be recorded again
+            bool updateTextureStreaming();
+            // Bytes of decoded texture levels still to be uploaded, 0 once streaming is complete
+            VkDeviceSize getTextureStreamingPendingBytes();
+            // Asks for the mip level of every texture of the visible primitives that matches their size
+            // on screen, projectionScale as for selectLods. Call once per frame after updateVisibility
+            void updateTextureUsage(glm::vec3 cameraPosition, float projectionScale);
+            // Loads and evicts top mip levels for the usage of the last updateTextureUsage call. Call
+            // once per frame while the device is idle, true if command buffers have to be recorded again
+            bool updateTextureResidency();
+            // Bytes of the managed texture levels in device memory and the budget they are kept under
+            VkDeviceSize getResidentTextureBytes();
+            VkDeviceSize getTextureResidencyBudget();
+            void bindBuffers(VkCommandBuffer commandBuffer, uint32_t vertexStreams = VertexStreamFlags::AttributeStream);
+            VkPipelineVertexInputStateCreateInfo* getPositionInputState(uint32_t binding = 0, uint32_t location = 0);
+            // Vertex components at binding 0 from location 0, InstanceData at binding 1 on the next locations
+            VkPipelineVertexInputStateCreateInfo* getInstancedInputState(const std::vector<VertexComponent> components);
+            // Factors of all materials in the order of materials, the start of an instance material table
+            std::vector<MaterialData> getMaterialData();
+            bool updateVisibility(const Frustum& frustum);
+            bool selectLods(glm::vec3 cameraPosition, float projectionScale, float maxPixelError = 1.0f);
             void drawNode(Node* node, VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
             void draw(VkCommandBuffer commandBuffer, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1);
+            // Draws every primitive once for instanceCount InstanceData of instanceBuffer. Node matrices
+            // aren't applied, load with FileLoadingFlags::PreTransformVertices. A material override is
+            // bound instead of the primitives' own ones with RenderFlags::BindImages
+            void drawInstanced(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, uint32_t instanceCount, uint32_t renderFlags = 0, VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t bindImageSet = 1, Material* materialOverride = nullptr);
             void getNodeDimensions(Node* node, glm::vec3& min, glm::vec3& max);
             void getSceneDimensions();
             void updateAnimation(uint32_t index, float time);
+            void buildTransformHierarchy();
+            // Refreshes the dirty world matrices and the node matrices of the meshes they affect
+            void updateTransforms();
+            void updateNodeMatrix(Node* node);
+            // Copies nodeMatrices into the region of the frame, the GPU must be done with its previous use
+            void updateNodeTransforms(uint32_t frame);
+            // Shaders read the matrix of a draw as nodes[gl_InstanceIndex]
+            void bindNodeTransforms(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, uint32_t frame);
             Node* findNode(Node* parent, uint32_t index);
             Node* nodeFromIndex(uint32_t index);
-            void prepareNodeDescriptor(Node* node, VkDescriptorSetLayout descriptorSetLayout);
+            void prepareNodeTransforms();
     };
 }
@@ -15,6 +15,8 @@
 #include "tiny_gltf.h"
 
 #include "VulkanBase.hpp"
+#include "VulkanglTFAccessor.hpp"
+#include "DrawList.hpp"
 
 namespace VulkanLearning {
 
@@ -22,6 +24,10 @@ namespace VulkanLearning {
         public:
             VulkanDevice* device;
             VkQueue copyQueue;
+            // Worker threads used to read images, 0 uses all hardware threads
+            uint32_t imageLoadingThreadCount = 0;
+            // Prints the image loading time to the console
+            bool verbose = false;
 
             struct Vertex {
                 glm::vec3 pos;
@@ -46,6 +52,8 @@ namespace VulkanLearning {
                 uint32_t firstIndex;
                 uint32_t indexCount;
                 int32_t materialIndex;
+                // Center of the vertex bounds in node space, used for depth sorting
+                glm::vec3 center = glm::vec3(0.0f);
             };
 
             struct Mesh {
@@ -87,6 +95,18 @@ namespace VulkanLearning {
 
             std::string path;
 
+            // Visible primitives flattened by buildDrawList, with their world matrices
+            // and centers, sortDrawList orders a copy of them for drawSorted
+            std::vector<DrawList::DrawItem> drawItems;
+            std::vector<DrawList::DrawItem> sortedDrawItems;
+            std::vector<DrawList::DrawItem> sortScratch;
+            std::vector<glm::mat4> drawTransforms;
+            std::vector<glm::vec3> drawCenters;
+            // Pipeline slot of every material, materials sharing a pipeline share a slot
+            std::vector<uint32_t> materialPipelineIds;
+            // State changes of the last draw or drawSorted call
+            DrawList::BindStatistics bindStatistics;
+
             VulkanglTFScene();
             ~VulkanglTFScene();
 
@@ -96,9 +116,15 @@ namespace VulkanLearning {
             void loadTextures(tinygltf::Model& input);
             void loadMaterials(tinygltf::Model& input);
             void loadNode(const tinygltf::Node& inputNode, const tinygltf::Model& input, VulkanglTFScene::Node* parent, std::vector<uint32_t>& indexBuffer, std::vector<VulkanglTFScene::Vertex>& vertexBuffer);
-            void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node node);
+            void drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const VulkanglTFScene::Node& node, const glm::mat4& parentMatrix);
             void draw(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
 
+            // Flattens the visible nodes, needs the material pipelines and must be called again when visibility changes
+            void buildDrawList();
+            // Sorts by pass, pipeline and material, blended draws back to front. Returns true if the order changed
+            bool sortDrawList(const glm::mat4& view);
+            void drawSorted(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout);
+
             void cleanup();
     };
 }
@@ -13,6 +13,8 @@
 #include "tiny_gltf.h"
 
 #include "VulkanBase.hpp"
+#include "VulkanglTFImageLoader.hpp"
+#include "VulkanglTFAccessor.hpp"
 
 namespace VulkanLearning {
 
@@ -20,6 +22,10 @@ namespace VulkanLearning {
         public:
             VulkanDevice* device;
             VkQueue copyQueue;
+            // Worker threads used to decode images, 0 uses all hardware threads
+            uint32_t imageLoadingThreadCount = 0;
+            // Prints the image loading time to the console
+            bool verbose = false;
 
             struct Vertex {
                 glm::vec3 pos;
@@ -75,6 +81,9 @@ namespace VulkanLearning {
             std::vector<Material> materials;
             std::vector<Node> nodes;
 
+            // Directory of the glTF file, external KTX images are read relative to it
+            std::string path;
+
             VulkanglTFSimpleModel();
             ~VulkanglTFSimpleModel();
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+namespace VulkanLearning {
+
+    /*
+       View frustum planes extracted from a view-projection matrix, in the space the matrix
+       transforms from. Boxes are tested against four planes at once with SSE or NEON.
+       */
+    class Frustum {
+        private:
+            // Planes transposed into two groups of four, the last group repeats the far plane
+            alignas(16) float m_planeGroups[2][4][4];
+
+        public:
+            enum Side { Left = 0, Right = 1, Bottom = 2, Top = 3, Near = 4, Far = 5 };
+
+            // Normalized, inside is where dot(plane, vec4(p, 1)) >= 0
+            std::array<glm::vec4, 6> planes;
+
+            Frustum();
+
+            // The near plane assumes a -1..1 depth range, which is conservative for 0..1 projections
+            void update(const glm::mat4& viewProjection);
+
+            bool checkSphere(glm::vec3 center, float radius) const;
+            // Box given by its center and half extent
+            bool checkBox(glm::vec3 center, glm::vec3 extent) const;
+            // Writes 1 for every box intersecting the frustum and 0 otherwise, returns the number of visible boxes
+            size_t checkBoxes(const glm::vec3* centers, const glm::vec3* extents, uint8_t* visible, size_t count) const;
+
+            // Axis aligned bounds of a transformed box, as center and half extent
+            static void transformBox(const glm::mat4& matrix, glm::vec3 min, glm::vec3 max, glm::vec3& center, glm::vec3& extent);
+    };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VulkanLearning {
+
+    /*
+       Import time compression of animation keys: removal of keys that interpolation of their
+       neighbours reproduces, smallest three quaternions and range quantized vectors, both
+       stored as three 16 bit values per key. Quaternions are x, y, z, w.
+       */
+    namespace AnimationCompression {
+
+        // Per component offset and size of the quantized range
+        struct QuantizationRange {
+            float min[3];
+            float extent[3];
+        };
+
+        // Indices of the keys to keep, always including the first and last one. A key is dropped when
+        // interpolating the kept keys around it stays within tolerance (per component) of every
+        // original key in between. Rotations are slerped, step keys are only dropped when they repeat
+        // the previous value
+        std::vector<uint32_t> reduceKeys(const float* times, const float* values, size_t keyCount, uint32_t components, bool rotation, bool step, float tolerance);
+
+        // Largest component index in 2 bits, the three others in 15 bits each
+        void encodeQuaternion(const float q[4], uint16_t out[3]);
+        void decodeQuaternion(const uint16_t in[3], float q[4]);
+
+        QuantizationRange computeRange(const float* values, size_t keyCount, uint32_t components);
+        void encodeVector(const float v[3], const QuantizationRange& range, uint16_t out[3]);
+        void decodeVector(const uint16_t in[3], const QuantizationRange& range, float out[3]);
+
+        // Interpolation used for the key reduction, matching the sampler
+        void interpolate(const float* a, const float* b, float u, uint32_t components, bool rotation, float* out);
+        // Rotation angle in radians between two unit quaternions
+        float quaternionAngle(const float a[4], const float b[4]);
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace VulkanLearning {
+
+    /*
+       Building blocks of cooked asset files: a 64 bit FNV-1a hash for the cache keys, a read only
+       memory mapping of a whole file, and a sequential writer and reader for the binary layout.
+       Blobs are meant to be copied from the mapping straight into staging memory.
+       */
+    namespace AssetCache {
+
+        static const uint64_t kHashSeed = 0xcbf29ce484222325ull;
+
+        uint64_t hash(const void* data, size_t size, uint64_t seed = kHashSeed);
+
+        template<typename T>
+        uint64_t hashValue(const T& value, uint64_t seed) {
+            return hash(&value, sizeof(T), seed);
+        }
+
+        // Size and modification time of a file, false if it can't be found
+        bool fileStamp(const std::string& filename, uint64_t& size, int64_t& modificationTime);
+
+        // Hex string of a key, used in cache file names
+        std::string keyString(uint64_t key);
+
+        // Read only view of a whole file, memory mapped on Linux and Windows
+        class MappedFile {
+            private:
+                const uint8_t* m_data = nullptr;
+                size_t m_size = 0;
+#if defined(_WIN32)
+                void* m_file = nullptr;
+                void* m_mapping = nullptr;
+#else
+                int m_file = -1;
+#endif
+
+            public:
+                MappedFile() {};
+                ~MappedFile();
+                MappedFile(const MappedFile&) = delete;
+                MappedFile& operator=(const MappedFile&) = delete;
+
+                bool open(const std::string& filename);
+                void close();
+
+                inline const uint8_t* data() const { return m_data; }
+                inline size_t size() const { return m_size; }
+        };
+
+        // Appends to a temporary file that only replaces the target once finish succeeds,
+        // so an interrupted write never leaves a truncated cache behind
+        class Writer {
+            private:
+                std::ofstream m_stream;
+                std::string m_filename;
+                uint64_t m_offset = 0;
+
+            public:
+                Writer() {};
+                // An unfinished file is discarded
+                ~Writer();
+
+                bool open(const std::string& filename);
+                // Closes and renames the file, false if any write failed
+                bool finish();
+                // Closes and deletes the temporary file
+                void discard();
+
+                inline uint64_t tell() const { return m_offset; }
+                void write(const void* data, size_t size);
+                // Pads with zeros up to the next multiple of alignment
+                void align(size_t alignment);
+                // Overwrites bytes written before, e.g. an offset only known at the end
+                void patch(uint64_t offset, const void* data, size_t size);
+
+                template<typename T>
+                void writeValue(const T& value) {
+                    write(&value, sizeof(T));
+                }
+                void writeString(const std::string& value);
+                // Element count followed by the raw elements
+                template<typename T>
+                void writeArray(const std::vector<T>& values) {
+                    writeValue(static_cast<uint32_t>(values.size()));
+                    write(values.data(), values.size() * sizeof(T));
+                }
+        };
+
+        // Bounds checked reads from a mapped file, a failed read sets good() to false
+        class Reader {
+            private:
+                const uint8_t* m_data = nullptr;
+                size_t m_size = 0;
+                size_t m_offset = 0;
+                bool m_good = true;
+
+            public:
+                Reader() {};
+                Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {};
+
+                inline bool good() const { return m_good; }
+                bool seek(uint64_t offset);
+                bool read(void* data, size_t size);
+                // Pointer to size bytes at offset within the file, nullptr if out of range
+                const uint8_t* view(uint64_t offset, uint64_t size);
+
+                template<typename T>
+                T readValue() {
+                    T value{};
+                    read(&value, sizeof(T));
+                    return value;
+                }
+                std::string readString();
+                template<typename T>
+                bool readArray(std::vector<T>& values) {
+                    const uint32_t count = readValue<uint32_t>();
+                    // Checked before resizing so a corrupt count can't allocate arbitrary amounts
+                    if (!m_good || count > (m_size - m_offset) / sizeof(T)) {
+                        m_good = false;
+                        return false;
+                    }
+                    values.resize(count);
+                    return read(values.data(), count * sizeof(T));
+                }
+        };
+    }
+}
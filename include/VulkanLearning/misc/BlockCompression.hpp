@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VulkanLearning {
+
+    /*
+       CPU encoders for the BC formats textures are cooked to. BC1 stores opaque RGB in 8 bytes per
+       4x4 block, BC5 stores two independent channels (the X and Y of a normal map) in 16 bytes and
+       BC7 stores RGBA in 16 bytes. The BC7 encoder only uses mode 6 (one subset, 7 bit endpoints
+       with a p-bit, 4 bit indices), which is fast and good enough for everything but images with
+       several distinct colors per block. Partial blocks at the edges replicate the last row and
+       column, the decoders exist to measure the error.
+       */
+    namespace BlockCompression {
+
+        enum class Format {
+            BC1,
+            BC5,
+            BC7
+        };
+
+        const char* getFormatName(Format format);
+
+        // Bytes per 4x4 block
+        uint32_t getBlockSize(Format format);
+        // Bytes of a width x height image, rounded up to whole blocks
+        size_t getImageSize(Format format, uint32_t width, uint32_t height);
+
+        // Compresses tightly packed RGBA8 pixels into getImageSize(format, width, height) bytes.
+        // BC1 ignores alpha, BC5 keeps red and green
+        void encode(Format format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* dst);
+        // Decodes what encode wrote back to RGBA8, channels the format doesn't store are 0 (alpha 255)
+        void decode(Format format, const uint8_t* src, uint32_t width, uint32_t height, uint8_t* rgba);
+
+        // Peak signal to noise ratio in dB over the channels the format stores, 99 for an exact match
+        double psnr(Format format, const uint8_t* reference, const uint8_t* decoded, uint32_t width, uint32_t height);
+    }
+}
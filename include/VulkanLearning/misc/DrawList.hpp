@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VulkanLearning {
+
+    /*
+       Flat list of draws ordered by a 64 bit sort key, so recording is a single linear
+       scan that only binds state when it differs from the previous draw.
+       */
+    namespace DrawList {
+
+        struct DrawItem {
+            uint64_t key;
+            uint32_t firstIndex;
+            uint32_t indexCount;
+            uint32_t transformIndex;
+            uint32_t materialIndex;
+        };
+
+        // State changes issued while recording, for comparing draw orders
+        struct BindStatistics {
+            uint32_t pipelineBinds = 0;
+            uint32_t descriptorSetBinds = 0;
+            uint32_t pushConstants = 0;
+            uint32_t draws = 0;
+        };
+
+        // Bits, most significant first: pass (4), pipeline (12), material (16), depth (32).
+        // backToFront swaps to pass, inverted depth, pipeline, material for blended passes,
+        // where the draw order matters more than the state changes
+        uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, bool backToFront = false);
+
+        // Stable LSD radix sort on DrawItem::key, 8 bits per pass, scratch is resized as needed.
+        // Passes over bytes that are equal in all keys are skipped
+        void sort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch);
+    }
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VulkanLearning {
+
+    /*
+       Index and vertex reordering for indexed triangle lists: vertex deduplication,
+       post-transform cache ordering (Forsyth), overdraw ordering of cache friendly
+       clusters (Sander et al.) and first-use vertex fetch ordering.
+       Unless noted otherwise dst must not alias the source.
+       */
+    namespace MeshOptimizer {
+
+        // Post-transform cache simulation results, ACMR is transformed vertices per triangle
+        // (0.5 is ideal for regular grids) and ATVR transformed vertices per unique vertex (1.0 is ideal)
+        struct VertexCacheStatistics {
+            size_t verticesTransformed = 0;
+            size_t triangleCount = 0;
+            size_t vertexCount = 0;
+
+            float acmr() const { return triangleCount ? float(verticesTransformed) / float(triangleCount) : 0.0f; }
+            float atvr() const { return vertexCount ? float(verticesTransformed) / float(vertexCount) : 0.0f; }
+            VertexCacheStatistics& operator+=(const VertexCacheStatistics& other);
+        };
+
+        // Small cluster of triangles, its vertices are listed in meshletVertices and its triangles
+        // as three local (8 bit) vertex indices each in meshletTriangles
+        struct Meshlet {
+            uint32_t vertexOffset;
+            uint32_t triangleOffset;
+            uint32_t vertexCount;
+            uint32_t triangleCount;
+        };
+
+        // Bounding sphere and normal cone, the meshlet faces away from a viewer at p if
+        // dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius
+        struct MeshletBounds {
+            float center[3];
+            float radius;
+            float coneAxis[3];
+            float coneCutoff;
+        };
+
+        // Simulates a FIFO cache of cacheSize entries
+        VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+        // Maps bitwise identical vertices to a single index, in order of first reference.
+        // Unreferenced vertices map to ~0u. Returns the number of unique vertices
+        size_t generateVertexRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize);
+
+        // Numbers vertices in the order the index buffer first references them, unreferenced ones map to ~0u.
+        // Returns the number of referenced vertices
+        size_t generateVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+        // dst may alias indices
+        void remapIndexBuffer(uint32_t* dst, const uint32_t* indices, size_t indexCount, const uint32_t* remap);
+        void remapVertexBuffer(void* dst, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* remap);
+
+        // Reorders triangles for post-transform cache locality, dst may alias indices
+        void optimizeVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+        // Reorders clusters of a cache optimized index buffer so outward facing ones are drawn first,
+        // clusters are split where the cache is cold so the ACMR is preserved. dst may alias indices
+        void optimizeOverdraw(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount);
+
+        // Collapses edges in order of quadric error until targetIndexCount is reached or the error would exceed
+        // targetError, relative to half the bounding box diagonal. Border and attribute seam vertices are kept
+        // so the vertex buffer can be shared with the source. Returns the new index count
+        size_t simplify(
+                uint32_t* dst,
+                const uint32_t* indices,
+                size_t indexCount,
+                const float* positions,
+                size_t positionStride,
+                size_t vertexCount,
+                size_t targetIndexCount,
+                float targetError,
+                float* resultError = nullptr);
+
+        // Greedily splits the triangle list in index order, which keeps a cache optimized order local.
+        // maxVertices can be at most 256. Returns the number of meshlets
+        size_t buildMeshlets(
+                std::vector<Meshlet>& meshlets,
+                std::vector<uint32_t>& meshletVertices,
+                std::vector<uint8_t>& meshletTriangles,
+                const uint32_t* indices,
+                size_t indexCount,
+                size_t vertexCount,
+                uint32_t maxVertices = 64,
+                uint32_t maxTriangles = 124);
+
+        MeshletBounds computeMeshletBounds(
+                const Meshlet& meshlet,
+                const uint32_t* meshletVertices,
+                const uint8_t* meshletTriangles,
+                const float* positions,
+                size_t positionStride);
+
+        // Runs deduplication, cache, overdraw and fetch ordering in place. Positions are three floats
+        // at positionOffset in each vertex. Returns the new vertex count, fills the optional statistics
+        size_t optimizeMesh(
+                uint32_t* indices,
+                size_t indexCount,
+                void* vertices,
+                size_t vertexCount,
+                size_t vertexSize,
+                size_t positionOffset = 0,
+                VertexCacheStatistics* before = nullptr,
+                VertexCacheStatistics* after = nullptr);
+    }
+}
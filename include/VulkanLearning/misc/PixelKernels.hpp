@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace VulkanLearning {
+
+    /*
+       Conversion kernels for 8 bit per channel images with SSE2, AVX2 and NEON paths
+       and a scalar fallback. The best path supported by the CPU is picked on first use,
+       every path produces bit-exact identical results.
+       */
+    namespace PixelKernels {
+
+        enum class Isa {
+            Scalar,
+            SSE2,
+            AVX2,
+            NEON
+        };
+
+        bool isSupported(Isa isa);
+        const char* getIsaName(Isa isa);
+
+        Isa getActiveIsa();
+        // Forces a path (e.g. for benchmarking), returns false if the CPU doesn't support it.
+        // Safe while other threads run the kernels, they pick up the new path on their next call
+        bool setActiveIsa(Isa isa);
+
+        // Expands tightly packed RGB pixels to RGBA with a constant alpha
+        void rgbToRgba(const uint8_t* src, uint8_t* dst, size_t pixelCount, uint8_t alpha = 255);
+
+        // dst channel i is taken from src channel order[i], { 2, 1, 0, 3 } swaps RGBA and BGRA
+        void swizzleRgba(const uint8_t* src, uint8_t* dst, size_t pixelCount, const std::array<uint8_t, 4>& order);
+
+        // Multiplies the color channels of RGBA pixels by their alpha, src and dst may alias
+        void premultiplyAlpha(const uint8_t* src, uint8_t* dst, size_t pixelCount);
+
+        // 2x2 box filter of an RGBA image into a max(1, width / 2) x max(1, height / 2) one,
+        // the last texel of an odd sized row or column is folded into a 3 texel wide footprint
+        void downsample2x2(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst);
+
+        // Prints the throughput of every kernel for each supported path
+        void benchmark(uint32_t width = 4096, uint32_t height = 4096, uint32_t iterations = 10);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VulkanLearning {
+
+    class ThreadPool {
+        private:
+            std::vector<std::thread> m_workers;
+            std::deque<std::function<void()>> m_jobs;
+            std::mutex m_mutex;
+            std::condition_variable m_jobAvailable;
+            std::condition_variable m_jobsDone;
+            uint32_t m_activeJobs = 0;
+            bool m_stopping = false;
+
+            void workerLoop();
+
+        public:
+            // A thread count of 0 uses one worker per hardware thread
+            ThreadPool(uint32_t threadCount = 0);
+            ~ThreadPool();
+
+            void push(std::function<void()> job);
+            void wait();
+
+            inline uint32_t getThreadCount() { return static_cast<uint32_t>(m_workers.size()); }
+    };
+
+    /*
+       Collects the indices of finished jobs so the caller can consume
+       results in completion order rather than submission order
+       */
+    class CompletionQueue {
+        private:
+            std::deque<size_t> m_completed;
+            std::mutex m_mutex;
+            std::condition_variable m_available;
+
+        public:
+            void push(size_t index);
+            size_t pop();
+            // Doesn't block, false if nothing has completed yet
+            bool tryPop(size_t& index);
+    };
+}
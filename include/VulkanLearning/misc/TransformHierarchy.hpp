@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace VulkanLearning {
+
+    /*
+       Flat node hierarchy stored as arrays, parents always come before their children,
+       so world matrices are refreshed in a single linear pass. Only nodes marked dirty
+       and their descendants are recomputed.
+       */
+    class TransformHierarchy {
+        public:
+            // -1 for roots, otherwise the index of an earlier node
+            std::vector<int32_t> parents;
+            std::vector<glm::vec3> translations;
+            std::vector<glm::quat> rotations;
+            std::vector<glm::vec3> scales;
+            // Applied after the TRS components, identity for most nodes
+            std::vector<glm::mat4> matrices;
+            std::vector<glm::mat4> worldMatrices;
+            // Set by the setters, cleared by update
+            std::vector<uint8_t> dirty;
+            // Nodes whose world matrix was recomputed by the last update
+            std::vector<uint8_t> changed;
+
+            // The parent must have been added before
+            uint32_t add(int32_t parent, glm::vec3 translation, glm::quat rotation, glm::vec3 scale, const glm::mat4& matrix);
+            void clear();
+            size_t size() const;
+
+            void setTranslation(uint32_t index, glm::vec3 translation);
+            void setRotation(uint32_t index, glm::quat rotation);
+            void setScale(uint32_t index, glm::vec3 scale);
+            void setMatrix(uint32_t index, const glm::mat4& matrix);
+
+            // Recomputes dirty nodes and their descendants, returns the number of updated nodes
+            size_t update();
+
+            glm::mat4 localMatrix(uint32_t index) const;
+
+            // out = a * b, out may alias a or b
+            static void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out);
+
+        private:
+            std::vector<uint8_t> m_hasMatrix;
+    };
+}
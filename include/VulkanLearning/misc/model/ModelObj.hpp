@@ -17,9 +17,14 @@ namespace VulkanLearning {
             std::vector<VertexTextured> m_vertices;
             std::vector<uint32_t> m_indices;
 
+            // Reorder the geometry for the post-transform cache, overdraw and vertex fetch after loading
+            bool m_optimize = false;
+            // Prints the optimization statistics to the console
+            bool m_verbose = false;
+
         public:
             ModelObj();
-            ModelObj(std::string modelPath);
+            ModelObj(std::string modelPath, bool optimize = false, bool verbose = false);
             ~ModelObj();
 
             inline std::vector<VertexTextured> getVerticies() { return m_vertices; }
@@ -175,7 +175,7 @@ namespace VulkanLearning {
         samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
         samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
         samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-        VK_CHECK_RESULT(vkCreateSampler(m_device.getLogicalDevice(), &samplerInfo, nullptr, &m_sampler));
+        m_sampler = m_device.getSampler(samplerInfo);
 
         // Descriptor Pool
         std::vector<VkDescriptorPoolSize> poolSizes = std::vector<VkDescriptorPoolSize>(1);
@@ -483,7 +483,6 @@ namespace VulkanLearning {
         vkDestroyImageView(m_device.getLogicalDevice(), m_fontView, nullptr);
         vkDestroyImage(m_device.getLogicalDevice(), m_fontImage, nullptr);
         vkFreeMemory(m_device.getLogicalDevice(), m_fontMemory, nullptr);
-        vkDestroySampler(m_device.getLogicalDevice(), m_sampler, nullptr);
         vkDestroyDescriptorSetLayout(m_device.getLogicalDevice(), m_descriptorSetLayout.getDescriptorSetLayout(), nullptr);
         vkDestroyDescriptorPool(m_device.getLogicalDevice(), m_descriptorPool.getDescriptorPool(), nullptr);
         vkDestroyPipelineLayout(m_device.getLogicalDevice(), m_pipelineLayout, nullptr);
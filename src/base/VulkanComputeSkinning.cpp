@@ -0,0 +1,213 @@
+#include "VulkanComputeSkinning.hpp"
+
+#include <array>
+
+#include "VulkanShaderModule.hpp"
+
+namespace VulkanLearning {
+
+    VulkanComputeSkinning::VulkanComputeSkinning(VulkanDevice* device)
+        : m_device(device) {}
+
+    VulkanComputeSkinning::~VulkanComputeSkinning() {
+        cleanup();
+    }
+
+    void VulkanComputeSkinning::cleanup() {
+        if (m_pipeline == VK_NULL_HANDLE) {
+            return;
+        }
+        VkDevice device = m_device->getLogicalDevice();
+        vkDestroyPipeline(device, m_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+        m_jointBuffer.unmap();
+        m_jointBuffer.cleanup();
+        m_vertexBuffer.cleanup();
+        m_descriptorSets.clear();
+        m_pipeline = VK_NULL_HANDLE;
+    }
+
+    void VulkanComputeSkinning::create(VulkanglTFModel* model, uint32_t frameCount) {
+        if (model->compactVertices) {
+            throw std::runtime_error("Compute skinning needs the full vertex layout!");
+        }
+        m_model = model;
+        m_frameCount = frameCount > 0 ? frameCount : model->nodeTransforms.frameCount;
+        VkDevice device = m_device->getLogicalDevice();
+
+        // Every skinned node gets its own joint range, nodes sharing a skin still differ in their inverse transform
+        m_jobs.clear();
+        m_skinnedNodes.clear();
+        m_jointOffsets.clear();
+        m_jointCount = 0;
+        for (Node* node : model->linearNodes) {
+            if (!node->mesh || !node->skin) {
+                continue;
+            }
+            m_skinnedNodes.push_back(node);
+            m_jointOffsets.push_back(m_jointCount);
+            for (Primitive* primitive : node->mesh->primitives) {
+                if (primitive->vertexCount == 0) {
+                    continue;
+                }
+                Job job{};
+                job.pushConstants.firstVertex = primitive->firstVertex;
+                job.pushConstants.vertexCount = primitive->vertexCount;
+                job.pushConstants.jointOffset = m_jointCount;
+                job.pushConstants.vertexStride = sizeof(Vertex) / sizeof(float);
+                job.node = node;
+                m_jobs.push_back(job);
+            }
+            m_jointCount += static_cast<uint32_t>(node->skin->joints.size());
+        }
+        if (m_jobs.empty()) {
+            throw std::runtime_error("Compute skinning needs a model with skinned meshes!");
+        }
+
+        const VkDeviceSize alignment = m_device->getMinStorageBufferOffsetAlignment();
+        m_frameSize = m_jointCount * sizeof(glm::mat4);
+        if (alignment > 0) {
+            m_frameSize = (m_frameSize + alignment - 1) & ~(alignment - 1);
+        }
+        m_jointBuffer = VulkanBuffer(*m_device);
+        m_jointBuffer.createBuffer(m_frameSize * m_frameCount,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_jointBuffer.map();
+
+        // Starts as a copy of the source, unskinned meshes and attributes are never touched again
+        const VkDeviceSize vertexBufferSize = model->vertices.buffer.getSize();
+        m_vertexBuffer = VulkanBuffer(*m_device);
+        m_vertexBuffer.createBuffer(vertexBufferSize,
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VulkanCommandBuffer copyCmd;
+        copyCmd.create(m_device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+        VkBufferCopy copyRegion{};
+        copyRegion.size = vertexBufferSize;
+        vkCmdCopyBuffer(copyCmd.getCommandBuffer(), model->vertices.buffer.getBuffer(), m_vertexBuffer.getBuffer(), 1, &copyRegion);
+        copyCmd.flushCommandBuffer(m_device, true);
+
+        std::array<VkDescriptorSetLayoutBinding, 3> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutCI{};
+        setLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+        setLayoutCI.pBindings = bindings.data();
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &m_descriptorSetLayout));
+
+        VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * m_frameCount };
+        VkDescriptorPoolCreateInfo descriptorPoolCI{};
+        descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCI.maxSets = m_frameCount;
+        descriptorPoolCI.poolSizeCount = 1;
+        descriptorPoolCI.pPoolSizes = &poolSize;
+        VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &m_descriptorPool));
+
+        std::vector<VkDescriptorSetLayout> setLayouts(m_frameCount, m_descriptorSetLayout);
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = m_frameCount;
+        allocInfo.pSetLayouts = setLayouts.data();
+        m_descriptorSets.resize(m_frameCount);
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, m_descriptorSets.data()));
+
+        for (uint32_t frame = 0; frame < m_frameCount; frame++) {
+            std::array<VkDescriptorBufferInfo, 3> bufferInfos = {{
+                { model->vertices.buffer.getBuffer(), 0, VK_WHOLE_SIZE },
+                { m_vertexBuffer.getBuffer(), 0, VK_WHOLE_SIZE },
+                { m_jointBuffer.getBuffer(), frame * m_frameSize, m_jointCount * sizeof(glm::mat4) }
+            }};
+            std::array<VkWriteDescriptorSet, 3> writes{};
+            for (uint32_t i = 0; i < writes.size(); i++) {
+                writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[i].dstSet = m_descriptorSets[frame];
+                writes[i].dstBinding = i;
+                writes[i].descriptorCount = 1;
+                writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[i].pBufferInfo = &bufferInfos[i];
+            }
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.size = sizeof(PushConstants);
+        VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+        pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCI.setLayoutCount = 1;
+        pipelineLayoutCI.pSetLayouts = &m_descriptorSetLayout;
+        pipelineLayoutCI.pushConstantRangeCount = 1;
+        pipelineLayoutCI.pPushConstantRanges = &pushConstantRange;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &m_pipelineLayout));
+
+        VulkanShaderModule shader("src/shaders/skinningComp.spv", m_device, VK_SHADER_STAGE_COMPUTE_BIT);
+        VkComputePipelineCreateInfo pipelineCI{};
+        pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineCI.stage = shader.getStageCreateInfo();
+        pipelineCI.layout = m_pipelineLayout;
+        VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &m_pipeline));
+        shader.cleanup(m_device);
+
+        for (uint32_t frame = 0; frame < m_frameCount; frame++) {
+            update(frame);
+        }
+    }
+
+    void VulkanComputeSkinning::update(uint32_t frame) {
+        glm::mat4* joints = reinterpret_cast<glm::mat4*>(static_cast<char*>(m_jointBuffer.getMappedMemory()) + frame * m_frameSize);
+        for (size_t i = 0; i < m_skinnedNodes.size(); i++) {
+            Node* node = m_skinnedNodes[i];
+            const glm::mat4 inverseTransform = glm::inverse(node->getMatrix());
+            glm::mat4* nodeJoints = joints + m_jointOffsets[i];
+            for (size_t j = 0; j < node->skin->joints.size(); j++) {
+                nodeJoints[j] = inverseTransform * node->skin->joints[j]->getMatrix() * node->skin->inverseBindMatrices[j];
+            }
+        }
+    }
+
+    void VulkanComputeSkinning::dispatch(VkCommandBuffer commandBuffer, uint32_t frame) {
+        // Earlier draws must be done reading the skinned vertices before they are rewritten
+        vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSets[frame], 0, nullptr);
+        for (const Job& job : m_jobs) {
+            vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &job.pushConstants);
+            vkCmdDispatch(commandBuffer, (job.pushConstants.vertexCount + 63) / 64, 1, 1);
+        }
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void VulkanComputeSkinning::bindBuffers(VkCommandBuffer commandBuffer) {
+        const VkDeviceSize offsets[1] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, m_vertexBuffer.getBufferPointer(), offsets);
+        vkCmdBindIndexBuffer(commandBuffer, m_model->indices.buffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        m_model->buffersBound = true;
+    }
+
+    uint32_t VulkanComputeSkinning::getJointCount() {
+        return m_jointCount;
+    }
+
+    VkBuffer VulkanComputeSkinning::getVertexBuffer() {
+        return m_vertexBuffer.getBuffer();
+    }
+}
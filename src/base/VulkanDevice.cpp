@@ -3,23 +3,54 @@
 #include <vector>
 #include <set>
 #include <string>
+#include <cstring>
+#include <mutex>
 
 #include "VulkanDevice.hpp"
 
 namespace VulkanLearning {
 
+    struct VulkanDevice::SamplerCache {
+        std::mutex mutex;
+        // A handful of entries in practice, a linear search is all it takes
+        std::vector<std::pair<VkSamplerCreateInfo, VkSampler>> samplers;
+    };
+
+    static bool isSameSamplerState(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b) {
+        // maxAnisotropy is ignored while anisotropic filtering is off, compareOp without compareEnable
+        return a.flags == b.flags
+            && a.magFilter == b.magFilter
+            && a.minFilter == b.minFilter
+            && a.mipmapMode == b.mipmapMode
+            && a.addressModeU == b.addressModeU
+            && a.addressModeV == b.addressModeV
+            && a.addressModeW == b.addressModeW
+            && a.mipLodBias == b.mipLodBias
+            && a.anisotropyEnable == b.anisotropyEnable
+            && (!a.anisotropyEnable || a.maxAnisotropy == b.maxAnisotropy)
+            && a.compareEnable == b.compareEnable
+            && (!a.compareEnable || a.compareOp == b.compareOp)
+            && a.minLod == b.minLod
+            && a.maxLod == b.maxLod
+            && a.borderColor == b.borderColor
+            && a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+    }
+
+    VulkanDevice::VulkanDevice() : m_samplerCache(std::make_shared<SamplerCache>()) {
+    }
+
     VulkanDevice::VulkanDevice(
             VkInstance instance, 
             VkSurfaceKHR surface,
             const std::vector<const char*> deviceExtensions,
             bool enableValidationLayers,
             const std::vector<const char*> validationLayers,
-            uint32_t msaaSamplesMax) : m_msaaSamplesMax(msaaSamplesMax) {
+            uint32_t msaaSamplesMax) : m_msaaSamplesMax(msaaSamplesMax), m_samplerCache(std::make_shared<SamplerCache>()) {
         pickPhysicalDevice(instance, surface, deviceExtensions);
         createLogicalDevice(surface, enableValidationLayers, validationLayers);
     }
 
-    VulkanDevice::VulkanDevice(uint32_t msaaSamplesMax) : m_msaaSamplesMax(msaaSamplesMax) {
+    VulkanDevice::VulkanDevice(uint32_t msaaSamplesMax) : m_msaaSamplesMax(msaaSamplesMax), m_samplerCache(std::make_shared<SamplerCache>()) {
     }
 
     VulkanDevice::~VulkanDevice() {
@@ -36,11 +67,62 @@ namespace VulkanLearning {
         return m_commandPool;
     }
 
+    uint32_t VulkanDevice::getSwapChainImageCount() {
+        return m_swapChainImageCount;
+    }
+
+    void VulkanDevice::setSwapChainImageCount(uint32_t imageCount) {
+        m_swapChainImageCount = imageCount;
+    }
+
+    bool VulkanDevice::isExtensionEnabled(const char* extension) {
+        for (const char* enabled : m_enabledOptionalExtensions) {
+            if (strcmp(enabled, extension) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    VkSampler VulkanDevice::getSampler(const VkSamplerCreateInfo& samplerInfo) {
+        std::lock_guard<std::mutex> lock(m_samplerCache->mutex);
+        for (const auto& entry : m_samplerCache->samplers) {
+            if (isSameSamplerState(entry.first, samplerInfo)) {
+                return entry.second;
+            }
+        }
+        VkSamplerCreateInfo cachedInfo = samplerInfo;
+        cachedInfo.pNext = nullptr;
+        VkSampler sampler;
+        if (vkCreateSampler(m_logicalDevice, &cachedInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("Sampler creation failed!");
+        }
+        m_samplerCache->samplers.push_back({ cachedInfo, sampler });
+        return sampler;
+    }
+
+    uint32_t VulkanDevice::getSamplerCount() {
+        std::lock_guard<std::mutex> lock(m_samplerCache->mutex);
+        return static_cast<uint32_t>(m_samplerCache->samplers.size());
+    }
+
+    void VulkanDevice::destroySamplers() {
+        std::lock_guard<std::mutex> lock(m_samplerCache->mutex);
+        for (const auto& entry : m_samplerCache->samplers) {
+            vkDestroySampler(m_logicalDevice, entry.second, nullptr);
+        }
+        m_samplerCache->samplers.clear();
+    }
+
     size_t VulkanDevice::getMinUniformBufferOffsetAlignment() {
         return properties.limits.minUniformBufferOffsetAlignment;
     }
 
-    void VulkanDevice::pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::vector<const char*> deviceExtensions) {
+    size_t VulkanDevice::getMinStorageBufferOffsetAlignment() {
+        return properties.limits.minStorageBufferOffsetAlignment;
+    }
+
+    void VulkanDevice::pickPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const std::vector<const char*> deviceExtensions, bool physicalDeviceProperties2) {
         uint32_t deviceCount = 0;
         vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr);
 
@@ -55,6 +137,9 @@ namespace VulkanLearning {
             if (isDeviceSuitable(device, surface, deviceExtensions)) {
                 m_physicalDevice = device;
                 vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+                // The loader may hand out the entry point even if the extension wasn't enabled
+                m_getMemoryProperties2 = physicalDeviceProperties2 ? reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+                        vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR")) : nullptr;
                 m_msaaSamples = m_msaaSamplesMax <= 
                     static_cast<int>(getMaxUsableSampleCount()) ?
                     (VkSampleCountFlagBits) m_msaaSamplesMax 
@@ -86,6 +171,34 @@ namespace VulkanLearning {
         enabledFeatures.samplerAnisotropy = VK_TRUE;
         enabledFeatures.sampleRateShading = VK_TRUE;
         enabledFeatures.fillModeNonSolid = VK_TRUE;
+        // Used by the compute mip downsampler for formats that can't be blitted into
+        enabledFeatures.shaderStorageImageWriteWithoutFormat = features.shaderStorageImageWriteWithoutFormat;
+        // Optional for the GPU driven indirect path, see VulkanIndirectRenderer
+        enabledFeatures.multiDrawIndirect = features.multiDrawIndirect;
+        enabledFeatures.drawIndirectFirstInstance = features.drawIndirectFirstInstance;
+        // Transcoding targets of Basis Universal textures, see getKtxTranscodeTarget
+        enabledFeatures.textureCompressionBC = features.textureCompressionBC;
+        enabledFeatures.textureCompressionETC2 = features.textureCompressionETC2;
+        enabledFeatures.textureCompressionASTC_LDR = features.textureCompressionASTC_LDR;
+
+        uint32_t extensionCount;
+        vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(m_physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+        m_enabledOptionalExtensions.clear();
+        for (const char* extension : optionalDeviceExtensions) {
+            if (strcmp(extension, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0 && m_getMemoryProperties2 == nullptr) {
+                continue;
+            }
+            for (const auto& available : availableExtensions) {
+                if (strcmp(available.extensionName, extension) == 0) {
+                    m_enabledOptionalExtensions.push_back(extension);
+                    break;
+                }
+            }
+        }
+        std::vector<const char*> enabledExtensions(deviceExtensions);
+        enabledExtensions.insert(enabledExtensions.end(), m_enabledOptionalExtensions.begin(), m_enabledOptionalExtensions.end());
 
         VkDeviceCreateInfo createInfo{};
         createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -95,8 +208,8 @@ namespace VulkanLearning {
 
         createInfo.pEnabledFeatures = &enabledFeatures;
 
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+        createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
         if (enableValidationLayers) {
             createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -267,6 +380,36 @@ namespace VulkanLearning {
         throw std::runtime_error("No memory type is available for the buffer!");
     }
 
+    VkDeviceSize VulkanDevice::getDeviceLocalBudget(VkDeviceSize* usage) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memProperties2{};
+        memProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+
+        const bool hasBudget = m_getMemoryProperties2 && isExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (hasBudget) {
+            memProperties2.pNext = &budgetProperties;
+            m_getMemoryProperties2(m_physicalDevice, &memProperties2);
+        } else {
+            vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties2.memoryProperties);
+        }
+
+        const VkPhysicalDeviceMemoryProperties& memProperties = memProperties2.memoryProperties;
+        VkDeviceSize budget = 0;
+        VkDeviceSize used = 0;
+        for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+            if (!(memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)) {
+                continue;
+            }
+            budget += hasBudget ? budgetProperties.heapBudget[i] : memProperties.memoryHeaps[i].size;
+            used += hasBudget ? budgetProperties.heapUsage[i] : 0;
+        }
+        if (usage) {
+            *usage = used;
+        }
+        return budget;
+    }
+
     bool VulkanDevice::checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*> deviceExtensions) {
         uint32_t extensionCount;
         vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
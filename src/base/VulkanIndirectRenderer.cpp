@@ -0,0 +1,273 @@
+#include "VulkanIndirectRenderer.hpp"
+
+#include <array>
+
+#include "VulkanShaderModule.hpp"
+
+namespace VulkanLearning {
+
+    VulkanIndirectRenderer::VulkanIndirectRenderer(VulkanDevice* device)
+        : m_device(device) {}
+
+    VulkanIndirectRenderer::~VulkanIndirectRenderer() {
+        cleanup();
+    }
+
+    void VulkanIndirectRenderer::cleanup() {
+        if (m_pipeline == VK_NULL_HANDLE) {
+            return;
+        }
+        VkDevice device = m_device->getLogicalDevice();
+        vkDestroyPipeline(device, m_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+        m_uniformBuffer.unmap();
+        m_uniformBuffer.cleanup();
+        m_transformBuffer.unmap();
+        m_transformBuffer.cleanup();
+        m_objectBuffer.cleanup();
+        m_drawBuffer.cleanup();
+        m_countBuffer.cleanup();
+        m_pipeline = VK_NULL_HANDLE;
+    }
+
+    void VulkanIndirectRenderer::create(VulkanglTFModel* model) {
+        m_model = model;
+        VkDevice device = m_device->getLogicalDevice();
+
+        if (m_device->isExtensionEnabled(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+            m_vkCmdDrawIndexedIndirectCountKHR = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+                    vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+        }
+
+        // Objects are grouped by batch so every batch is a contiguous range of draws
+        std::array<std::vector<ObjectData>, BatchCount> batches;
+        m_transformNodes.clear();
+        for (Node* node : model->linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            const uint32_t transformIndex = static_cast<uint32_t>(m_transformNodes.size());
+            m_transformNodes.push_back(node);
+            for (Primitive* primitive : node->mesh->primitives) {
+                uint32_t batch = BatchOpaque;
+                if (primitive->material.alphaMode == Material::ALPHAMODE_MASK) {
+                    batch = BatchMask;
+                } else if (primitive->material.alphaMode == Material::ALPHAMODE_BLEND) {
+                    batch = BatchBlend;
+                }
+                ObjectData object{};
+                object.boundsMin = glm::vec4(primitive->dimensions.min, 0.0f);
+                object.boundsMax = glm::vec4(primitive->dimensions.max, 0.0f);
+                object.firstIndex = primitive->firstIndex;
+                object.indexCount = primitive->indexCount;
+                object.transformIndex = transformIndex;
+                object.batch = batch;
+                object.batchSlot = static_cast<uint32_t>(batches[batch].size());
+                object.transformSlot = node->mesh->transformSlot;
+                batches[batch].push_back(object);
+            }
+        }
+        std::vector<ObjectData> objects;
+        for (uint32_t batch = 0; batch < BatchCount; batch++) {
+            m_batchOffsets[batch] = static_cast<uint32_t>(objects.size());
+            objects.insert(objects.end(), batches[batch].begin(), batches[batch].end());
+        }
+        m_objectCount = static_cast<uint32_t>(objects.size());
+        m_batchOffsets[BatchCount] = m_objectCount;
+        if (m_objectCount == 0) {
+            throw std::runtime_error("Indirect rendering needs a model with at least one primitive!");
+        }
+
+        m_uniformBuffer = VulkanBuffer(*m_device);
+        m_uniformBuffer.createBuffer(sizeof(UniformData),
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_uniformBuffer.map();
+
+        m_objectBuffer = VulkanBuffer(*m_device);
+        m_objectBuffer.createWithStagingBuffer(objects, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+        m_transformBuffer = VulkanBuffer(*m_device);
+        m_transformBuffer.createBuffer(m_transformNodes.size() * sizeof(glm::mat4),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_transformBuffer.map();
+        updateTransforms();
+
+        m_drawBuffer = VulkanBuffer(*m_device);
+        m_drawBuffer.createBuffer(m_objectCount * sizeof(VkDrawIndexedIndirectCommand),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        m_countBuffer = VulkanBuffer(*m_device);
+        m_countBuffer.createBuffer(4 * sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutCI{};
+        setLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+        setLayoutCI.pBindings = bindings.data();
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &m_descriptorSetLayout));
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 }
+        }};
+        VkDescriptorPoolCreateInfo descriptorPoolCI{};
+        descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCI.maxSets = 1;
+        descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolCI.pPoolSizes = poolSizes.data();
+        VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &m_descriptorPool));
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_descriptorSetLayout;
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet));
+
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos = {{
+            { m_uniformBuffer.getBuffer(), 0, VK_WHOLE_SIZE },
+            { m_objectBuffer.getBuffer(), 0, VK_WHOLE_SIZE },
+            { m_transformBuffer.getBuffer(), 0, VK_WHOLE_SIZE },
+            { m_drawBuffer.getBuffer(), 0, VK_WHOLE_SIZE },
+            { m_countBuffer.getBuffer(), 0, VK_WHOLE_SIZE }
+        }};
+        std::array<VkWriteDescriptorSet, 5> writes{};
+        for (uint32_t i = 0; i < writes.size(); i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = m_descriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = bindings[i].descriptorType;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+        pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCI.setLayoutCount = 1;
+        pipelineLayoutCI.pSetLayouts = &m_descriptorSetLayout;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &m_pipelineLayout));
+
+        VulkanShaderModule shader("src/shaders/indirectCullComp.spv", m_device, VK_SHADER_STAGE_COMPUTE_BIT);
+        VkComputePipelineCreateInfo pipelineCI{};
+        pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineCI.stage = shader.getStageCreateInfo();
+        pipelineCI.layout = m_pipelineLayout;
+        VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &m_pipeline));
+        shader.cleanup(m_device);
+
+        update(glm::mat4(1.0f));
+    }
+
+    void VulkanIndirectRenderer::update(const glm::mat4& viewProjection) {
+        Frustum frustum;
+        frustum.update(viewProjection);
+        UniformData uniformData{};
+        for (uint32_t i = 0; i < 6; i++) {
+            uniformData.frustumPlanes[i] = frustum.planes[i];
+        }
+        for (uint32_t i = 0; i <= BatchCount; i++) {
+            uniformData.batchOffsets[i] = m_batchOffsets[i];
+        }
+        uniformData.objectCount = m_objectCount;
+        uniformData.compact = usesDrawIndirectCount() ? 1 : 0;
+        uniformData.firstInstance = m_device->features.drawIndirectFirstInstance ? 1 : 0;
+        memcpy(m_uniformBuffer.getMappedMemory(), &uniformData, sizeof(uniformData));
+    }
+
+    void VulkanIndirectRenderer::updateTransforms() {
+        glm::mat4* transforms = static_cast<glm::mat4*>(m_transformBuffer.getMappedMemory());
+        for (size_t i = 0; i < m_transformNodes.size(); i++) {
+            transforms[i] = m_transformNodes[i]->getMatrix();
+        }
+    }
+
+    void VulkanIndirectRenderer::dispatch(VkCommandBuffer commandBuffer) {
+        // Draws of earlier submissions must be done reading before the buffers are overwritten
+        vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+        vkCmdFillBuffer(commandBuffer, m_countBuffer.getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+        vkCmdDispatch(commandBuffer, (m_objectCount + 63) / 64, 1, 1);
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void VulkanIndirectRenderer::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags) {
+        m_model->bindBuffers(commandBuffer);
+
+        bool drawBatch[BatchCount] = {
+            (renderFlags & RenderFlags::RenderOpaqueNodes) != 0,
+            (renderFlags & RenderFlags::RenderAlphaMaskedNodes) != 0,
+            (renderFlags & RenderFlags::RenderAlphaBlendedNodes) != 0
+        };
+        if (!drawBatch[BatchOpaque] && !drawBatch[BatchMask] && !drawBatch[BatchBlend]) {
+            drawBatch[BatchOpaque] = drawBatch[BatchMask] = drawBatch[BatchBlend] = true;
+        }
+
+        const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+        for (uint32_t batch = 0; batch < BatchCount; batch++) {
+            const uint32_t batchSize = m_batchOffsets[batch + 1] - m_batchOffsets[batch];
+            if (!drawBatch[batch] || batchSize == 0) {
+                continue;
+            }
+            const VkDeviceSize offset = m_batchOffsets[batch] * stride;
+            if (usesDrawIndirectCount()) {
+                m_vkCmdDrawIndexedIndirectCountKHR(commandBuffer, m_drawBuffer.getBuffer(), offset,
+                        m_countBuffer.getBuffer(), batch * sizeof(uint32_t), batchSize, stride);
+            } else if (m_device->features.multiDrawIndirect) {
+                // Culled objects are left in place with an instance count of zero
+                vkCmdDrawIndexedIndirect(commandBuffer, m_drawBuffer.getBuffer(), offset, batchSize, stride);
+            } else {
+                for (uint32_t i = 0; i < batchSize; i++) {
+                    vkCmdDrawIndexedIndirect(commandBuffer, m_drawBuffer.getBuffer(), offset + i * stride, 1, stride);
+                }
+            }
+        }
+    }
+
+    VkBuffer VulkanIndirectRenderer::getObjectBuffer() {
+        return m_objectBuffer.getBuffer();
+    }
+
+    VkBuffer VulkanIndirectRenderer::getTransformBuffer() {
+        return m_transformBuffer.getBuffer();
+    }
+
+    uint32_t VulkanIndirectRenderer::getObjectCount() {
+        return m_objectCount;
+    }
+
+    bool VulkanIndirectRenderer::usesDrawIndirectCount() {
+        return m_vkCmdDrawIndexedIndirectCountKHR != nullptr;
+    }
+}
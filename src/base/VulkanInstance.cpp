@@ -90,6 +90,20 @@ namespace VulkanLearning {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
         }
 
+        // Needed on a 1.0 instance to query VK_EXT_memory_budget, optional like the extension itself
+        m_physicalDeviceProperties2 = false;
+        uint32_t availableCount = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, nullptr);
+        std::vector<VkExtensionProperties> availableExtensions(availableCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &availableCount, availableExtensions.data());
+        for (const auto& extension : availableExtensions) {
+            if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+                extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+                m_physicalDeviceProperties2 = true;
+                break;
+            }
+        }
+
         return extensions;
     }
 
@@ -0,0 +1,105 @@
+#include "VulkanKtxTranscoder.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+namespace VulkanLearning {
+
+    static bool canSample(VulkanDevice* device, VkFormat format) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(device->getPhysicalDevice(), format, &formatProperties);
+        const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+            | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+            | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
+
+    ktx_transcode_fmt_e getKtxTranscodeTarget(VulkanDevice* device, ktxTexture2* texture) {
+        // Compressed formats can only be used if their feature was enabled with the device
+        const bool bc = device->enabledFeatures.textureCompressionBC;
+        const bool etc2 = device->enabledFeatures.textureCompressionETC2;
+        const bool astc = device->enabledFeatures.textureCompressionASTC_LDR;
+        const bool bc7 = bc && canSample(device, VK_FORMAT_BC7_UNORM_BLOCK);
+        const bool bc1 = bc && canSample(device, VK_FORMAT_BC1_RGB_UNORM_BLOCK) && canSample(device, VK_FORMAT_BC3_UNORM_BLOCK);
+        const bool etc = etc2 && canSample(device, VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK);
+        const bool astc4x4 = astc && canSample(device, VK_FORMAT_ASTC_4x4_UNORM_BLOCK);
+
+        if (ktxTexture2_GetColorModel_e(texture) == KHR_DF_MODEL_UASTC) {
+            // UASTC keeps its quality in ASTC and BC7, ETC2 loses some of it
+            if (astc4x4) {
+                return KTX_TTF_ASTC_4x4_RGBA;
+            }
+            if (bc7) {
+                return KTX_TTF_BC7_RGBA;
+            }
+            if (etc) {
+                return KTX_TTF_ETC2_RGBA;
+            }
+        } else {
+            // ETC1S maps almost directly to ETC, BC1 (BC3 with alpha) is the cheapest desktop match
+            if (etc) {
+                return KTX_TTF_ETC;
+            }
+            if (bc1) {
+                return KTX_TTF_BC1_OR_3;
+            }
+            if (bc7) {
+                return KTX_TTF_BC7_RGBA;
+            }
+        }
+        return KTX_TTF_RGBA32;
+    }
+
+    ktxResult prepareKtxTexture(VulkanDevice* device, ktxTexture* texture, VkFormat fallbackFormat, VkFormat& format) {
+        format = fallbackFormat;
+        if (texture->classId != ktxTexture2_c) {
+            return KTX_SUCCESS;
+        }
+
+        ktxTexture2* texture2 = reinterpret_cast<ktxTexture2*>(texture);
+        if (ktxTexture2_NeedsTranscoding(texture2)) {
+            // The transcoder builds its tables on first use, let that happen once before going parallel
+            static std::mutex initMutex;
+            static std::atomic<bool> initialized{ false };
+            std::unique_lock<std::mutex> lock(initMutex, std::defer_lock);
+            if (!initialized) {
+                lock.lock();
+            }
+            ktxResult result = ktxTexture2_TranscodeBasis(texture2, getKtxTranscodeTarget(device, texture2), 0);
+            if (lock.owns_lock()) {
+                initialized = true;
+            }
+            if (result != KTX_SUCCESS) {
+                return result;
+            }
+        }
+        // Set by the transcoder, sRGB if the file says so
+        if (texture2->vkFormat != VK_FORMAT_UNDEFINED) {
+            format = static_cast<VkFormat>(texture2->vkFormat);
+        }
+        return KTX_SUCCESS;
+    }
+
+    std::vector<VkBufferImageCopy> getKtxLevelRegions(ktxTexture* texture) {
+        std::vector<VkBufferImageCopy> regions;
+        for (uint32_t level = 0; level < texture->numLevels; level++) {
+            ktx_size_t offset;
+            if (ktxTexture_GetImageOffset(texture, level, 0, 0, &offset) != KTX_SUCCESS) {
+                throw std::runtime_error("KTX get image offset failed!");
+            }
+            VkBufferImageCopy region{};
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent.width = std::max(1u, texture->baseWidth >> level);
+            region.imageExtent.height = std::max(1u, texture->baseHeight >> level);
+            region.imageExtent.depth = 1;
+            region.bufferOffset = offset;
+            regions.push_back(region);
+        }
+        return regions;
+    }
+}
@@ -0,0 +1,215 @@
+#include "VulkanMeshletCulling.hpp"
+
+#include <array>
+
+#include "VulkanShaderModule.hpp"
+
+namespace VulkanLearning {
+
+    VulkanMeshletCulling::VulkanMeshletCulling(VulkanDevice* device)
+        : m_device(device) {}
+
+    VulkanMeshletCulling::~VulkanMeshletCulling() {
+        cleanup();
+    }
+
+    void VulkanMeshletCulling::cleanup() {
+        if (m_pipeline == VK_NULL_HANDLE) {
+            return;
+        }
+        VkDevice device = m_device->getLogicalDevice();
+        vkDestroyPipeline(device, m_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+        m_uniformBuffer.unmap();
+        m_uniformBuffer.cleanup();
+        m_indexBuffer.cleanup();
+        m_drawBuffer.cleanup();
+        m_resetBuffer.cleanup();
+        m_pipeline = VK_NULL_HANDLE;
+    }
+
+    void VulkanMeshletCulling::create(VulkanglTFModel* model) {
+        if (model->meshlets.count == 0) {
+            throw std::runtime_error("Meshlet culling needs a model loaded with FileLoadingFlags::BuildMeshlets!");
+        }
+        m_model = model;
+        VkDevice device = m_device->getLogicalDevice();
+
+        m_uniformBuffer = VulkanBuffer(*m_device);
+        m_uniformBuffer.createBuffer(sizeof(UniformData),
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        m_uniformBuffer.map();
+
+        m_indexBuffer = VulkanBuffer(*m_device);
+        m_indexBuffer.createBuffer(model->meshlets.indexCount * sizeof(uint32_t),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        // Each primitive's draw starts empty at the beginning of its region
+        std::vector<VkDrawIndexedIndirectCommand> resetCommands(model->meshlets.drawCount);
+        for (Node* node : model->linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            for (Primitive* primitive : node->mesh->primitives) {
+                if (primitive->meshletCount > 0) {
+                    resetCommands[primitive->meshletDrawIndex] = { 0, 1, primitive->meshletFirstIndex, 0, 0 };
+                }
+            }
+        }
+        VkDeviceSize drawBufferSize = resetCommands.size() * sizeof(VkDrawIndexedIndirectCommand);
+        m_resetBuffer = VulkanBuffer(*m_device);
+        m_resetBuffer.createWithStagingBuffer(resetCommands, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        m_drawBuffer = VulkanBuffer(*m_device);
+        m_drawBuffer.createBuffer(drawBufferSize,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i].binding = i;
+            bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            bindings[i].descriptorCount = 1;
+            bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutCI{};
+        setLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+        setLayoutCI.pBindings = bindings.data();
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &m_descriptorSetLayout));
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 }
+        }};
+        VkDescriptorPoolCreateInfo descriptorPoolCI{};
+        descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolCI.maxSets = 1;
+        descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        descriptorPoolCI.pPoolSizes = poolSizes.data();
+        VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &m_descriptorPool));
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_descriptorSetLayout;
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &m_descriptorSet));
+
+        std::array<VkDescriptorBufferInfo, 5> bufferInfos = {{
+            { m_uniformBuffer.getBuffer(), 0, VK_WHOLE_SIZE },
+            { model->meshlets.buffer.getBuffer(), 0, VK_WHOLE_SIZE },
+            { model->meshlets.indices.getBuffer(), 0, VK_WHOLE_SIZE },
+            { m_indexBuffer.getBuffer(), 0, VK_WHOLE_SIZE },
+            { m_drawBuffer.getBuffer(), 0, VK_WHOLE_SIZE }
+        }};
+        std::array<VkWriteDescriptorSet, 5> writes{};
+        for (uint32_t i = 0; i < writes.size(); i++) {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = m_descriptorSet;
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+            writes[i].descriptorType = bindings[i].descriptorType;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+        pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCI.setLayoutCount = 1;
+        pipelineLayoutCI.pSetLayouts = &m_descriptorSetLayout;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &m_pipelineLayout));
+
+        VulkanShaderModule shader("src/shaders/meshletCullComp.spv", m_device, VK_SHADER_STAGE_COMPUTE_BIT);
+        VkComputePipelineCreateInfo pipelineCI{};
+        pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineCI.stage = shader.getStageCreateInfo();
+        pipelineCI.layout = m_pipelineLayout;
+        VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &m_pipeline));
+        shader.cleanup(m_device);
+
+        UniformData uniformData{};
+        uniformData.meshletCount = model->meshlets.count;
+        memcpy(m_uniformBuffer.getMappedMemory(), &uniformData, sizeof(uniformData));
+    }
+
+    void VulkanMeshletCulling::update(const glm::mat4& viewProjection, glm::vec3 cameraPosition) {
+        Frustum frustum;
+        frustum.update(viewProjection);
+        UniformData uniformData{};
+        for (uint32_t i = 0; i < 6; i++) {
+            uniformData.frustumPlanes[i] = frustum.planes[i];
+        }
+        uniformData.cameraPosition = glm::vec4(cameraPosition, 1.0f);
+        uniformData.meshletCount = m_model->meshlets.count;
+        uniformData.coneCulling = coneCulling ? 1 : 0;
+        memcpy(m_uniformBuffer.getMappedMemory(), &uniformData, sizeof(uniformData));
+    }
+
+    void VulkanMeshletCulling::dispatch(VkCommandBuffer commandBuffer) {
+        // Draws of earlier submissions must be done reading before the buffers are overwritten
+        vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+        VkBufferCopy copyRegion{};
+        copyRegion.size = m_drawBuffer.getSize();
+        vkCmdCopyBuffer(commandBuffer, m_resetBuffer.getBuffer(), m_drawBuffer.getBuffer(), 1, &copyRegion);
+
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &m_descriptorSet, 0, nullptr);
+        // One workgroup per meshlet, spread over y past the guaranteed 65535 groups per dimension
+        const uint32_t maxGroups = 65535;
+        const uint32_t groupsX = std::min(m_model->meshlets.count, maxGroups);
+        const uint32_t groupsY = (m_model->meshlets.count + maxGroups - 1) / maxGroups;
+        vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    void VulkanMeshletCulling::draw(VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet) {
+        const VkDeviceSize offsets[1] = {0};
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, m_model->vertices.buffer.getBufferPointer(), offsets);
+        vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+        // Without pass flags every primitive is drawn, as in VulkanglTFModel::drawNode
+        const uint32_t passFlags = renderFlags & (RenderFlags::RenderOpaqueNodes | RenderFlags::RenderAlphaMaskedNodes | RenderFlags::RenderAlphaBlendedNodes);
+
+        // Vertices are pre-transformed, so the node hierarchy doesn't matter
+        for (Node* node : m_model->linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            for (Primitive* primitive : node->mesh->primitives) {
+                if (primitive->meshletCount == 0) {
+                    continue;
+                }
+                if (passFlags != 0 && (passFlags & primitive->renderPass) == 0) {
+                    continue;
+                }
+                const Material& material = primitive->material;
+                if (renderFlags & RenderFlags::BindImages) {
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+                }
+                vkCmdDrawIndexedIndirect(commandBuffer, m_drawBuffer.getBuffer(),
+                        primitive->meshletDrawIndex * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+            }
+        }
+    }
+}
@@ -2,6 +2,7 @@
 #include "stb_image.h"
 
 #include "VulkanBase.hpp"
+#include "VulkanKtxTranscoder.hpp"
 
 namespace VulkanLearning {
 
@@ -23,20 +24,27 @@ namespace VulkanLearning {
     void VulkanTexture::destroy() {
         vkDestroyImageView(m_device->getLogicalDevice(), m_view, nullptr);
         vkDestroyImage(m_device->getLogicalDevice(), m_image, nullptr);
-
-        if (m_sampler) {
-            vkDestroySampler(m_device->getLogicalDevice(), m_sampler, nullptr);
-        }
+        // Samplers come from the device cache and are shared with other textures
         vkFreeMemory(m_device->getLogicalDevice(), m_deviceMemory, nullptr);
     }
 
     void VulkanTexture2D::loadFromKTXFile(std::string filename, VkFormat format, VulkanDevice* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlag, VkImageLayout imageLayout, bool forceLinear) {
-        m_device = device;
-
-        ktxResult result;
         ktxTexture* ktxTexture;
+        loadKTXFile(filename, &ktxTexture);
 
-        result = loadKTXFile(filename, &ktxTexture);
+        // KTX2 files carry their format, Basis Universal ones are transcoded to one the device supports
+        if (prepareKtxTexture(device, ktxTexture, format, format) != KTX_SUCCESS) {
+            ktxTexture_Destroy(ktxTexture);
+            throw std::runtime_error("KTX Texture :" + filename + " transcoding failed!");
+        }
+
+        loadFromKTXTexture(ktxTexture, format, device, copyQueue, imageUsageFlag, imageLayout, forceLinear);
+
+        ktxTexture_Destroy(ktxTexture);
+    }
+
+    void VulkanTexture2D::loadFromKTXTexture(ktxTexture* ktxTexture, VkFormat format, VulkanDevice* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlag, VkImageLayout imageLayout, bool forceLinear, VulkanTextureBatch* uploadBatch) {
+        m_device = device;
 
         m_width = ktxTexture->baseWidth;
         m_height = ktxTexture->baseHeight;
@@ -56,59 +64,8 @@ namespace VulkanLearning {
 
         VkMemoryRequirements memReqs = {};
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-
-        VkBufferCreateInfo bufferCreateInfo = {};
-        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferCreateInfo.size = ktxTextureSize;
-        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-        if (vkCreateBuffer(m_device->getLogicalDevice(), &bufferCreateInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
-            throw std::runtime_error("Buffer creation failed!");
-        }
-
-        vkGetBufferMemoryRequirements(m_device->getLogicalDevice(), stagingBuffer, &memReqs);
-        memAllocInfo.allocationSize = memReqs.size;
-        memAllocInfo.memoryTypeIndex = m_device->findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-        if (vkAllocateMemory(m_device->getLogicalDevice(), &memAllocInfo, nullptr, &stagingMemory) != VK_SUCCESS) {
-            throw std::runtime_error("Memory allocation failed!");
-        }
-
-        if (vkBindBufferMemory(m_device->getLogicalDevice(), stagingBuffer, stagingMemory, 0) != VK_SUCCESS) {
-            throw std::runtime_error("Buffer memory binding failed!");
-        }
-
-        uint8_t *data;
-        if (vkMapMemory(m_device->getLogicalDevice(), stagingMemory, 0, memReqs.size, 0, (void **)&data) != VK_SUCCESS) {
-            throw std::runtime_error("Mapping memory failed!");
-        }
-        memcpy(data, ktxTextureData, ktxTextureSize);
-        vkUnmapMemory(m_device->getLogicalDevice(), stagingMemory);
-
-        std::vector<VkBufferImageCopy> bufferCopyRegions;
-
-        uint32_t offset = 0;
-
-        for (uint32_t i = 0; i < m_mipLevels; i++) {
-            ktx_size_t offset;
-            if (ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset) != KTX_SUCCESS) {
-                throw std::runtime_error("KTX get image offset failed!");
-            }
-
-            VkBufferImageCopy bufferCopyRegion = {};
-            bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            bufferCopyRegion.imageSubresource.mipLevel = i;
-            bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-            bufferCopyRegion.imageSubresource.layerCount = 1;
-            bufferCopyRegion.imageExtent.width = ktxTexture->baseWidth >> i;
-            bufferCopyRegion.imageExtent.height = ktxTexture->baseHeight >> i;
-            bufferCopyRegion.imageExtent.depth = 1;
-            bufferCopyRegion.bufferOffset = offset;
-            bufferCopyRegions.push_back(bufferCopyRegion);
-        }
+        // Levels of non square textures are clamped to one texel
+        std::vector<VkBufferImageCopy> bufferCopyRegions = getKtxLevelRegions(ktxTexture);
 
         VkImageCreateInfo imageCreateInfo = {};
         imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -139,70 +96,16 @@ namespace VulkanLearning {
             throw std::runtime_error("Image memory binding failed!");
         }
 
-        VulkanCommandBuffer copyCmd;
-        copyCmd.create(m_device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-        VkImageSubresourceRange subresourceRange = {};
-        subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        subresourceRange.baseMipLevel = 0;
-        subresourceRange.levelCount = m_mipLevels;
-        subresourceRange.layerCount = 1;
-
-        VkImageMemoryBarrier imageMemoryBarrier = {};
-        imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        imageMemoryBarrier.image = m_image;
-        imageMemoryBarrier.subresourceRange = subresourceRange;
-        imageMemoryBarrier.srcAccessMask = 0;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-
-        vkCmdPipelineBarrier(
-                copyCmd.getCommandBuffer(), 
-                VK_PIPELINE_STAGE_HOST_BIT, 
-                VK_PIPELINE_STAGE_TRANSFER_BIT, 
-                0,
-                0,
-                nullptr,
-                0,
-                nullptr,
-                1,
-                &imageMemoryBarrier);
-
-        vkCmdCopyBufferToImage(
-                copyCmd.getCommandBuffer(), 
-                stagingBuffer, 
-                m_image, 
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-                static_cast<uint32_t>(bufferCopyRegions.size()), 
-                bufferCopyRegions.data());
-
-        imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-        vkCmdPipelineBarrier(
-                copyCmd.getCommandBuffer(), 
-                VK_PIPELINE_STAGE_TRANSFER_BIT, 
-                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
-                0,
-                0,
-                nullptr,
-                0,
-                nullptr,
-                1,
-                &imageMemoryBarrier);
+        // Copies are recorded into the caller's batch, or into a local one flushed right away
+        std::unique_ptr<VulkanTextureBatch> localBatch;
+        if (uploadBatch == nullptr) {
+            localBatch = std::make_unique<VulkanTextureBatch>(m_device, copyQueue);
+            uploadBatch = localBatch.get();
+        }
+        uploadBatch->add(m_image, format, m_width, m_height, m_mipLevels, ktxTextureData, ktxTextureSize, bufferCopyRegions);
 
         m_imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-        copyCmd.flushCommandBuffer(m_device, true);
-
-        vkFreeMemory(m_device->getLogicalDevice(), stagingMemory, nullptr);
-        vkDestroyBuffer(m_device->getLogicalDevice(), stagingBuffer, nullptr);
-
-        ktxTexture_Destroy(ktxTexture);
-
         VkSamplerCreateInfo sampler = {};
         sampler.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         sampler.magFilter = VK_FILTER_LINEAR;
@@ -214,7 +117,8 @@ namespace VulkanLearning {
         sampler.mipLodBias = 0.0f;
         sampler.compareOp = VK_COMPARE_OP_NEVER;
         sampler.minLod = 0.0f;
-        sampler.maxLod = (float)m_mipLevels;
+        // Views limit the levels, so textures with any mip count share the cached sampler
+        sampler.maxLod = VK_LOD_CLAMP_NONE;
         if (m_device->features.samplerAnisotropy) {
             sampler.anisotropyEnable = VK_TRUE;
             sampler.maxAnisotropy = 16.0f;
@@ -225,10 +129,7 @@ namespace VulkanLearning {
 
         sampler.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 
-        if (vkCreateSampler(m_device->getLogicalDevice(), &sampler, 
-                    nullptr, &m_sampler) != VK_SUCCESS) {
-            throw std::runtime_error("Sampler creation failed!");
-        }
+        m_sampler = m_device->getSampler(sampler);
 
         VkImageViewCreateInfo view = {};
         view.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -255,36 +156,31 @@ namespace VulkanLearning {
         m_descriptor.sampler = m_sampler;
         m_descriptor.imageView = m_view;
         m_descriptor.imageLayout = m_imageLayout;
+
+        if (localBatch) {
+            localBatch->flush();
+        }
     }
 
 
-    void VulkanTexture2D::loadFromFile(std::string filename, VkFormat format, VulkanDevice* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlag, VkImageLayout imageLayout) {
+    void VulkanTexture2D::loadFromFile(std::string filename, VkFormat format, VulkanDevice* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlag, VkImageLayout imageLayout, VulkanTextureBatch* uploadBatch) {
         m_device = device;
         stbi_uc* pixels = stbi_load(filename.c_str(), &m_width, &m_height, &m_channelCount, STBI_rgb_alpha);
 
         VkDeviceSize imageSize = m_width * m_height * 4;
 
-        m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(
-                            m_width, m_height)))) + 1;
-
         if (!pixels) {
             throw std::runtime_error("Texture image loading failed!");
         }
 
-        VulkanBuffer stagingBuffer(*m_device);
-        stagingBuffer.createBuffer(
-                imageSize, 
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-        void* data;
-        vkMapMemory(m_device->getLogicalDevice(), 
-                stagingBuffer.getBufferMemory(), 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(m_device->getLogicalDevice(), 
-                stagingBuffer.getBufferMemory());
+        // Upload and mip generation are recorded into the caller's batch, or into a local one flushed right away
+        std::unique_ptr<VulkanTextureBatch> localBatch;
+        if (uploadBatch == nullptr) {
+            localBatch = std::make_unique<VulkanTextureBatch>(m_device, copyQueue);
+            uploadBatch = localBatch.get();
+        }
 
-        stbi_image_free(pixels);
+        m_mipLevels = uploadBatch->getMipLevels(format, m_width, m_height);
 
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -298,7 +194,7 @@ namespace VulkanLearning {
         imageInfo.format = format;
         imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
         imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.usage = imageUsageFlag | uploadBatch->getImageUsage(format, m_mipLevels);
         imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
         if (vkCreateImage(m_device->getLogicalDevice(), &imageInfo, nullptr, &m_image) != VK_SUCCESS) {
@@ -319,28 +215,10 @@ namespace VulkanLearning {
 
         vkBindImageMemory(m_device->getLogicalDevice(), m_image, m_deviceMemory, 0);
 
-        transitionImageLayout(
-                VK_FORMAT_R8G8B8A8_SRGB, 
-                VK_IMAGE_LAYOUT_UNDEFINED, 
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-                m_mipLevels);
-
-        copyBufferToImage(
-                stagingBuffer, 
-                static_cast<uint32_t>(m_width), 
-                static_cast<uint32_t>(m_height));
-
-        vkDestroyBuffer(
-                m_device->getLogicalDevice(), 
-                stagingBuffer.getBuffer(), 
-                nullptr);
-
-        vkFreeMemory(
-                m_device->getLogicalDevice(), 
-                stagingBuffer.getBufferMemory(), 
-                nullptr);
+        uploadBatch->add(m_image, format, m_width, m_height, m_mipLevels, pixels, imageSize, imageLayout);
+        m_imageLayout = imageLayout;
 
-        generateMipmaps(VK_FORMAT_R8G8B8A8_SRGB, m_width, m_height, m_mipLevels);
+        stbi_image_free(pixels);
 
         createSampler();
 
@@ -362,6 +240,10 @@ namespace VulkanLearning {
         m_descriptor.sampler = m_sampler;
         m_descriptor.imageView = m_view;
         m_descriptor.imageLayout = m_imageLayout;
+
+        if (localBatch) {
+            localBatch->flush();
+        }
     }
 
     void VulkanTexture2D::loadFromBuffer(void* buffer, VkDeviceSize bufferSize, VkFormat format, uint32_t texWidth, uint32_t texHeight, VulkanDevice* device, VkQueue copyQueue, VkFilter filter, VkImageUsageFlags imageUsageFlag, VkImageLayout imageLayout) {
@@ -499,10 +381,7 @@ namespace VulkanLearning {
         sampler.maxLod = 0.0f;
         sampler.maxAnisotropy = 1.0f;
 
-        if (vkCreateSampler(m_device->getLogicalDevice(), &sampler, 
-                    nullptr, &m_sampler) != VK_SUCCESS) {
-            throw std::runtime_error("Sampler creation failed!");
-        }
+        m_sampler = m_device->getSampler(sampler);
 
         VkImageViewCreateInfo view = {};
         view.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -529,167 +408,6 @@ namespace VulkanLearning {
         m_descriptor.imageLayout = m_imageLayout;
     }
 
-    void VulkanTexture2D::generateMipmaps(VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels) {
-        VkFormatProperties formatProperties;
-        vkGetPhysicalDeviceFormatProperties(m_device->getPhysicalDevice(), 
-                imageFormat, &formatProperties);
-
-        if (!(formatProperties.optimalTilingFeatures & 
-                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT)) {
-            throw std::runtime_error("Image texture format does not support linear filtering");
-        }
-
-        VulkanCommandBuffer commandBuffer;
-        commandBuffer.create(m_device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = m_image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32_t mipWidth = texWidth;
-        int32_t mipHeight = texHeight;
-
-        for (uint32_t i = 1; i < mipLevels; i++) {
-            barrier.subresourceRange.baseMipLevel = i - 1;
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer.getCommandBuffer(), 
-                    VK_PIPELINE_STAGE_TRANSFER_BIT, 
-                    VK_PIPELINE_STAGE_TRANSFER_BIT,
-                    0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-            VkImageBlit blit{};
-            blit.srcOffsets[0] = {0, 0, 0};
-            blit.srcOffsets[1] = {mipWidth, mipHeight, 1};
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-            blit.dstOffsets[0] = {0, 0, 0};
-            blit.dstOffsets[1] = {mipWidth > 1 ? mipWidth / 2 : 1, 
-                mipHeight > 1 ? mipHeight / 2 : 1, 1};
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(commandBuffer.getCommandBuffer(), 
-                    m_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 
-                    m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, 
-                    VK_FILTER_LINEAR);
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(commandBuffer.getCommandBuffer(), 
-                    VK_PIPELINE_STAGE_TRANSFER_BIT, 
-                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                    0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-            if (mipWidth > 1) mipWidth /= 2;
-            if (mipHeight > 1) mipHeight /= 2;
-        }
-
-        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(commandBuffer.getCommandBuffer(), 
-                VK_PIPELINE_STAGE_TRANSFER_BIT, 
-                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-                0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        commandBuffer.flushCommandBuffer(m_device, true);
-    }
-
-    void VulkanTexture2D::transitionImageLayout(VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
-        VulkanCommandBuffer commandBuffer;
-        commandBuffer.create(m_device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-        VkImageMemoryBarrier barrier{};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = oldLayout;
-        barrier.newLayout = newLayout;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = m_image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = mipLevels;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        } else {
-            throw std::runtime_error("Organisation of a transition not supported!");
-        }
-
-        vkCmdPipelineBarrier(commandBuffer.getCommandBuffer(), sourceStage, 
-                destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        commandBuffer.flushCommandBuffer(m_device, true);
-    }
-
-    void VulkanTexture2D::copyBufferToImage(VulkanBuffer buffer, uint32_t width, uint32_t height) {
-        VulkanCommandBuffer commandBuffer;
-        commandBuffer.create(m_device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-        VkBufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {
-            width,
-            height,
-            1
-        };
-
-        vkCmdCopyBufferToImage(
-                commandBuffer.getCommandBuffer(), 
-                buffer.getBuffer(), 
-                m_image, 
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
-                1, 
-                &region);
-
-        commandBuffer.flushCommandBuffer(m_device, true);
-
-    }
-
     void VulkanTexture2D::createSampler() {
         VkSamplerCreateInfo samplerInfo{};
 
@@ -708,13 +426,10 @@ namespace VulkanLearning {
         samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         samplerInfo.minLod = 0;
         /* samplerInfo.minLod = static_cast<float>(m_mipLevels / 2); */
-        samplerInfo.maxLod = static_cast<float>(m_mipLevels);
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
         samplerInfo.mipLodBias = 0.0f;
 
-        if (vkCreateSampler(m_device->getLogicalDevice(), &samplerInfo, 
-                    nullptr, &m_sampler) != VK_SUCCESS) {
-            throw std::runtime_error("Sampler creation failed!");
-        }
+        m_sampler = m_device->getSampler(samplerInfo);
     }
 
     void VulkanTexture2DArray::loadFromKTXFile(std::string filename, VkFormat format, VulkanDevice* device, VkQueue copyQueue, VkImageUsageFlags imageUsageFlags, VkImageLayout imageLayout) {
@@ -877,13 +592,10 @@ namespace VulkanLearning {
         }
         samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
         samplerCreateInfo.minLod = 0.0f;
-        samplerCreateInfo.maxLod = (float)m_mipLevels;
+        samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
         samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
 
-        if (vkCreateSampler(m_device->getLogicalDevice(), &samplerCreateInfo, 
-                    nullptr, &m_sampler) != VK_SUCCESS) {
-            throw std::runtime_error("Sampler creation failed!");
-        }
+        m_sampler = m_device->getSampler(samplerCreateInfo);
         
         VkImageViewCreateInfo viewCreateInfo = {};
         viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
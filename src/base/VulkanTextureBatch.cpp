@@ -0,0 +1,513 @@
+#include "VulkanTextureBatch.hpp"
+#include "VulkanCommandBuffer.hpp"
+#include "VulkanShaderModule.hpp"
+#include "VulkanTools.hpp"
+#include "PixelKernels.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace VulkanLearning {
+
+    static VkImageMemoryBarrier mipBarrier(
+            VkImage image,
+            uint32_t baseMipLevel,
+            uint32_t levelCount,
+            VkImageLayout oldLayout,
+            VkImageLayout newLayout,
+            VkAccessFlags srcAccessMask,
+            VkAccessFlags dstAccessMask) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = baseMipLevel;
+        barrier.subresourceRange.levelCount = levelCount;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        return barrier;
+    }
+
+    static bool isSrgb(VkFormat format) {
+        return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_B8G8R8A8_SRGB;
+    }
+
+    // 2x2 box filter of sRGB encoded RGBA pixels, the color channels are averaged in linear space
+    // and alpha as is. Odd sized levels use the same 3 texel edge footprint as PixelKernels.
+    static void downsampleSrgb2x2(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst) {
+        static const std::array<float, 256> toLinear = [] {
+            std::array<float, 256> table{};
+            for (uint32_t i = 0; i < 256; i++) {
+                float c = i / 255.0f;
+                table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return table;
+        }();
+        // Linear values are quantized to 12 bits before encoding, finer than the 8 bit output needs
+        static const std::array<uint8_t, 4096> toSrgb = [] {
+            std::array<uint8_t, 4096> table{};
+            for (uint32_t i = 0; i < 4096; i++) {
+                float c = i / 4095.0f;
+                float encoded = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+                table[i] = static_cast<uint8_t>(std::lround(std::min(1.0f, encoded) * 255.0f));
+            }
+            return table;
+        }();
+
+        uint32_t dstWidth = std::max(1u, width / 2);
+        uint32_t dstHeight = std::max(1u, height / 2);
+        for (uint32_t y = 0; y < dstHeight; y++) {
+            uint32_t rows = (y + 1 == dstHeight) ? height - 2 * y : 2;
+            for (uint32_t x = 0; x < dstWidth; x++) {
+                uint32_t columns = (x + 1 == dstWidth) ? width - 2 * x : 2;
+                float color[3] = {};
+                uint32_t alpha = 0;
+                for (uint32_t j = 0; j < rows; j++) {
+                    const uint8_t* texel = src + (static_cast<size_t>(2 * y + j) * width + 2 * x) * 4;
+                    for (uint32_t i = 0; i < columns; i++, texel += 4) {
+                        color[0] += toLinear[texel[0]];
+                        color[1] += toLinear[texel[1]];
+                        color[2] += toLinear[texel[2]];
+                        alpha += texel[3];
+                    }
+                }
+                const uint32_t count = rows * columns;
+                uint8_t* out = dst + (static_cast<size_t>(y) * dstWidth + x) * 4;
+                for (uint32_t c = 0; c < 3; c++) {
+                    out[c] = toSrgb[static_cast<uint32_t>(color[c] / count * 4095.0f + 0.5f)];
+                }
+                out[3] = static_cast<uint8_t>((alpha + count / 2) / count);
+            }
+        }
+    }
+
+    VulkanTextureBatch::VulkanTextureBatch(VulkanDevice* device, VkQueue queue, VkDeviceSize flushThreshold)
+        : m_device(device), m_queue(queue), m_flushThreshold(flushThreshold) {}
+
+    VulkanTextureBatch::~VulkanTextureBatch() {
+        // Submit whatever is still pending so no staging buffer is leaked
+        flush();
+
+        VkDevice device = m_device->getLogicalDevice();
+        if (m_computePipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, m_computePipeline, nullptr);
+            vkDestroyPipelineLayout(device, m_computePipelineLayout, nullptr);
+            vkDestroyDescriptorSetLayout(device, m_computeSetLayout, nullptr);
+        }
+    }
+
+    bool VulkanTextureBatch::canBlit(VkFormat format) {
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(m_device->getPhysicalDevice(), format, &formatProperties);
+
+        const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT
+            | VK_FORMAT_FEATURE_BLIT_DST_BIT
+            | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
+
+    bool VulkanTextureBatch::canComputeMipmaps(VkFormat format) {
+        // The downsampler writes through an image without format qualifier
+        if (!m_device->enabledFeatures.shaderStorageImageWriteWithoutFormat) {
+            return false;
+        }
+
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(m_device->getPhysicalDevice(), format, &formatProperties);
+
+        const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+            | VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+        return (formatProperties.optimalTilingFeatures & required) == required;
+    }
+
+    bool VulkanTextureBatch::canCpuMipmaps(VkFormat format) {
+        switch (format) {
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    uint32_t VulkanTextureBatch::getMipLevels(VkFormat format, uint32_t width, uint32_t height) {
+        if (!canBlit(format) && !canComputeMipmaps(format) && !canCpuMipmaps(format)) {
+            std::cerr << "Format " << format << " supports neither blits nor storage writes, mip chain is skipped" << std::endl;
+            return 1;
+        }
+        return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+    }
+
+    VkImageUsageFlags VulkanTextureBatch::getImageUsage(VkFormat format, uint32_t mipLevels) {
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (mipLevels > 1) {
+            if (canBlit(format)) {
+                usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            } else if (canComputeMipmaps(format)) {
+                usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+            }
+        }
+        return usage;
+    }
+
+    void VulkanTextureBatch::add(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, const void* data, VkDeviceSize size, VkImageLayout finalLayout) {
+        if (mipLevels > 1 && !canBlit(format) && !canComputeMipmaps(format)) {
+            addCpuMipmaps(image, format, width, height, mipLevels, data, finalLayout);
+            return;
+        }
+
+        VkBufferImageCopy copyRegion{};
+        copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copyRegion.imageSubresource.mipLevel = 0;
+        copyRegion.imageSubresource.baseArrayLayer = 0;
+        copyRegion.imageSubresource.layerCount = 1;
+        copyRegion.imageExtent = { width, height, 1 };
+
+        queueUpload(image, format, width, height, mipLevels, 1, mipLevels > 1 && !canBlit(format),
+                data, size, { copyRegion }, finalLayout);
+    }
+
+    void VulkanTextureBatch::add(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& copyRegions, VkImageLayout finalLayout) {
+        queueUpload(image, format, width, height, mipLevels, mipLevels, false, data, size, copyRegions, finalLayout);
+    }
+
+    void VulkanTextureBatch::queueUpload(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, uint32_t providedLevels, bool useCompute, const void* data, VkDeviceSize size, const std::vector<VkBufferImageCopy>& copyRegions, VkImageLayout finalLayout) {
+        Upload upload{};
+        upload.image = image;
+        upload.format = format;
+        upload.width = width;
+        upload.height = height;
+        upload.mipLevels = mipLevels;
+        upload.providedLevels = providedLevels;
+        upload.useCompute = useCompute;
+        upload.finalLayout = finalLayout;
+        upload.copyRegions = copyRegions;
+
+        upload.stagingBuffer = VulkanBuffer(*m_device);
+        upload.stagingBuffer.createBuffer(
+                size,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                const_cast<void*>(data));
+
+        m_uploads.push_back(upload);
+        m_pendingSize += size;
+
+        // Bounds the staging memory, the uploads done so far still share one submit
+        if (m_flushThreshold > 0 && m_pendingSize >= m_flushThreshold) {
+            flush();
+        }
+    }
+
+    void VulkanTextureBatch::addCpuMipmaps(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, const void* data, VkImageLayout finalLayout) {
+        // Last resort when the device can't generate the chain, levels are box filtered
+        // on the CPU and uploaded like a file that already contains them
+        std::vector<VkBufferImageCopy> copyRegions(mipLevels);
+        VkDeviceSize totalSize = 0;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            uint32_t levelWidth = std::max(1u, width >> level);
+            uint32_t levelHeight = std::max(1u, height >> level);
+
+            copyRegions[level] = {};
+            copyRegions[level].bufferOffset = totalSize;
+            copyRegions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegions[level].imageSubresource.mipLevel = level;
+            copyRegions[level].imageSubresource.layerCount = 1;
+            copyRegions[level].imageExtent = { levelWidth, levelHeight, 1 };
+            totalSize += static_cast<VkDeviceSize>(levelWidth) * levelHeight * 4;
+        }
+
+        std::vector<uint8_t> levels(totalSize);
+        memcpy(levels.data(), data, static_cast<size_t>(width) * height * 4);
+        // Averaging sRGB values as stored would darken the smaller levels
+        auto downsample = isSrgb(format) ? downsampleSrgb2x2 : PixelKernels::downsample2x2;
+        for (uint32_t level = 1; level < mipLevels; level++) {
+            downsample(
+                    levels.data() + copyRegions[level - 1].bufferOffset,
+                    copyRegions[level - 1].imageExtent.width,
+                    copyRegions[level - 1].imageExtent.height,
+                    levels.data() + copyRegions[level].bufferOffset);
+        }
+
+        add(image, format, width, height, mipLevels, levels.data(), totalSize, copyRegions, finalLayout);
+    }
+
+    void VulkanTextureBatch::prepareComputePipeline() {
+        if (m_computePipeline != VK_NULL_HANDLE) {
+            return;
+        }
+
+        VkDevice device = m_device->getLogicalDevice();
+
+        std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+        bindings[0].binding = 0;
+        bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        bindings[0].descriptorCount = 1;
+        bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        bindings[1].binding = 1;
+        bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        bindings[1].descriptorCount = 1;
+        bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        VkDescriptorSetLayoutCreateInfo setLayoutCI{};
+        setLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutCI.bindingCount = static_cast<uint32_t>(bindings.size());
+        setLayoutCI.pBindings = bindings.data();
+        VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &m_computeSetLayout));
+
+        VkPipelineLayoutCreateInfo pipelineLayoutCI{};
+        pipelineLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutCI.setLayoutCount = 1;
+        pipelineLayoutCI.pSetLayouts = &m_computeSetLayout;
+        VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &m_computePipelineLayout));
+
+        // Source texels are fetched directly, the sampler only has to exist
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.maxLod = 0.0f;
+        m_computeSampler = m_device->getSampler(samplerInfo);
+
+        VulkanShaderModule shader("src/shaders/mipmapDownsampleComp.spv", m_device, VK_SHADER_STAGE_COMPUTE_BIT);
+
+        VkComputePipelineCreateInfo pipelineCI{};
+        pipelineCI.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineCI.stage = shader.getStageCreateInfo();
+        pipelineCI.layout = m_computePipelineLayout;
+        VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &m_computePipeline));
+
+        shader.cleanup(m_device);
+    }
+
+    void VulkanTextureBatch::flush() {
+        if (m_uploads.empty()) {
+            return;
+        }
+
+        VkDevice device = m_device->getLogicalDevice();
+
+        uint32_t maxLevels = 0;
+        bool needsCompute = false;
+        for (Upload& upload : m_uploads) {
+            maxLevels = std::max(maxLevels, upload.mipLevels);
+            needsCompute |= upload.useCompute;
+        }
+
+        // The compute path reads and writes single levels, so it needs one view per level
+        std::vector<std::vector<VkImageView>> levelViews(m_uploads.size());
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        if (needsCompute) {
+            prepareComputePipeline();
+
+            uint32_t setCount = 0;
+            for (size_t i = 0; i < m_uploads.size(); i++) {
+                Upload& upload = m_uploads[i];
+                if (!upload.useCompute) {
+                    continue;
+                }
+                levelViews[i].resize(upload.mipLevels);
+                for (uint32_t level = 0; level < upload.mipLevels; level++) {
+                    VkImageViewCreateInfo viewInfo{};
+                    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+                    viewInfo.image = upload.image;
+                    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                    viewInfo.format = upload.format;
+                    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                    viewInfo.subresourceRange.baseMipLevel = level;
+                    viewInfo.subresourceRange.levelCount = 1;
+                    viewInfo.subresourceRange.layerCount = 1;
+                    VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &levelViews[i][level]));
+                }
+                setCount += upload.mipLevels - 1;
+            }
+
+            std::array<VkDescriptorPoolSize, 2> poolSizes{};
+            poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            poolSizes[0].descriptorCount = setCount;
+            poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            poolSizes[1].descriptorCount = setCount;
+
+            VkDescriptorPoolCreateInfo descriptorPoolCI{};
+            descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+            descriptorPoolCI.pPoolSizes = poolSizes.data();
+            descriptorPoolCI.maxSets = setCount;
+            VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolCI, nullptr, &descriptorPool));
+        }
+
+        VulkanCommandBuffer commandBuffer;
+        commandBuffer.create(m_device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+        VkCommandBuffer cmd = commandBuffer.getCommandBuffer();
+
+        std::vector<VkImageMemoryBarrier> barriers;
+        barriers.reserve(m_uploads.size() * 2);
+
+        // Every level of every image becomes a transfer destination in a single barrier call
+        for (Upload& upload : m_uploads) {
+            barriers.push_back(mipBarrier(upload.image, 0, upload.mipLevels,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        0, VK_ACCESS_TRANSFER_WRITE_BIT));
+        }
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        for (Upload& upload : m_uploads) {
+            vkCmdCopyBufferToImage(cmd, upload.stagingBuffer.getBuffer(), upload.image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    static_cast<uint32_t>(upload.copyRegions.size()), upload.copyRegions.data());
+        }
+
+        const VkPipelineStageFlags mipStages = VK_PIPELINE_STAGE_TRANSFER_BIT
+            | (needsCompute ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : 0);
+
+        // Walk the chains level by level so all images share the barrier between two levels
+        for (uint32_t level = 1; level < maxLevels; level++) {
+            barriers.clear();
+            for (Upload& upload : m_uploads) {
+                if (level >= upload.mipLevels || level < upload.providedLevels) {
+                    continue;
+                }
+                if (upload.useCompute) {
+                    barriers.push_back(mipBarrier(upload.image, level - 1, 1,
+                                level == 1 ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL,
+                                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                                level == 1 ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT,
+                                VK_ACCESS_SHADER_READ_BIT));
+                    barriers.push_back(mipBarrier(upload.image, level, 1,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,
+                                0, VK_ACCESS_SHADER_WRITE_BIT));
+                } else {
+                    barriers.push_back(mipBarrier(upload.image, level - 1, 1,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT));
+                }
+            }
+            if (barriers.empty()) {
+                continue;
+            }
+            vkCmdPipelineBarrier(cmd, mipStages, mipStages,
+                    0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+            bool computePipelineBound = false;
+            for (size_t i = 0; i < m_uploads.size(); i++) {
+                Upload& upload = m_uploads[i];
+                if (level >= upload.mipLevels || level < upload.providedLevels) {
+                    continue;
+                }
+
+                int32_t srcWidth = std::max(1, int32_t(upload.width >> (level - 1)));
+                int32_t srcHeight = std::max(1, int32_t(upload.height >> (level - 1)));
+                int32_t dstWidth = std::max(1, int32_t(upload.width >> level));
+                int32_t dstHeight = std::max(1, int32_t(upload.height >> level));
+
+                if (upload.useCompute) {
+                    if (!computePipelineBound) {
+                        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
+                        computePipelineBound = true;
+                    }
+
+                    VkDescriptorSetAllocateInfo allocInfo{};
+                    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                    allocInfo.descriptorPool = descriptorPool;
+                    allocInfo.descriptorSetCount = 1;
+                    allocInfo.pSetLayouts = &m_computeSetLayout;
+                    VkDescriptorSet descriptorSet;
+                    VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet));
+
+                    VkDescriptorImageInfo srcInfo{ m_computeSampler, levelViews[i][level - 1], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+                    VkDescriptorImageInfo dstInfo{ VK_NULL_HANDLE, levelViews[i][level], VK_IMAGE_LAYOUT_GENERAL };
+
+                    std::array<VkWriteDescriptorSet, 2> writes{};
+                    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    writes[0].dstSet = descriptorSet;
+                    writes[0].dstBinding = 0;
+                    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    writes[0].descriptorCount = 1;
+                    writes[0].pImageInfo = &srcInfo;
+                    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    writes[1].dstSet = descriptorSet;
+                    writes[1].dstBinding = 1;
+                    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                    writes[1].descriptorCount = 1;
+                    writes[1].pImageInfo = &dstInfo;
+                    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+                    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+                    vkCmdDispatch(cmd, (dstWidth + 7) / 8, (dstHeight + 7) / 8, 1);
+                } else {
+                    VkImageBlit imageBlit{};
+                    imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                    imageBlit.srcSubresource.layerCount = 1;
+                    imageBlit.srcSubresource.mipLevel = level - 1;
+                    imageBlit.srcOffsets[1] = { srcWidth, srcHeight, 1 };
+                    imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                    imageBlit.dstSubresource.layerCount = 1;
+                    imageBlit.dstSubresource.mipLevel = level;
+                    imageBlit.dstOffsets[1] = { dstWidth, dstHeight, 1 };
+
+                    vkCmdBlitImage(cmd,
+                            upload.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                            upload.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            1, &imageBlit, VK_FILTER_LINEAR);
+                }
+            }
+        }
+
+        // And all images end up in their final layout with one last barrier call
+        barriers.clear();
+        for (Upload& upload : m_uploads) {
+            if (upload.providedLevels >= upload.mipLevels) {
+                barriers.push_back(mipBarrier(upload.image, 0, upload.mipLevels,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, upload.finalLayout,
+                            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+            } else if (upload.useCompute) {
+                barriers.push_back(mipBarrier(upload.image, 0, upload.mipLevels - 1,
+                            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, upload.finalLayout,
+                            VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_READ_BIT));
+                barriers.push_back(mipBarrier(upload.image, upload.mipLevels - 1, 1,
+                            VK_IMAGE_LAYOUT_GENERAL, upload.finalLayout,
+                            VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+            } else {
+                barriers.push_back(mipBarrier(upload.image, 0, upload.mipLevels - 1,
+                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, upload.finalLayout,
+                            VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT));
+                barriers.push_back(mipBarrier(upload.image, upload.mipLevels - 1, 1,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, upload.finalLayout,
+                            VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT));
+            }
+        }
+        vkCmdPipelineBarrier(cmd, mipStages, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        commandBuffer.flushCommandBuffer(m_device, m_queue, true);
+
+        for (Upload& upload : m_uploads) {
+            upload.stagingBuffer.cleanup();
+        }
+        for (std::vector<VkImageView>& views : levelViews) {
+            for (VkImageView view : views) {
+                vkDestroyImageView(device, view, nullptr);
+            }
+        }
+        if (descriptorPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        }
+
+        m_uploads.clear();
+        m_pendingSize = 0;
+    }
+}
@@ -0,0 +1,181 @@
+#include "VulkanTextureResidency.hpp"
+#include "VulkanTools.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace VulkanLearning {
+
+    VulkanTextureResidency::VulkanTextureResidency(VulkanDevice* device) : m_device(device) {}
+
+    uint32_t VulkanTextureResidency::add(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+        uint32_t blockExtent;
+        uint32_t blockSize;
+        if (!tools::getFormatBlock(format, blockExtent, blockSize)) {
+            throw std::runtime_error("texture residency doesn't handle this format!");
+        }
+
+        Entry entry{};
+        entry.mipLevels = mipLevels;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            const VkDeviceSize levelWidth = std::max(1u, width >> level);
+            const VkDeviceSize levelHeight = std::max(1u, height >> level);
+            entry.levelSizes.push_back(((levelWidth + blockExtent - 1) / blockExtent)
+                    * ((levelHeight + blockExtent - 1) / blockExtent) * blockSize);
+        }
+        entry.tailLevel = 0;
+        while (entry.tailLevel + 1 < mipLevels
+                && std::max(width >> entry.tailLevel, height >> entry.tailLevel) > tailSize) {
+            entry.tailLevel++;
+        }
+        entry.residentLevel = entry.tailLevel;
+        entry.requiredLevel = entry.tailLevel;
+
+        m_residentBytes += getLevelBytes(entry, entry.residentLevel);
+        m_entries.push_back(entry);
+        return static_cast<uint32_t>(m_entries.size() - 1);
+    }
+
+    uint32_t VulkanTextureResidency::getInitialLevel(uint32_t index) {
+        return m_entries[index].tailLevel;
+    }
+
+    void VulkanTextureResidency::use(uint32_t index, uint32_t requiredLevel) {
+        Entry& entry = m_entries[index];
+        requiredLevel = std::min(requiredLevel, entry.mipLevels - 1);
+        if (!entry.used || entry.lastUsedFrame != m_frame) {
+            entry.requiredLevel = requiredLevel;
+        } else {
+            entry.requiredLevel = std::min(entry.requiredLevel, requiredLevel);
+        }
+        entry.lastUsedFrame = m_frame;
+        entry.used = true;
+    }
+
+    VkDeviceSize VulkanTextureResidency::getLevelBytes(const Entry& entry, uint32_t firstLevel) {
+        return std::accumulate(entry.levelSizes.begin() + firstLevel, entry.levelSizes.end(), VkDeviceSize(0));
+    }
+
+    bool VulkanTextureResidency::isRecent(const Entry& entry) {
+        return entry.used && m_frame - entry.lastUsedFrame <= retainFrames;
+    }
+
+    VkDeviceSize VulkanTextureResidency::queryBudget() {
+        if (budget > 0) {
+            return budget;
+        }
+        // Memory used by everything else isn't available to textures, whatever the share
+        VkDeviceSize usage;
+        const VkDeviceSize deviceBudget = m_device->getDeviceLocalBudget(&usage);
+        const VkDeviceSize otherUsage = usage > m_residentBytes ? usage - m_residentBytes : 0;
+        const VkDeviceSize available = deviceBudget > otherUsage ? deviceBudget - otherUsage : 0;
+        return std::min(available, static_cast<VkDeviceSize>(deviceBudget * budgetShare));
+    }
+
+    std::vector<uint32_t> VulkanTextureResidency::update() {
+        m_budget = queryBudget();
+
+        std::vector<uint32_t> planned(m_entries.size());
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            planned[i] = m_entries[i].residentLevel;
+        }
+
+        // Reloads for the textures asked for this frame, one level at a time from the coarse end.
+        // Older requests aren't reloaded, they would fight over the budget with the current ones
+        std::vector<uint32_t> order(m_entries.size());
+        std::iota(order.begin(), order.end(), 0);
+        VkDeviceSize reloadBytes = 0;
+        for (uint32_t i : order) {
+            const Entry& entry = m_entries[i];
+            if (!entry.used || entry.lastUsedFrame != m_frame) {
+                continue;
+            }
+            const uint32_t target = std::min(entry.requiredLevel, entry.tailLevel);
+            while (planned[i] > target) {
+                const VkDeviceSize bytes = entry.levelSizes[planned[i] - 1];
+                if (reloadBytes > 0 && reloadBytes + bytes > reloadBudget) {
+                    break;
+                }
+                reloadBytes += bytes;
+                planned[i]--;
+            }
+        }
+
+        VkDeviceSize total = 0;
+        for (size_t i = 0; i < m_entries.size(); i++) {
+            total += getLevelBytes(m_entries[i], planned[i]);
+        }
+
+        // Evictions, least recently used first, the texture with the largest top level on ties.
+        // The first pass only drops levels that weren't asked for, the second whatever it takes
+        if (total > m_budget) {
+            std::stable_sort(order.begin(), order.end(), [this, &planned](uint32_t a, uint32_t b) {
+                    if (m_entries[a].lastUsedFrame != m_entries[b].lastUsedFrame) {
+                        return m_entries[a].lastUsedFrame < m_entries[b].lastUsedFrame;
+                    }
+                    return m_entries[a].levelSizes[planned[a]] > m_entries[b].levelSizes[planned[b]];
+                    });
+            for (int pass = 0; pass < 2 && total > m_budget; pass++) {
+                for (uint32_t i : order) {
+                    const Entry& entry = m_entries[i];
+                    uint32_t floor = entry.tailLevel;
+                    if (pass == 0 && isRecent(entry)) {
+                        floor = std::min(entry.requiredLevel, entry.tailLevel);
+                    }
+                    while (total > m_budget && planned[i] < floor) {
+                        total -= entry.levelSizes[planned[i]];
+                        planned[i]++;
+                    }
+                    if (total <= m_budget) {
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::vector<uint32_t> changed;
+        for (uint32_t i = 0; i < m_entries.size(); i++) {
+            Entry& entry = m_entries[i];
+            if (planned[i] == entry.residentLevel) {
+                continue;
+            }
+            const VkDeviceSize before = getLevelBytes(entry, entry.residentLevel);
+            const VkDeviceSize after = getLevelBytes(entry, planned[i]);
+            if (after > before) {
+                m_reloadedBytes += after - before;
+            } else {
+                m_evictedBytes += before - after;
+            }
+            entry.residentLevel = planned[i];
+            changed.push_back(i);
+        }
+        m_residentBytes = total;
+        m_frame++;
+        return changed;
+    }
+
+    uint32_t VulkanTextureResidency::getResidentLevel(uint32_t index) {
+        return m_entries[index].residentLevel;
+    }
+
+    uint32_t VulkanTextureResidency::getTextureCount() {
+        return static_cast<uint32_t>(m_entries.size());
+    }
+
+    VkDeviceSize VulkanTextureResidency::getResidentBytes() {
+        return m_residentBytes;
+    }
+
+    VkDeviceSize VulkanTextureResidency::getBudget() {
+        return m_budget;
+    }
+
+    VkDeviceSize VulkanTextureResidency::getEvictedBytes() {
+        return m_evictedBytes;
+    }
+
+    VkDeviceSize VulkanTextureResidency::getReloadedBytes() {
+        return m_reloadedBytes;
+    }
+}
@@ -0,0 +1,322 @@
+#include "VulkanTextureStreamer.hpp"
+#include "VulkanTools.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace VulkanLearning {
+
+    static VkImageMemoryBarrier levelBarrier(
+            VkImage image,
+            uint32_t level,
+            VkImageLayout oldLayout,
+            VkImageLayout newLayout,
+            VkAccessFlags srcAccessMask,
+            VkAccessFlags dstAccessMask) {
+        VkImageMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = level;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        return barrier;
+    }
+
+    VulkanTextureStreamer::VulkanTextureStreamer(VulkanDevice* device, VkQueue queue)
+        : m_device(device), m_queue(queue) {}
+
+    VulkanTextureStreamer::~VulkanTextureStreamer() {
+        cleanup();
+    }
+
+    void VulkanTextureStreamer::cleanup() {
+        if (m_commandPool == VK_NULL_HANDLE) {
+            return;
+        }
+        VkDevice device = m_device->getLogicalDevice();
+        if (m_submitted) {
+            vkWaitForFences(device, 1, &m_fence, VK_TRUE, UINT64_MAX);
+            m_submitted = false;
+        }
+        m_stagingBuffer.unmap();
+        m_stagingBuffer.cleanup();
+        m_stagingSize = 0;
+        vkDestroyFence(device, m_fence, nullptr);
+        vkDestroyCommandPool(device, m_commandPool, nullptr);
+        m_fence = VK_NULL_HANDLE;
+        m_commandPool = VK_NULL_HANDLE;
+        m_commandBuffer = VK_NULL_HANDLE;
+    }
+
+    void VulkanTextureStreamer::prepare(VkDeviceSize stagingSize) {
+        VkDevice device = m_device->getLogicalDevice();
+        if (m_commandPool == VK_NULL_HANDLE) {
+            VkCommandPoolCreateInfo poolInfo{};
+            poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            poolInfo.queueFamilyIndex = m_device->getQueueFamilyIndices().graphicsFamily.value();
+            VK_CHECK_RESULT(vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool));
+
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = m_commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &m_commandBuffer));
+
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &m_fence));
+        }
+
+        // Only called without a submission in flight, so the old buffer is free to go
+        if (m_stagingSize != stagingSize) {
+            if (m_stagingSize > 0) {
+                m_stagingBuffer.unmap();
+                m_stagingBuffer.cleanup();
+            }
+            m_stagingBuffer = VulkanBuffer(*m_device);
+            m_stagingBuffer.createBuffer(
+                    stagingSize,
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_CHECK_RESULT(m_stagingBuffer.map());
+            m_stagingSize = stagingSize;
+        }
+    }
+
+    uint32_t VulkanTextureStreamer::add(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels) {
+        Stream stream{};
+        stream.image = image;
+        stream.width = width;
+        stream.height = height;
+        stream.mipLevels = mipLevels;
+        if (!tools::getFormatBlock(format, stream.blockExtent, stream.blockSize)) {
+            throw std::runtime_error("Texture streaming doesn't support format " + std::to_string(format));
+        }
+        stream.levelOffsets.resize(mipLevels);
+        VkDeviceSize offset = 0;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            stream.levelOffsets[level] = offset;
+            offset += getLevelSize(stream, level);
+        }
+        stream.pendingLevels = mipLevels;
+        stream.recordedLevel = mipLevels;
+        stream.residentLevel = mipLevels;
+        m_streams.push_back(std::move(stream));
+        return static_cast<uint32_t>(m_streams.size() - 1);
+    }
+
+    void VulkanTextureStreamer::provide(uint32_t index, std::vector<uint8_t>&& levels) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_provided.push_back({ index, std::move(levels), nullptr });
+    }
+
+    void VulkanTextureStreamer::provideExternal(uint32_t index, const uint8_t* levels) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_provided.push_back({ index, std::vector<uint8_t>(), levels });
+    }
+
+    void VulkanTextureStreamer::collectProvided() {
+        std::vector<Provided> provided;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            provided.swap(m_provided);
+        }
+        for (Provided& levels : provided) {
+            Stream& stream = m_streams[levels.index];
+            stream.storage = std::move(levels.storage);
+            stream.data = stream.storage.empty() ? levels.data : stream.storage.data();
+            for (uint32_t level = 0; level < stream.mipLevels; level++) {
+                m_pendingBytes += getLevelSize(stream, level);
+            }
+        }
+    }
+
+    VkDeviceSize VulkanTextureStreamer::getRowSize(const Stream& stream, uint32_t level) {
+        const uint32_t width = std::max(1u, stream.width >> level);
+        return static_cast<VkDeviceSize>((width + stream.blockExtent - 1) / stream.blockExtent) * stream.blockSize;
+    }
+
+    uint32_t VulkanTextureStreamer::getRowCount(const Stream& stream, uint32_t level) {
+        const uint32_t height = std::max(1u, stream.height >> level);
+        return (height + stream.blockExtent - 1) / stream.blockExtent;
+    }
+
+    VkDeviceSize VulkanTextureStreamer::getLevelSize(const Stream& stream, uint32_t level) {
+        return getRowSize(stream, level) * getRowCount(stream, level);
+    }
+
+    std::vector<uint32_t> VulkanTextureStreamer::update() {
+        std::vector<uint32_t> changed;
+        if (m_submitted) {
+            if (vkGetFenceStatus(m_device->getLogicalDevice(), m_fence) != VK_SUCCESS) {
+                return changed;
+            }
+            VK_CHECK_RESULT(vkResetFences(m_device->getLogicalDevice(), 1, &m_fence));
+            m_submitted = false;
+            // Nothing is recorded while a submission is in flight, so the recorded level is what just finished
+            for (uint32_t index : m_completing) {
+                m_streams[index].residentLevel = m_streams[index].recordedLevel;
+                changed.push_back(index);
+            }
+            m_completing.clear();
+        }
+
+        collectProvided();
+        record();
+        return changed;
+    }
+
+    void VulkanTextureStreamer::record() {
+        m_lastUploadBytes = 0;
+        if (m_pendingBytes == 0) {
+            return;
+        }
+        // A budget below the widest row still has to make progress
+        VkDeviceSize stagingSize = uploadBudget;
+        for (const Stream& stream : m_streams) {
+            if (stream.data && stream.pendingLevels > 0) {
+                stagingSize = std::max(stagingSize, getRowSize(stream, stream.pendingLevels - 1));
+            }
+        }
+        prepare(stagingSize);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(m_commandBuffer, &beginInfo));
+
+        uint8_t* staging = static_cast<uint8_t*>(m_stagingBuffer.getMappedMemory());
+        VkDeviceSize offset = 0;
+        while (true) {
+            // Smallest pending level of all streams, coarse versions of everything come first
+            uint32_t next = std::numeric_limits<uint32_t>::max();
+            VkDeviceSize nextSize = std::numeric_limits<VkDeviceSize>::max();
+            for (uint32_t i = 0; i < m_streams.size(); i++) {
+                const Stream& stream = m_streams[i];
+                if (stream.data && stream.pendingLevels > 0 && getLevelSize(stream, stream.pendingLevels - 1) < nextSize) {
+                    next = i;
+                    nextSize = getLevelSize(stream, stream.pendingLevels - 1);
+                }
+            }
+            if (next == std::numeric_limits<uint32_t>::max()) {
+                break;
+            }
+
+            Stream& stream = m_streams[next];
+            const uint32_t level = stream.pendingLevels - 1;
+            const uint32_t levelWidth = std::max(1u, stream.width >> level);
+            const uint32_t levelHeight = std::max(1u, stream.height >> level);
+            const uint32_t levelRows = getRowCount(stream, level);
+            const VkDeviceSize rowSize = getRowSize(stream, level);
+            // Copies of compressed levels have to start at a multiple of their block size
+            offset = (offset + stream.blockSize - 1) / stream.blockSize * stream.blockSize;
+            uint32_t rows = static_cast<uint32_t>(std::min<VkDeviceSize>(levelRows - stream.uploadedRows, (uploadBudget - std::min(offset, uploadBudget)) / rowSize));
+            if (rows == 0) {
+                if (offset > 0) {
+                    break;
+                }
+                rows = 1;
+            }
+
+            if (stream.uploadedRows == 0) {
+                VkImageMemoryBarrier barrier = levelBarrier(stream.image, level,
+                        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        0, VK_ACCESS_TRANSFER_WRITE_BIT);
+                vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        0, 0, nullptr, 0, nullptr, 1, &barrier);
+            }
+
+            const VkDeviceSize size = rows * rowSize;
+            memcpy(staging + offset, stream.data + stream.levelOffsets[level] + stream.uploadedRows * rowSize, static_cast<size_t>(size));
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.layerCount = 1;
+            // Block rows start at multiples of the block, the last one may end at a partial block
+            const uint32_t y = stream.uploadedRows * stream.blockExtent;
+            region.imageOffset = { 0, static_cast<int32_t>(y), 0 };
+            region.imageExtent = { levelWidth, std::min(rows * stream.blockExtent, levelHeight - y), 1 };
+            vkCmdCopyBufferToImage(m_commandBuffer, m_stagingBuffer.getBuffer(), stream.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+            offset += size;
+            m_pendingBytes -= size;
+            stream.uploadedRows += rows;
+
+            if (stream.uploadedRows == levelRows) {
+                VkImageMemoryBarrier barrier = levelBarrier(stream.image, level,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT);
+                vkCmdPipelineBarrier(m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        0, 0, nullptr, 0, nullptr, 1, &barrier);
+                stream.pendingLevels--;
+                stream.uploadedRows = 0;
+                stream.recordedLevel = level;
+                if (std::find(m_completing.begin(), m_completing.end(), next) == m_completing.end()) {
+                    m_completing.push_back(next);
+                }
+                if (stream.pendingLevels == 0) {
+                    // Everything is in the staging buffer or on the GPU already
+                    std::vector<uint8_t>().swap(stream.storage);
+                    stream.data = nullptr;
+                }
+            }
+            if (offset >= uploadBudget) {
+                break;
+            }
+        }
+
+        VK_CHECK_RESULT(vkEndCommandBuffer(m_commandBuffer));
+        if (offset == 0) {
+            return;
+        }
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_commandBuffer;
+        VK_CHECK_RESULT(vkQueueSubmit(m_queue, 1, &submitInfo, m_fence));
+        m_submitted = true;
+        m_lastUploadBytes = offset;
+    }
+
+    uint32_t VulkanTextureStreamer::getResidentLevel(uint32_t index) {
+        return m_streams[index].residentLevel;
+    }
+
+    bool VulkanTextureStreamer::isComplete() {
+        if (m_submitted) {
+            return false;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_provided.empty()) {
+            return false;
+        }
+        for (const Stream& stream : m_streams) {
+            if (stream.residentLevel > 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    VkDeviceSize VulkanTextureStreamer::getPendingBytes() {
+        return m_pendingBytes;
+    }
+
+    VkDeviceSize VulkanTextureStreamer::getLastUploadBytes() {
+        return m_lastUploadBytes;
+    }
+}
@@ -237,5 +237,42 @@ namespace VulkanLearning {
             exitFatal(message, (int32_t)resultCode);
         }
 
+
+        bool getFormatBlock(VkFormat format, uint32_t& blockExtent, uint32_t& blockSize)
+        {
+            switch (format) {
+                case VK_FORMAT_R8G8B8A8_UNORM:
+                case VK_FORMAT_R8G8B8A8_SRGB:
+                case VK_FORMAT_B8G8R8A8_UNORM:
+                case VK_FORMAT_B8G8R8A8_SRGB:
+                    blockExtent = 1;
+                    blockSize = 4;
+                    return true;
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+                    blockExtent = 4;
+                    blockSize = 8;
+                    return true;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+                case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+                case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+                case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                case VK_FORMAT_BC7_SRGB_BLOCK:
+                    blockExtent = 4;
+                    blockSize = 16;
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
     }
 }
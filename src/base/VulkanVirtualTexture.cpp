@@ -0,0 +1,786 @@
+#include "VulkanVirtualTexture.hpp"
+#include "VulkanTools.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace VulkanLearning {
+
+    static bool isPowerOfTwo(uint32_t value) {
+        return value > 0 && (value & (value - 1)) == 0;
+    }
+
+    static uint32_t log2Floor(uint32_t value) {
+        uint32_t log = 0;
+        while (value >>= 1) {
+            log++;
+        }
+        return log;
+    }
+
+    // Every other bit of a Z-order index, squares of 4^n cells starting at multiples of 4^n stay square
+    static uint32_t compactBits(uint32_t value) {
+        value &= 0x55555555;
+        value = (value | (value >> 1)) & 0x33333333;
+        value = (value | (value >> 2)) & 0x0f0f0f0f;
+        value = (value | (value >> 4)) & 0x00ff00ff;
+        value = (value | (value >> 8)) & 0x0000ffff;
+        return value;
+    }
+
+    VulkanVirtualTexture::VulkanVirtualTexture(VulkanDevice* device, VkQueue queue)
+        : m_device(device), m_queue(queue) {}
+
+    VulkanVirtualTexture::~VulkanVirtualTexture() {
+        cleanup();
+    }
+
+    void VulkanVirtualTexture::cleanup() {
+        if (m_commandPool == VK_NULL_HANDLE) {
+            return;
+        }
+        // Joins the worker before anything it writes to goes away
+        m_feedbackWorker.reset();
+
+        VkDevice device = m_device->getLogicalDevice();
+        // Uploads aren't waited for when they are submitted
+        for (Upload& upload : m_uploads) {
+            VK_CHECK_RESULT(vkWaitForFences(device, 1, &upload.fence, VK_TRUE, UINT64_MAX));
+        }
+        destroyFeedbackTarget();
+        vkDestroyRenderPass(device, m_feedbackRenderPass, nullptr);
+        vkDestroyImageView(device, m_atlasView, nullptr);
+        vkDestroyImage(device, m_atlasImage, nullptr);
+        vkFreeMemory(device, m_atlasMemory, nullptr);
+        vkDestroyImageView(device, m_indirectionView, nullptr);
+        vkDestroyImage(device, m_indirectionImage, nullptr);
+        vkFreeMemory(device, m_indirectionMemory, nullptr);
+        m_uniformBuffer.unmap();
+        m_uniformBuffer.cleanup();
+        for (Upload& upload : m_uploads) {
+            upload.stagingBuffer.unmap();
+            upload.stagingBuffer.cleanup();
+            vkDestroyFence(device, upload.fence, nullptr);
+        }
+        m_uploads.clear();
+        vkDestroyCommandPool(device, m_commandPool, nullptr);
+        m_feedbackRenderPass = VK_NULL_HANDLE;
+        m_commandPool = VK_NULL_HANDLE;
+    }
+
+    uint32_t VulkanVirtualTexture::getPhysicalPageSize() {
+        return pageSize + 2 * pageBorder;
+    }
+
+    uint32_t VulkanVirtualTexture::pageKey(uint32_t level, uint32_t x, uint32_t y) {
+        return (level << 28) | (y << 14) | x;
+    }
+
+    int32_t VulkanVirtualTexture::getPageOwner(uint32_t key) {
+        const uint32_t level = key >> 28;
+        const uint32_t x = key & 0x3fff;
+        const uint32_t y = (key >> 14) & 0x3fff;
+        if (level >= m_levelCount || x >= (virtualPageCount >> level) || y >= (virtualPageCount >> level)) {
+            return -1;
+        }
+        const int32_t owner = m_pageOwners[static_cast<size_t>(y << level) * virtualPageCount + (x << level)];
+        // Pages above the texture's own levels are shared with its neighbours
+        if (owner < 0 || level > m_textures[owner].maxLevel) {
+            return -1;
+        }
+        return owner;
+    }
+
+    uint32_t VulkanVirtualTexture::addTexture(const uint8_t* levels, uint32_t width, uint32_t height, uint32_t mipLevels) {
+        if (m_commandPool != VK_NULL_HANDLE) {
+            throw std::runtime_error("Textures must be added to the virtual texture before it is created!");
+        }
+        Texture texture{};
+        texture.levels = levels;
+        texture.width = width;
+        texture.height = height;
+        texture.mipLevels = mipLevels;
+        size_t offset = 0;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            texture.levelOffsets.push_back(offset);
+            offset += static_cast<size_t>(std::max(1u, width >> level)) * std::max(1u, height >> level) * 4;
+        }
+        // Smallest square of pages covering the texture, a power of two so it can be aligned to its size
+        const uint32_t pages = (std::max(width, height) + pageSize - 1) / pageSize;
+        texture.pageCount = 1;
+        while (texture.pageCount < pages) {
+            texture.pageCount <<= 1;
+        }
+        texture.maxLevel = log2Floor(texture.pageCount);
+        m_textures.push_back(texture);
+        return static_cast<uint32_t>(m_textures.size() - 1);
+    }
+
+    VulkanVirtualTexture::TextureInfo VulkanVirtualTexture::getTextureInfo(uint32_t index) {
+        const Texture& texture = m_textures[index];
+        const float virtualTexels = static_cast<float>(virtualPageCount * pageSize);
+        TextureInfo info{};
+        info.transform = glm::vec4(
+                static_cast<float>(texture.pageX * pageSize) / virtualTexels,
+                static_cast<float>(texture.pageY * pageSize) / virtualTexels,
+                static_cast<float>(texture.width) / virtualTexels,
+                static_cast<float>(texture.height) / virtualTexels);
+        info.maxLevel = texture.maxLevel;
+        return info;
+    }
+
+    void VulkanVirtualTexture::createImage(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, VkImageUsageFlags usage,
+            VkImageAspectFlags aspect, VkImage& image, VkDeviceMemory& memory, VkImageView& view) {
+        VkDevice device = m_device->getLogicalDevice();
+
+        VkImageCreateInfo imageCreateInfo{};
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = format;
+        imageCreateInfo.mipLevels = mipLevels;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageCreateInfo.extent = { width, height, 1 };
+        imageCreateInfo.usage = usage;
+        VK_CHECK_RESULT(vkCreateImage(device, &imageCreateInfo, nullptr, &image));
+
+        VkMemoryRequirements memReqs{};
+        vkGetImageMemoryRequirements(device, image, &memReqs);
+        VkMemoryAllocateInfo memAllocInfo{};
+        memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAllocInfo.allocationSize = memReqs.size;
+        memAllocInfo.memoryTypeIndex = m_device->findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_CHECK_RESULT(vkAllocateMemory(device, &memAllocInfo, nullptr, &memory));
+        VK_CHECK_RESULT(vkBindImageMemory(device, image, memory, 0));
+
+        VkImageViewCreateInfo viewInfo{};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = aspect;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        viewInfo.subresourceRange.layerCount = 1;
+        VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, nullptr, &view));
+    }
+
+    void VulkanVirtualTexture::create(uint32_t width, uint32_t height) {
+        if (!isPowerOfTwo(virtualPageCount) || virtualPageCount > 16384) {
+            throw std::runtime_error("The virtual texture needs a power of two page count up to 16384!");
+        }
+        if (atlasPageCount == 0 || atlasPageCount > 256 || atlasPageCount * atlasPageCount <= m_textures.size()) {
+            throw std::runtime_error("The virtual texture atlas needs more pages than textures and at most 256 per side!");
+        }
+        VkDevice device = m_device->getLogicalDevice();
+        m_levelCount = log2Floor(virtualPageCount) + 1;
+
+        // Largest textures first along a Z-order curve, every square then starts at a multiple of its size
+        std::vector<uint32_t> order(m_textures.size());
+        for (uint32_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+                return m_textures[a].pageCount > m_textures[b].pageCount;
+                });
+        m_pageOwners.assign(static_cast<size_t>(virtualPageCount) * virtualPageCount, -1);
+        uint64_t cursor = 0;
+        for (uint32_t index : order) {
+            Texture& texture = m_textures[index];
+            const uint64_t cells = static_cast<uint64_t>(texture.pageCount) * texture.pageCount;
+            if (cursor + cells > m_pageOwners.size()) {
+                throw std::runtime_error("The textures don't fit into the virtual texture!");
+            }
+            texture.pageX = compactBits(static_cast<uint32_t>(cursor));
+            texture.pageY = compactBits(static_cast<uint32_t>(cursor >> 1));
+            for (uint32_t y = 0; y < texture.pageCount; y++) {
+                for (uint32_t x = 0; x < texture.pageCount; x++) {
+                    m_pageOwners[static_cast<size_t>(texture.pageY + y) * virtualPageCount + texture.pageX + x] = static_cast<int32_t>(index);
+                }
+            }
+            cursor += cells;
+        }
+
+        const uint32_t atlasSize = atlasPageCount * getPhysicalPageSize();
+        createImage(VK_FORMAT_R8G8B8A8_UNORM, atlasSize, atlasSize, 1, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, m_atlasImage, m_atlasMemory, m_atlasView);
+        createImage(VK_FORMAT_R8G8B8A8_UINT, virtualPageCount, virtualPageCount, m_levelCount, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT, m_indirectionImage, m_indirectionMemory, m_indirectionView);
+
+        // Pages carry their own border, the atlas is never filtered across pages or levels
+        VkSamplerCreateInfo samplerInfo{};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+        samplerInfo.maxAnisotropy = 1.0f;
+        m_atlasSampler = m_device->getSampler(samplerInfo);
+        // Integer texels of the indirection texture are fetched, never filtered
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+        m_indirectionSampler = m_device->getSampler(samplerInfo);
+
+        ShaderData shaderData{};
+        shaderData.virtualSize = glm::vec4(static_cast<float>(virtualPageCount * pageSize), static_cast<float>(pageSize),
+                static_cast<float>(pageBorder), static_cast<float>(getPhysicalPageSize()));
+        shaderData.atlasSize = glm::vec4(static_cast<float>(atlasSize), static_cast<float>(m_levelCount),
+                static_cast<float>(log2Floor(std::max(1u, feedbackDivisor))), 0.0f);
+        m_uniformBuffer = VulkanBuffer(*m_device);
+        m_uniformBuffer.createBuffer(sizeof(ShaderData),
+                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VK_CHECK_RESULT(m_uniformBuffer.map());
+        memcpy(m_uniformBuffer.getMappedMemory(), &shaderData, sizeof(shaderData));
+
+        m_slots.assign(static_cast<size_t>(atlasPageCount) * atlasPageCount, Slot());
+        m_freeSlots.clear();
+        for (uint32_t i = static_cast<uint32_t>(m_slots.size()); i > 0; i--) {
+            m_freeSlots.push_back(i - 1);
+        }
+        m_residentPages.clear();
+        m_pageTableOffsets.clear();
+        size_t pageTableSize = 0;
+        for (uint32_t level = 0; level < m_levelCount; level++) {
+            m_pageTableOffsets.push_back(pageTableSize);
+            pageTableSize += static_cast<size_t>(virtualPageCount >> level) * (virtualPageCount >> level);
+        }
+        m_pageTable.assign(pageTableSize, 0);
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        poolInfo.queueFamilyIndex = m_device->getQueueFamilyIndices().graphicsFamily.value();
+        VK_CHECK_RESULT(vkCreateCommandPool(device, &poolInfo, nullptr, &m_commandPool));
+
+        // Fences start signaled, so the first uploads find their submission free.
+        // Each has room for the initial pages or one update's worth, followed by the whole page table
+        const VkDeviceSize pageBytes = static_cast<VkDeviceSize>(getPhysicalPageSize()) * getPhysicalPageSize() * 4;
+        const uint32_t stagingPages = std::max(pageUploadBudget, static_cast<uint32_t>(m_textures.size()));
+        m_uploads.resize(kUploadCount);
+        m_nextUpload = 0;
+        for (Upload& upload : m_uploads) {
+            VkCommandBufferAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = m_commandPool;
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = 1;
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &upload.commandBuffer));
+
+            VkFenceCreateInfo fenceInfo{};
+            fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+            VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &upload.fence));
+
+            upload.stagingBuffer = VulkanBuffer(*m_device);
+            upload.stagingBuffer.createBuffer(
+                    stagingPages * pageBytes + pageTableSize * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_CHECK_RESULT(upload.stagingBuffer.map());
+        }
+
+        // The copy to host memory waits for the render pass to be done with the color attachment
+        VkAttachmentDescription attachments[2] = {};
+        attachments[0].format = VK_FORMAT_R32_UINT;
+        attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+        attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        attachments[1].format = m_device->findDepthFormat();
+        attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+        attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+        attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        attachments[1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+        VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+        VkAttachmentReference depthReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+        VkSubpassDescription subpass{};
+        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+        subpass.colorAttachmentCount = 1;
+        subpass.pColorAttachments = &colorReference;
+        subpass.pDepthStencilAttachment = &depthReference;
+
+        VkSubpassDependency dependency{};
+        dependency.srcSubpass = 0;
+        dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        VkRenderPassCreateInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = 2;
+        renderPassInfo.pAttachments = attachments;
+        renderPassInfo.subpassCount = 1;
+        renderPassInfo.pSubpasses = &subpass;
+        renderPassInfo.dependencyCount = 1;
+        renderPassInfo.pDependencies = &dependency;
+        VK_CHECK_RESULT(vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_feedbackRenderPass));
+
+        createFeedbackTarget(width, height);
+        m_feedbackWorker = std::make_unique<ThreadPool>(1);
+
+        // The coarsest page of every texture is what everything falls back to
+        std::vector<std::pair<uint32_t, uint32_t>> pages;
+        for (const Texture& texture : m_textures) {
+            const uint32_t key = pageKey(texture.maxLevel, texture.pageX >> texture.maxLevel, texture.pageY >> texture.maxLevel);
+            uint32_t slot;
+            allocateSlot(slot);
+            m_slots[slot].page = key;
+            m_slots[slot].locked = true;
+            m_residentPages[key] = slot;
+            pages.push_back({ key, slot });
+        }
+        upload(pages);
+    }
+
+    void VulkanVirtualTexture::createFeedbackTarget(uint32_t width, uint32_t height) {
+        VkDevice device = m_device->getLogicalDevice();
+        m_feedbackExtent.width = std::max(1u, width / std::max(1u, feedbackDivisor));
+        m_feedbackExtent.height = std::max(1u, height / std::max(1u, feedbackDivisor));
+
+        const uint32_t frameCount = feedbackFrameCount > 0 ? feedbackFrameCount : std::max(1u, m_device->getSwapChainImageCount());
+        m_feedbackFrames.resize(frameCount);
+        for (FeedbackFrame& frame : m_feedbackFrames) {
+            createImage(VK_FORMAT_R32_UINT, m_feedbackExtent.width, m_feedbackExtent.height, 1,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_IMAGE_ASPECT_COLOR_BIT, frame.image, frame.memory, frame.view);
+            createImage(m_device->findDepthFormat(), m_feedbackExtent.width, m_feedbackExtent.height, 1,
+                    VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+                    VK_IMAGE_ASPECT_DEPTH_BIT, frame.depthImage, frame.depthMemory, frame.depthView);
+
+            std::array<VkImageView, 2> attachments = { frame.view, frame.depthView };
+            VkFramebufferCreateInfo framebufferInfo{};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = m_feedbackRenderPass;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+            framebufferInfo.pAttachments = attachments.data();
+            framebufferInfo.width = m_feedbackExtent.width;
+            framebufferInfo.height = m_feedbackExtent.height;
+            framebufferInfo.layers = 1;
+            VK_CHECK_RESULT(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &frame.framebuffer));
+
+            frame.readbackBuffer = VulkanBuffer(*m_device);
+            frame.readbackBuffer.createBuffer(
+                    static_cast<VkDeviceSize>(m_feedbackExtent.width) * m_feedbackExtent.height * sizeof(uint32_t),
+                    VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_CHECK_RESULT(frame.readbackBuffer.map());
+            // Nothing is requested until the frame's first feedback pass has run
+            memset(frame.readbackBuffer.getMappedMemory(), 0xff, static_cast<size_t>(frame.readbackBuffer.getSize()));
+        }
+    }
+
+    void VulkanVirtualTexture::destroyFeedbackTarget() {
+        VkDevice device = m_device->getLogicalDevice();
+        for (FeedbackFrame& frame : m_feedbackFrames) {
+            vkDestroyFramebuffer(device, frame.framebuffer, nullptr);
+            vkDestroyImageView(device, frame.view, nullptr);
+            vkDestroyImage(device, frame.image, nullptr);
+            vkFreeMemory(device, frame.memory, nullptr);
+            vkDestroyImageView(device, frame.depthView, nullptr);
+            vkDestroyImage(device, frame.depthImage, nullptr);
+            vkFreeMemory(device, frame.depthMemory, nullptr);
+            frame.readbackBuffer.unmap();
+            frame.readbackBuffer.cleanup();
+        }
+        m_feedbackFrames.clear();
+    }
+
+    void VulkanVirtualTexture::resize(uint32_t width, uint32_t height) {
+        if (m_feedbackRenderPass == VK_NULL_HANDLE) {
+            return;
+        }
+        destroyFeedbackTarget();
+        createFeedbackTarget(width, height);
+    }
+
+    VkRenderPass VulkanVirtualTexture::getFeedbackRenderPass() {
+        return m_feedbackRenderPass;
+    }
+
+    VkExtent2D VulkanVirtualTexture::getFeedbackExtent() {
+        return m_feedbackExtent;
+    }
+
+    void VulkanVirtualTexture::beginFeedbackPass(VkCommandBuffer commandBuffer, uint32_t frame) {
+        std::array<VkClearValue, 2> clearValues{};
+        clearValues[0].color.uint32[0] = kInvalidPage;
+        clearValues[1].depthStencil = { 1.0f, 0 };
+
+        VkRenderPassBeginInfo renderPassInfo{};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = m_feedbackRenderPass;
+        renderPassInfo.framebuffer = m_feedbackFrames[frame].framebuffer;
+        renderPassInfo.renderArea.extent = m_feedbackExtent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+        renderPassInfo.pClearValues = clearValues.data();
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+        VkViewport viewport{};
+        viewport.width = static_cast<float>(m_feedbackExtent.width);
+        viewport.height = static_cast<float>(m_feedbackExtent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor{};
+        scissor.extent = m_feedbackExtent;
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+    }
+
+    void VulkanVirtualTexture::endFeedbackPass(VkCommandBuffer commandBuffer, uint32_t frame) {
+        vkCmdEndRenderPass(commandBuffer);
+
+        const FeedbackFrame& feedback = m_feedbackFrames[frame];
+        VkBufferImageCopy region{};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { m_feedbackExtent.width, m_feedbackExtent.height, 1 };
+        vkCmdCopyImageToBuffer(commandBuffer, feedback.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, feedback.readbackBuffer.getBuffer(), 1, &region);
+
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = feedback.readbackBuffer.getBuffer();
+        barrier.size = VK_WHOLE_SIZE;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    VkDescriptorImageInfo VulkanVirtualTexture::getAtlasDescriptor() {
+        return { m_atlasSampler, m_atlasView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    }
+
+    VkDescriptorImageInfo VulkanVirtualTexture::getIndirectionDescriptor() {
+        return { m_indirectionSampler, m_indirectionView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    }
+
+    VkDescriptorBufferInfo VulkanVirtualTexture::getUniformDescriptor() {
+        return { m_uniformBuffer.getBuffer(), 0, sizeof(ShaderData) };
+    }
+
+    void VulkanVirtualTexture::decodeFeedback(std::vector<uint32_t> feedback) {
+        // Neighbouring pixels mostly ask for the same page, sorting is cheaper than hashing all of them
+        std::sort(feedback.begin(), feedback.end());
+        feedback.erase(std::unique(feedback.begin(), feedback.end()), feedback.end());
+        if (!feedback.empty() && feedback.back() == kInvalidPage) {
+            feedback.pop_back();
+        }
+
+        std::lock_guard<std::mutex> lock(m_requestMutex);
+        m_requests = std::move(feedback);
+        m_requestsReady = true;
+        m_decoding = false;
+    }
+
+    void VulkanVirtualTexture::buildPage(uint32_t key, uint8_t* dst) {
+        const uint32_t level = key >> 28;
+        const uint32_t x = key & 0x3fff;
+        const uint32_t y = (key >> 14) & 0x3fff;
+        const Texture& texture = m_textures[getPageOwner(key)];
+
+        // Textures without enough levels are point sampled from their last one
+        const uint32_t mip = std::min(level, texture.mipLevels - 1);
+        const uint32_t step = 1u << (level - mip);
+        const int32_t levelWidth = static_cast<int32_t>(std::max(1u, texture.width >> mip));
+        const int32_t levelHeight = static_cast<int32_t>(std::max(1u, texture.height >> mip));
+        const uint8_t* levelData = texture.levels + texture.levelOffsets[mip];
+
+        const int32_t originX = static_cast<int32_t>((x - (texture.pageX >> level)) * pageSize) - static_cast<int32_t>(pageBorder);
+        const int32_t originY = static_cast<int32_t>((y - (texture.pageY >> level)) * pageSize) - static_cast<int32_t>(pageBorder);
+        const uint32_t physicalPageSize = getPhysicalPageSize();
+        for (uint32_t row = 0; row < physicalPageSize; row++) {
+            const int32_t sy = std::min(std::max((originY + static_cast<int32_t>(row)) * static_cast<int32_t>(step), 0), levelHeight - 1);
+            const uint8_t* srcRow = levelData + static_cast<size_t>(sy) * levelWidth * 4;
+            uint8_t* dstRow = dst + static_cast<size_t>(row) * physicalPageSize * 4;
+            for (uint32_t column = 0; column < physicalPageSize; column++) {
+                const int32_t sx = std::min(std::max((originX + static_cast<int32_t>(column)) * static_cast<int32_t>(step), 0), levelWidth - 1);
+                memcpy(dstRow + column * 4, srcRow + static_cast<size_t>(sx) * 4, 4);
+            }
+        }
+    }
+
+    bool VulkanVirtualTexture::allocateSlot(uint32_t& slot) {
+        if (!m_freeSlots.empty()) {
+            slot = m_freeSlots.back();
+            m_freeSlots.pop_back();
+            return true;
+        }
+        // Least recently requested page that wasn't requested by the feedback being applied
+        uint32_t oldest = kInvalidPage;
+        for (uint32_t i = 0; i < m_slots.size(); i++) {
+            if (m_slots[i].locked || m_slots[i].lastUsedFrame >= m_frame) {
+                continue;
+            }
+            if (oldest == kInvalidPage || m_slots[i].lastUsedFrame < m_slots[oldest].lastUsedFrame) {
+                oldest = i;
+            }
+        }
+        if (oldest == kInvalidPage) {
+            return false;
+        }
+        m_residentPages.erase(m_slots[oldest].page);
+        m_slots[oldest].page = kInvalidPage;
+        m_evictedPages++;
+        slot = oldest;
+        return true;
+    }
+
+    void VulkanVirtualTexture::rebuildPageTable() {
+        // Resident pages grouped by level, everything else takes its parent's entry from the level above
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> residentByLevel(m_levelCount);
+        for (const auto& resident : m_residentPages) {
+            residentByLevel[resident.first >> 28].push_back(resident);
+        }
+        for (uint32_t level = m_levelCount; level > 0; level--) {
+            const uint32_t current = level - 1;
+            const uint32_t side = virtualPageCount >> current;
+            uint32_t* entries = m_pageTable.data() + m_pageTableOffsets[current];
+            if (current + 1 < m_levelCount) {
+                const uint32_t* parents = m_pageTable.data() + m_pageTableOffsets[current + 1];
+                const uint32_t parentSide = side >> 1;
+                for (uint32_t y = 0; y < side; y++) {
+                    for (uint32_t x = 0; x < side; x++) {
+                        entries[y * side + x] = parents[(y >> 1) * parentSide + (x >> 1)];
+                    }
+                }
+            } else {
+                std::fill(entries, entries + static_cast<size_t>(side) * side, 0u);
+            }
+            for (const auto& resident : residentByLevel[current]) {
+                const uint32_t x = resident.first & 0x3fff;
+                const uint32_t y = (resident.first >> 14) & 0x3fff;
+                const uint32_t slotX = resident.second % atlasPageCount;
+                const uint32_t slotY = resident.second / atlasPageCount;
+                entries[y * side + x] = slotX | (slotY << 8) | (current << 16) | (1u << 24);
+            }
+        }
+    }
+
+    void VulkanVirtualTexture::upload(const std::vector<std::pair<uint32_t, uint32_t>>& pages) {
+        VkDevice device = m_device->getLogicalDevice();
+        // Its previous submission is done, update only gets here once the fence signaled
+        Upload& upload = m_uploads[m_nextUpload];
+        m_nextUpload = (m_nextUpload + 1) % static_cast<uint32_t>(m_uploads.size());
+        VK_CHECK_RESULT(vkResetFences(device, 1, &upload.fence));
+        const uint32_t physicalPageSize = getPhysicalPageSize();
+        const VkDeviceSize pageBytes = static_cast<VkDeviceSize>(physicalPageSize) * physicalPageSize * 4;
+        uint8_t* staging = static_cast<uint8_t*>(upload.stagingBuffer.getMappedMemory());
+
+        std::vector<VkBufferImageCopy> atlasRegions;
+        VkDeviceSize offset = 0;
+        for (const auto& page : pages) {
+            buildPage(page.first, staging + offset);
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = {
+                static_cast<int32_t>((page.second % atlasPageCount) * physicalPageSize),
+                static_cast<int32_t>((page.second / atlasPageCount) * physicalPageSize),
+                0 };
+            region.imageExtent = { physicalPageSize, physicalPageSize, 1 };
+            atlasRegions.push_back(region);
+            offset += pageBytes;
+        }
+
+        // The whole table is small next to the pages, it's rewritten rather than patched
+        rebuildPageTable();
+        memcpy(staging + offset, m_pageTable.data(), m_pageTable.size() * sizeof(uint32_t));
+        std::vector<VkBufferImageCopy> tableRegions;
+        for (uint32_t level = 0; level < m_levelCount; level++) {
+            VkBufferImageCopy region{};
+            region.bufferOffset = offset + m_pageTableOffsets[level] * sizeof(uint32_t);
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = { virtualPageCount >> level, virtualPageCount >> level, 1 };
+            tableRegions.push_back(region);
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        VK_CHECK_RESULT(vkBeginCommandBuffer(upload.commandBuffer, &beginInfo));
+
+        // The atlas keeps its other pages, the first upload has nothing to keep
+        std::array<VkImageMemoryBarrier, 2> barriers{};
+        for (VkImageMemoryBarrier& barrier : barriers) {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.layerCount = 1;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        }
+        barriers[0].image = m_atlasImage;
+        barriers[0].subresourceRange.levelCount = 1;
+        barriers[0].oldLayout = m_uploadedPages == 0 ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[1].image = m_indirectionImage;
+        barriers[1].subresourceRange.levelCount = m_levelCount;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+        if (!atlasRegions.empty()) {
+            vkCmdCopyBufferToImage(upload.commandBuffer, upload.stagingBuffer.getBuffer(), m_atlasImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    static_cast<uint32_t>(atlasRegions.size()), atlasRegions.data());
+        }
+        vkCmdCopyBufferToImage(upload.commandBuffer, upload.stagingBuffer.getBuffer(), m_indirectionImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                static_cast<uint32_t>(tableRegions.size()), tableRegions.data());
+
+        for (VkImageMemoryBarrier& barrier : barriers) {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        }
+        vkCmdPipelineBarrier(upload.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+        VK_CHECK_RESULT(vkEndCommandBuffer(upload.commandBuffer));
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &upload.commandBuffer;
+        // The barriers order it after the frames already submitted to the queue and before the next ones
+        VK_CHECK_RESULT(vkQueueSubmit(m_queue, 1, &submitInfo, upload.fence));
+
+        m_lastUploadCount = static_cast<uint32_t>(pages.size());
+        m_uploadedPages += pages.size();
+    }
+
+    bool VulkanVirtualTexture::update(uint32_t frame) {
+        if (m_commandPool == VK_NULL_HANDLE || frame >= m_feedbackFrames.size()) {
+            return false;
+        }
+
+        // Requests wait for the next update while the upload that would take them is still running
+        const bool canUpload = vkGetFenceStatus(m_device->getLogicalDevice(), m_uploads[m_nextUpload].fence) == VK_SUCCESS;
+        std::vector<uint32_t> requests;
+        bool ready = false;
+        bool decoding;
+        {
+            std::lock_guard<std::mutex> lock(m_requestMutex);
+            if (m_requestsReady && canUpload) {
+                requests.swap(m_requests);
+                m_requestsReady = false;
+                ready = true;
+            }
+            decoding = m_decoding;
+            m_decoding = true;
+        }
+        // The frame is done, so its readback holds its feedback. A copy of it is decoded while the
+        // next frames render, unless the worker is still busy with the previous one
+        if (!decoding) {
+            const uint32_t* readback = static_cast<const uint32_t*>(m_feedbackFrames[frame].readbackBuffer.getMappedMemory());
+            std::vector<uint32_t> feedback(readback, readback + static_cast<size_t>(m_feedbackExtent.width) * m_feedbackExtent.height);
+            m_feedbackWorker->push([this, feedback]() mutable {
+                decodeFeedback(std::move(feedback));
+            });
+        }
+        if (!ready) {
+            m_lastUploadCount = 0;
+            return false;
+        }
+        m_frame++;
+        m_requestedPageCount = static_cast<uint32_t>(requests.size());
+
+        // Requested pages and the parents they fall back to are marked used, missing ones are collected
+        std::vector<uint32_t> missing;
+        for (uint32_t key : requests) {
+            const int32_t owner = getPageOwner(key);
+            if (owner < 0) {
+                continue;
+            }
+            const uint32_t maxLevel = m_textures[owner].maxLevel;
+            uint32_t level = key >> 28;
+            uint32_t x = key & 0x3fff;
+            uint32_t y = (key >> 14) & 0x3fff;
+            while (true) {
+                const uint32_t page = pageKey(level, x, y);
+                auto resident = m_residentPages.find(page);
+                if (resident != m_residentPages.end()) {
+                    m_slots[resident->second].lastUsedFrame = m_frame;
+                } else {
+                    missing.push_back(page);
+                }
+                if (level == maxLevel) {
+                    break;
+                }
+                level++;
+                x >>= 1;
+                y >>= 1;
+            }
+        }
+        // The level is in the top bits, so descending keys load coarse pages before the ones relying on them
+        std::sort(missing.begin(), missing.end(), std::greater<uint32_t>());
+        missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+
+        std::vector<std::pair<uint32_t, uint32_t>> pages;
+        for (uint32_t page : missing) {
+            if (pages.size() >= pageUploadBudget) {
+                break;
+            }
+            uint32_t slot;
+            if (!allocateSlot(slot)) {
+                break;
+            }
+            m_slots[slot].page = page;
+            m_slots[slot].lastUsedFrame = m_frame;
+            m_residentPages[page] = slot;
+            pages.push_back({ page, slot });
+        }
+        if (pages.empty()) {
+            m_lastUploadCount = 0;
+            return false;
+        }
+        upload(pages);
+        return true;
+    }
+
+    uint32_t VulkanVirtualTexture::getResidentPageCount() {
+        return static_cast<uint32_t>(m_residentPages.size());
+    }
+
+    uint32_t VulkanVirtualTexture::getPhysicalPageCount() {
+        return static_cast<uint32_t>(m_slots.size());
+    }
+
+    uint32_t VulkanVirtualTexture::getRequestedPageCount() {
+        return m_requestedPageCount;
+    }
+
+    uint32_t VulkanVirtualTexture::getLastUploadCount() {
+        return m_lastUploadCount;
+    }
+
+    uint64_t VulkanVirtualTexture::getUploadedPageCount() {
+        return m_uploadedPages;
+    }
+
+    uint64_t VulkanVirtualTexture::getEvictedPageCount() {
+        return m_evictedPages;
+    }
+}
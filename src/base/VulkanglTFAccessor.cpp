@@ -0,0 +1,360 @@
+#include "VulkanglTFAccessor.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include "tiny_gltf.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define GLTF_ACCESSOR_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define GLTF_ACCESSOR_NEON
+#include <arm_neon.h>
+#endif
+
+namespace VulkanLearning {
+
+    /* Element conversion */
+
+    template<typename T>
+    static inline float normalizeComponent(T value);
+
+    // Signed values are clamped so both -128 and -127 map to -1 as the spec requires
+    template<> inline float normalizeComponent<int8_t>(int8_t value) { return std::max(value / 127.0f, -1.0f); }
+    template<> inline float normalizeComponent<uint8_t>(uint8_t value) { return value / 255.0f; }
+    template<> inline float normalizeComponent<int16_t>(int16_t value) { return std::max(value / 32767.0f, -1.0f); }
+    template<> inline float normalizeComponent<uint16_t>(uint16_t value) { return value / 65535.0f; }
+    template<> inline float normalizeComponent<uint32_t>(uint32_t value) { return static_cast<float>(value / 4294967295.0); }
+
+    template<typename T>
+    static void convertElements(const uint8_t* src, size_t srcStride, bool normalized, uint32_t components, size_t count, uint8_t* dst, size_t dstStride) {
+        for (size_t i = 0; i < count; i++) {
+            T values[4];
+            memcpy(values, src, components * sizeof(T));
+            float* out = reinterpret_cast<float*>(dst);
+            for (uint32_t c = 0; c < components; c++) {
+                out[c] = normalized ? normalizeComponent<T>(values[c]) : static_cast<float>(values[c]);
+            }
+            src += srcStride;
+            dst += dstStride;
+        }
+    }
+
+    // Fixed size copies compile to plain vector moves, so interleaved floats are split without a per component loop
+    template<uint32_t N>
+    static void copyFloats(const uint8_t* src, size_t srcStride, size_t count, uint8_t* dst, size_t dstStride) {
+        for (size_t i = 0; i < count; i++) {
+            memcpy(dst, src, N * sizeof(float));
+            src += srcStride;
+            dst += dstStride;
+        }
+    }
+
+    static bool convertAccessorElements(const uint8_t* src, size_t srcStride, int componentType, bool normalized, uint32_t components, size_t count, uint8_t* dst, size_t dstStride) {
+        switch (componentType) {
+            case TINYGLTF_COMPONENT_TYPE_FLOAT:
+                if (srcStride == dstStride && srcStride == components * sizeof(float)) {
+                    memcpy(dst, src, count * srcStride);
+                    return true;
+                }
+                switch (components) {
+                    case 1: copyFloats<1>(src, srcStride, count, dst, dstStride); break;
+                    case 2: copyFloats<2>(src, srcStride, count, dst, dstStride); break;
+                    case 3: copyFloats<3>(src, srcStride, count, dst, dstStride); break;
+                    default: copyFloats<4>(src, srcStride, count, dst, dstStride); break;
+                }
+                return true;
+            case TINYGLTF_COMPONENT_TYPE_BYTE:
+                convertElements<int8_t>(src, srcStride, normalized, components, count, dst, dstStride);
+                return true;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                convertElements<uint8_t>(src, srcStride, normalized, components, count, dst, dstStride);
+                return true;
+            case TINYGLTF_COMPONENT_TYPE_SHORT:
+                convertElements<int16_t>(src, srcStride, normalized, components, count, dst, dstStride);
+                return true;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+                convertElements<uint16_t>(src, srcStride, normalized, components, count, dst, dstStride);
+                return true;
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+                convertElements<uint32_t>(src, srcStride, normalized, components, count, dst, dstStride);
+                return true;
+            default:
+                std::cerr << "Accessor component type " << componentType << " not supported!" << std::endl;
+                return false;
+        }
+    }
+
+    /* Index widening */
+
+    static void widenIndices8(const uint8_t* src, size_t count, uint32_t* dst, uint32_t offset) {
+        size_t i = 0;
+#if defined(GLTF_ACCESSOR_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i base = _mm_set1_epi32(static_cast<int>(offset));
+        for (; i + 16 <= count; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i lo = _mm_unpacklo_epi8(v, zero);
+            __m128i hi = _mm_unpackhi_epi8(v, zero);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(_mm_unpacklo_epi16(lo, zero), base));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(lo, zero), base));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_add_epi32(_mm_unpacklo_epi16(hi, zero), base));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 12), _mm_add_epi32(_mm_unpackhi_epi16(hi, zero), base));
+        }
+#elif defined(GLTF_ACCESSOR_NEON)
+        const uint32x4_t base = vdupq_n_u32(offset);
+        for (; i + 16 <= count; i += 16) {
+            uint8x16_t v = vld1q_u8(src + i);
+            uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+            uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+            vst1q_u32(dst + i, vaddq_u32(vmovl_u16(vget_low_u16(lo)), base));
+            vst1q_u32(dst + i + 4, vaddq_u32(vmovl_u16(vget_high_u16(lo)), base));
+            vst1q_u32(dst + i + 8, vaddq_u32(vmovl_u16(vget_low_u16(hi)), base));
+            vst1q_u32(dst + i + 12, vaddq_u32(vmovl_u16(vget_high_u16(hi)), base));
+        }
+#endif
+        for (; i < count; i++) {
+            dst[i] = src[i] + offset;
+        }
+    }
+
+    static void widenIndices16(const uint8_t* src, size_t count, uint32_t* dst, uint32_t offset) {
+        size_t i = 0;
+#if defined(GLTF_ACCESSOR_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i base = _mm_set1_epi32(static_cast<int>(offset));
+        for (; i + 8 <= count; i += 8) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(_mm_unpacklo_epi16(v, zero), base));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), _mm_add_epi32(_mm_unpackhi_epi16(v, zero), base));
+        }
+#elif defined(GLTF_ACCESSOR_NEON)
+        const uint32x4_t base = vdupq_n_u32(offset);
+        for (; i + 8 <= count; i += 8) {
+            uint16x8_t v = vreinterpretq_u16_u8(vld1q_u8(src + i * 2));
+            vst1q_u32(dst + i, vaddq_u32(vmovl_u16(vget_low_u16(v)), base));
+            vst1q_u32(dst + i + 4, vaddq_u32(vmovl_u16(vget_high_u16(v)), base));
+        }
+#endif
+        for (; i < count; i++) {
+            uint16_t index;
+            memcpy(&index, src + i * 2, sizeof(uint16_t));
+            dst[i] = index + offset;
+        }
+    }
+
+    static void widenIndices32(const uint8_t* src, size_t count, uint32_t* dst, uint32_t offset) {
+        size_t i = 0;
+#if defined(GLTF_ACCESSOR_SSE2)
+        const __m128i base = _mm_set1_epi32(static_cast<int>(offset));
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi32(v, base));
+        }
+#elif defined(GLTF_ACCESSOR_NEON)
+        const uint32x4_t base = vdupq_n_u32(offset);
+        for (; i + 4 <= count; i += 4) {
+            uint32x4_t v = vreinterpretq_u32_u8(vld1q_u8(src + i * 4));
+            vst1q_u32(dst + i, vaddq_u32(v, base));
+        }
+#endif
+        for (; i < count; i++) {
+            uint32_t index;
+            memcpy(&index, src + i * 4, sizeof(uint32_t));
+            dst[i] = index + offset;
+        }
+    }
+
+    static uint32_t readSparseIndex(const uint8_t* src, int componentType, size_t i) {
+        switch (componentType) {
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+                return src[i];
+            case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+                uint16_t index;
+                memcpy(&index, src + i * 2, sizeof(uint16_t));
+                return index;
+            }
+            default: {
+                uint32_t index;
+                memcpy(&index, src + i * 4, sizeof(uint32_t));
+                return index;
+            }
+        }
+    }
+
+    static const uint8_t* getBufferViewData(const tinygltf::Model& model, int bufferViewIndex, size_t byteOffset) {
+        const tinygltf::BufferView& view = model.bufferViews[bufferViewIndex];
+        return model.buffers[view.buffer].data.data() + view.byteOffset + byteOffset;
+    }
+
+    // Same as getBufferViewData, but null unless byteLength bytes from byteOffset lie in the view and its buffer
+    static const uint8_t* getBufferViewRange(const tinygltf::Model& model, int bufferViewIndex, size_t byteOffset, size_t byteLength) {
+        if (bufferViewIndex < 0 || bufferViewIndex >= static_cast<int>(model.bufferViews.size())) {
+            return nullptr;
+        }
+        const tinygltf::BufferView& view = model.bufferViews[bufferViewIndex];
+        if (view.buffer < 0 || view.buffer >= static_cast<int>(model.buffers.size())) {
+            return nullptr;
+        }
+        const size_t bufferSize = model.buffers[view.buffer].data.size();
+        if (view.byteOffset > bufferSize || view.byteLength > bufferSize - view.byteOffset) {
+            return nullptr;
+        }
+        if (byteOffset > view.byteLength || byteLength > view.byteLength - byteOffset) {
+            return nullptr;
+        }
+        return getBufferViewData(model, bufferViewIndex, byteOffset);
+    }
+
+    // Sparse indices and values come straight from the file, they are checked before anything is written:
+    // both arrays must lie in their buffer views and every index must address an element of the accessor
+    static bool getSparseData(const tinygltf::Model& model, const tinygltf::Accessor& accessor, size_t valueSize, const uint8_t** indices, const uint8_t** values) {
+        const int indexType = accessor.sparse.indices.componentType;
+        if (indexType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE && indexType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT && indexType != TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
+            std::cerr << "Sparse accessor " << accessor.name << " has an invalid index component type!" << std::endl;
+            return false;
+        }
+        if (accessor.sparse.count < 0) {
+            std::cerr << "Sparse accessor " << accessor.name << " has a negative count!" << std::endl;
+            return false;
+        }
+        const size_t count = static_cast<size_t>(accessor.sparse.count);
+        const size_t indexSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(indexType)));
+        *indices = getBufferViewRange(model, accessor.sparse.indices.bufferView, accessor.sparse.indices.byteOffset, count * indexSize);
+        *values = getBufferViewRange(model, accessor.sparse.values.bufferView, accessor.sparse.values.byteOffset, count * valueSize);
+        if (*indices == nullptr || *values == nullptr) {
+            std::cerr << "Sparse accessor " << accessor.name << " reads past its buffer views!" << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (readSparseIndex(*indices, indexType, i) >= accessor.count) {
+                std::cerr << "Sparse accessor " << accessor.name << " has an index past its " << accessor.count << " elements!" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Accessors */
+
+    bool readAccessor(const tinygltf::Model& model, const tinygltf::Accessor& accessor, float* dst, size_t dstStride, uint32_t dstComponents, size_t* decodedBytes) {
+        const uint32_t components = std::min(static_cast<uint32_t>(tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type))), dstComponents);
+        const size_t componentSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType)));
+        const size_t elementSize = componentSize * tinygltf::GetNumComponentsInType(static_cast<uint32_t>(accessor.type));
+        uint8_t* out = reinterpret_cast<uint8_t*>(dst);
+
+        if (accessor.bufferView > -1) {
+            const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+            int byteStride = accessor.ByteStride(view);
+            if (byteStride < 0) {
+                std::cerr << "Accessor " << accessor.name << " has an invalid byte stride!" << std::endl;
+                return false;
+            }
+            const uint8_t* src = getBufferViewData(model, accessor.bufferView, accessor.byteOffset);
+            if (!convertAccessorElements(src, byteStride, accessor.componentType, accessor.normalized, components, accessor.count, out, dstStride)) {
+                return false;
+            }
+        } else {
+            // Sparse accessors without a buffer view start out zero initialized
+            for (size_t i = 0; i < accessor.count; i++) {
+                memset(out + i * dstStride, 0, components * sizeof(float));
+            }
+        }
+
+        if (accessor.sparse.isSparse) {
+            const uint8_t* indices;
+            const uint8_t* values;
+            if (!getSparseData(model, accessor, elementSize, &indices, &values)) {
+                return false;
+            }
+            for (int i = 0; i < accessor.sparse.count; i++) {
+                uint32_t index = readSparseIndex(indices, accessor.sparse.indices.componentType, i);
+                convertAccessorElements(values + i * elementSize, elementSize, accessor.componentType, accessor.normalized, components, 1, out + index * dstStride, dstStride);
+            }
+            if (decodedBytes) {
+                *decodedBytes += accessor.sparse.count * (elementSize + tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.sparse.indices.componentType)));
+            }
+        }
+
+        if (decodedBytes && accessor.bufferView > -1) {
+            *decodedBytes += accessor.count * elementSize;
+        }
+        return true;
+    }
+
+    bool readIndices(const tinygltf::Model& model, const tinygltf::Accessor& accessor, uint32_t* dst, uint32_t vertexOffset, size_t* decodedBytes) {
+        const size_t componentSize = static_cast<size_t>(tinygltf::GetComponentSizeInBytes(static_cast<uint32_t>(accessor.componentType)));
+
+        if (accessor.bufferView > -1) {
+            const tinygltf::BufferView& view = model.bufferViews[accessor.bufferView];
+            const uint8_t* src = getBufferViewData(model, accessor.bufferView, accessor.byteOffset);
+
+            // Index buffer views are always tightly packed
+            if (view.byteStride != 0 && view.byteStride != componentSize) {
+                std::cerr << "Index accessor " << accessor.name << " has an invalid byte stride!" << std::endl;
+                return false;
+            }
+
+            switch (accessor.componentType) {
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+                    widenIndices32(src, accessor.count, dst, vertexOffset);
+                    break;
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+                    widenIndices16(src, accessor.count, dst, vertexOffset);
+                    break;
+                case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+                    widenIndices8(src, accessor.count, dst, vertexOffset);
+                    break;
+                default:
+                    std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
+                    return false;
+            }
+            if (decodedBytes) {
+                *decodedBytes += accessor.count * componentSize;
+            }
+        } else {
+            std::fill(dst, dst + accessor.count, vertexOffset);
+        }
+
+        if (accessor.sparse.isSparse) {
+            const uint8_t* indices;
+            const uint8_t* values;
+            if (!getSparseData(model, accessor, componentSize, &indices, &values)) {
+                return false;
+            }
+            for (int i = 0; i < accessor.sparse.count; i++) {
+                uint32_t index = readSparseIndex(indices, accessor.sparse.indices.componentType, i);
+                dst[index] = readSparseIndex(values, accessor.componentType, i) + vertexOffset;
+            }
+        }
+        return true;
+    }
+
+    static void getNodeGeometrySize(const tinygltf::Model& model, const tinygltf::Node& node, size_t& vertexCount, size_t& indexCount) {
+        for (int child : node.children) {
+            getNodeGeometrySize(model, model.nodes[child], vertexCount, indexCount);
+        }
+        if (node.mesh < 0) {
+            return;
+        }
+        for (const tinygltf::Primitive& primitive : model.meshes[node.mesh].primitives) {
+            auto position = primitive.attributes.find("POSITION");
+            if (primitive.indices < 0 || position == primitive.attributes.end()) {
+                continue;
+            }
+            vertexCount += model.accessors[position->second].count;
+            indexCount += model.accessors[primitive.indices].count;
+        }
+    }
+
+    void getSceneGeometrySize(const tinygltf::Model& model, const tinygltf::Scene& scene, size_t& vertexCount, size_t& indexCount) {
+        vertexCount = 0;
+        indexCount = 0;
+        for (int node : scene.nodes) {
+            getNodeGeometrySize(model, model.nodes[node], vertexCount, indexCount);
+        }
+    }
+}
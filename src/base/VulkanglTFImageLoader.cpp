@@ -0,0 +1,77 @@
+#include "VulkanglTFImageLoader.hpp"
+
+#include <fstream>
+#include <iostream>
+
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include "tiny_gltf.h"
+
+namespace VulkanLearning {
+    bool isKtxImage(const tinygltf::Image& image)
+    {
+        if (image.mimeType == "image/ktx2") {
+            return true;
+        }
+        if (image.uri.find_last_of(".") != std::string::npos) {
+            const std::string extension = image.uri.substr(image.uri.find_last_of(".") + 1);
+            return extension == "ktx" || extension == "ktx2";
+        }
+        return false;
+    }
+
+    static bool isKtx1Image(const tinygltf::Image& image)
+    {
+        return isKtxImage(image) && image.uri.substr(image.uri.find_last_of(".") + 1) == "ktx";
+    }
+
+    int getTextureSource(const tinygltf::Texture& texture)
+    {
+        auto basisu = texture.extensions.find("KHR_texture_basisu");
+        if (basisu != texture.extensions.end() && basisu->second.Has("source")) {
+            return basisu->second.Get("source").GetNumberAsInt();
+        }
+        return texture.source;
+    }
+
+    bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
+    {
+        // KTX files will be handled by our own code, KTX2 ones may be embedded and are kept
+        if (isKtx1Image(*image)) {
+            return true;
+        }
+
+        // Only keep the encoded bytes, decoding is deferred to the worker threads in loadImages
+        image->image.assign(bytes, bytes + size);
+        return true;
+    }
+
+    void decodeImageData(tinygltf::Image* image, int imageIndex, const std::string& path)
+    {
+        if (isKtxImage(*image)) {
+#if !defined(__ANDROID__)
+            if (!image->image.empty()) {
+                return;
+            }
+            std::ifstream file(path + "/" + image->uri, std::ios::binary | std::ios::ate);
+            if (file.is_open()) {
+                image->image.resize(static_cast<size_t>(file.tellg()));
+                file.seekg(0);
+                file.read(reinterpret_cast<char*>(image->image.data()), image->image.size());
+            }
+#endif
+            return;
+        }
+
+        // Nothing to do if tinygltf already decoded the image itself
+        if (image->image.empty() || image->width > 0) {
+            return;
+        }
+
+        std::vector<unsigned char> encoded = std::move(image->image);
+        image->image.clear();
+        std::string error, warning;
+        if (!tinygltf::LoadImageData(image, imageIndex, &error, &warning, 0, 0, encoded.data(), static_cast<int>(encoded.size()), nullptr)) {
+            std::cerr << "Could not decode glTF image " << image->uri << ": " << error << std::endl;
+        }
+    }
+}
@@ -1,26 +1,18 @@
 #include "VulkanglTFModel.hpp"
+#include "VulkanTextureStreamer.hpp"
+#include "VulkanTextureResidency.hpp"
+#include "VulkanKtxTranscoder.hpp"
+#include "BlockCompression.hpp"
+#include "PixelKernels.hpp"
+
+#include <atomic>
 
 namespace VulkanLearning {
     VkDescriptorSetLayout descriptorSetLayoutImage = VK_NULL_HANDLE;
-    VkDescriptorSetLayout descriptorSetLayoutUbo = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayoutNodeTransforms = VK_NULL_HANDLE;
     VkMemoryPropertyFlags memoryPropertyFlags = 0;
     uint32_t descriptorBindingFlags = DescriptorBindingFlags::ImageBaseColor;
 
-    /*
-       We use a custom image loading function with tinyglTF, so we can do custom stuff loading ktx textures
-       */
-    bool loadImageDataFunc(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
-    {
-        // KTX files will be handled by our own code
-        if (image->uri.find_last_of(".") != std::string::npos) {
-            if (image->uri.substr(image->uri.find_last_of(".") + 1) == "ktx") {
-                return true;
-            }
-        }
-
-        return tinygltf::LoadImageData(image, imageIndex, error, warning, req_width, req_height, bytes, size, userData);
-    }
-
     bool loadImageDataFuncEmpty(tinygltf::Image* image, const int imageIndex, std::string* error, std::string* warning, int req_width, int req_height, const unsigned char* bytes, int size, void* userData)
     {
         // This function will be used for samples that don't require images to be loaded
@@ -44,21 +36,22 @@ namespace VulkanLearning {
         vkDestroyImageView(device->getLogicalDevice(), view, nullptr);
         vkDestroyImage(device->getLogicalDevice(), image, nullptr);
         vkFreeMemory(device->getLogicalDevice(), deviceMemory, nullptr);
-        vkDestroySampler(device->getLogicalDevice(), sampler, nullptr);
     }
 
-    void Texture::fromglTFImage(tinygltf::Image &gltfimage, std::string path, VulkanDevice *device, VkQueue copyQueue)
+    void Texture::fromglTFImage(tinygltf::Image &gltfimage, std::string path, VulkanDevice *device, VkQueue copyQueue, VulkanTextureBatch* uploadBatch)
     {
         this->device = device;
 
-        bool isKtx = false;
-        // Image points to an external ktx file
-        if (gltfimage.uri.find_last_of(".") != std::string::npos) {
-            if (gltfimage.uri.substr(gltfimage.uri.find_last_of(".") + 1) == "ktx") {
-                isKtx = true;
-            }
+        // Uploads are recorded into the caller's batch, or into a local one that is flushed right away
+        std::unique_ptr<VulkanTextureBatch> localBatch;
+        if (uploadBatch == nullptr) {
+            localBatch = std::make_unique<VulkanTextureBatch>(device, copyQueue);
+            uploadBatch = localBatch.get();
         }
 
+        // Image points to an external ktx file
+        bool isKtx = isKtxImage(gltfimage);
+
         VkFormat format;
 
         if (!isKtx) {
@@ -72,15 +65,7 @@ namespace VulkanLearning {
                 // TODO: Check actual format support and transform only if required
                 bufferSize = gltfimage.width * gltfimage.height * 4;
                 buffer = new unsigned char[bufferSize];
-                unsigned char* rgba = buffer;
-                unsigned char* rgb = &gltfimage.image[0];
-                for (size_t i = 0; i < gltfimage.width * gltfimage.height; ++i) {
-                    for (int32_t j = 0; j < 3; ++j) {
-                        rgba[j] = rgb[j];
-                    }
-                    rgba += 4;
-                    rgb += 3;
-                }
+                PixelKernels::rgbToRgba(&gltfimage.image[0], buffer, static_cast<size_t>(gltfimage.width) * gltfimage.height);
                 deleteBuffer = true;
             }
             else {
@@ -90,181 +75,21 @@ namespace VulkanLearning {
 
             format = VK_FORMAT_R8G8B8A8_UNORM;
 
-            VkFormatProperties formatProperties;
-
             width = gltfimage.width;
             height = gltfimage.height;
-            mipLevels = static_cast<uint32_t>(floor(log2(std::max(width, height))) + 1.0);
-
-            vkGetPhysicalDeviceFormatProperties(device->getPhysicalDevice(), format, &formatProperties);
-            assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT);
-            assert(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
-
-            VkMemoryAllocateInfo memAllocInfo{};
-            memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            VkMemoryRequirements memReqs{};
-
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingMemory;
-
-            VkBufferCreateInfo bufferCreateInfo{};
-            bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-            bufferCreateInfo.size = bufferSize;
-            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            VK_CHECK_RESULT(vkCreateBuffer(device->getLogicalDevice(), &bufferCreateInfo, nullptr, &stagingBuffer));
-            vkGetBufferMemoryRequirements(device->getLogicalDevice(), stagingBuffer, &memReqs);
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = device->findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-            VK_CHECK_RESULT(vkAllocateMemory(device->getLogicalDevice(), &memAllocInfo, nullptr, &stagingMemory));
-            VK_CHECK_RESULT(vkBindBufferMemory(device->getLogicalDevice(), stagingBuffer, stagingMemory, 0));
-
-            uint8_t* data;
-            VK_CHECK_RESULT(vkMapMemory(device->getLogicalDevice(), stagingMemory, 0, memReqs.size, 0, (void**)&data));
-            memcpy(data, buffer, bufferSize);
-            vkUnmapMemory(device->getLogicalDevice(), stagingMemory);
-
-            VkImageCreateInfo imageCreateInfo{};
-            imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageCreateInfo.format = format;
-            imageCreateInfo.mipLevels = mipLevels;
-            imageCreateInfo.arrayLayers = 1;
-            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-            imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT;
-            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageCreateInfo.extent = { width, height, 1 };
-            imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-            VK_CHECK_RESULT(vkCreateImage(device->getLogicalDevice(), &imageCreateInfo, nullptr, &image));
-            vkGetImageMemoryRequirements(device->getLogicalDevice(), image, &memReqs);
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = device->findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            VK_CHECK_RESULT(vkAllocateMemory(device->getLogicalDevice(), &memAllocInfo, nullptr, &deviceMemory));
-            VK_CHECK_RESULT(vkBindImageMemory(device->getLogicalDevice(), image, deviceMemory, 0));
-
-            //VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-            VulkanCommandBuffer copyCmd;
-            copyCmd.create(device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-            VkImageSubresourceRange subresourceRange = {};
-            subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            subresourceRange.levelCount = 1;
-            subresourceRange.layerCount = 1;
-
-            {
-                VkImageMemoryBarrier imageMemoryBarrier{};
-                imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                imageMemoryBarrier.srcAccessMask = 0;
-                imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                imageMemoryBarrier.image = image;
-                imageMemoryBarrier.subresourceRange = subresourceRange;
-                vkCmdPipelineBarrier(copyCmd.getCommandBuffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-            }
-
-            VkBufferImageCopy bufferCopyRegion = {};
-            bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            bufferCopyRegion.imageSubresource.mipLevel = 0;
-            bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-            bufferCopyRegion.imageSubresource.layerCount = 1;
-            bufferCopyRegion.imageExtent.width = width;
-            bufferCopyRegion.imageExtent.height = height;
-            bufferCopyRegion.imageExtent.depth = 1;
-
-            vkCmdCopyBufferToImage(copyCmd.getCommandBuffer(), stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion);
-
-            {
-                VkImageMemoryBarrier imageMemoryBarrier{};
-                imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                imageMemoryBarrier.image = image;
-                imageMemoryBarrier.subresourceRange = subresourceRange;
-                vkCmdPipelineBarrier(copyCmd.getCommandBuffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-            }
-
-            copyCmd.flushCommandBuffer(device, copyQueue, true);
-            //device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-            vkFreeMemory(device->getLogicalDevice(), stagingMemory, nullptr);
-            vkDestroyBuffer(device->getLogicalDevice(), stagingBuffer, nullptr);
-
-            // Generate the mip chain (glTF uses jpg and png, so we need to create this manually)
-            VulkanCommandBuffer blitCmd;
-            blitCmd.create(device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-            //VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-            for (uint32_t i = 1; i < mipLevels; i++) {
-                VkImageBlit imageBlit{};
-
-                imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                imageBlit.srcSubresource.layerCount = 1;
-                imageBlit.srcSubresource.mipLevel = i - 1;
-                imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-                imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-                imageBlit.srcOffsets[1].z = 1;
-
-                imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                imageBlit.dstSubresource.layerCount = 1;
-                imageBlit.dstSubresource.mipLevel = i;
-                imageBlit.dstOffsets[1].x = int32_t(width >> i);
-                imageBlit.dstOffsets[1].y = int32_t(height >> i);
-                imageBlit.dstOffsets[1].z = 1;
-
-                VkImageSubresourceRange mipSubRange = {};
-                mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                mipSubRange.baseMipLevel = i;
-                mipSubRange.levelCount = 1;
-                mipSubRange.layerCount = 1;
+            // The mip chain is generated by the batch (glTF uses jpg and png, so we need to create it manually)
+            mipLevels = uploadBatch->getMipLevels(format, width, height);
+            createImage(format, uploadBatch->getImageUsage(format, mipLevels));
 
-                {
-                    VkImageMemoryBarrier imageMemoryBarrier{};
-                    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                    imageMemoryBarrier.srcAccessMask = 0;
-                    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                    imageMemoryBarrier.image = image;
-                    imageMemoryBarrier.subresourceRange = mipSubRange;
-                    vkCmdPipelineBarrier(blitCmd.getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-                }
-
-                vkCmdBlitImage(blitCmd.getCommandBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &imageBlit, VK_FILTER_LINEAR);
-
-                {
-                    VkImageMemoryBarrier imageMemoryBarrier{};
-                    imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                    imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-                    imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                    imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                    imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                    imageMemoryBarrier.image = image;
-                    imageMemoryBarrier.subresourceRange = mipSubRange;
-                    vkCmdPipelineBarrier(blitCmd.getCommandBuffer(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
-                }
-            }
-
-            subresourceRange.levelCount = mipLevels;
-            imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            // Pixels are copied into a staging buffer here, so the temporary buffer can go right away
+            uploadBatch->add(image, format, width, height, mipLevels, buffer, bufferSize);
 
-            {
-                VkImageMemoryBarrier imageMemoryBarrier{};
-                imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-                imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-                imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-                imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-                imageMemoryBarrier.image = image;
-                imageMemoryBarrier.subresourceRange = subresourceRange;
-                vkCmdPipelineBarrier(blitCmd.getCommandBuffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+            if (deleteBuffer) {
+                delete[] buffer;
             }
 
-            blitCmd.flushCommandBuffer(device, copyQueue, true);
-            //device->flushCommandBuffer(blitCmd, copyQueue, true);
+            createSampler();
+            createView();
         }
         else {
             // Texture is stored in an external ktx file
@@ -273,129 +98,107 @@ namespace VulkanLearning {
             ktxTexture* ktxTexture;
 
             ktxResult result = KTX_SUCCESS;
+            if (!gltfimage.image.empty()) {
+                // File contents have already been read by a loader thread, or were embedded in the glTF file
+                result = ktxTexture_CreateFromMemory(gltfimage.image.data(), gltfimage.image.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+            } else {
 #if defined(__ANDROID__)
-            AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
-            if (!asset) {
-                tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-            }
-            size_t size = AAsset_getLength(asset);
-            assert(size > 0);
-            ktx_uint8_t* textureData = new ktx_uint8_t[size];
-            AAsset_read(asset, textureData, size);
-            AAsset_close(asset);
-            result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
-            delete[] textureData;
+                AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+                if (!asset) {
+                    tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+                }
+                size_t size = AAsset_getLength(asset);
+                assert(size > 0);
+                ktx_uint8_t* textureData = new ktx_uint8_t[size];
+                AAsset_read(asset, textureData, size);
+                AAsset_close(asset);
+                result = ktxTexture_CreateFromMemory(textureData, size, KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+                delete[] textureData;
 #else
-            if (!tools::fileExists(filename)) {
-                tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
-            }
-            result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+                if (!tools::fileExists(filename)) {
+                    tools::exitFatal("Could not load texture from " + filename + "\n\nThe file may be part of the additional asset pack.\n\nRun \"download_assets.py\" in the repository root to download the latest version.", -1);
+                }
+                result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
 #endif
+            }
             assert(result == KTX_SUCCESS);
 
-            this->device = device;
-            width = ktxTexture->baseWidth;
-            height = ktxTexture->baseHeight;
-            mipLevels = ktxTexture->numLevels;
+            // Basis Universal textures are transcoded for this device, KTX1 files are expected to hold RGBA8
+            if (prepareKtxTexture(device, ktxTexture, VK_FORMAT_R8G8B8A8_UNORM, format) != KTX_SUCCESS) {
+                tools::exitFatal("Could not transcode texture " + filename, -1);
+            }
+            fromKtxTexture(ktxTexture, format, device, copyQueue, uploadBatch);
 
-            ktx_uint8_t* ktxTextureData = ktxTexture_GetData(ktxTexture);
-            ktx_size_t ktxTextureSize = ktxTexture_GetSize(ktxTexture);
-            // @todo: Use ktxTexture_GetVkFormat(ktxTexture)
-            format = VK_FORMAT_R8G8B8A8_UNORM;
+            ktxTexture_Destroy(ktxTexture);
+        }
 
-            // Get device properties for the requested texture format
-            VkFormatProperties formatProperties;
-            vkGetPhysicalDeviceFormatProperties(device->getPhysicalDevice(), format, &formatProperties);
-
-            VulkanCommandBuffer copyCmd;
-            copyCmd.create(device, VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-            //VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingMemory;
-
-            //VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-            VkBufferCreateInfo bufferCreateInfo = {};
-            bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-            bufferCreateInfo.size = ktxTextureSize;
-            // This buffer is used as a transfer source for the buffer copy
-            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            VK_CHECK_RESULT(vkCreateBuffer(device->getLogicalDevice(), &bufferCreateInfo, nullptr, &stagingBuffer));
-
-            //VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-            VkMemoryAllocateInfo memAllocInfo = {};
-            memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-            VkMemoryRequirements memReqs;
-            vkGetBufferMemoryRequirements(device->getLogicalDevice(), stagingBuffer, &memReqs);
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = device->findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-            VK_CHECK_RESULT(vkAllocateMemory(device->getLogicalDevice(), &memAllocInfo, nullptr, &stagingMemory));
-            VK_CHECK_RESULT(vkBindBufferMemory(device->getLogicalDevice(), stagingBuffer, stagingMemory, 0));
-
-            uint8_t* data;
-            VK_CHECK_RESULT(vkMapMemory(device->getLogicalDevice(), stagingMemory, 0, memReqs.size, 0, (void**)&data));
-            memcpy(data, ktxTextureData, ktxTextureSize);
-            vkUnmapMemory(device->getLogicalDevice(), stagingMemory);
-
-            std::vector<VkBufferImageCopy> bufferCopyRegions;
-            for (uint32_t i = 0; i < mipLevels; i++)
-            {
-                ktx_size_t offset;
-                KTX_error_code result = ktxTexture_GetImageOffset(ktxTexture, i, 0, 0, &offset);
-                assert(result == KTX_SUCCESS);
-                VkBufferImageCopy bufferCopyRegion = {};
-                bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                bufferCopyRegion.imageSubresource.mipLevel = i;
-                bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-                bufferCopyRegion.imageSubresource.layerCount = 1;
-                bufferCopyRegion.imageExtent.width = std::max(1u, ktxTexture->baseWidth >> i);
-                bufferCopyRegion.imageExtent.height = std::max(1u, ktxTexture->baseHeight >> i);
-                bufferCopyRegion.imageExtent.depth = 1;
-                bufferCopyRegion.bufferOffset = offset;
-                bufferCopyRegions.push_back(bufferCopyRegion);
-            }
-
-            // Create optimal tiled target image
-            //VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-            VkImageCreateInfo imageCreateInfo = {};
-            imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-            imageCreateInfo.format = format;
-            imageCreateInfo.mipLevels = mipLevels;
-            imageCreateInfo.arrayLayers = 1;
-            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageCreateInfo.extent = { width, height, 1 };
-            imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
-            VK_CHECK_RESULT(vkCreateImage(device->getLogicalDevice(), &imageCreateInfo, nullptr, &image));
-
-            vkGetImageMemoryRequirements(device->getLogicalDevice(), image, &memReqs);
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = device->findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            VK_CHECK_RESULT(vkAllocateMemory(device->getLogicalDevice(), &memAllocInfo, nullptr, &deviceMemory));
-            VK_CHECK_RESULT(vkBindImageMemory(device->getLogicalDevice(), image, deviceMemory, 0));
-
-            VkImageSubresourceRange subresourceRange = {};
-            subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            subresourceRange.baseMipLevel = 0;
-            subresourceRange.levelCount = mipLevels;
-            subresourceRange.layerCount = 1;
-
-            tools::setImageLayout(copyCmd.getCommandBuffer(), image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, subresourceRange);
-            vkCmdCopyBufferToImage(copyCmd.getCommandBuffer(), stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(bufferCopyRegions.size()), bufferCopyRegions.data());
-            tools::setImageLayout(copyCmd.getCommandBuffer(), image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, subresourceRange);
-            copyCmd.flushCommandBuffer(device, copyQueue, true);
-            //device->flushCommandBuffer(copyCmd, copyQueue);
-            this->imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-            vkFreeMemory(device->getLogicalDevice(), stagingMemory, nullptr);
-            vkDestroyBuffer(device->getLogicalDevice(), stagingBuffer, nullptr);
+        if (localBatch) {
+            localBatch->flush();
+        }
+    }
 
-            ktxTexture_Destroy(ktxTexture);
+    void Texture::fromKtxTexture(ktxTexture* ktxTexture, VkFormat format, VulkanDevice* device, VkQueue copyQueue, VulkanTextureBatch* uploadBatch)
+    {
+        // All levels are stored in the file, the batch only has to copy them
+        fromPixels(ktxTexture_GetData(ktxTexture), ktxTexture_GetDataSize(ktxTexture), format,
+                ktxTexture->baseWidth, ktxTexture->baseHeight, ktxTexture->numLevels, getKtxLevelRegions(ktxTexture),
+                device, copyQueue, uploadBatch);
+    }
+
+    void Texture::fromPixels(const void* data, VkDeviceSize size, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels, const std::vector<VkBufferImageCopy>& regions, VulkanDevice* device, VkQueue copyQueue, VulkanTextureBatch* uploadBatch)
+    {
+        this->device = device;
+        this->width = width;
+        this->height = height;
+        this->mipLevels = mipLevels;
+
+        std::unique_ptr<VulkanTextureBatch> localBatch;
+        if (uploadBatch == nullptr) {
+            localBatch = std::make_unique<VulkanTextureBatch>(device, copyQueue);
+            uploadBatch = localBatch.get();
+        }
+
+        createImage(format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+        // Nothing is generated, the batch copies every level into its staging buffer
+        uploadBatch->add(image, format, width, height, mipLevels, data, size, regions);
+        createSampler();
+        createView();
+
+        if (localBatch) {
+            localBatch->flush();
         }
+    }
+
+    void Texture::createImage(VkFormat format, VkImageUsageFlags usage)
+    {
+        VkImageCreateInfo imageCreateInfo{};
+        imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageCreateInfo.format = format;
+        imageCreateInfo.mipLevels = mipLevels;
+        imageCreateInfo.arrayLayers = 1;
+        imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageCreateInfo.extent = { width, height, 1 };
+        imageCreateInfo.usage = usage;
+        VK_CHECK_RESULT(vkCreateImage(device->getLogicalDevice(), &imageCreateInfo, nullptr, &image));
+        this->format = format;
+        view = VK_NULL_HANDLE;
+
+        VkMemoryRequirements memReqs{};
+        vkGetImageMemoryRequirements(device->getLogicalDevice(), image, &memReqs);
+        VkMemoryAllocateInfo memAllocInfo{};
+        memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAllocInfo.allocationSize = memReqs.size;
+        memAllocInfo.memoryTypeIndex = device->findMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VK_CHECK_RESULT(vkAllocateMemory(device->getLogicalDevice(), &memAllocInfo, nullptr, &deviceMemory));
+        VK_CHECK_RESULT(vkBindImageMemory(device->getLogicalDevice(), image, deviceMemory, 0));
+    }
 
+    void Texture::createSampler()
+    {
         VkSamplerCreateInfo samplerInfo{};
         samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         samplerInfo.magFilter = VK_FILTER_LINEAR;
@@ -406,12 +209,21 @@ namespace VulkanLearning {
         samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
         samplerInfo.compareOp = VK_COMPARE_OP_NEVER;
         samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-        samplerInfo.maxAnisotropy = 1.0;
-        samplerInfo.anisotropyEnable = VK_FALSE;
-        samplerInfo.maxLod = (float)mipLevels;
+        // The view limits the levels, so all textures share one sampler whatever their mip count
+        samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
         samplerInfo.maxAnisotropy = 8.0f;
         samplerInfo.anisotropyEnable = VK_TRUE;
-        VK_CHECK_RESULT(vkCreateSampler(device->getLogicalDevice(), &samplerInfo, nullptr, &sampler));
+        sampler = device->getSampler(samplerInfo);
+    }
+
+    void Texture::createView(uint32_t baseMipLevel)
+    {
+        imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+        // Streamed textures replace their view whenever finer levels arrive
+        if (view != VK_NULL_HANDLE) {
+            vkDestroyImageView(device->getLogicalDevice(), view, nullptr);
+        }
 
         VkImageViewCreateInfo viewInfo{};
         viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -421,7 +233,8 @@ namespace VulkanLearning {
         viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
         viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         viewInfo.subresourceRange.layerCount = 1;
-        viewInfo.subresourceRange.levelCount = mipLevels;
+        viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+        viewInfo.subresourceRange.levelCount = mipLevels - baseMipLevel;
         VK_CHECK_RESULT(vkCreateImageView(device->getLogicalDevice(), &viewInfo, nullptr, &view));
 
         descriptor.sampler = sampler;
@@ -440,6 +253,11 @@ namespace VulkanLearning {
         descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
         descriptorSetAllocInfo.descriptorSetCount = 1;
         VK_CHECK_RESULT(vkAllocateDescriptorSets(device->getLogicalDevice(), &descriptorSetAllocInfo, &descriptorSet));
+        updateDescriptorSet(descriptorBindingFlags);
+    }
+
+    void Material::updateDescriptorSet(uint32_t descriptorBindingFlags)
+    {
         std::vector<VkDescriptorImageInfo> imageDescriptors{};
         std::vector<VkWriteDescriptorSet> writeDescriptorSets{};
         if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
@@ -482,42 +300,24 @@ namespace VulkanLearning {
     /*
        glTF mesh
        */
-    Mesh::Mesh(VulkanDevice *device, glm::mat4 matrix) {
+    Mesh::Mesh(VulkanDevice *device) {
         this->device = device;
-        this->uniformBlock.matrix = matrix;
-        /* VK_CHECK_RESULT(device->createBuffer( */
-        /*             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, */
-        /*             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, */
-        /*             sizeof(uniformBlock), */
-        /*             &uniformBuffer.buffer, */
-        /*             &uniformBuffer.memory, */
-        /*             &uniformBlock)); */
-        uniformBuffer.buffer = VulkanBuffer(*device);
-        uniformBuffer.buffer.createBuffer(
-                sizeof(uniformBlock), 
-                VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-                &uniformBlock);
-
-        //VK_CHECK_RESULT(vkMapMemory(device->getLogicalDevice(), uniformBuffer.memory, 0, sizeof(uniformBlock), 0, &uniformBuffer.mapped));
-        uniformBuffer.buffer.map(sizeof(uniformBlock), 0);
-        uniformBuffer.buffer.setupDescriptor(sizeof(uniformBlock), 0);
     };
 
-    Mesh::~Mesh() {
-        uniformBuffer.buffer.cleanup();
-        //vkDestroyBuffer(device->getLogicalDevice(), uniformBuffer.buffer, nullptr);
-        //vkFreeMemory(device->getLogicalDevice(), uniformBuffer.memory, nullptr);
-    }
-
     /*
        glTF node
        */
     glm::mat4 Node::localMatrix() {
+        if (hierarchy) {
+            return hierarchy->localMatrix(transformIndex);
+        }
         return glm::translate(glm::mat4(1.0f), translation) * glm::mat4(rotation) * glm::scale(glm::mat4(1.0f), scale) * matrix;
     }
 
     glm::mat4 Node::getMatrix() {
+        if (hierarchy) {
+            return hierarchy->worldMatrices[transformIndex];
+        }
         glm::mat4 m = localMatrix();
         Node *p = parent;
         while (p) {
@@ -527,31 +327,6 @@ namespace VulkanLearning {
         return m;
     }
 
-    void Node::update() {
-        if (mesh) {
-            glm::mat4 m = getMatrix();
-            if (skin) {
-                mesh->uniformBlock.matrix = m;
-                // Update join matrices
-                glm::mat4 inverseTransform = glm::inverse(m);
-                for (size_t i = 0; i < skin->joints.size(); i++) {
-                    Node *jointNode = skin->joints[i];
-                    glm::mat4 jointMat = jointNode->getMatrix() * skin->inverseBindMatrices[i];
-                    jointMat = inverseTransform * jointMat;
-                    mesh->uniformBlock.jointMatrix[i] = jointMat;
-                }
-                mesh->uniformBlock.jointCount = (float)skin->joints.size();
-                memcpy(mesh->uniformBuffer.buffer.getMappedMemory(), &mesh->uniformBlock, sizeof(mesh->uniformBlock));
-            } else {
-                memcpy(mesh->uniformBuffer.buffer.getMappedMemory(), &m, sizeof(glm::mat4));
-            }
-        }
-
-        for (auto& child : children) {
-            child->update();
-        }
-    }
-
     Node::~Node() {
         if (mesh) {
             delete mesh;
@@ -616,6 +391,360 @@ namespace VulkanLearning {
         return &pipelineVertexInputStateCreateInfo;
     }
 
+    /*
+       Per instance data
+       */
+
+    VkVertexInputBindingDescription InstanceData::inputBindingDescription(uint32_t binding) {
+        return VkVertexInputBindingDescription({ binding, sizeof(InstanceData), VK_VERTEX_INPUT_RATE_INSTANCE });
+    }
+
+    std::vector<VkVertexInputAttributeDescription> InstanceData::inputAttributeDescriptions(uint32_t binding, uint32_t firstLocation) {
+        std::vector<VkVertexInputAttributeDescription> result;
+        for (uint32_t column = 0; column < 4; column++) {
+            result.push_back({ firstLocation + column, binding, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, matrix) + column * sizeof(glm::vec4)) });
+        }
+        result.push_back({ firstLocation + 4, binding, VK_FORMAT_R32G32B32A32_SFLOAT, static_cast<uint32_t>(offsetof(InstanceData, baseColorFactor)) });
+        result.push_back({ firstLocation + 5, binding, VK_FORMAT_R32_UINT, static_cast<uint32_t>(offsetof(InstanceData, materialIndex)) });
+        return result;
+    }
+
+    /*
+       Compact glTF vertex layout
+       */
+
+    VkVertexInputBindingDescription CompactVertex::vertexInputBindingDescription;
+    std::vector<VkVertexInputAttributeDescription> CompactVertex::vertexInputAttributeDescriptions;
+    VkPipelineVertexInputStateCreateInfo CompactVertex::pipelineVertexInputStateCreateInfo;
+
+    VkVertexInputBindingDescription CompactVertex::inputBindingDescription(uint32_t binding) {
+        return VkVertexInputBindingDescription({ binding, sizeof(CompactVertex), VK_VERTEX_INPUT_RATE_VERTEX });
+    }
+
+    VkVertexInputAttributeDescription CompactVertex::inputAttributeDescription(uint32_t binding, uint32_t location, VertexComponent component) {
+        switch (component) {
+            case VertexComponent::Position:
+                return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16B16A16_SNORM, offsetof(CompactVertex, pos) });
+            case VertexComponent::Normal:
+                return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal) });
+            case VertexComponent::UV:
+                return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv) });
+            case VertexComponent::Color:
+                return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R8G8B8A8_UNORM, offsetof(CompactVertex, color) });
+            case VertexComponent::Tangent:
+                return VkVertexInputAttributeDescription({ location, binding, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, tangent) });
+            default:
+                std::cerr << "Vertex component " << static_cast<int>(component) << " isn't part of the compact layout" << std::endl;
+                return VkVertexInputAttributeDescription({});
+        }
+    }
+
+    std::vector<VkVertexInputAttributeDescription> CompactVertex::inputAttributeDescriptions(uint32_t binding, const std::vector<VertexComponent> components) {
+        std::vector<VkVertexInputAttributeDescription> result;
+        uint32_t location = 0;
+        for (VertexComponent component : components) {
+            result.push_back(CompactVertex::inputAttributeDescription(binding, location, component));
+            location++;
+        }
+        return result;
+    }
+
+    VkPipelineVertexInputStateCreateInfo* CompactVertex::getPipelineVertexInputState(const std::vector<VertexComponent> components) {
+        vertexInputBindingDescription = CompactVertex::inputBindingDescription(0);
+        CompactVertex::vertexInputAttributeDescriptions = CompactVertex::inputAttributeDescriptions(0, components);
+        pipelineVertexInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        pipelineVertexInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+        pipelineVertexInputStateCreateInfo.pVertexBindingDescriptions = &CompactVertex::vertexInputBindingDescription;
+        pipelineVertexInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(CompactVertex::vertexInputAttributeDescriptions.size());
+        pipelineVertexInputStateCreateInfo.pVertexAttributeDescriptions = CompactVertex::vertexInputAttributeDescriptions.data();
+        return &pipelineVertexInputStateCreateInfo;
+    }
+
+    // Octahedral mapping of a unit vector to [-1, 1]^2, decoded in the compact shader variants
+    static glm::vec2 octahedralEncode(glm::vec3 v) {
+        float l1 = std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+        if (l1 == 0.0f) {
+            return glm::vec2(0.0f);
+        }
+        glm::vec2 e = glm::vec2(v) / l1;
+        if (v.z < 0.0f) {
+            glm::vec2 signs(e.x >= 0.0f ? 1.0f : -1.0f, e.y >= 0.0f ? 1.0f : -1.0f);
+            e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * signs;
+        }
+        return e;
+    }
+
+    // Offset and uniform scale mapping the vertex range into [-1, 1], uniform so normals need no fixup
+    static glm::vec4 getPositionDequantization(const std::vector<Vertex>& vertexBuffer, size_t first, size_t last) {
+        glm::vec3 min(FLT_MAX);
+        glm::vec3 max(-FLT_MAX);
+        for (size_t i = first; i < last; i++) {
+            min = glm::min(min, vertexBuffer[i].pos);
+            max = glm::max(max, vertexBuffer[i].pos);
+        }
+        if (first >= last) {
+            return glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+        glm::vec3 halfExtent = (max - min) * 0.5f;
+        float scale = std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z));
+        return glm::vec4((min + max) * 0.5f, scale > 0.0f ? scale : 1.0f);
+    }
+
+    static void quantizeVertices(const std::vector<Vertex>& vertexBuffer, std::vector<CompactVertex>& compactVertexBuffer, size_t first, size_t last, glm::vec4 dequantization) {
+        const glm::vec3 offset = glm::vec3(dequantization);
+        const float invScale = 1.0f / dequantization.w;
+        for (size_t i = first; i < last; i++) {
+            const Vertex& vertex = vertexBuffer[i];
+            CompactVertex& compact = compactVertexBuffer[i];
+            glm::vec3 pos = glm::clamp((vertex.pos - offset) * invScale, glm::vec3(-1.0f), glm::vec3(1.0f));
+            compact.pos = glm::packSnorm4x16(glm::vec4(pos, vertex.tangent.w < 0.0f ? -1.0f : 1.0f));
+            compact.normal = glm::packSnorm2x16(octahedralEncode(vertex.normal));
+            compact.tangent = glm::packSnorm2x16(octahedralEncode(glm::vec3(vertex.tangent)));
+            compact.uv = glm::packHalf2x16(vertex.uv);
+            compact.color = glm::packUnorm4x8(glm::clamp(vertex.color, glm::vec4(0.0f), glm::vec4(1.0f)));
+        }
+    }
+
+    // Appends successively halved copies of a primitive's indices right after its full index range
+    static void generatePrimitiveLods(std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer, uint32_t indexStart, uint32_t indexCount, uint32_t vertexStart, uint32_t vertexCount, uint32_t maxLodCount, std::vector<Primitive::Lod>& lods)
+    {
+        lods.push_back({ indexStart, indexCount, 0.0f });
+        std::vector<uint32_t> source(indexBuffer.begin() + indexStart, indexBuffer.begin() + indexStart + indexCount);
+        for (uint32_t& index : source) {
+            index -= vertexStart;
+        }
+        std::vector<uint32_t> lod(source.size());
+        const float* positions = glm::value_ptr(vertexBuffer[vertexStart].pos);
+        float error = 0.0f;
+        for (uint32_t level = 1; level < maxLodCount; level++) {
+            float levelError = 0.0f;
+            size_t lodIndexCount = MeshOptimizer::simplify(lod.data(), source.data(), source.size(), positions, sizeof(Vertex), vertexCount, source.size() / 6 * 3, 1.0f, &levelError);
+            // Stop once borders and seams prevent a meaningful reduction
+            if (lodIndexCount == 0 || lodIndexCount > source.size() * 3 / 4) {
+                break;
+            }
+            MeshOptimizer::optimizeVertexCache(lod.data(), lod.data(), lodIndexCount, vertexCount);
+            // Each level simplifies the previous one, so the errors add up
+            error += levelError;
+            lods.push_back({ static_cast<uint32_t>(indexBuffer.size()), static_cast<uint32_t>(lodIndexCount), error });
+            for (size_t i = 0; i < lodIndexCount; i++) {
+                indexBuffer.push_back(lod[i] + vertexStart);
+            }
+            source.assign(lod.begin(), lod.begin() + lodIndexCount);
+        }
+    }
+
+    static uint32_t getRenderPass(const Material& material) {
+        switch (material.alphaMode) {
+            case Material::ALPHAMODE_MASK: return RenderFlags::RenderAlphaMaskedNodes;
+            case Material::ALPHAMODE_BLEND: return RenderFlags::RenderAlphaBlendedNodes;
+            default: return RenderFlags::RenderOpaqueNodes;
+        }
+    }
+
+    // Copy regions of a mip chain whose levels follow each other without padding, block
+    // compressed levels are whole blocks
+    static std::vector<VkBufferImageCopy> getPackedLevelRegions(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkDeviceSize& totalSize) {
+        uint32_t blockExtent = 1, blockSize = 4;
+        tools::getFormatBlock(format, blockExtent, blockSize);
+        std::vector<VkBufferImageCopy> regions(mipLevels);
+        totalSize = 0;
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            regions[level] = {};
+            regions[level].bufferOffset = totalSize;
+            regions[level].imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            regions[level].imageSubresource.mipLevel = level;
+            regions[level].imageSubresource.layerCount = 1;
+            regions[level].imageExtent = { std::max(1u, width >> level), std::max(1u, height >> level), 1 };
+            const uint32_t blocksWide = (regions[level].imageExtent.width + blockExtent - 1) / blockExtent;
+            const uint32_t blocksHigh = (regions[level].imageExtent.height + blockExtent - 1) / blockExtent;
+            totalSize += static_cast<VkDeviceSize>(blocksWide) * blocksHigh * blockSize;
+        }
+        return regions;
+    }
+
+    // RGBA8 pixels of a decoded image followed by its box filtered mip chain. Grey, grey alpha and
+    // 16 bit images are expanded to RGBA8 first
+    static std::vector<uint8_t> buildMipChain(const tinygltf::Image& image, uint32_t& mipLevels) {
+        mipLevels = 0;
+        const size_t bytesPerChannel = image.bits == 16 ? 2 : 1;
+        if (image.width <= 0 || image.height <= 0 || image.component < 1 || image.component > 4
+                || image.image.size() < static_cast<size_t>(image.width) * image.height * image.component * bytesPerChannel) {
+            return std::vector<uint8_t>();
+        }
+        const uint32_t width = static_cast<uint32_t>(image.width);
+        const uint32_t height = static_cast<uint32_t>(image.height);
+        mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+        VkDeviceSize totalSize;
+        std::vector<VkBufferImageCopy> regions = getPackedLevelRegions(width, height, mipLevels, VK_FORMAT_R8G8B8A8_UNORM, totalSize);
+        std::vector<uint8_t> levels(totalSize);
+        const size_t pixelCount = static_cast<size_t>(width) * height;
+        if (bytesPerChannel == 1 && image.component == 3) {
+            PixelKernels::rgbToRgba(image.image.data(), levels.data(), pixelCount);
+        } else if (bytesPerChannel == 1 && image.component == 4) {
+            memcpy(levels.data(), image.image.data(), pixelCount * 4);
+        } else {
+            // 16 bit channels keep their high byte
+            auto channel = [&image, bytesPerChannel](size_t pixel, int component) -> uint8_t {
+                const unsigned char* src = image.image.data() + (pixel * image.component + component) * bytesPerChannel;
+                if (bytesPerChannel == 1) {
+                    return src[0];
+                }
+                uint16_t value;
+                memcpy(&value, src, sizeof(value));
+                return static_cast<uint8_t>(value >> 8);
+            };
+            const bool grey = image.component < 3;
+            const bool alpha = image.component == 2 || image.component == 4;
+            for (size_t pixel = 0; pixel < pixelCount; pixel++) {
+                uint8_t* dst = levels.data() + pixel * 4;
+                dst[0] = channel(pixel, 0);
+                dst[1] = grey ? dst[0] : channel(pixel, 1);
+                dst[2] = grey ? dst[0] : channel(pixel, 2);
+                dst[3] = alpha ? channel(pixel, image.component - 1) : 255;
+            }
+        }
+        for (uint32_t level = 1; level < mipLevels; level++) {
+            PixelKernels::downsample2x2(
+                    levels.data() + regions[level - 1].bufferOffset,
+                    regions[level - 1].imageExtent.width,
+                    regions[level - 1].imageExtent.height,
+                    levels.data() + regions[level].bufferOffset);
+        }
+        return levels;
+    }
+
+    // Tightly packed levels of a KTX image, Basis Universal textures are transcoded for the device
+    // first. Sets the extent of the image, returns an empty chain if the file can't be read or its
+    // format can't be streamed. May be called from any thread
+    static std::vector<uint8_t> loadKtxMipChain(VulkanDevice* device, tinygltf::Image& image, const std::string& path, VkFormat& format, uint32_t& mipLevels) {
+        mipLevels = 0;
+        const std::string filename = path + "/" + image.uri;
+        ktxTexture* ktxTexture = nullptr;
+        ktxResult result = KTX_SUCCESS;
+        if (!image.image.empty()) {
+            result = ktxTexture_CreateFromMemory(image.image.data(), image.image.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+        } else {
+#if defined(__ANDROID__)
+            AAsset* asset = AAssetManager_open(androidApp->activity->assetManager, filename.c_str(), AASSET_MODE_STREAMING);
+            if (!asset) {
+                std::cerr << "Could not load texture from " << filename << std::endl;
+                return std::vector<uint8_t>();
+            }
+            std::vector<ktx_uint8_t> textureData(AAsset_getLength(asset));
+            AAsset_read(asset, textureData.data(), textureData.size());
+            AAsset_close(asset);
+            result = ktxTexture_CreateFromMemory(textureData.data(), textureData.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#else
+            result = ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+#endif
+        }
+        if (result != KTX_SUCCESS) {
+            std::cerr << "Could not load texture from " << filename << std::endl;
+            return std::vector<uint8_t>();
+        }
+
+        std::vector<uint8_t> levels;
+        uint32_t blockExtent, blockSize;
+        // KTX1 files are expected to hold RGBA8
+        if (prepareKtxTexture(device, ktxTexture, VK_FORMAT_R8G8B8A8_UNORM, format) != KTX_SUCCESS) {
+            std::cerr << "Could not transcode texture " << filename << std::endl;
+        } else if (!tools::getFormatBlock(format, blockExtent, blockSize)) {
+            std::cerr << "Texture " << filename << " has a format that can't be streamed" << std::endl;
+        } else {
+            // Only the first layer and face of each level is used, as in Texture::fromKtxTexture
+            VkDeviceSize totalSize;
+            std::vector<VkBufferImageCopy> regions = getPackedLevelRegions(ktxTexture->baseWidth, ktxTexture->baseHeight, ktxTexture->numLevels, format, totalSize);
+            levels.resize(totalSize);
+            for (uint32_t level = 0; level < ktxTexture->numLevels; level++) {
+                const VkDeviceSize levelSize = (level + 1 < ktxTexture->numLevels ? regions[level + 1].bufferOffset : totalSize) - regions[level].bufferOffset;
+                ktx_size_t offset;
+                if (ktxTexture_GetImageOffset(ktxTexture, level, 0, 0, &offset) != KTX_SUCCESS || ktxTexture_GetImageSize(ktxTexture, level) != levelSize) {
+                    std::cerr << "Texture " << filename << " has levels that aren't tightly packed" << std::endl;
+                    levels.clear();
+                    break;
+                }
+                memcpy(levels.data() + regions[level].bufferOffset, ktxTexture_GetData(ktxTexture) + offset, levelSize);
+            }
+            if (!levels.empty()) {
+                image.width = static_cast<int>(ktxTexture->baseWidth);
+                image.height = static_cast<int>(ktxTexture->baseHeight);
+                mipLevels = ktxTexture->numLevels;
+            }
+        }
+        ktxTexture_Destroy(ktxTexture);
+        return levels;
+    }
+
+    // What the materials use an image for, this decides the format it is compressed to
+    enum ImageUsage {
+        ImageUsageColor,
+        ImageUsageNormalMap,
+        ImageUsageMetallicRoughness,
+        ImageUsageCount
+    };
+    static const char* const imageUsageNames[ImageUsageCount] = { "color", "normal map", "metallic-roughness" };
+
+    static std::vector<ImageUsage> getImageUsages(const tinygltf::Model& gltfModel) {
+        std::vector<ImageUsage> usages(gltfModel.images.size(), ImageUsageColor);
+        auto setUsage = [&gltfModel, &usages](int textureIndex, ImageUsage usage) {
+            if (textureIndex < 0 || textureIndex >= static_cast<int>(gltfModel.textures.size())) {
+                return;
+            }
+            const int source = getTextureSource(gltfModel.textures[textureIndex]);
+            if (source >= 0 && source < static_cast<int>(usages.size())) {
+                usages[source] = usage;
+            }
+        };
+        // Normal maps win if an image is used both ways
+        for (const tinygltf::Material& material : gltfModel.materials) {
+            setUsage(material.pbrMetallicRoughness.metallicRoughnessTexture.index, ImageUsageMetallicRoughness);
+        }
+        for (const tinygltf::Material& material : gltfModel.materials) {
+            setUsage(material.normalTexture.index, ImageUsageNormalMap);
+        }
+        return usages;
+    }
+
+    static VkFormat getCompressedFormat(BlockCompression::Format format) {
+        switch (format) {
+            case BlockCompression::Format::BC1:
+                return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            case BlockCompression::Format::BC5:
+                return VK_FORMAT_BC5_UNORM_BLOCK;
+            default:
+                return VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+    }
+
+    static bool isOpaque(const uint8_t* rgba, size_t pixelCount) {
+        for (size_t i = 0; i < pixelCount; i++) {
+            if (rgba[i * 4 + 3] != 255) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Compresses every level of an RGBA8 chain from buildMipChain into a chain of the same layout,
+    // psnr is measured on the base level
+    static std::vector<uint8_t> compressMipChain(const std::vector<uint8_t>& levels, uint32_t width, uint32_t height, uint32_t mipLevels, BlockCompression::Format format, double& psnr) {
+        VkDeviceSize size;
+        std::vector<VkBufferImageCopy> regions = getPackedLevelRegions(width, height, mipLevels, VK_FORMAT_R8G8B8A8_UNORM, size);
+        VkDeviceSize compressedSize;
+        std::vector<VkBufferImageCopy> compressedRegions = getPackedLevelRegions(width, height, mipLevels, getCompressedFormat(format), compressedSize);
+        std::vector<uint8_t> compressed(compressedSize);
+        for (uint32_t level = 0; level < mipLevels; level++) {
+            BlockCompression::encode(format, levels.data() + regions[level].bufferOffset,
+                    regions[level].imageExtent.width, regions[level].imageExtent.height,
+                    compressed.data() + compressedRegions[level].bufferOffset);
+        }
+        std::vector<uint8_t> decoded(static_cast<size_t>(width) * height * 4);
+        BlockCompression::decode(format, compressed.data(), width, height, decoded.data());
+        psnr = BlockCompression::psnr(format, levels.data(), decoded.data(), width, height);
+        return compressed;
+    }
+
     Texture* VulkanglTFModel::getTexture(uint32_t index)
     {
 
@@ -724,7 +853,7 @@ namespace VulkanLearning {
         samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
         samplerCreateInfo.maxAnisotropy = 1.0f;
-        VK_CHECK_RESULT(vkCreateSampler(device->getLogicalDevice(), &samplerCreateInfo, nullptr, &emptyTexture.sampler));
+        emptyTexture.sampler = device->getSampler(samplerCreateInfo);
 
         //VkImageViewCreateInfo viewCreateInfo = vks::initializers::imageViewCreateInfo();
         VkImageViewCreateInfo viewCreateInfo = {};
@@ -745,19 +874,32 @@ namespace VulkanLearning {
     /*
        glTF model loading and rendering class
        */
+    VulkanglTFModel::VulkanglTFModel() {}
+
     VulkanglTFModel::~VulkanglTFModel()
     {
+        // Joins the loader threads and waits for the last upload before the images go away
+        textureStreaming.reset();
         vertices.buffer.cleanup();
         indices.buffer.cleanup();
+        if (separatePositions) {
+            positions.buffer.cleanup();
+        }
+        if (meshlets.count > 0) {
+            meshlets.buffer.cleanup();
+            meshlets.indices.cleanup();
+        }
         for (auto texture : textures) {
             texture.destroy();
         }
         for (auto node : nodes) {
             delete node;
         }
-        if (descriptorSetLayoutUbo != VK_NULL_HANDLE) {
-            vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayoutUbo, nullptr);
-            descriptorSetLayoutUbo = VK_NULL_HANDLE;
+        nodeTransforms.buffer.unmap();
+        nodeTransforms.buffer.cleanup();
+        if (descriptorSetLayoutNodeTransforms != VK_NULL_HANDLE) {
+            vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayoutNodeTransforms, nullptr);
+            descriptorSetLayoutNodeTransforms = VK_NULL_HANDLE;
         }
         if (descriptorSetLayoutImage != VK_NULL_HANDLE) {
             vkDestroyDescriptorSetLayout(device->getLogicalDevice(), descriptorSetLayoutImage, nullptr);
@@ -809,13 +951,28 @@ namespace VulkanLearning {
         // Node contains mesh data
         if (node.mesh > -1) {
             const tinygltf::Mesh mesh = model.meshes[node.mesh];
-            Mesh *newMesh = new Mesh(device, newNode->matrix);
+            Mesh *newMesh = new Mesh(device);
             newMesh->name = mesh.name;
             for (size_t j = 0; j < mesh.primitives.size(); j++) {
                 const tinygltf::Primitive &primitive = mesh.primitives[j];
                 if (primitive.indices < 0) {
                     continue;
                 }
+                Material& material = primitive.material > -1 ? materials[primitive.material] : materials.back();
+                if (!cookedPrimitives.empty()) {
+                    // Ranges and LODs of the geometry in the asset cache, nothing has to be decoded
+                    if (nextCookedPrimitive < cookedPrimitives.size()) {
+                        const CookedPrimitive& cooked = cookedPrimitives[nextCookedPrimitive++];
+                        Primitive *newPrimitive = new Primitive(cooked.firstIndex, cooked.indexCount, material);
+                        newPrimitive->firstVertex = cooked.firstVertex;
+                        newPrimitive->vertexCount = cooked.vertexCount;
+                        newPrimitive->setDimensions(cooked.min, cooked.max);
+                        newPrimitive->renderPass = getRenderPass(material);
+                        newPrimitive->lods.assign(cookedLods.begin() + cooked.firstLod, cookedLods.begin() + cooked.firstLod + cooked.lodCount);
+                        newMesh->primitives.push_back(newPrimitive);
+                    }
+                    continue;
+                }
                 uint32_t indexStart = static_cast<uint32_t>(indexBuffer.size());
                 uint32_t vertexStart = static_cast<uint32_t>(vertexBuffer.size());
                 uint32_t indexCount = 0;
@@ -825,134 +982,90 @@ namespace VulkanLearning {
                 bool hasSkin = false;
                 // Vertices
                 {
-                    const float *bufferPos = nullptr;
-                    const float *bufferNormals = nullptr;
-                    const float *bufferTexCoords = nullptr;
-                    const float* bufferColors = nullptr;
-                    const float *bufferTangents = nullptr;
-                    uint32_t numColorComponents;
-                    const uint16_t *bufferJoints = nullptr;
-                    const float *bufferWeights = nullptr;
-
                     // Position attribute is required
                     assert(primitive.attributes.find("POSITION") != primitive.attributes.end());
 
                     const tinygltf::Accessor &posAccessor = model.accessors[primitive.attributes.find("POSITION")->second];
-                    const tinygltf::BufferView &posView = model.bufferViews[posAccessor.bufferView];
-                    bufferPos = reinterpret_cast<const float *>(&(model.buffers[posView.buffer].data[posAccessor.byteOffset + posView.byteOffset]));
                     posMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
                     posMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+                    vertexCount = static_cast<uint32_t>(posAccessor.count);
 
-                    if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-                        const tinygltf::Accessor &normAccessor = model.accessors[primitive.attributes.find("NORMAL")->second];
-                        const tinygltf::BufferView &normView = model.bufferViews[normAccessor.bufferView];
-                        bufferNormals = reinterpret_cast<const float *>(&(model.buffers[normView.buffer].data[normAccessor.byteOffset + normView.byteOffset]));
-                    }
-
-                    if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-                        const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("TEXCOORD_0")->second];
-                        const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-                        bufferTexCoords = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-                    }
-
-                    if (primitive.attributes.find("COLOR_0") != primitive.attributes.end())
-                    {
-                        const tinygltf::Accessor& colorAccessor = model.accessors[primitive.attributes.find("COLOR_0")->second];
-                        const tinygltf::BufferView& colorView = model.bufferViews[colorAccessor.bufferView];
-                        // Color buffer are either of type vec3 or vec4
-                        numColorComponents = colorAccessor.type == TINYGLTF_PARAMETER_TYPE_FLOAT_VEC3 ? 3 : 4;
-                        bufferColors = reinterpret_cast<const float*>(&(model.buffers[colorView.buffer].data[colorAccessor.byteOffset + colorView.byteOffset]));
-                    }
+                    // Attributes missing from the primitive keep these values
+                    Vertex defaultVertex;
+                    defaultVertex.pos = glm::vec3(0.0f);
+                    defaultVertex.normal = glm::vec3(0.0f);
+                    defaultVertex.uv = glm::vec2(0.0f);
+                    defaultVertex.color = glm::vec4(1.0f);
+                    defaultVertex.joint0 = glm::vec4(0.0f);
+                    defaultVertex.weight0 = glm::vec4(0.0f);
+                    defaultVertex.tangent = glm::vec4(0.0f);
+                    vertexBuffer.resize(vertexStart + vertexCount, defaultVertex);
+                    Vertex* vertices = &vertexBuffer[vertexStart];
+
+                    // Every attribute is written straight into its slot of the interleaved vertices
+                    auto readAttribute = [&](const char* name, float* dst, uint32_t components) {
+                        auto attribute = primitive.attributes.find(name);
+                        if (attribute == primitive.attributes.end()) {
+                            return false;
+                        }
+                        return readAccessor(model, model.accessors[attribute->second], dst, sizeof(Vertex), components, &decodedAccessorBytes);
+                    };
 
-                    if (primitive.attributes.find("TANGENT") != primitive.attributes.end())
-                    {
-                        const tinygltf::Accessor &tangentAccessor = model.accessors[primitive.attributes.find("TANGENT")->second];
-                        const tinygltf::BufferView &tangentView = model.bufferViews[tangentAccessor.bufferView];
-                        bufferTangents = reinterpret_cast<const float *>(&(model.buffers[tangentView.buffer].data[tangentAccessor.byteOffset + tangentView.byteOffset]));
+                    readAttribute("POSITION", glm::value_ptr(vertices[0].pos), 3);
+                    if (readAttribute("NORMAL", glm::value_ptr(vertices[0].normal), 3)) {
+                        for (uint32_t v = 0; v < vertexCount; v++) {
+                            vertices[v].normal = glm::normalize(vertices[v].normal);
+                        }
                     }
+                    readAttribute("TEXCOORD_0", glm::value_ptr(vertices[0].uv), 2);
+                    // Color buffer are either of type vec3 or vec4, alpha stays at 1 for vec3
+                    readAttribute("COLOR_0", glm::value_ptr(vertices[0].color), 4);
+                    readAttribute("TANGENT", glm::value_ptr(vertices[0].tangent), 4);
 
                     // Skinning
-                    // Joints
-                    if (primitive.attributes.find("JOINTS_0") != primitive.attributes.end()) {
-                        const tinygltf::Accessor &jointAccessor = model.accessors[primitive.attributes.find("JOINTS_0")->second];
-                        const tinygltf::BufferView &jointView = model.bufferViews[jointAccessor.bufferView];
-                        bufferJoints = reinterpret_cast<const uint16_t *>(&(model.buffers[jointView.buffer].data[jointAccessor.byteOffset + jointView.byteOffset]));
-                    }
-
-                    if (primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end()) {
-                        const tinygltf::Accessor &uvAccessor = model.accessors[primitive.attributes.find("WEIGHTS_0")->second];
-                        const tinygltf::BufferView &uvView = model.bufferViews[uvAccessor.bufferView];
-                        bufferWeights = reinterpret_cast<const float *>(&(model.buffers[uvView.buffer].data[uvAccessor.byteOffset + uvView.byteOffset]));
-                    }
-
-                    hasSkin = (bufferJoints && bufferWeights);
-
-                    vertexCount = static_cast<uint32_t>(posAccessor.count);
-
-                    for (size_t v = 0; v < posAccessor.count; v++) {
-                        Vertex vert{};
-                        vert.pos = glm::vec4(glm::make_vec3(&bufferPos[v * 3]), 1.0f);
-                        vert.normal = glm::normalize(glm::vec3(bufferNormals ? glm::make_vec3(&bufferNormals[v * 3]) : glm::vec3(0.0f)));
-                        vert.uv = bufferTexCoords ? glm::make_vec2(&bufferTexCoords[v * 2]) : glm::vec3(0.0f);
-                        if (bufferColors) {
-                            switch (numColorComponents) {
-                                case 3:
-                                    vert.color = glm::vec4(glm::make_vec3(&bufferColors[v * 3]), 1.0f);
-                                case 4:
-                                    vert.color = glm::make_vec4(&bufferColors[v * 4]);
-                            }
-                        }
-                        else {
-                            vert.color = glm::vec4(1.0f);
-                        }
-                        vert.tangent = bufferTangents ? glm::vec4(glm::make_vec4(&bufferTangents[v * 4])) : glm::vec4(0.0f);
-                        vert.joint0 = hasSkin ? glm::vec4(glm::make_vec4(&bufferJoints[v * 4])) : glm::vec4(0.0f);
-                        vert.weight0 = hasSkin ? glm::make_vec4(&bufferWeights[v * 4]) : glm::vec4(0.0f);
-                        vertexBuffer.push_back(vert);
+                    hasSkin = primitive.attributes.find("JOINTS_0") != primitive.attributes.end()
+                        && primitive.attributes.find("WEIGHTS_0") != primitive.attributes.end();
+                    if (hasSkin) {
+                        readAttribute("JOINTS_0", glm::value_ptr(vertices[0].joint0), 4);
+                        readAttribute("WEIGHTS_0", glm::value_ptr(vertices[0].weight0), 4);
                     }
                 }
                 // Indices
                 {
                     const tinygltf::Accessor &accessor = model.accessors[primitive.indices];
-                    const tinygltf::BufferView &bufferView = model.bufferViews[accessor.bufferView];
-                    const tinygltf::Buffer &buffer = model.buffers[bufferView.buffer];
 
                     indexCount = static_cast<uint32_t>(accessor.count);
-
-                    switch (accessor.componentType) {
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                                                                       uint32_t *buf = new uint32_t[accessor.count];
-                                                                       memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-                                                                       for (size_t index = 0; index < accessor.count; index++) {
-                                                                           indexBuffer.push_back(buf[index] + vertexStart);
-                                                                       }
-                                                                       break;
-                                                                   }
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                                                                         uint16_t *buf = new uint16_t[accessor.count];
-                                                                         memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-                                                                         for (size_t index = 0; index < accessor.count; index++) {
-                                                                             indexBuffer.push_back(buf[index] + vertexStart);
-                                                                         }
-                                                                         break;
-                                                                     }
-                        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-                                                                        uint8_t *buf = new uint8_t[accessor.count];
-                                                                        memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-                                                                        for (size_t index = 0; index < accessor.count; index++) {
-                                                                            indexBuffer.push_back(buf[index] + vertexStart);
-                                                                        }
-                                                                        break;
-                                                                    }
-                        default:
-                                                                    std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-                                                                    return;
+                    indexBuffer.resize(indexStart + indexCount);
+                    // Optimized primitives are processed with local indices and offset afterwards
+                    const bool optimize = optimizeMeshes && primitive.mode == TINYGLTF_MODE_TRIANGLES;
+                    if (!readIndices(model, accessor, &indexBuffer[indexStart], optimize ? 0 : vertexStart, &decodedAccessorBytes)) {
+                        indexBuffer.resize(indexStart);
+                        return;
+                    }
+                    if (optimize) {
+                        MeshOptimizer::VertexCacheStatistics before, after;
+                        vertexCount = static_cast<uint32_t>(MeshOptimizer::optimizeMesh(
+                                    &indexBuffer[indexStart], indexCount,
+                                    &vertexBuffer[vertexStart], vertexCount, sizeof(Vertex), offsetof(Vertex, pos),
+                                    &before, &after));
+                        vertexBuffer.resize(vertexStart + vertexCount);
+                        for (uint32_t i = indexStart; i < indexStart + indexCount; i++) {
+                            indexBuffer[i] += vertexStart;
+                        }
+                        cacheStatisticsBefore += before;
+                        cacheStatisticsAfter += after;
                     }
                 }
-                Primitive *newPrimitive = new Primitive(indexStart, indexCount, primitive.material > -1 ? materials[primitive.material] : materials.back());
+                Primitive *newPrimitive = new Primitive(indexStart, indexCount, material);
                 newPrimitive->firstVertex = vertexStart;
                 newPrimitive->vertexCount = vertexCount;
                 newPrimitive->setDimensions(posMin, posMax);
+                newPrimitive->renderPass = getRenderPass(material);
+                if (generateLods && primitive.mode == TINYGLTF_MODE_TRIANGLES) {
+                    generatePrimitiveLods(indexBuffer, vertexBuffer, indexStart, indexCount, vertexStart, vertexCount, maxLodCount, newPrimitive->lods);
+                } else {
+                    newPrimitive->lods.push_back({ indexStart, indexCount, 0.0f });
+                }
                 newMesh->primitives.push_back(newPrimitive);
             }
             newNode->mesh = newMesh;
@@ -997,13 +1110,139 @@ namespace VulkanLearning {
         }
     }
 
-    void VulkanglTFModel::loadImages(tinygltf::Model &gltfModel, VulkanDevice *device, VkQueue transferQueue)
+    void VulkanglTFModel::loadImages(tinygltf::Model &gltfModel, VulkanDevice *device, VkQueue transferQueue, AssetCache::Writer* cookWriter)
     {
-        for (tinygltf::Image &image : gltfModel.images) {
-            Texture texture;
-            texture.fromglTFImage(image, path, device, transferQueue);
-            textures.push_back(texture);
+        auto tStart = std::chrono::high_resolution_clock::now();
+
+        // Images are decoded on the worker pool and uploaded here in the order they finish
+        textures.resize(gltfModel.images.size());
+        CompletionQueue decodedImages;
+        ThreadPool threadPool(imageLoadingThreadCount);
+        // When cooking, the workers also build the mip chains that go into the cache
+        std::vector<std::vector<uint8_t>> mipChains(cookWriter ? gltfModel.images.size() : 0);
+        std::vector<uint32_t> mipChainLevels(mipChains.size());
+        // With compressTextures they replace the chains by their BC version, so that is only paid once
+        struct ImageCompression {
+            VkFormat format = VK_FORMAT_R8G8B8A8_UNORM;
+            VkDeviceSize sourceSize = 0;
+            double psnr = 0.0;
+            double milliseconds = 0.0;
+        };
+        const bool compress = cookWriter && compressTextures;
+        const std::vector<ImageUsage> imageUsages = compress ? getImageUsages(gltfModel) : std::vector<ImageUsage>();
+        std::vector<ImageCompression> imageCompressions(compress ? gltfModel.images.size() : 0);
+        // Ktx files are parsed and, for Basis Universal, transcoded by the workers as well
+        std::vector<ktxTexture*> ktxTextures(gltfModel.images.size(), nullptr);
+        std::vector<VkFormat> ktxFormats(gltfModel.images.size(), VK_FORMAT_UNDEFINED);
+        for (size_t i = 0; i < gltfModel.images.size(); i++) {
+            tinygltf::Image* image = &gltfModel.images[i];
+            threadPool.push([this, image, i, device, cookWriter, compress, &imageUsages, &imageCompressions, &mipChains, &mipChainLevels, &ktxTextures, &ktxFormats, &decodedImages]() {
+                decodeImageData(image, static_cast<int>(i), path);
+                if (isKtxImage(*image)) {
+                    // Failures are left to fromglTFImage, which reports them
+                    if (!image->image.empty() && ktxTexture_CreateFromMemory(image->image.data(), image->image.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTextures[i]) == KTX_SUCCESS
+                            && prepareKtxTexture(device, ktxTextures[i], VK_FORMAT_R8G8B8A8_UNORM, ktxFormats[i]) != KTX_SUCCESS) {
+                        ktxTexture_Destroy(ktxTextures[i]);
+                        ktxTextures[i] = nullptr;
+                    }
+                } else if (cookWriter) {
+                    mipChains[i] = buildMipChain(*image, mipChainLevels[i]);
+                    if (compress && !mipChains[i].empty()) {
+                        auto tCompressStart = std::chrono::high_resolution_clock::now();
+                        const uint32_t width = static_cast<uint32_t>(image->width);
+                        const uint32_t height = static_cast<uint32_t>(image->height);
+                        // Normal maps keep Z in blue and metallic-roughness keeps metallic there, both stay BC7 unless BC5 is asked for
+                        BlockCompression::Format format = BlockCompression::Format::BC7;
+                        if (imageUsages[i] == ImageUsageNormalMap && compressNormalMapsToBC5) {
+                            format = BlockCompression::Format::BC5;
+                        } else if (imageUsages[i] == ImageUsageColor && compressColorToBC1 && isOpaque(mipChains[i].data(), static_cast<size_t>(width) * height)) {
+                            format = BlockCompression::Format::BC1;
+                        }
+                        ImageCompression& compression = imageCompressions[i];
+                        compression.sourceSize = mipChains[i].size();
+                        mipChains[i] = compressMipChain(mipChains[i], width, height, mipChainLevels[i], format, compression.psnr);
+                        compression.format = getCompressedFormat(format);
+                        compression.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - tCompressStart).count();
+                    }
+                }
+                decodedImages.push(i);
+            });
+        }
+        // All uploads and mip chains go through a single submission
+        VulkanTextureBatch uploadBatch(device, transferQueue);
+        cookedTextures.assign(cookWriter ? gltfModel.images.size() : 0, CookedTexture{});
+        for (size_t i = 0; i < gltfModel.images.size(); i++) {
+            size_t imageIndex = decodedImages.pop();
+            if (cookWriter && !mipChains[imageIndex].empty()) {
+                const tinygltf::Image& image = gltfModel.images[imageIndex];
+                const std::vector<uint8_t>& levels = mipChains[imageIndex];
+                CookedTexture& cooked = cookedTextures[imageIndex];
+                cooked.width = static_cast<uint32_t>(image.width);
+                cooked.height = static_cast<uint32_t>(image.height);
+                cooked.mipLevels = mipChainLevels[imageIndex];
+                cooked.format = compress ? imageCompressions[imageIndex].format : VK_FORMAT_R8G8B8A8_UNORM;
+                VkDeviceSize size;
+                std::vector<VkBufferImageCopy> regions = getPackedLevelRegions(cooked.width, cooked.height, cooked.mipLevels, static_cast<VkFormat>(cooked.format), size);
+                textures[imageIndex].fromPixels(levels.data(), size, static_cast<VkFormat>(cooked.format), cooked.width, cooked.height, cooked.mipLevels, regions, device, transferQueue, &uploadBatch);
+                cookWriter->align(16);
+                cooked.offset = cookWriter->tell();
+                cooked.size = size;
+                cookWriter->write(levels.data(), levels.size());
+                std::vector<uint8_t>().swap(mipChains[imageIndex]);
+            } else if (ktxTextures[imageIndex]) {
+                textures[imageIndex].fromKtxTexture(ktxTextures[imageIndex], ktxFormats[imageIndex], device, transferQueue, &uploadBatch);
+                ktxTexture_Destroy(ktxTextures[imageIndex]);
+            } else {
+                textures[imageIndex].fromglTFImage(gltfModel.images[imageIndex], path, device, transferQueue, &uploadBatch);
+            }
+            // Pixels are in the staging buffers now
+            std::vector<unsigned char>().swap(gltfModel.images[imageIndex].image);
+        }
+        uploadBatch.flush();
+
+        auto tEnd = std::chrono::high_resolution_clock::now();
+        if (verbose) {
+            std::cout << "Loaded " << gltfModel.images.size() << " glTF images using " << threadPool.getThreadCount() << " threads in "
+                << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << " ms" << std::endl;
+        }
+
+        if (compress) {
+            // Worker time per pixel of all levels, the error per usage is the mean of the base levels
+            double megapixels = 0.0, milliseconds = 0.0;
+            VkDeviceSize sourceSize = 0, compressedSize = 0;
+            uint32_t usageCounts[ImageUsageCount] = {};
+            double usagePsnr[ImageUsageCount] = {};
+            VkDeviceSize usageSourceSizes[ImageUsageCount] = {};
+            VkDeviceSize usageCompressedSizes[ImageUsageCount] = {};
+            for (size_t i = 0; i < imageCompressions.size(); i++) {
+                const ImageCompression& compression = imageCompressions[i];
+                if (compression.sourceSize == 0) {
+                    continue;
+                }
+                megapixels += compression.sourceSize / (4.0 * 1000000.0);
+                milliseconds += compression.milliseconds;
+                usageCounts[imageUsages[i]]++;
+                usagePsnr[imageUsages[i]] += compression.psnr;
+                usageSourceSizes[imageUsages[i]] += compression.sourceSize;
+                usageCompressedSizes[imageUsages[i]] += cookedTextures[i].size;
+                sourceSize += compression.sourceSize;
+                compressedSize += cookedTextures[i].size;
+            }
+            if (verbose && sourceSize > 0) {
+                std::cout << "Compressed glTF images at " << megapixels / (milliseconds / 1000.0) << " Mpixels/s per thread ("
+                    << megapixels << " Mpixels in " << milliseconds << " ms of worker time)" << std::endl;
+                for (uint32_t usage = 0; usage < ImageUsageCount; usage++) {
+                    if (usageCounts[usage] > 0) {
+                        std::cout << "  " << imageUsageNames[usage] << ": " << usageCounts[usage] << " images, "
+                            << usageSourceSizes[usage] / (1024.0 * 1024.0) << " MB -> " << usageCompressedSizes[usage] / (1024.0 * 1024.0) << " MB, PSNR "
+                            << usagePsnr[usage] / usageCounts[usage] << " dB" << std::endl;
+                    }
+                }
+                std::cout << "Texture memory " << sourceSize / (1024.0 * 1024.0) << " MB -> " << compressedSize / (1024.0 * 1024.0) << " MB ("
+                    << 100.0 * compressedSize / sourceSize << "%)" << std::endl;
+            }
         }
+
         // Create an empty texture to be used for empty material images
         createEmptyTexture(transferQueue);
     }
@@ -1013,11 +1252,11 @@ namespace VulkanLearning {
         for (tinygltf::Material &mat : gltfModel.materials) {
             Material material(device);
             if (mat.values.find("baseColorTexture") != mat.values.end()) {
-                material.baseColorTexture = getTexture(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()].source);
+                material.baseColorTexture = getTexture(getTextureSource(gltfModel.textures[mat.values["baseColorTexture"].TextureIndex()]));
             }
             // Metallic roughness workflow
             if (mat.values.find("metallicRoughnessTexture") != mat.values.end()) {
-                material.metallicRoughnessTexture = getTexture(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()].source);
+                material.metallicRoughnessTexture = getTexture(getTextureSource(gltfModel.textures[mat.values["metallicRoughnessTexture"].TextureIndex()]));
             }
             if (mat.values.find("roughnessFactor") != mat.values.end()) {
                 material.roughnessFactor = static_cast<float>(mat.values["roughnessFactor"].Factor());
@@ -1029,15 +1268,15 @@ namespace VulkanLearning {
                 material.baseColorFactor = glm::make_vec4(mat.values["baseColorFactor"].ColorFactor().data());
             }
             if (mat.additionalValues.find("normalTexture") != mat.additionalValues.end()) {
-                material.normalTexture = getTexture(gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()].source);
+                material.normalTexture = getTexture(getTextureSource(gltfModel.textures[mat.additionalValues["normalTexture"].TextureIndex()]));
             } else {
                 material.normalTexture = &emptyTexture;
             }
             if (mat.additionalValues.find("emissiveTexture") != mat.additionalValues.end()) {
-                material.emissiveTexture = getTexture(gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()].source);
+                material.emissiveTexture = getTexture(getTextureSource(gltfModel.textures[mat.additionalValues["emissiveTexture"].TextureIndex()]));
             }
             if (mat.additionalValues.find("occlusionTexture") != mat.additionalValues.end()) {
-                material.occlusionTexture = getTexture(gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()].source);
+                material.occlusionTexture = getTexture(getTextureSource(gltfModel.textures[mat.additionalValues["occlusionTexture"].TextureIndex()]));
             }
             if (mat.additionalValues.find("alphaMode") != mat.additionalValues.end()) {
                 tinygltf::Parameter param = mat.additionalValues["alphaMode"];
@@ -1082,59 +1321,47 @@ namespace VulkanLearning {
                 }
 
                 // Read sampler input time values
-                {
-                    const tinygltf::Accessor &accessor = gltfModel.accessors[samp.input];
-                    const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-                    const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-                    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-                    float *buf = new float[accessor.count];
-                    memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(float));
-                    for (size_t index = 0; index < accessor.count; index++) {
-                        sampler.inputs.push_back(buf[index]);
-                    }
-
-                    for (auto input : sampler.inputs) {
-                        if (input < animation.start) {
-                            animation.start = input;
-                        };
-                        if (input > animation.end) {
-                            animation.end = input;
-                        }
+                const tinygltf::Accessor &inputAccessor = gltfModel.accessors[samp.input];
+                sampler.inputs.resize(inputAccessor.count);
+                if (!readAccessor(gltfModel, inputAccessor, sampler.inputs.data(), sizeof(float), 1)) {
+                    sampler.inputs.clear();
+                }
+                for (auto input : sampler.inputs) {
+                    if (input < animation.start) {
+                        animation.start = input;
+                    };
+                    if (input > animation.end) {
+                        animation.end = input;
                     }
                 }
 
-                // Read sampler output T/R/S values
-                {
-                    const tinygltf::Accessor &accessor = gltfModel.accessors[samp.output];
-                    const tinygltf::BufferView &bufferView = gltfModel.bufferViews[accessor.bufferView];
-                    const tinygltf::Buffer &buffer = gltfModel.buffers[bufferView.buffer];
-
-                    assert(accessor.componentType == TINYGLTF_COMPONENT_TYPE_FLOAT);
-
-                    switch (accessor.type) {
-                        case TINYGLTF_TYPE_VEC3: {
-                                                     glm::vec3 *buf = new glm::vec3[accessor.count];
-                                                     memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec3));
-                                                     for (size_t index = 0; index < accessor.count; index++) {
-                                                         sampler.outputsVec4.push_back(glm::vec4(buf[index], 0.0f));
-                                                     }
-                                                     break;
-                                                 }
-                        case TINYGLTF_TYPE_VEC4: {
-                                                     glm::vec4 *buf = new glm::vec4[accessor.count];
-                                                     memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(glm::vec4));
-                                                     for (size_t index = 0; index < accessor.count; index++) {
-                                                         sampler.outputsVec4.push_back(buf[index]);
-                                                     }
-                                                     break;
-                                                 }
-                        default: {
-                                     std::cout << "unknown type" << std::endl;
-                                     break;
-                                 }
+                // Read sampler output T/R/S values, cubic splines store in tangent, value and out tangent per key
+                const tinygltf::Accessor &outputAccessor = gltfModel.accessors[samp.output];
+                sampler.components = outputAccessor.type == TINYGLTF_TYPE_VEC3 ? 3 : 4;
+                if (outputAccessor.type != TINYGLTF_TYPE_VEC3 && outputAccessor.type != TINYGLTF_TYPE_VEC4) {
+                    std::cout << "unknown type" << std::endl;
+                }
+                std::vector<float> outputs(outputAccessor.count * sampler.components);
+                if (!readAccessor(gltfModel, outputAccessor, outputs.data(), sampler.components * sizeof(float), sampler.components)) {
+                    outputs.clear();
+                }
+                const size_t keyCount = sampler.inputs.size();
+                const size_t keySize = sampler.components;
+                if (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE && outputs.size() >= keyCount * keySize * 3) {
+                    sampler.inTangents.resize(keyCount * keySize);
+                    sampler.values.resize(keyCount * keySize);
+                    sampler.outTangents.resize(keyCount * keySize);
+                    for (size_t key = 0; key < keyCount; key++) {
+                        const float* source = &outputs[key * keySize * 3];
+                        memcpy(&sampler.inTangents[key * keySize], source, keySize * sizeof(float));
+                        memcpy(&sampler.values[key * keySize], source + keySize, keySize * sizeof(float));
+                        memcpy(&sampler.outTangents[key * keySize], source + keySize * 2, keySize * sizeof(float));
+                    }
+                } else {
+                    if (sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE) {
+                        sampler.interpolation = AnimationSampler::InterpolationType::LINEAR;
                     }
+                    sampler.values.swap(outputs);
                 }
 
                 animation.samplers.push_back(sampler);
@@ -1170,11 +1397,663 @@ namespace VulkanLearning {
         }
     }
 
+    void VulkanglTFModel::buildMeshlets(const std::vector<uint32_t>& indexBuffer, const std::vector<Vertex>& vertexBuffer)
+    {
+        auto tStart = std::chrono::high_resolution_clock::now();
+        std::vector<MeshletData> meshletData;
+        std::vector<uint32_t> meshletIndices;
+        std::vector<uint32_t> localIndices;
+        std::vector<MeshOptimizer::Meshlet> primitiveMeshlets;
+        std::vector<uint32_t> meshletVertices;
+        std::vector<uint8_t> meshletTriangles;
+
+        meshlets.drawCount = 0;
+        for (Node* node : linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            for (Primitive* primitive : node->mesh->primitives) {
+                const Primitive::Lod& full = primitive->lods[0];
+                if (full.indexCount == 0) {
+                    continue;
+                }
+                localIndices.assign(indexBuffer.begin() + full.firstIndex, indexBuffer.begin() + full.firstIndex + full.indexCount);
+                for (uint32_t& index : localIndices) {
+                    index -= primitive->firstVertex;
+                }
+                primitiveMeshlets.clear();
+                meshletVertices.clear();
+                meshletTriangles.clear();
+                MeshOptimizer::buildMeshlets(primitiveMeshlets, meshletVertices, meshletTriangles,
+                        localIndices.data(), localIndices.size(), primitive->vertexCount, maxMeshletVertices, maxMeshletTriangles);
+
+                primitive->firstMeshlet = static_cast<uint32_t>(meshletData.size());
+                primitive->meshletCount = static_cast<uint32_t>(primitiveMeshlets.size());
+                primitive->meshletDrawIndex = meshlets.drawCount++;
+                primitive->meshletFirstIndex = static_cast<uint32_t>(meshletIndices.size());
+                const float* positions = glm::value_ptr(vertexBuffer[primitive->firstVertex].pos);
+                for (const MeshOptimizer::Meshlet& meshlet : primitiveMeshlets) {
+                    MeshOptimizer::MeshletBounds bounds = MeshOptimizer::computeMeshletBounds(
+                            meshlet, meshletVertices.data(), meshletTriangles.data(), positions, sizeof(Vertex));
+                    MeshletData data{};
+                    data.sphere = glm::vec4(glm::make_vec3(bounds.center), bounds.radius);
+                    data.cone = glm::vec4(glm::make_vec3(bounds.coneAxis), bounds.coneCutoff);
+                    data.firstIndex = static_cast<uint32_t>(meshletIndices.size());
+                    data.indexCount = meshlet.triangleCount * 3;
+                    data.drawIndex = primitive->meshletDrawIndex;
+                    meshletData.push_back(data);
+                    for (uint32_t i = 0; i < meshlet.triangleCount * 3; i++) {
+                        uint8_t localIndex = meshletTriangles[meshlet.triangleOffset * 3 + i];
+                        meshletIndices.push_back(meshletVertices[meshlet.vertexOffset + localIndex] + primitive->firstVertex);
+                    }
+                }
+            }
+        }
+        if (meshletData.empty()) {
+            return;
+        }
+
+        meshlets.count = static_cast<uint32_t>(meshletData.size());
+        meshlets.indexCount = static_cast<uint32_t>(meshletIndices.size());
+        meshlets.buffer = VulkanBuffer(*device);
+        meshlets.buffer.createWithStagingBuffer(meshletData, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        meshlets.indices = VulkanBuffer(*device);
+        meshlets.indices.createWithStagingBuffer(meshletIndices, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+        auto tEnd = std::chrono::high_resolution_clock::now();
+        if (verbose) {
+            std::cout << "Built " << meshlets.count << " meshlets (" << meshlets.indexCount / 3 / meshlets.count << " triangles on average) in "
+                << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << " ms" << std::endl;
+        }
+    }
+
+    /*
+       Asset cache: a header, the texture and geometry blobs aligned to 16 bytes, then the tables
+       */
+    static const uint32_t kAssetCacheMagic = 0x43414c56;
+    // Bumped whenever the layout or the cooked data changes
+    static const uint32_t kAssetCacheVersion = 1;
+
+    struct AssetCacheHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        // Written last, once the blobs are in the file
+        uint64_t tableOffset;
+    };
+
+    uint64_t VulkanglTFModel::getAssetCacheKey(const std::string& filename, uint32_t fileLoadingFlags, float scale)
+    {
+        AssetCache::MappedFile source;
+        if (!source.open(filename)) {
+            return 0;
+        }
+        uint64_t key = AssetCache::hash(source.data(), source.size());
+        key = AssetCache::hashValue(kAssetCacheVersion, key);
+        // Animations, texture residency and the cache itself don't change the cooked data
+        key = AssetCache::hashValue(fileLoadingFlags & ~(FileLoadingFlags::UseAssetCache | FileLoadingFlags::CompressAnimations | FileLoadingFlags::ManageTextureResidency), key);
+        key = AssetCache::hashValue(maxLodCount, key);
+        key = AssetCache::hashValue(scale, key);
+        if (fileLoadingFlags & FileLoadingFlags::CompressTextures) {
+            key = AssetCache::hashValue(static_cast<uint32_t>(compressColorToBC1), key);
+            key = AssetCache::hashValue(static_cast<uint32_t>(compressNormalMapsToBC5), key);
+        }
+        return key;
+    }
+
+    bool VulkanglTFModel::readAssetCache(const AssetCache::MappedFile& file, uint64_t key, CookedGeometry& geometry, std::vector<glm::mat4>& meshDequantizations)
+    {
+        AssetCache::Reader reader(file.data(), file.size());
+        const AssetCacheHeader header = reader.readValue<AssetCacheHeader>();
+        if (!reader.good() || header.magic != kAssetCacheMagic || header.version != kAssetCacheVersion || header.key != key || !reader.seek(header.tableOffset)) {
+            return false;
+        }
+
+        // Buffers and images the glTF file references, the key only covers the glTF file itself
+        const uint32_t dependencyCount = reader.readValue<uint32_t>();
+        for (uint32_t i = 0; i < dependencyCount && reader.good(); i++) {
+            const std::string uri = reader.readString();
+            const uint64_t size = reader.readValue<uint64_t>();
+            const int64_t modificationTime = reader.readValue<int64_t>();
+            uint64_t currentSize;
+            int64_t currentModificationTime;
+            if (!AssetCache::fileStamp(path + "/" + uri, currentSize, currentModificationTime) || currentSize != size || currentModificationTime != modificationTime) {
+                return false;
+            }
+        }
+
+        reader.readArray(cookedTextures);
+        geometry = reader.readValue<CookedGeometry>();
+        reader.readArray(cookedPrimitives);
+        reader.readArray(cookedLods);
+        reader.readArray(meshDequantizations);
+        if (!reader.good()) {
+            return false;
+        }
+
+        // Every range has to lie within the file
+        if (!reader.view(geometry.vertexOffset, geometry.vertexCount * geometry.vertexStride)
+                || !reader.view(geometry.indexOffset, geometry.indexCount * sizeof(uint32_t))) {
+            return false;
+        }
+        for (const CookedTexture& texture : cookedTextures) {
+            if (texture.mipLevels > 0 && !reader.view(texture.offset, texture.size)) {
+                return false;
+            }
+        }
+        for (const CookedPrimitive& primitive : cookedPrimitives) {
+            if (primitive.firstLod + primitive.lodCount > cookedLods.size()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool VulkanglTFModel::writeAssetCache(AssetCache::Writer& writer, const tinygltf::Model& gltfModel, const CookedGeometry& geometry, const void* vertexData, const void* indexData)
+    {
+        // A warm load can't decode images, so all of them must be in the cache unless they are ktx files
+        for (size_t i = 0; i < cookedTextures.size(); i++) {
+            if (cookedTextures[i].mipLevels == 0 && !isKtxImage(gltfModel.images[i])) {
+                std::cerr << "Could not cook glTF image " << gltfModel.images[i].uri << ", the asset cache isn't written" << std::endl;
+                return false;
+            }
+        }
+
+        CookedGeometry cookedGeometry = geometry;
+        writer.align(16);
+        cookedGeometry.vertexOffset = writer.tell();
+        writer.write(vertexData, static_cast<size_t>(geometry.vertexCount * geometry.vertexStride));
+        writer.align(16);
+        cookedGeometry.indexOffset = writer.tell();
+        writer.write(indexData, static_cast<size_t>(geometry.indexCount * sizeof(uint32_t)));
+
+        const uint64_t tableOffset = writer.tell();
+
+        std::vector<std::string> dependencies;
+        for (const tinygltf::Buffer& buffer : gltfModel.buffers) {
+            dependencies.push_back(buffer.uri);
+        }
+        for (const tinygltf::Image& image : gltfModel.images) {
+            dependencies.push_back(image.uri);
+        }
+        // Embedded data is covered by the key
+        dependencies.erase(std::remove_if(dependencies.begin(), dependencies.end(), [](const std::string& uri) {
+            return uri.empty() || uri.compare(0, 5, "data:") == 0;
+        }), dependencies.end());
+        writer.writeValue(static_cast<uint32_t>(dependencies.size()));
+        for (const std::string& uri : dependencies) {
+            uint64_t size = 0;
+            int64_t modificationTime = 0;
+            AssetCache::fileStamp(path + "/" + uri, size, modificationTime);
+            writer.writeString(uri);
+            writer.writeValue(size);
+            writer.writeValue(modificationTime);
+        }
+
+        writer.writeArray(cookedTextures);
+        writer.writeValue(cookedGeometry);
+
+        // loadNode creates the primitives in the order of linearNodes
+        std::vector<CookedPrimitive> primitives;
+        std::vector<Primitive::Lod> lods;
+        std::vector<glm::mat4> meshDequantizations;
+        for (Node* node : linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            meshDequantizations.push_back(node->mesh->dequantization);
+            for (Primitive* primitive : node->mesh->primitives) {
+                CookedPrimitive cooked{};
+                cooked.firstIndex = primitive->firstIndex;
+                cooked.indexCount = primitive->indexCount;
+                cooked.firstVertex = primitive->firstVertex;
+                cooked.vertexCount = primitive->vertexCount;
+                cooked.min = primitive->dimensions.min;
+                cooked.max = primitive->dimensions.max;
+                cooked.firstLod = static_cast<uint32_t>(lods.size());
+                cooked.lodCount = static_cast<uint32_t>(primitive->lods.size());
+                lods.insert(lods.end(), primitive->lods.begin(), primitive->lods.end());
+                primitives.push_back(cooked);
+            }
+        }
+        writer.writeArray(primitives);
+        writer.writeArray(lods);
+        writer.writeArray(meshDequantizations);
+
+        writer.patch(offsetof(AssetCacheHeader, tableOffset), &tableOffset, sizeof(tableOffset));
+        return true;
+    }
+
+    void VulkanglTFModel::loadCookedImages(tinygltf::Model& gltfModel, const AssetCache::MappedFile& file, VulkanDevice* device, VkQueue transferQueue)
+    {
+        auto tStart = std::chrono::high_resolution_clock::now();
+
+        textures.resize(gltfModel.images.size());
+        AssetCache::Reader reader(file.data(), file.size());
+        VulkanTextureBatch uploadBatch(device, transferQueue);
+        VkDeviceSize cookedBytes = 0;
+        for (size_t i = 0; i < gltfModel.images.size(); i++) {
+            if (i < cookedTextures.size() && cookedTextures[i].mipLevels > 0) {
+                const CookedTexture& cooked = cookedTextures[i];
+                VkDeviceSize size;
+                std::vector<VkBufferImageCopy> regions = getPackedLevelRegions(cooked.width, cooked.height, cooked.mipLevels, static_cast<VkFormat>(cooked.format), size);
+                // Copied from the mapping into the staging buffer, pages are read in as they are touched
+                textures[i].fromPixels(reader.view(cooked.offset, cooked.size), cooked.size, static_cast<VkFormat>(cooked.format),
+                        cooked.width, cooked.height, cooked.mipLevels, regions, device, transferQueue, &uploadBatch);
+                cookedBytes += cooked.size;
+            } else {
+                // Images that already carry their mip chain (ktx) aren't cooked
+                decodeImageData(&gltfModel.images[i], static_cast<int>(i), path);
+                textures[i].fromglTFImage(gltfModel.images[i], path, device, transferQueue, &uploadBatch);
+                std::vector<unsigned char>().swap(gltfModel.images[i].image);
+            }
+        }
+        uploadBatch.flush();
+
+        auto tEnd = std::chrono::high_resolution_clock::now();
+        if (verbose) {
+            std::cout << "Uploaded " << gltfModel.images.size() << " cooked glTF images (" << cookedBytes / (1024.0 * 1024.0) << " MB) in "
+                << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << " ms" << std::endl;
+        }
+
+        createEmptyTexture(transferQueue);
+    }
+
+    struct VulkanglTFModel::TextureStreaming {
+        VulkanTextureStreamer streamer;
+        VkQueue transferQueue;
+        // Moved out of the glTF model, the workers decode them after loading has returned
+        std::vector<tinygltf::Image> images;
+        // Levels decoded or transcoded by the workers, empty if the image couldn't be loaded
+        std::vector<std::vector<uint8_t>> mipChains;
+        std::vector<uint32_t> mipChainLevels;
+        std::vector<VkFormat> mipChainFormats;
+        CompletionQueue decodedImages;
+        size_t remainingImages = 0;
+        // Texture of each stream
+        std::vector<size_t> streamTextureIndices;
+        // Cooked levels are streamed straight from the mapping
+        AssetCache::MappedFile cookedFile;
+        std::chrono::high_resolution_clock::time_point tStart;
+        bool firstLevelsResident = false;
+        std::atomic<bool> cancelled{ false };
+        // Declared last so the workers are joined before anything they write to goes away
+        std::unique_ptr<ThreadPool> threadPool;
+
+        TextureStreaming(VulkanDevice* device, VkQueue transferQueue)
+            : streamer(device, transferQueue), transferQueue(transferQueue), tStart(std::chrono::high_resolution_clock::now()) {}
+        ~TextureStreaming() {
+            cancelled = true;
+        }
+    };
+
+    void VulkanglTFModel::streamImages(tinygltf::Model& gltfModel, VulkanDevice* device, VkQueue transferQueue)
+    {
+        createEmptyTexture(transferQueue);
+
+        TextureStreaming& streaming = *textureStreaming;
+        streaming.streamer.uploadBudget = textureStreamingBudget;
+        streaming.images = std::move(gltfModel.images);
+        streaming.mipChains.resize(streaming.images.size());
+        streaming.mipChainLevels.resize(streaming.images.size());
+        streaming.mipChainFormats.resize(streaming.images.size(), VK_FORMAT_R8G8B8A8_UNORM);
+        streaming.remainingImages = streaming.images.size();
+        // Materials sample the empty texture until the first levels of their images arrive
+        textures.resize(streaming.images.size());
+        for (Texture& texture : textures) {
+            texture.device = device;
+            texture.descriptor = emptyTexture.descriptor;
+        }
+
+        streaming.threadPool = std::make_unique<ThreadPool>(imageLoadingThreadCount);
+        const std::string imagePath = path;
+        for (size_t i = 0; i < streaming.images.size(); i++) {
+            tinygltf::Image* image = &streaming.images[i];
+            streaming.threadPool->push([&streaming, device, image, i, imagePath]() {
+                if (streaming.cancelled) {
+                    return;
+                }
+                // Ktx files are transcoded here as well, so the main thread only hands levels to the streamer
+                decodeImageData(image, static_cast<int>(i), imagePath);
+                if (isKtxImage(*image)) {
+                    streaming.mipChains[i] = loadKtxMipChain(device, *image, imagePath, streaming.mipChainFormats[i], streaming.mipChainLevels[i]);
+                } else {
+                    streaming.mipChains[i] = buildMipChain(*image, streaming.mipChainLevels[i]);
+                }
+                std::vector<unsigned char>().swap(image->image);
+                streaming.decodedImages.push(i);
+            });
+        }
+    }
+
+    void VulkanglTFModel::streamCookedImages(tinygltf::Model& gltfModel, VulkanDevice* device, VkQueue transferQueue)
+    {
+        createEmptyTexture(transferQueue);
+
+        TextureStreaming& streaming = *textureStreaming;
+        streaming.streamer.uploadBudget = textureStreamingBudget;
+        textures.resize(gltfModel.images.size());
+        AssetCache::Reader reader(streaming.cookedFile.data(), streaming.cookedFile.size());
+        for (size_t i = 0; i < gltfModel.images.size(); i++) {
+            Texture& texture = textures[i];
+            texture.device = device;
+            if (i < cookedTextures.size() && cookedTextures[i].mipLevels > 0) {
+                // Nothing to decode, every image exists right away and gets its levels from the mapping
+                const CookedTexture& cooked = cookedTextures[i];
+                texture.width = cooked.width;
+                texture.height = cooked.height;
+                texture.mipLevels = cooked.mipLevels;
+                texture.createImage(static_cast<VkFormat>(cooked.format), VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+                texture.createSampler();
+                texture.descriptor = emptyTexture.descriptor;
+                const uint32_t stream = streaming.streamer.add(texture.image, texture.format, texture.width, texture.height, texture.mipLevels);
+                streaming.streamTextureIndices.push_back(i);
+                streaming.streamer.provideExternal(stream, reader.view(cooked.offset, cooked.size));
+            } else {
+                decodeImageData(&gltfModel.images[i], static_cast<int>(i), path);
+                texture.fromglTFImage(gltfModel.images[i], path, device, transferQueue);
+                std::vector<unsigned char>().swap(gltfModel.images[i].image);
+            }
+        }
+    }
+
+    bool VulkanglTFModel::updateTextureStreaming()
+    {
+        if (!textureStreaming) {
+            return false;
+        }
+        TextureStreaming& streaming = *textureStreaming;
+
+        std::vector<const Texture*> updatedTextures;
+        size_t imageIndex;
+        while (streaming.decodedImages.tryPop(imageIndex)) {
+            streaming.remainingImages--;
+            Texture& texture = textures[imageIndex];
+            tinygltf::Image& image = streaming.images[imageIndex];
+            if (streaming.mipChains[imageIndex].empty()) {
+                // The worker couldn't load it, the materials keep sampling the empty texture
+                std::cerr << "Could not stream glTF image " << image.uri << std::endl;
+                continue;
+            }
+            texture.width = static_cast<uint32_t>(image.width);
+            texture.height = static_cast<uint32_t>(image.height);
+            texture.mipLevels = streaming.mipChainLevels[imageIndex];
+            texture.createImage(streaming.mipChainFormats[imageIndex], VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+            texture.createSampler();
+            const uint32_t stream = streaming.streamer.add(texture.image, texture.format, texture.width, texture.height, texture.mipLevels);
+            streaming.streamTextureIndices.push_back(imageIndex);
+            streaming.streamer.provide(stream, std::move(streaming.mipChains[imageIndex]));
+        }
+
+        // Views start at the finest resident level, the old ones aren't in use as the device is idle
+        for (uint32_t stream : streaming.streamer.update()) {
+            Texture& texture = textures[streaming.streamTextureIndices[stream]];
+            texture.createView(streaming.streamer.getResidentLevel(stream));
+            updatedTextures.push_back(&texture);
+        }
+        if (!updatedTextures.empty() && !streaming.firstLevelsResident) {
+            streaming.firstLevelsResident = true;
+            if (verbose) {
+                auto tNow = std::chrono::high_resolution_clock::now();
+                std::cout << "First texture levels resident after "
+                    << std::chrono::duration<double, std::milli>(tNow - streaming.tStart).count() << " ms" << std::endl;
+            }
+        }
+
+        bool descriptorsUpdated = false;
+        if (!updatedTextures.empty()) {
+            auto updated = [&updatedTextures](const Texture* texture) {
+                return std::find(updatedTextures.begin(), updatedTextures.end(), texture) != updatedTextures.end();
+            };
+            for (Material& material : materials) {
+                if (material.descriptorSet != VK_NULL_HANDLE && (updated(material.baseColorTexture) || updated(material.normalTexture))) {
+                    material.updateDescriptorSet(descriptorBindingFlags);
+                    descriptorsUpdated = true;
+                }
+            }
+        }
+
+        if (streaming.remainingImages == 0 && streaming.streamer.isComplete()) {
+            if (verbose) {
+                auto tEnd = std::chrono::high_resolution_clock::now();
+                std::cout << "Streamed " << textures.size() << " glTF images in "
+                    << std::chrono::duration<double, std::milli>(tEnd - streaming.tStart).count() << " ms" << std::endl;
+            }
+            textureStreaming.reset();
+        }
+        return descriptorsUpdated;
+    }
+
+    VkDeviceSize VulkanglTFModel::getTextureStreamingPendingBytes()
+    {
+        return textureStreaming ? textureStreaming->streamer.getPendingBytes() : 0;
+    }
+
+    struct VulkanglTFModel::TextureResidency {
+        VulkanTextureResidency manager;
+        VkQueue transferQueue;
+        // Texture of each managed entry, and the entry of each texture, -1 if it isn't managed
+        std::vector<size_t> textureIndices;
+        std::vector<int32_t> entries;
+        // Levels are reloaded from the mapping whenever they become resident again
+        AssetCache::MappedFile cookedFile;
+
+        TextureResidency(VulkanDevice* device, VkQueue transferQueue)
+            : manager(device), transferQueue(transferQueue) {}
+    };
+
+    void VulkanglTFModel::loadResidentLevels(Texture& texture, const CookedTexture& cooked, uint32_t firstLevel, VulkanTextureBatch& uploadBatch)
+    {
+        const VkFormat format = static_cast<VkFormat>(cooked.format);
+        VkDeviceSize size;
+        std::vector<VkBufferImageCopy> regions = getPackedLevelRegions(cooked.width, cooked.height, cooked.mipLevels, format, size);
+        // The levels from firstLevel down follow each other in the mapping, the image starts with the first one
+        const VkDeviceSize offset = regions[firstLevel].bufferOffset;
+        regions.erase(regions.begin(), regions.begin() + firstLevel);
+        for (VkBufferImageCopy& region : regions) {
+            region.bufferOffset -= offset;
+            region.imageSubresource.mipLevel -= firstLevel;
+        }
+        AssetCache::Reader reader(textureResidency->cookedFile.data(), textureResidency->cookedFile.size());
+        texture.fromPixels(reader.view(cooked.offset + offset, size - offset), size - offset, format,
+                std::max(1u, cooked.width >> firstLevel), std::max(1u, cooked.height >> firstLevel), cooked.mipLevels - firstLevel,
+                regions, device, textureResidency->transferQueue, &uploadBatch);
+    }
+
+    void VulkanglTFModel::loadResidentCookedImages(tinygltf::Model& gltfModel, VulkanDevice* device, VkQueue transferQueue)
+    {
+        TextureResidency& residency = *textureResidency;
+        textures.resize(gltfModel.images.size());
+        residency.entries.assign(textures.size(), -1);
+        VulkanTextureBatch uploadBatch(device, transferQueue);
+        for (size_t i = 0; i < gltfModel.images.size(); i++) {
+            if (i < cookedTextures.size() && cookedTextures[i].mipLevels > 0) {
+                const CookedTexture& cooked = cookedTextures[i];
+                const uint32_t entry = residency.manager.add(static_cast<VkFormat>(cooked.format), cooked.width, cooked.height, cooked.mipLevels);
+                residency.entries[i] = static_cast<int32_t>(entry);
+                residency.textureIndices.push_back(i);
+                loadResidentLevels(textures[i], cooked, residency.manager.getInitialLevel(entry), uploadBatch);
+            } else {
+                // Ktx images aren't cooked and keep all their levels
+                decodeImageData(&gltfModel.images[i], static_cast<int>(i), path);
+                textures[i].fromglTFImage(gltfModel.images[i], path, device, transferQueue, &uploadBatch);
+                std::vector<unsigned char>().swap(gltfModel.images[i].image);
+            }
+        }
+        uploadBatch.flush();
+        if (verbose) {
+            std::cout << "Loaded the mip tails of " << residency.textureIndices.size() << " cooked glTF images ("
+                << residency.manager.getResidentBytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+        }
+
+        createEmptyTexture(transferQueue);
+    }
+
+    void VulkanglTFModel::updateTextureUsage(glm::vec3 cameraPosition, float projectionScale)
+    {
+        if (!textureResidency) {
+            return;
+        }
+        TextureResidency& residency = *textureResidency;
+
+        // Assumes the texture is mapped once across the primitive, the level whose texels are as
+        // large as the pixels of its projected bounding sphere is the finest one that gets sampled
+        auto use = [this, &residency](const Texture* texture, float footprint) {
+            if (texture == nullptr || texture == &emptyTexture) {
+                return;
+            }
+            const size_t index = static_cast<size_t>(texture - textures.data());
+            if (residency.entries[index] < 0) {
+                return;
+            }
+            const float size = static_cast<float>(std::max(cookedTextures[index].width, cookedTextures[index].height));
+            const uint32_t level = footprint >= size ? 0 : static_cast<uint32_t>(std::floor(std::log2(size / std::max(footprint, 1.0f))));
+            residency.manager.use(static_cast<uint32_t>(residency.entries[index]), level);
+        };
+
+        for (Node* node : linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            const glm::mat4 matrix = node->getMatrix();
+            const float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+            for (Primitive* primitive : node->mesh->primitives) {
+                if (!primitive->visible) {
+                    continue;
+                }
+                const glm::vec3 center = glm::vec3(matrix * glm::vec4(primitive->dimensions.center, 1.0f));
+                const float radius = primitive->dimensions.radius * scale;
+                const float distance = glm::distance(center, cameraPosition);
+                // Inside the bounding sphere the primitive may cover the whole screen
+                const float footprint = distance > radius ? 2.0f * radius * projectionScale / distance : FLT_MAX;
+                // Only the textures Material::updateDescriptorSet binds are ever sampled
+                const Material& material = primitive->material;
+                if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
+                    use(material.baseColorTexture, footprint);
+                }
+                if (descriptorBindingFlags & DescriptorBindingFlags::ImageNormalMap) {
+                    use(material.normalTexture, footprint);
+                }
+            }
+        }
+    }
+
+    bool VulkanglTFModel::updateTextureResidency()
+    {
+        if (!textureResidency) {
+            return false;
+        }
+        TextureResidency& residency = *textureResidency;
+        residency.manager.budget = textureResidencyBudget;
+        std::vector<uint32_t> changed = residency.manager.update();
+        if (changed.empty()) {
+            return false;
+        }
+
+        // Images are recreated with their new level count, the old ones aren't in use as the device is idle
+        std::vector<const Texture*> updatedTextures;
+        VulkanTextureBatch uploadBatch(device, residency.transferQueue);
+        for (uint32_t entry : changed) {
+            const size_t index = residency.textureIndices[entry];
+            textures[index].destroy();
+            loadResidentLevels(textures[index], cookedTextures[index], residency.manager.getResidentLevel(entry), uploadBatch);
+            updatedTextures.push_back(&textures[index]);
+        }
+        uploadBatch.flush();
+
+        auto updated = [&updatedTextures](const Texture* texture) {
+            return std::find(updatedTextures.begin(), updatedTextures.end(), texture) != updatedTextures.end();
+        };
+        bool descriptorsUpdated = false;
+        for (Material& material : materials) {
+            if (material.descriptorSet != VK_NULL_HANDLE && (updated(material.baseColorTexture) || updated(material.normalTexture))) {
+                material.updateDescriptorSet(descriptorBindingFlags);
+                descriptorsUpdated = true;
+            }
+        }
+        return descriptorsUpdated;
+    }
+
+    VkDeviceSize VulkanglTFModel::getResidentTextureBytes()
+    {
+        return textureResidency ? textureResidency->manager.getResidentBytes() : 0;
+    }
+
+    VkDeviceSize VulkanglTFModel::getTextureResidencyBudget()
+    {
+        return textureResidency ? textureResidency->manager.getBudget() : 0;
+    }
+
     void VulkanglTFModel::loadFromFile(std::string filename, VulkanDevice *device, VkQueue transferQueue, uint32_t fileLoadingFlags, float scale)
     {
+        auto tLoadStart = std::chrono::high_resolution_clock::now();
+
+        size_t pos = filename.find_last_of('/');
+        path = filename.substr(0, pos);
+
+        // Cooked data is looked up by the hash of the glTF file and the flags, a hit skips image
+        // decoding and all vertex processing. Meshlets are built from the full vertices, which
+        // the cache doesn't keep
+        bool useAssetCache = (fileLoadingFlags & FileLoadingFlags::UseAssetCache) && !(fileLoadingFlags & FileLoadingFlags::BuildMeshlets);
+#if defined(__ANDROID__)
+        useAssetCache = false;
+#endif
+        // Textures are only compressed while cooking, the device has to sample BC for the result to load
+        compressTextures = useAssetCache && (fileLoadingFlags & FileLoadingFlags::CompressTextures);
+        if (compressTextures && !device->enabledFeatures.textureCompressionBC) {
+            std::cerr << "The device doesn't support BC textures, glTF images are cooked uncompressed" << std::endl;
+            fileLoadingFlags &= ~FileLoadingFlags::CompressTextures;
+            compressTextures = false;
+        }
+        // Managed textures reload their levels from the cooked data, they start out with the smallest
+        // ones already, so streaming isn't needed on top
+        manageTextureResidency = useAssetCache && (fileLoadingFlags & FileLoadingFlags::ManageTextureResidency) && !(fileLoadingFlags & FileLoadingFlags::DontLoadImages);
+        textureResidency.reset();
+        if (manageTextureResidency) {
+            textureResidency = std::make_unique<TextureResidency>(device, transferQueue);
+        }
+        // Streamed cooked textures keep reading from the mapping after loading has returned
+        streamTextures = (fileLoadingFlags & FileLoadingFlags::StreamTextures) && !(fileLoadingFlags & FileLoadingFlags::DontLoadImages) && !manageTextureResidency;
+        textureStreaming.reset();
+        if (streamTextures) {
+            textureStreaming = std::make_unique<TextureStreaming>(device, transferQueue);
+        }
+        AssetCache::MappedFile localCookedFile;
+        AssetCache::MappedFile& cookedFile = textureStreaming ? textureStreaming->cookedFile
+            : textureResidency ? textureResidency->cookedFile : localCookedFile;
+        AssetCache::Writer cookWriter;
+        CookedGeometry cookedGeometry{};
+        std::vector<glm::mat4> meshDequantizations;
+        std::string cacheFilename;
+        loadedFromAssetCache = false;
+        cookedTextures.clear();
+        if (useAssetCache) {
+            const uint64_t key = getAssetCacheKey(filename, fileLoadingFlags, scale);
+            const std::string name = filename.substr(pos + 1);
+            cacheFilename = (assetCachePath.empty() ? path : assetCachePath) + "/" + name.substr(0, name.find_last_of('.')) + "." + AssetCache::keyString(key) + ".cooked";
+            if (key != 0 && cookedFile.open(cacheFilename)) {
+                loadedFromAssetCache = readAssetCache(cookedFile, key, cookedGeometry, meshDequantizations);
+                if (!loadedFromAssetCache) {
+                    cookedTextures.clear();
+                    cookedPrimitives.clear();
+                    cookedLods.clear();
+                    cookedFile.close();
+                }
+            }
+            if (!loadedFromAssetCache) {
+                if (key != 0 && cookWriter.open(cacheFilename)) {
+                    const AssetCacheHeader header = { kAssetCacheMagic, kAssetCacheVersion, key, 0 };
+                    cookWriter.writeValue(header);
+                } else {
+                    std::cerr << "Could not create the asset cache " << cacheFilename << std::endl;
+                    useAssetCache = false;
+                }
+            }
+        }
+
         tinygltf::Model gltfModel;
         tinygltf::TinyGLTF gltfContext;
-        if (fileLoadingFlags & FileLoadingFlags::DontLoadImages) {
+        if ((fileLoadingFlags & FileLoadingFlags::DontLoadImages) || loadedFromAssetCache) {
             gltfContext.SetImageLoader(loadImageDataFuncEmpty, nullptr);
         } else {
             gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
@@ -1184,8 +2063,6 @@ namespace VulkanLearning {
         // We let tinygltf handle this, by passing the asset manager of our app
         tinygltf::asset_manager = androidApp->activity->assetManager;
 #endif
-        size_t pos = filename.find_last_of('/');
-        path = filename.substr(0, pos);
 
         std::string error, warning;
 
@@ -1203,19 +2080,84 @@ namespace VulkanLearning {
 
         if (fileLoaded) {
             if (!(fileLoadingFlags & FileLoadingFlags::DontLoadImages)) {
-                loadImages(gltfModel, device, transferQueue);
+                if (loadedFromAssetCache) {
+                    if (manageTextureResidency) {
+                        loadResidentCookedImages(gltfModel, device, transferQueue);
+                    } else if (streamTextures) {
+                        streamCookedImages(gltfModel, device, transferQueue);
+                    } else {
+                        loadCookedImages(gltfModel, cookedFile, device, transferQueue);
+                    }
+                } else if (streamTextures && !useAssetCache) {
+                    streamImages(gltfModel, device, transferQueue);
+                } else {
+                    // Images are cooked with the full chain on a cold cache, streaming and residency management
+                    // start with the next load
+                    streamTextures = false;
+                    manageTextureResidency = false;
+                    loadImages(gltfModel, device, transferQueue, useAssetCache ? &cookWriter : nullptr);
+                }
             }
             loadMaterials(gltfModel);
             const tinygltf::Scene &scene = gltfModel.scenes[gltfModel.defaultScene > -1 ? gltfModel.defaultScene : 0];
+
+            // Size the buffers once so decoding never reallocates
+            size_t sceneVertexCount = 0, sceneIndexCount = 0;
+            if (!loadedFromAssetCache) {
+                getSceneGeometrySize(gltfModel, scene, sceneVertexCount, sceneIndexCount);
+                vertexBuffer.reserve(sceneVertexCount);
+                indexBuffer.reserve(sceneIndexCount);
+            }
+
+            auto tStart = std::chrono::high_resolution_clock::now();
+            decodedAccessorBytes = 0;
+            optimizeMeshes = (fileLoadingFlags & FileLoadingFlags::OptimizeMeshes) != 0;
+            generateLods = (fileLoadingFlags & FileLoadingFlags::GenerateLods) != 0;
+            cacheStatisticsBefore = {};
+            cacheStatisticsAfter = {};
+            nextCookedPrimitive = 0;
             for (size_t i = 0; i < scene.nodes.size(); i++) {
                 const tinygltf::Node node = gltfModel.nodes[scene.nodes[i]];
                 loadNode(nullptr, node, scene.nodes[i], gltfModel, indexBuffer, vertexBuffer, scale);
             }
+            if (loadedFromAssetCache) {
+                size_t meshIndex = 0;
+                for (Node* node : linearNodes) {
+                    if (node->mesh && meshIndex < meshDequantizations.size()) {
+                        node->mesh->dequantization = meshDequantizations[meshIndex++];
+                    }
+                }
+            }
+            buildTransformHierarchy();
+            auto tEnd = std::chrono::high_resolution_clock::now();
+            double decodeMs = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+            if (verbose) {
+                if (loadedFromAssetCache) {
+                    std::cout << "Created " << nextCookedPrimitive << " primitives from the asset cache in " << decodeMs << " ms" << std::endl;
+                } else {
+                    std::cout << "Decoded " << decodedAccessorBytes / (1024.0 * 1024.0) << " MB of vertex and index data in "
+                        << decodeMs << " ms (" << (decodedAccessorBytes / (1024.0 * 1024.0)) / (decodeMs / 1000.0) << " MB/s)" << std::endl;
+                    if (optimizeMeshes) {
+                        std::cout << "Mesh optimization (included above): "
+                            << cacheStatisticsBefore.vertexCount << " -> " << cacheStatisticsAfter.vertexCount << " vertices, "
+                            << "ACMR " << cacheStatisticsBefore.acmr() << " -> " << cacheStatisticsAfter.acmr() << ", "
+                            << "ATVR " << cacheStatisticsBefore.atvr() << " -> " << cacheStatisticsAfter.atvr() << std::endl;
+                    }
+                    if (generateLods) {
+                        size_t lodIndexCount = indexBuffer.size() - sceneIndexCount;
+                        std::cout << "Generated LODs: " << lodIndexCount / 3 << " triangles on top of " << sceneIndexCount / 3 << std::endl;
+                    }
+                }
+            }
             if (gltfModel.animations.size() > 0) {
                 loadAnimations(gltfModel);
+                if (fileLoadingFlags & FileLoadingFlags::CompressAnimations) {
+                    compressAnimations(animationTolerance);
+                }
             }
             loadSkins(gltfModel);
 
+            nodeMatrices.clear();
             for (auto node : linearNodes) {
                 // Assign skins
                 if (node->skinIndex > -1) {
@@ -1223,7 +2165,9 @@ namespace VulkanLearning {
                 }
                 // Initial pose
                 if (node->mesh) {
-                    node->update();
+                    node->mesh->transformSlot = static_cast<uint32_t>(nodeMatrices.size());
+                    nodeMatrices.emplace_back(1.0f);
+                    updateNodeMatrix(node);
                 }
             }
         }
@@ -1233,8 +2177,8 @@ namespace VulkanLearning {
             return;
         }
 
-        // Pre-Calculations for requested features
-        if ((fileLoadingFlags & FileLoadingFlags::PreTransformVertices) || (fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors) || (fileLoadingFlags & FileLoadingFlags::FlipY)) {
+        // Pre-Calculations for requested features, cooked vertices already contain them
+        if (!loadedFromAssetCache && (fileLoadingFlags & (FileLoadingFlags::PreTransformVertices | FileLoadingFlags::PreMultiplyVertexColors | FileLoadingFlags::FlipY))) {
             const bool preTransform = fileLoadingFlags & FileLoadingFlags::PreTransformVertices;
             const bool preMultiplyColor = fileLoadingFlags & FileLoadingFlags::PreMultiplyVertexColors;
             const bool flipY = fileLoadingFlags & FileLoadingFlags::FlipY;
@@ -1264,6 +2208,15 @@ namespace VulkanLearning {
             }
         }
 
+        // Meshlets are culled in the space of the vertex buffer, which all nodes only share once pre-transformed
+        if (fileLoadingFlags & FileLoadingFlags::BuildMeshlets) {
+            if (fileLoadingFlags & FileLoadingFlags::PreTransformVertices) {
+                buildMeshlets(indexBuffer, vertexBuffer);
+            } else {
+                std::cerr << "Meshlets require pre-transformed vertices, none were built" << std::endl;
+            }
+        }
+
         for (auto extension : gltfModel.extensionsUsed) {
             if (extension == "KHR_materials_pbrSpecularGlossiness") {
                 std::cout << "Required extension: " << extension;
@@ -1271,10 +2224,99 @@ namespace VulkanLearning {
             }
         }
 
-        size_t vertexBufferSize = vertexBuffer.size() * sizeof(Vertex);
-        size_t indexBufferSize = indexBuffer.size() * sizeof(uint32_t);
-        indices.count = static_cast<uint32_t>(indexBuffer.size());
-        vertices.count = static_cast<uint32_t>(vertexBuffer.size());
+        // Quantize into the compact layout, static models only as joints and weights are dropped
+        std::vector<CompactVertex> compactVertexBuffer;
+        compactVertices = (fileLoadingFlags & FileLoadingFlags::CompactVertices) && skins.empty();
+        if ((fileLoadingFlags & FileLoadingFlags::CompactVertices) && !skins.empty()) {
+            std::cerr << "Compact vertices don't support skinned models, using the default layout" << std::endl;
+        }
+        if (loadedFromAssetCache) {
+            compactVertices = cookedGeometry.compactVertices != 0;
+            dequantization = cookedGeometry.dequantization;
+        } else if (compactVertices) {
+            compactVertexBuffer.resize(vertexBuffer.size());
+            if (fileLoadingFlags & FileLoadingFlags::PreTransformVertices) {
+                // All vertices are in model space already, a single range covers them
+                dequantization = getPositionDequantization(vertexBuffer, 0, vertexBuffer.size());
+                quantizeVertices(vertexBuffer, compactVertexBuffer, 0, vertexBuffer.size(), dequantization);
+            } else {
+                // Each node instance has its own contiguous vertex range, the dequantization goes into its matrix
+                for (Node* node : linearNodes) {
+                    if (!node->mesh || node->mesh->primitives.empty()) {
+                        continue;
+                    }
+                    size_t first = std::numeric_limits<size_t>::max();
+                    size_t last = 0;
+                    for (Primitive* primitive : node->mesh->primitives) {
+                        first = std::min(first, static_cast<size_t>(primitive->firstVertex));
+                        last = std::max(last, static_cast<size_t>(primitive->firstVertex + primitive->vertexCount));
+                    }
+                    glm::vec4 meshDequantization = getPositionDequantization(vertexBuffer, first, last);
+                    quantizeVertices(vertexBuffer, compactVertexBuffer, first, last, meshDequantization);
+                    node->mesh->dequantization = glm::scale(
+                            glm::translate(glm::mat4(1.0f), glm::vec3(meshDequantization)),
+                            glm::vec3(meshDequantization.w));
+                }
+                for (Node* node : linearNodes) {
+                    if (node->mesh) {
+                        updateNodeMatrix(node);
+                    }
+                }
+            }
+        }
+
+        const size_t vertexStride = compactVertices ? sizeof(CompactVertex) : sizeof(Vertex);
+        const void* vertexData = compactVertices ? static_cast<const void*>(compactVertexBuffer.data()) : static_cast<const void*>(vertexBuffer.data());
+        const void* indexData = indexBuffer.data();
+        size_t vertexCount = vertexBuffer.size();
+        size_t indexCount = indexBuffer.size();
+        if (loadedFromAssetCache) {
+            // Blobs go from the mapping straight into the staging buffers
+            AssetCache::Reader reader(cookedFile.data(), cookedFile.size());
+            vertexCount = static_cast<size_t>(cookedGeometry.vertexCount);
+            indexCount = static_cast<size_t>(cookedGeometry.indexCount);
+            vertexData = reader.view(cookedGeometry.vertexOffset, vertexCount * vertexStride);
+            indexData = reader.view(cookedGeometry.indexOffset, indexCount * sizeof(uint32_t));
+        } else if (useAssetCache) {
+            cookedGeometry.compactVertices = compactVertices ? 1 : 0;
+            cookedGeometry.vertexStride = static_cast<uint32_t>(vertexStride);
+            cookedGeometry.vertexCount = vertexCount;
+            cookedGeometry.indexCount = indexCount;
+            cookedGeometry.dequantization = dequantization;
+            if (writeAssetCache(cookWriter, gltfModel, cookedGeometry, vertexData, indexData)) {
+                const uint64_t cacheSize = cookWriter.tell();
+                if (!cookWriter.finish()) {
+                    std::cerr << "Could not write the asset cache " << cacheFilename << std::endl;
+                } else if (verbose) {
+                    std::cout << "Wrote asset cache " << cacheFilename << " (" << cacheSize / (1024.0 * 1024.0) << " MB)" << std::endl;
+                }
+            } else {
+                cookWriter.discard();
+            }
+        }
+        size_t vertexBufferSize = vertexCount * vertexStride;
+        size_t indexBufferSize = indexCount * sizeof(uint32_t);
+        indices.count = static_cast<uint32_t>(indexCount);
+        vertices.count = static_cast<uint32_t>(vertexCount);
+        if (verbose) {
+            std::cout << "Vertex data: " << vertexBufferSize / 1024 << " KB (" << vertexStride << " bytes per vertex)" << std::endl;
+        }
+
+        // De-interleaved copy of the positions, in the same format as the attribute stream
+        separatePositions = (fileLoadingFlags & FileLoadingFlags::SeparatePositions) != 0;
+        const size_t positionStride = compactVertices ? sizeof(CompactVertex::pos) : sizeof(glm::vec3);
+        std::vector<uint8_t> positionBuffer;
+        if (separatePositions) {
+            // Both layouts start with the position
+            const uint8_t* vertexBytes = static_cast<const uint8_t*>(vertexData);
+            positionBuffer.resize(vertexCount * positionStride);
+            for (size_t i = 0; i < vertexCount; i++) {
+                memcpy(&positionBuffer[i * positionStride], vertexBytes + i * vertexStride, positionStride);
+            }
+            if (verbose) {
+                std::cout << "Position data: " << positionBuffer.size() / 1024 << " KB (" << positionStride << " bytes per vertex)" << std::endl;
+            }
+        }
 
         assert((vertexBufferSize > 0) && (indexBufferSize > 0));
 
@@ -1288,13 +2330,22 @@ namespace VulkanLearning {
                 vertexBufferSize, 
                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-                vertexBuffer.data());
+                const_cast<void*>(vertexData));
 
         indexStaging.createBuffer(
                 indexBufferSize, 
                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-                indexBuffer.data());
+                const_cast<void*>(indexData));
+
+        VulkanBuffer positionStaging = VulkanBuffer(*device);
+        if (separatePositions) {
+            positionStaging.createBuffer(
+                    positionBuffer.size(),
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    positionBuffer.data());
+        }
 
         // Create staging buffers
         // Vertex data
@@ -1319,7 +2370,9 @@ namespace VulkanLearning {
         vertices.buffer = VulkanBuffer(*device);
         vertices.buffer.createBuffer(
                 vertexBufferSize, 
-                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags, 
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags
+                    // Source of VulkanComputeSkinning
+                    | (skins.empty() ? 0 : VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT),
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
         indices.buffer = VulkanBuffer(*device);
@@ -1327,6 +2380,14 @@ namespace VulkanLearning {
                 indexBufferSize, 
                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags, 
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        if (separatePositions) {
+            positions.buffer = VulkanBuffer(*device);
+            positions.buffer.createBuffer(
+                    positionBuffer.size(),
+                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
         /* // Vertex buffer */
         /* VK_CHECK_RESULT(device->createBuffer( */
         /*             VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | memoryPropertyFlags, */
@@ -1355,6 +2416,11 @@ namespace VulkanLearning {
         copyRegion.size = indexBufferSize;
         vkCmdCopyBuffer(copyCmd.getCommandBuffer(), indexStaging.getBuffer(), indices.buffer.getBuffer(), 1, &copyRegion);
 
+        if (separatePositions) {
+            copyRegion.size = positionBuffer.size();
+            vkCmdCopyBuffer(copyCmd.getCommandBuffer(), positionStaging.getBuffer(), positions.buffer.getBuffer(), 1, &copyRegion);
+        }
+
         copyCmd.flushCommandBuffer(device, transferQueue, true);
         //device->flushCommandBuffer(copyCmd, transferQueue, true);
 
@@ -1362,24 +2428,25 @@ namespace VulkanLearning {
         vkFreeMemory(device->getLogicalDevice(), vertexStaging.getBufferMemory(), nullptr);
         vkDestroyBuffer(device->getLogicalDevice(), indexStaging.getBuffer(), nullptr);
         vkFreeMemory(device->getLogicalDevice(), indexStaging.getBufferMemory(), nullptr);
+        if (separatePositions) {
+            positionStaging.cleanup();
+        }
 
         getSceneDimensions();
 
+        if (nodeTransforms.frameCount == 0) {
+            nodeTransforms.frameCount = device->getSwapChainImageCount() > 0 ? device->getSwapChainImageCount() : MAX_FRAMES_IN_FLIGHT;
+        }
+
         // Setup descriptors
-        uint32_t uboCount{ 0 };
         uint32_t imageCount{ 0 };
-        for (auto node : linearNodes) {
-            if (node->mesh) {
-                uboCount++;
-            }
-        }
         for (auto material : materials) {
             if (material.baseColorTexture != nullptr) {
                 imageCount++;
             }
         }
         std::vector<VkDescriptorPoolSize> poolSizes = {
-            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uboCount },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, nodeTransforms.frameCount },
         };
         if (imageCount > 0) {
             if (descriptorBindingFlags & DescriptorBindingFlags::ImageBaseColor) {
@@ -1393,31 +2460,11 @@ namespace VulkanLearning {
         descriptorPoolCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         descriptorPoolCI.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         descriptorPoolCI.pPoolSizes = poolSizes.data();
-        descriptorPoolCI.maxSets = uboCount + imageCount;
+        descriptorPoolCI.maxSets = nodeTransforms.frameCount + imageCount;
         VK_CHECK_RESULT(vkCreateDescriptorPool(device->getLogicalDevice(), &descriptorPoolCI, nullptr, &descriptorPool));
 
-        // Descriptors for per-node uniform buffers
-        {
-            // Layout is global, so only create if it hasn't already been created before
-            if (descriptorSetLayoutUbo == VK_NULL_HANDLE) {
-                std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings(1);
-                setLayoutBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                setLayoutBindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-                setLayoutBindings[0].binding = 0;
-                setLayoutBindings[0].descriptorCount = 1;
-                /* std::vector<VkDescriptorSetLayoutBinding> setLayoutBindings = { */
-                /*     vks::initializers::descriptorSetLayoutBinding(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT, 0), */
-                /* }; */
-                VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
-                descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-                descriptorLayoutCI.bindingCount = static_cast<uint32_t>(setLayoutBindings.size());
-                descriptorLayoutCI.pBindings = setLayoutBindings.data();
-                VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->getLogicalDevice(), &descriptorLayoutCI, nullptr, &descriptorSetLayoutUbo));
-            }
-            for (auto node : nodes) {
-                prepareNodeDescriptor(node, descriptorSetLayoutUbo);
-            }
-        }
+        // One storage buffer of node matrices per frame
+        prepareNodeTransforms();
 
         // Descriptors for per-material images
         {
@@ -1454,41 +2501,160 @@ namespace VulkanLearning {
                 }
             }
         }
+
+        std::vector<CookedPrimitive>().swap(cookedPrimitives);
+        std::vector<Primitive::Lod>().swap(cookedLods);
+        if (!streamTextures) {
+            textureStreaming.reset();
+        }
+        if (!manageTextureResidency) {
+            textureResidency.reset();
+        }
+
+        if (verbose && useAssetCache) {
+            auto tLoadEnd = std::chrono::high_resolution_clock::now();
+            std::cout << (loadedFromAssetCache ? "Warm load of " : "Cold load of ") << filename << " in "
+                << std::chrono::duration<double, std::milli>(tLoadEnd - tLoadStart).count() << " ms" << std::endl;
+        }
     }
 
-    void VulkanglTFModel::bindBuffers(VkCommandBuffer commandBuffer)
+    void VulkanglTFModel::bindBuffers(VkCommandBuffer commandBuffer, uint32_t vertexStreams)
     {
-        const VkDeviceSize offsets[1] = {0};
-        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertices.buffer.getBufferPointer(), offsets);
+        // Requested streams take consecutive bindings, a depth only pass binds the positions at 0
+        VkBuffer buffers[2];
+        const VkDeviceSize offsets[2] = {0, 0};
+        uint32_t bufferCount = 0;
+        if (vertexStreams & VertexStreamFlags::AttributeStream) {
+            buffers[bufferCount++] = vertices.buffer.getBuffer();
+        }
+        if (vertexStreams & VertexStreamFlags::PositionStream) {
+            if (!separatePositions) {
+                std::cerr << "Position stream requested but the model was loaded without FileLoadingFlags::SeparatePositions" << std::endl;
+            } else {
+                buffers[bufferCount++] = positions.buffer.getBuffer();
+            }
+        }
+        if (bufferCount > 0) {
+            vkCmdBindVertexBuffers(commandBuffer, 0, bufferCount, buffers, offsets);
+        }
         vkCmdBindIndexBuffer(commandBuffer, indices.buffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
         buffersBound = true;
     }
 
+    VkPipelineVertexInputStateCreateInfo* VulkanglTFModel::getPositionInputState(uint32_t binding, uint32_t location)
+    {
+        const uint32_t stride = compactVertices ? sizeof(CompactVertex::pos) : sizeof(glm::vec3);
+        const VkFormat format = compactVertices ? VK_FORMAT_R16G16B16A16_SNORM : VK_FORMAT_R32G32B32_SFLOAT;
+        positionInputBindingDescription = { binding, stride, VK_VERTEX_INPUT_RATE_VERTEX };
+        positionInputAttributeDescription = { location, binding, format, 0 };
+        positionInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        positionInputStateCreateInfo.vertexBindingDescriptionCount = 1;
+        positionInputStateCreateInfo.pVertexBindingDescriptions = &positionInputBindingDescription;
+        positionInputStateCreateInfo.vertexAttributeDescriptionCount = 1;
+        positionInputStateCreateInfo.pVertexAttributeDescriptions = &positionInputAttributeDescription;
+        return &positionInputStateCreateInfo;
+    }
+
+    VkPipelineVertexInputStateCreateInfo* VulkanglTFModel::getInstancedInputState(const std::vector<VertexComponent> components)
+    {
+        instancedInputBindingDescriptions[0] = compactVertices ? CompactVertex::inputBindingDescription(0) : Vertex::inputBindingDescription(0);
+        instancedInputBindingDescriptions[1] = InstanceData::inputBindingDescription(1);
+        instancedInputAttributeDescriptions = compactVertices ?
+            CompactVertex::inputAttributeDescriptions(0, components) :
+            Vertex::inputAttributeDescriptions(0, components);
+        const std::vector<VkVertexInputAttributeDescription> instanceAttributes =
+            InstanceData::inputAttributeDescriptions(1, static_cast<uint32_t>(components.size()));
+        instancedInputAttributeDescriptions.insert(instancedInputAttributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+        instancedInputStateCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        instancedInputStateCreateInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(instancedInputBindingDescriptions.size());
+        instancedInputStateCreateInfo.pVertexBindingDescriptions = instancedInputBindingDescriptions.data();
+        instancedInputStateCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instancedInputAttributeDescriptions.size());
+        instancedInputStateCreateInfo.pVertexAttributeDescriptions = instancedInputAttributeDescriptions.data();
+        return &instancedInputStateCreateInfo;
+    }
+
+    bool VulkanglTFModel::updateVisibility(const Frustum& frustum)
+    {
+        // World space boxes of all primitives, tested in one batch
+        std::vector<Primitive*> primitives;
+        std::vector<glm::vec3> centers;
+        std::vector<glm::vec3> extents;
+        for (Node* node : linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            const glm::mat4 matrix = node->getMatrix();
+            for (Primitive* primitive : node->mesh->primitives) {
+                glm::vec3 center, extent;
+                Frustum::transformBox(matrix, primitive->dimensions.min, primitive->dimensions.max, center, extent);
+                primitives.push_back(primitive);
+                centers.push_back(center);
+                extents.push_back(extent);
+            }
+        }
+        std::vector<uint8_t> visible(primitives.size());
+        visiblePrimitiveCount = static_cast<uint32_t>(frustum.checkBoxes(centers.data(), extents.data(), visible.data(), primitives.size()));
+        culledPrimitiveCount = static_cast<uint32_t>(primitives.size()) - visiblePrimitiveCount;
+
+        bool changed = false;
+        for (size_t i = 0; i < primitives.size(); i++) {
+            changed |= primitives[i]->visible != (visible[i] != 0);
+            primitives[i]->visible = visible[i] != 0;
+        }
+        return changed;
+    }
+
+    bool VulkanglTFModel::selectLods(glm::vec3 cameraPosition, float projectionScale, float maxPixelError)
+    {
+        // Coarsest level whose error, scaled by the projected bounding sphere, stays below maxPixelError
+        bool changed = false;
+        selectedTriangleCount = 0;
+        for (Node* node : linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            const glm::mat4 matrix = node->getMatrix();
+            const float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+            for (Primitive* primitive : node->mesh->primitives) {
+                const glm::vec3 center = glm::vec3(matrix * glm::vec4(primitive->dimensions.center, 1.0f));
+                const float radius = primitive->dimensions.radius * scale;
+                const float distance = glm::distance(center, cameraPosition);
+                uint32_t lodIndex = 0;
+                if (distance > radius) {
+                    const float projectedRadius = radius * projectionScale / distance;
+                    for (uint32_t i = static_cast<uint32_t>(primitive->lods.size()) - 1; i > 0; i--) {
+                        if (primitive->lods[i].error * projectedRadius <= maxPixelError) {
+                            lodIndex = i;
+                            break;
+                        }
+                    }
+                }
+                changed |= primitive->currentLod != lodIndex;
+                primitive->currentLod = lodIndex;
+                selectedTriangleCount += primitive->lods[lodIndex].indexCount / 3;
+            }
+        }
+        return changed;
+    }
+
     void VulkanglTFModel::drawNode(Node *node, VkCommandBuffer commandBuffer, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet)
     {
         if (node->mesh) {
+            // Without pass flags every primitive is drawn
+            const uint32_t passFlags = renderFlags & (RenderFlags::RenderOpaqueNodes | RenderFlags::RenderAlphaMaskedNodes | RenderFlags::RenderAlphaBlendedNodes);
             for (Primitive* primitive : node->mesh->primitives) {
-                bool skip = false;
-                const Material& material = primitive->material;
-                if (renderFlags & RenderFlags::RenderOpaqueNodes) {
-                    skip = (material.alphaMode != Material::ALPHAMODE_OPAQUE);
-                }
-                if (renderFlags & RenderFlags::RenderAlphaMaskedNodes) {
-                    skip = (material.alphaMode != Material::ALPHAMODE_MASK);
-                }
-                if (renderFlags & RenderFlags::RenderAlphaBlendedNodes) {
-                    skip = (material.alphaMode != Material::ALPHAMODE_BLEND);
-                }
-                if (!skip) {
+                const bool skip = passFlags != 0 && (passFlags & primitive->renderPass) == 0;
+                if (!skip && primitive->visible) {
                     if (renderFlags & RenderFlags::BindImages) {
-                        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material.descriptorSet, 0, nullptr);
+                        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &primitive->material.descriptorSet, 0, nullptr);
                     }
-                    vkCmdDrawIndexed(commandBuffer, primitive->indexCount, 1, primitive->firstIndex, 0, 0);
+                    const Primitive::Lod& lod = primitive->lods[primitive->currentLod];
+                    vkCmdDrawIndexed(commandBuffer, lod.indexCount, 1, lod.firstIndex, 0, node->mesh->transformSlot);
                 }
             }
         }
         for (auto& child : node->children) {
-            drawNode(child, commandBuffer, renderFlags);
+            drawNode(child, commandBuffer, renderFlags, pipelineLayout, bindImageSet);
         }
     }
 
@@ -1504,12 +2670,56 @@ namespace VulkanLearning {
         }
     }
 
+    std::vector<MaterialData> VulkanglTFModel::getMaterialData()
+    {
+        std::vector<MaterialData> result(materials.size());
+        for (size_t i = 0; i < materials.size(); i++) {
+            result[i].baseColorFactor = materials[i].baseColorFactor;
+            result[i].metallicFactor = materials[i].metallicFactor;
+            result[i].roughnessFactor = materials[i].roughnessFactor;
+            result[i].alphaCutoff = materials[i].alphaCutoff;
+            result[i].alphaMode = static_cast<uint32_t>(materials[i].alphaMode);
+        }
+        return result;
+    }
+
+    void VulkanglTFModel::drawInstanced(VkCommandBuffer commandBuffer, VkBuffer instanceBuffer, uint32_t instanceCount, uint32_t renderFlags, VkPipelineLayout pipelineLayout, uint32_t bindImageSet, Material* materialOverride)
+    {
+        if (!buffersBound) {
+            const VkDeviceSize offsets[1] = {0};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertices.buffer.getBufferPointer(), offsets);
+            vkCmdBindIndexBuffer(commandBuffer, indices.buffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+        }
+        const VkDeviceSize instanceOffset = 0;
+        vkCmdBindVertexBuffers(commandBuffer, 1, 1, &instanceBuffer, &instanceOffset);
+
+        // One traversal for all instances, frustum visibility of the model itself doesn't apply to them
+        const uint32_t passFlags = renderFlags & (RenderFlags::RenderOpaqueNodes | RenderFlags::RenderAlphaMaskedNodes | RenderFlags::RenderAlphaBlendedNodes);
+        for (Node* node : linearNodes) {
+            if (!node->mesh) {
+                continue;
+            }
+            for (Primitive* primitive : node->mesh->primitives) {
+                if (passFlags != 0 && (passFlags & primitive->renderPass) == 0) {
+                    continue;
+                }
+                if (renderFlags & RenderFlags::BindImages) {
+                    const Material* material = materialOverride ? materialOverride : &primitive->material;
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, bindImageSet, 1, &material->descriptorSet, 0, nullptr);
+                }
+                const Primitive::Lod& lod = primitive->lods[primitive->currentLod];
+                vkCmdDrawIndexed(commandBuffer, lod.indexCount, instanceCount, lod.firstIndex, 0, 0);
+            }
+        }
+    }
+
     void VulkanglTFModel::getNodeDimensions(Node *node, glm::vec3 &min, glm::vec3 &max)
     {
         if (node->mesh) {
+            const glm::mat4 matrix = node->getMatrix();
             for (Primitive *primitive : node->mesh->primitives) {
-                glm::vec4 locMin = glm::vec4(primitive->dimensions.min, 1.0f) * node->getMatrix();
-                glm::vec4 locMax = glm::vec4(primitive->dimensions.max, 1.0f) * node->getMatrix();
+                glm::vec4 locMin = glm::vec4(primitive->dimensions.min, 1.0f) * matrix;
+                glm::vec4 locMax = glm::vec4(primitive->dimensions.max, 1.0f) * matrix;
                 if (locMin.x < min.x) { min.x = locMin.x; }
                 if (locMin.y < min.y) { min.y = locMin.y; }
                 if (locMin.z < min.z) { min.z = locMin.z; }
@@ -1535,6 +2745,98 @@ namespace VulkanLearning {
         dimensions.radius = glm::distance(dimensions.min, dimensions.max) / 2.0f;
     }
 
+    bool AnimationSampler::hasKeys() const
+    {
+        if (inputs.empty()) {
+            return false;
+        }
+        return quantized ? quantizedValues.size() >= inputs.size() * 3 : values.size() >= inputs.size() * components;
+    }
+
+    size_t AnimationSampler::memorySize() const
+    {
+        return inputs.size() * sizeof(float) + quantizedValues.size() * sizeof(uint16_t)
+            + (values.size() + inTangents.size() + outTangents.size()) * sizeof(float);
+    }
+
+    uint32_t AnimationSampler::findKey(float time)
+    {
+        const uint32_t keyCount = static_cast<uint32_t>(inputs.size());
+        if (keyCount < 2 || time <= inputs[0]) {
+            return 0;
+        }
+        if (time >= inputs[keyCount - 1]) {
+            cursor = keyCount - 2;
+            return cursor;
+        }
+        // Same or next interval as the previous sample, otherwise a seek
+        if (cursor + 1 < keyCount && time >= inputs[cursor]) {
+            if (time <= inputs[cursor + 1]) {
+                return cursor;
+            }
+            if (cursor + 2 < keyCount && time <= inputs[cursor + 2]) {
+                return ++cursor;
+            }
+        }
+        auto upper = std::upper_bound(inputs.begin(), inputs.end(), time);
+        cursor = static_cast<uint32_t>(std::distance(inputs.begin(), upper)) - 1;
+        return cursor;
+    }
+
+    glm::vec4 AnimationSampler::sample(float time, bool rotation)
+    {
+        // Quantized samplers have neither tangents nor float values, the source is ignored for them
+        auto load = [this, rotation](const std::vector<float>& source, uint32_t key) {
+            glm::vec4 value(0.0f);
+            if (quantized) {
+                if (rotation) {
+                    AnimationCompression::decodeQuaternion(&quantizedValues[key * 3], &value.x);
+                } else {
+                    AnimationCompression::decodeVector(&quantizedValues[key * 3], quantizationRange, &value.x);
+                }
+                return value;
+            }
+            const float* v = &source[key * components];
+            return glm::vec4(v[0], v[1], v[2], components > 3 ? v[3] : 0.0f);
+        };
+        const uint32_t key = findKey(time);
+        const uint32_t keyCount = static_cast<uint32_t>(inputs.size());
+        if (keyCount < 2 || time <= inputs[0]) {
+            return load(values, key);
+        }
+        // Past the last key every interpolation holds it, findKey returns the last interval's start
+        if (time >= inputs[keyCount - 1]) {
+            return load(values, keyCount - 1);
+        }
+        if (interpolation == STEP) {
+            return load(values, key);
+        }
+
+        const float delta = inputs[key + 1] - inputs[key];
+        const float u = delta > 0.0f ? (time - inputs[key]) / delta : 0.0f;
+        glm::vec4 result;
+        if (interpolation == CUBICSPLINE) {
+            // Hermite spline, tangents are scaled by the key interval
+            const float u2 = u * u;
+            const float u3 = u2 * u;
+            result = (2.0f * u3 - 3.0f * u2 + 1.0f) * load(values, key)
+                + (u3 - 2.0f * u2 + u) * delta * load(outTangents, key)
+                + (-2.0f * u3 + 3.0f * u2) * load(values, key + 1)
+                + (u3 - u2) * delta * load(inTangents, key + 1);
+        } else if (rotation) {
+            const glm::vec4 a = load(values, key);
+            const glm::vec4 b = load(values, key + 1);
+            const glm::quat q = glm::slerp(glm::quat(a.w, a.x, a.y, a.z), glm::quat(b.w, b.x, b.y, b.z), u);
+            result = glm::vec4(q.x, q.y, q.z, q.w);
+        } else {
+            result = glm::mix(load(values, key), load(values, key + 1), u);
+        }
+        if (rotation) {
+            result = glm::normalize(result);
+        }
+        return result;
+    }
+
     void VulkanglTFModel::updateAnimation(uint32_t index, float time)
     {
         if (index > static_cast<uint32_t>(animations.size()) - 1) {
@@ -1546,52 +2848,149 @@ namespace VulkanLearning {
         bool updated = false;
         for (auto& channel : animation.channels) {
             AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-            if (sampler.inputs.size() > sampler.outputsVec4.size()) {
+            if (!sampler.hasKeys()) {
                 continue;
             }
+            const bool rotation = channel.path == AnimationChannel::PathType::ROTATION;
+            const glm::vec4 value = sampler.sample(time, rotation);
+            switch (channel.path) {
+                case AnimationChannel::PathType::TRANSLATION:
+                    transforms.setTranslation(channel.node->transformIndex, glm::vec3(value));
+                    break;
+                case AnimationChannel::PathType::SCALE:
+                    transforms.setScale(channel.node->transformIndex, glm::vec3(value));
+                    break;
+                case AnimationChannel::PathType::ROTATION:
+                    transforms.setRotation(channel.node->transformIndex, glm::quat(value.w, value.x, value.y, value.z));
+                    break;
+            }
+            updated = true;
+        }
+        if (updated) {
+            updateTransforms();
+        }
+    }
+
+    void VulkanglTFModel::compressAnimations(float tolerance)
+    {
+        size_t keysBefore = 0, keysAfter = 0, bytesBefore = 0, bytesAfter = 0;
+        animationMaxVectorError = 0.0f;
+        animationMaxRotationError = 0.0f;
+        for (Animation& animation : animations) {
+            std::vector<bool> rotations(animation.samplers.size(), false);
+            for (const AnimationChannel& channel : animation.channels) {
+                if (channel.path == AnimationChannel::PathType::ROTATION) {
+                    rotations[channel.samplerIndex] = true;
+                }
+            }
+            for (size_t i = 0; i < animation.samplers.size(); i++) {
+                AnimationSampler& sampler = animation.samplers[i];
+                const bool rotation = rotations[i];
+                keysBefore += sampler.inputs.size();
+                bytesBefore += sampler.memorySize();
+                if (sampler.quantized || !sampler.hasKeys() || sampler.interpolation == AnimationSampler::InterpolationType::CUBICSPLINE
+                        || (rotation && sampler.components != 4)) {
+                    keysAfter += sampler.inputs.size();
+                    bytesAfter += sampler.memorySize();
+                    continue;
+                }
 
-            for (auto i = 0; i < sampler.inputs.size() - 1; i++) {
-                if ((time >= sampler.inputs[i]) && (time <= sampler.inputs[i + 1])) {
-                    float u = std::max(0.0f, time - sampler.inputs[i]) / (sampler.inputs[i + 1] - sampler.inputs[i]);
-                    if (u <= 1.0f) {
-                        switch (channel.path) {
-                            case AnimationChannel::PathType::TRANSLATION: {
-                                                                              glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-                                                                              channel.node->translation = glm::vec3(trans);
-                                                                              break;
-                                                                          }
-                            case AnimationChannel::PathType::SCALE: {
-                                                                        glm::vec4 trans = glm::mix(sampler.outputsVec4[i], sampler.outputsVec4[i + 1], u);
-                                                                        channel.node->scale = glm::vec3(trans);
-                                                                        break;
-                                                                    }
-                            case AnimationChannel::PathType::ROTATION: {
-                                                                           glm::quat q1;
-                                                                           q1.x = sampler.outputsVec4[i].x;
-                                                                           q1.y = sampler.outputsVec4[i].y;
-                                                                           q1.z = sampler.outputsVec4[i].z;
-                                                                           q1.w = sampler.outputsVec4[i].w;
-                                                                           glm::quat q2;
-                                                                           q2.x = sampler.outputsVec4[i + 1].x;
-                                                                           q2.y = sampler.outputsVec4[i + 1].y;
-                                                                           q2.z = sampler.outputsVec4[i + 1].z;
-                                                                           q2.w = sampler.outputsVec4[i + 1].w;
-                                                                           channel.node->rotation = glm::normalize(glm::slerp(q1, q2, u));
-                                                                           break;
-                                                                       }
+                const std::vector<float> sourceInputs = sampler.inputs;
+                const std::vector<float> sourceValues = sampler.values;
+                const size_t keyCount = sourceInputs.size();
+                const uint32_t components = sampler.components;
+                const std::vector<uint32_t> kept = AnimationCompression::reduceKeys(sourceInputs.data(), sourceValues.data(), keyCount, components,
+                        rotation, sampler.interpolation == AnimationSampler::InterpolationType::STEP, tolerance);
+
+                sampler.quantizationRange = AnimationCompression::computeRange(sourceValues.data(), keyCount, components);
+                sampler.inputs.resize(kept.size());
+                sampler.quantizedValues.resize(kept.size() * 3);
+                for (size_t k = 0; k < kept.size(); k++) {
+                    const float* value = &sourceValues[kept[k] * components];
+                    sampler.inputs[k] = sourceInputs[kept[k]];
+                    if (rotation) {
+                        AnimationCompression::encodeQuaternion(value, &sampler.quantizedValues[k * 3]);
+                    } else {
+                        AnimationCompression::encodeVector(value, sampler.quantizationRange, &sampler.quantizedValues[k * 3]);
+                    }
+                }
+                sampler.values.clear();
+                sampler.values.shrink_to_fit();
+                sampler.quantized = true;
+                sampler.cursor = 0;
+
+                // Compare against every source key
+                for (size_t key = 0; key < keyCount; key++) {
+                    glm::vec4 decoded = sampler.sample(sourceInputs[key], rotation);
+                    const float* source = &sourceValues[key * components];
+                    if (rotation) {
+                        animationMaxRotationError = std::max(animationMaxRotationError, AnimationCompression::quaternionAngle(&decoded.x, source));
+                    } else {
+                        for (uint32_t c = 0; c < 3; c++) {
+                            animationMaxVectorError = std::max(animationMaxVectorError, std::abs(decoded[c] - source[c]));
                         }
-                        updated = true;
                     }
                 }
+                sampler.cursor = 0;
+                keysAfter += sampler.inputs.size();
+                bytesAfter += sampler.memorySize();
             }
         }
-        if (updated) {
-            for (auto &node : nodes) {
-                node->update();
+        if (verbose) {
+            std::cout << "Compressed animations: " << keysBefore << " -> " << keysAfter << " keys, "
+                << bytesBefore << " -> " << bytesAfter << " bytes, max error " << animationMaxVectorError
+                << " (translation/scale), " << animationMaxRotationError << " rad (rotation)" << std::endl;
+        }
+    }
+
+    void VulkanglTFModel::buildTransformHierarchy()
+    {
+        // Depth first from the roots, so every parent is added before its children
+        transforms.clear();
+        std::vector<Node*> stack(nodes.rbegin(), nodes.rend());
+        while (!stack.empty()) {
+            Node* node = stack.back();
+            stack.pop_back();
+            const int32_t parent = node->parent && node->parent->hierarchy ? static_cast<int32_t>(node->parent->transformIndex) : -1;
+            node->transformIndex = transforms.add(parent, node->translation, node->rotation, node->scale, node->matrix);
+            node->hierarchy = &transforms;
+            stack.insert(stack.end(), node->children.rbegin(), node->children.rend());
+        }
+        transforms.update();
+    }
+
+    void VulkanglTFModel::updateTransforms()
+    {
+        if (transforms.update() == 0) {
+            return;
+        }
+        // Joint matrices are rebuilt by VulkanComputeSkinning, only the mesh nodes themselves matter here
+        for (Node* node : linearNodes) {
+            if (node->mesh && transforms.changed[node->transformIndex]) {
+                updateNodeMatrix(node);
             }
         }
     }
 
+    void VulkanglTFModel::updateNodeMatrix(Node* node)
+    {
+        nodeMatrices[node->mesh->transformSlot] = node->getMatrix() * node->mesh->dequantization;
+    }
+
+    void VulkanglTFModel::updateNodeTransforms(uint32_t frame)
+    {
+        if (nodeMatrices.empty()) {
+            return;
+        }
+        char* region = static_cast<char*>(nodeTransforms.buffer.getMappedMemory()) + frame * nodeTransforms.frameSize;
+        memcpy(region, nodeMatrices.data(), nodeMatrices.size() * sizeof(glm::mat4));
+    }
+
+    void VulkanglTFModel::bindNodeTransforms(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, uint32_t set, uint32_t frame)
+    {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, set, 1, &nodeTransforms.descriptorSets[frame], 0, nullptr);
+    }
+
     /*
        Helper functions
        */
@@ -1620,27 +3019,54 @@ namespace VulkanLearning {
         return nodeFound;
     }
 
-    void VulkanglTFModel::prepareNodeDescriptor(Node* node, VkDescriptorSetLayout descriptorSetLayout) {
-        if (node->mesh) {
-            VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
-            descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-            descriptorSetAllocInfo.descriptorPool = descriptorPool;
-            descriptorSetAllocInfo.pSetLayouts = &descriptorSetLayout;
-            descriptorSetAllocInfo.descriptorSetCount = 1;
-            VK_CHECK_RESULT(vkAllocateDescriptorSets(device->getLogicalDevice(), &descriptorSetAllocInfo, &node->mesh->uniformBuffer.descriptorSet));
+    void VulkanglTFModel::prepareNodeTransforms()
+    {
+        // Layout is global, so only create if it hasn't already been created before
+        if (descriptorSetLayoutNodeTransforms == VK_NULL_HANDLE) {
+            VkDescriptorSetLayoutBinding setLayoutBinding{};
+            setLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            setLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+            setLayoutBinding.binding = 0;
+            setLayoutBinding.descriptorCount = 1;
+            VkDescriptorSetLayoutCreateInfo descriptorLayoutCI{};
+            descriptorLayoutCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            descriptorLayoutCI.bindingCount = 1;
+            descriptorLayoutCI.pBindings = &setLayoutBinding;
+            VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device->getLogicalDevice(), &descriptorLayoutCI, nullptr, &descriptorSetLayoutNodeTransforms));
+        }
+
+        // At least one matrix so the set stays valid for models without meshes
+        const VkDeviceSize alignment = device->getMinStorageBufferOffsetAlignment();
+        const VkDeviceSize matricesSize = std::max<size_t>(nodeMatrices.size(), 1) * sizeof(glm::mat4);
+        nodeTransforms.frameSize = alignment > 0 ? (matricesSize + alignment - 1) & ~(alignment - 1) : matricesSize;
+        nodeTransforms.buffer = VulkanBuffer(*device);
+        nodeTransforms.buffer.createBuffer(
+                nodeTransforms.frameSize * nodeTransforms.frameCount,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        nodeTransforms.buffer.map();
+
+        std::vector<VkDescriptorSetLayout> setLayouts(nodeTransforms.frameCount, descriptorSetLayoutNodeTransforms);
+        VkDescriptorSetAllocateInfo descriptorSetAllocInfo{};
+        descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        descriptorSetAllocInfo.descriptorPool = descriptorPool;
+        descriptorSetAllocInfo.pSetLayouts = setLayouts.data();
+        descriptorSetAllocInfo.descriptorSetCount = nodeTransforms.frameCount;
+        nodeTransforms.descriptorSets.resize(nodeTransforms.frameCount);
+        VK_CHECK_RESULT(vkAllocateDescriptorSets(device->getLogicalDevice(), &descriptorSetAllocInfo, nodeTransforms.descriptorSets.data()));
 
+        for (uint32_t frame = 0; frame < nodeTransforms.frameCount; frame++) {
+            VkDescriptorBufferInfo bufferInfo{ nodeTransforms.buffer.getBuffer(), frame * nodeTransforms.frameSize, matricesSize };
             VkWriteDescriptorSet writeDescriptorSet{};
             writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
             writeDescriptorSet.descriptorCount = 1;
-            writeDescriptorSet.dstSet = node->mesh->uniformBuffer.descriptorSet;
+            writeDescriptorSet.dstSet = nodeTransforms.descriptorSets[frame];
             writeDescriptorSet.dstBinding = 0;
-            writeDescriptorSet.pBufferInfo = node->mesh->uniformBuffer.buffer.getDescriptorPointer();
-
+            writeDescriptorSet.pBufferInfo = &bufferInfo;
             vkUpdateDescriptorSets(device->getLogicalDevice(), 1, &writeDescriptorSet, 0, nullptr);
-        }
-        for (auto& child : node->children) {
-            prepareNodeDescriptor(child, descriptorSetLayout);
+
+            updateNodeTransforms(frame);
         }
     }
 }
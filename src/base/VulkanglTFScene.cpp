@@ -1,5 +1,7 @@
 //#define TINYGLTF_IMPLEMENTATION
 #include "VulkanglTFScene.hpp"
+#include "VulkanglTFImageLoader.hpp"
+#include "VulkanKtxTranscoder.hpp"
 
 namespace VulkanLearning {
     VulkanglTFScene::VulkanglTFScene() {}
@@ -18,22 +20,80 @@ namespace VulkanLearning {
     }
 
     void VulkanglTFScene::loadImages(tinygltf::Model& input) {
+        auto tStart = std::chrono::high_resolution_clock::now();
+
         images.resize(input.images.size());
 
+        // Files are read and parsed on the worker pool and uploaded here in the order they finish
+        std::vector<ktxTexture*> ktxTextures(input.images.size(), nullptr);
+        std::vector<ktxResult> results(input.images.size(), KTX_SUCCESS);
+        // Basis Universal (KHR_texture_basisu) images are transcoded by the workers too
+        std::vector<VkFormat> formats(input.images.size(), VK_FORMAT_R8G8B8A8_UNORM);
+        CompletionQueue loadedImages;
+        ThreadPool threadPool(imageLoadingThreadCount);
+        VulkanDevice* device = this->device;
         for (size_t i = 0; i < input.images.size(); i++) {
-            tinygltf::Image& glTFImage = input.images[i];
-            images[i].texture.loadFromKTXFile(
-                    path + "/" + glTFImage.uri, 
-                    VK_FORMAT_R8G8B8A8_UNORM, 
-                    device, 
-                    copyQueue);
+            std::string filename = path + "/" + input.images[i].uri;
+            const std::vector<unsigned char>* embedded = &input.images[i].image;
+            threadPool.push([filename, i, device, embedded, &ktxTextures, &results, &formats, &loadedImages]() {
+                if (!embedded->empty()) {
+                    results[i] = ktxTexture_CreateFromMemory(
+                            embedded->data(),
+                            embedded->size(),
+                            KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT,
+                            &ktxTextures[i]);
+                } else {
+                    results[i] = ktxTexture_CreateFromNamedFile(
+                            filename.c_str(),
+                            KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT,
+                            &ktxTextures[i]);
+                }
+                if (results[i] == KTX_SUCCESS) {
+                    results[i] = prepareKtxTexture(device, ktxTextures[i], VK_FORMAT_R8G8B8A8_UNORM, formats[i]);
+                }
+                loadedImages.push(i);
+            });
+        }
+
+        // All copies go through a single submission
+        VulkanTextureBatch uploadBatch(device, copyQueue);
+        for (size_t n = 0; n < input.images.size(); n++) {
+            size_t i = loadedImages.pop();
+            if (results[i] != KTX_SUCCESS) {
+                // Let the workers finish so every texture they created can be released
+                threadPool.wait();
+                for (ktxTexture* texture : ktxTextures) {
+                    if (texture) {
+                        ktxTexture_Destroy(texture);
+                    }
+                }
+                throw std::runtime_error("KTX Texture :" + path + "/" + input.images[i].uri + " creation failed!");
+            }
+            images[i].texture.loadFromKTXTexture(
+                    ktxTextures[i],
+                    formats[i],
+                    device,
+                    copyQueue,
+                    VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    false,
+                    &uploadBatch);
+            ktxTexture_Destroy(ktxTextures[i]);
+            ktxTextures[i] = nullptr;
+        }
+        uploadBatch.flush();
+
+        auto tEnd = std::chrono::high_resolution_clock::now();
+        if (verbose) {
+            std::cout << "Loaded " << input.images.size() << " glTF images using " << threadPool.getThreadCount() << " threads in "
+                << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << " ms" << std::endl;
         }
     }
 
     void VulkanglTFScene::loadTextures(tinygltf::Model& input) {
         textures.resize(input.textures.size());
         for (size_t i = 0; i < input.textures.size(); i++) {
-            textures[i].imageIndex = input.textures[i].source;
+            textures[i].imageIndex = getTextureSource(input.textures[i]);
         }
     }
 
@@ -99,104 +159,61 @@ namespace VulkanLearning {
                 uint32_t indexCount = 0;
 
                 // Vertices
-                const float* positionBuffer = nullptr;
-                const float* normalsBuffer = nullptr;
-                const float* texCoordsBuffer = nullptr;
-                const float* tangentsBuffer = nullptr;
                 size_t vertexCount = 0;
-
                 if (glTFPrimitive.attributes.find("POSITION") != glTFPrimitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.attributes.find("POSITION")->second];
-                    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
-                    positionBuffer = reinterpret_cast<const float*>(&(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                    vertexCount = accessor.count;
-                }
-
-                if (glTFPrimitive.attributes.find("NORMAL") != glTFPrimitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.attributes.find("NORMAL")->second];
-                    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
-                    normalsBuffer = reinterpret_cast<const float*>(&(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                }
-
-                if (glTFPrimitive.attributes.find("TEXCOORD_0") != glTFPrimitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.attributes.find("TEXCOORD_0")->second];
-                    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
-                    texCoordsBuffer = reinterpret_cast<const float*>(&(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
+                    vertexCount = input.accessors[glTFPrimitive.attributes.find("POSITION")->second].count;
                 }
 
-                if (glTFPrimitive.attributes.find("TANGENT") != glTFPrimitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.attributes.find("TANGENT")->second];
-                    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
-                    tangentsBuffer = reinterpret_cast<const float*>(&(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                }
+                Vertex defaultVertex;
+                defaultVertex.pos = glm::vec3(0.0f);
+                defaultVertex.normal = glm::vec3(0.0f);
+                defaultVertex.uv = glm::vec2(0.0f);
+                defaultVertex.color = glm::vec3(1.0f);
+                defaultVertex.tangent = glm::vec4(0.0f);
+                vertexBuffer.resize(vertexStart + vertexCount, defaultVertex);
+                Vertex* vertices = vertexBuffer.data() + vertexStart;
+
+                auto readAttribute = [&](const char* name, float* dst, uint32_t components) {
+                    auto attribute = glTFPrimitive.attributes.find(name);
+                    if (vertexCount == 0 || attribute == glTFPrimitive.attributes.end()) {
+                        return false;
+                    }
+                    return readAccessor(input, input.accessors[attribute->second], dst, sizeof(Vertex), components);
+                };
 
-                for (size_t v = 0; v < vertexCount; v++) {
-                    Vertex vert{};
-                    vert.pos = glm::vec4(glm::make_vec3(&positionBuffer[v * 3]), 1.0f);
-                    vert.normal = glm::normalize(glm::vec3(normalsBuffer ? glm::make_vec3(&normalsBuffer[v * 3]) : glm::vec3(0.0f)));
-                    vert.uv = texCoordsBuffer ? glm::make_vec2(&texCoordsBuffer[v * 2]) : glm::vec3(0.0f);
-                    vert.color = glm::vec3(1.0f);
-                    vert.tangent = tangentsBuffer ? glm::make_vec4(&tangentsBuffer[v * 4]) : glm::vec4(0.0f);
-                    vertexBuffer.push_back(vert);
+                readAttribute("POSITION", glm::value_ptr(vertices[0].pos), 3);
+                if (readAttribute("NORMAL", glm::value_ptr(vertices[0].normal), 3)) {
+                    for (size_t v = 0; v < vertexCount; v++) {
+                        vertices[v].normal = glm::normalize(vertices[v].normal);
+                    }
                 }
+                readAttribute("TEXCOORD_0", glm::value_ptr(vertices[0].uv), 2);
+                readAttribute("TANGENT", glm::value_ptr(vertices[0].tangent), 4);
 
 
                 // Indices
                 const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.indices];
-                const tinygltf::BufferView& bufferView = input.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = input.buffers[bufferView.buffer];
 
                 indexCount += static_cast<uint32_t>(accessor.count);
-
-                switch (accessor.componentType) {
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                        uint32_t* buf = new uint32_t[accessor.count];
-                        memcpy(
-                            buf, 
-                            &buffer.data[accessor.byteOffset + bufferView.byteOffset], 
-                            accessor.count * sizeof(uint32_t));
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indexBuffer.push_back(buf[index] + vertexStart);
-                    }
-                    break;
-                                                               }
-
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                        uint16_t* buf = new uint16_t[accessor.count];
-                        memcpy(
-                                buf, 
-                                &buffer.data[accessor.byteOffset + bufferView.byteOffset], 
-                                accessor.count * sizeof(uint16_t));
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indexBuffer.push_back(buf[index] + vertexStart);
-                    }
-                    break;
-                                                                 }
-
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:  {
-                        uint8_t* buf = new uint8_t[accessor.count];
-                        memcpy(
-                                buf,
-                                &buffer.data[accessor.byteOffset + bufferView.byteOffset], 
-                                accessor.count * sizeof(uint8_t));
-                        for (size_t index = 0; index < accessor.count; index++) {
-                            indexBuffer.push_back(buf[index] + vertexStart);
-                    }
-                    break;
-                                                                 }
-
-                    default:
-                        std::cerr << "Index component type " << 
-                            accessor.componentType << " not supported!"
-                            << std::endl;
-                                                                 return;
-
+                indexBuffer.resize(firstIndex + indexCount);
+                if (!readIndices(input, accessor, indexBuffer.data() + firstIndex, vertexStart)) {
+                    indexBuffer.resize(firstIndex);
+                    return;
                 }
 
                 Primitive primitive{};
                 primitive.firstIndex = firstIndex;
                 primitive.indexCount = indexCount;
                 primitive.materialIndex = glTFPrimitive.material;
+                if (vertexCount > 0) {
+                    glm::vec3 posMin = vertices[0].pos;
+                    glm::vec3 posMax = vertices[0].pos;
+                    for (size_t v = 1; v < vertexCount; v++) {
+                        posMin = glm::min(posMin, vertices[v].pos);
+                        posMax = glm::max(posMax, vertices[v].pos);
+                    }
+                    primitive.center = (posMin + posMax) * 0.5f;
+                }
                 node.mesh.primitives.push_back(primitive);
             }
         }
@@ -212,19 +229,14 @@ namespace VulkanLearning {
         return images[index].texture.getDescriptor();
     }
 
-    void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, VulkanglTFScene::Node node) {
+    void VulkanglTFScene::drawNode(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout, const VulkanglTFScene::Node& node, const glm::mat4& parentMatrix) {
         if (!node.visible) {
             return;
         }
 
+        // Parent pointers of loaded nodes don't survive the copies into their parent's children, the matrix is passed down instead
+        const glm::mat4 nodeMatrix = parentMatrix * node.matrix;
         if (node.mesh.primitives.size() > 0) {
-            glm::mat4 nodeMatrix = node.matrix;
-            VulkanglTFScene::Node* currentParent = node.parent;
-            while (currentParent) {
-                nodeMatrix = currentParent->matrix * nodeMatrix;
-                currentParent = currentParent->parent;
-            }
-
             vkCmdPushConstants(
                     commandBuffer, 
                     pipelineLayout, 
@@ -232,8 +244,9 @@ namespace VulkanLearning {
                     0, 
                     sizeof(glm::mat4), 
                     &nodeMatrix);
+            bindStatistics.pushConstants++;
 
-            for (VulkanglTFScene::Primitive& primitive : node.mesh.primitives) {
+            for (const VulkanglTFScene::Primitive& primitive : node.mesh.primitives) {
                 if (primitive.indexCount > 0) {
                     VulkanglTFScene::Material& material = 
                         materials[primitive.materialIndex];
@@ -257,12 +270,14 @@ namespace VulkanLearning {
                             primitive.indexCount, 
                             1, 
                             primitive.firstIndex, 0, 0);
-
+                    bindStatistics.pipelineBinds++;
+                    bindStatistics.descriptorSetBinds++;
+                    bindStatistics.draws++;
                 }
             }
         }
-        for (auto& child : node.children) {
-            drawNode(commandBuffer, pipelineLayout, child);
+        for (const auto& child : node.children) {
+            drawNode(commandBuffer, pipelineLayout, child, nodeMatrix);
         }
     }
 
@@ -271,8 +286,111 @@ namespace VulkanLearning {
         vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertices.buffer->getBufferPointer(), offsets);
         vkCmdBindIndexBuffer(commandBuffer, indices.buffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
 
+        bindStatistics = {};
         for (auto& node : nodes) {
-            drawNode(commandBuffer, pipelineLayout, node);
+            drawNode(commandBuffer, pipelineLayout, node, glm::mat4(1.0f));
+        }
+    }
+
+    void VulkanglTFScene::buildDrawList() {
+        materialPipelineIds.resize(materials.size());
+        std::unordered_map<VkPipeline, uint32_t> pipelineIds;
+        for (size_t i = 0; i < materials.size(); i++) {
+            auto inserted = pipelineIds.insert({ materials[i].pipeline, static_cast<uint32_t>(pipelineIds.size()) });
+            materialPipelineIds[i] = inserted.first->second;
+        }
+
+        drawItems.clear();
+        drawTransforms.clear();
+        drawCenters.clear();
+        std::function<void(const Node&, const glm::mat4&)> flatten = [&](const Node& node, const glm::mat4& parentMatrix) {
+            if (!node.visible) {
+                return;
+            }
+            const glm::mat4 nodeMatrix = parentMatrix * node.matrix;
+            const uint32_t transformIndex = static_cast<uint32_t>(drawTransforms.size());
+            bool hasDraws = false;
+            for (const Primitive& primitive : node.mesh.primitives) {
+                if (primitive.indexCount == 0 || primitive.materialIndex < 0) {
+                    continue;
+                }
+                DrawList::DrawItem item{};
+                item.firstIndex = primitive.firstIndex;
+                item.indexCount = primitive.indexCount;
+                item.transformIndex = transformIndex;
+                item.materialIndex = static_cast<uint32_t>(primitive.materialIndex);
+                drawItems.push_back(item);
+                drawCenters.push_back(glm::vec3(nodeMatrix * glm::vec4(primitive.center, 1.0f)));
+                hasDraws = true;
+            }
+            if (hasDraws) {
+                drawTransforms.push_back(nodeMatrix);
+            }
+            for (const Node& child : node.children) {
+                flatten(child, nodeMatrix);
+            }
+        };
+        for (const Node& node : nodes) {
+            flatten(node, glm::mat4(1.0f));
+        }
+        sortedDrawItems = drawItems;
+    }
+
+    bool VulkanglTFScene::sortDrawList(const glm::mat4& view) {
+        // Opaque first, then masked, both by state only so their order doesn't follow the camera.
+        // Blended last and back to front, the only part that changes as the camera moves
+        for (size_t i = 0; i < drawItems.size(); i++) {
+            DrawList::DrawItem& item = drawItems[i];
+            const Material& material = materials[item.materialIndex];
+            const uint32_t pass = material.alphaMode == "BLEND" ? 2 : (material.alphaMode == "MASK" ? 1 : 0);
+            const float depth = pass == 2 ? -(view * glm::vec4(drawCenters[i], 1.0f)).z : 0.0f;
+            item.key = DrawList::makeKey(pass, materialPipelineIds[item.materialIndex], item.materialIndex, depth, pass == 2);
+        }
+        std::vector<DrawList::DrawItem> previous;
+        previous.swap(sortedDrawItems);
+        sortedDrawItems = drawItems;
+        DrawList::sort(sortedDrawItems, sortScratch);
+
+        // Only a different sequence of draws needs a new recording, equal keys keep their build order
+        if (previous.size() != sortedDrawItems.size()) {
+            return true;
+        }
+        for (size_t i = 0; i < previous.size(); i++) {
+            if (previous[i].firstIndex != sortedDrawItems[i].firstIndex || previous[i].transformIndex != sortedDrawItems[i].transformIndex) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void VulkanglTFScene::drawSorted(VkCommandBuffer commandBuffer, VkPipelineLayout pipelineLayout) {
+        VkDeviceSize offsets[1] = { 0 };
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertices.buffer->getBufferPointer(), offsets);
+        vkCmdBindIndexBuffer(commandBuffer, indices.buffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+        bindStatistics = {};
+        VkPipeline boundPipeline = VK_NULL_HANDLE;
+        uint32_t boundMaterial = UINT32_MAX;
+        uint32_t boundTransform = UINT32_MAX;
+        for (const DrawList::DrawItem& item : sortedDrawItems) {
+            const Material& material = materials[item.materialIndex];
+            if (material.pipeline != boundPipeline) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, material.pipeline);
+                boundPipeline = material.pipeline;
+                bindStatistics.pipelineBinds++;
+            }
+            if (item.materialIndex != boundMaterial) {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 1, 1, &material.descriptorSet, 0, nullptr);
+                boundMaterial = item.materialIndex;
+                bindStatistics.descriptorSetBinds++;
+            }
+            if (item.transformIndex != boundTransform) {
+                vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &drawTransforms[item.transformIndex]);
+                boundTransform = item.transformIndex;
+                bindStatistics.pushConstants++;
+            }
+            vkCmdDrawIndexed(commandBuffer, item.indexCount, 1, item.firstIndex, 0, 0);
+            bindStatistics.draws++;
         }
     }
 
@@ -1,5 +1,7 @@
 //#define TINYGLTF_IMPLEMENTATION
 #include "VulkanglTFSimpleModel.hpp"
+#include "VulkanKtxTranscoder.hpp"
+#include "PixelKernels.hpp"
 
 namespace VulkanLearning {
     VulkanglTFSimpleModel::VulkanglTFSimpleModel() {}
@@ -15,9 +17,42 @@ namespace VulkanLearning {
     }
 
     void VulkanglTFSimpleModel::loadImages(tinygltf::Model& input) {
+        auto tStart = std::chrono::high_resolution_clock::now();
+
         images.resize(input.images.size());
+
+        // Images are decoded on the worker pool and uploaded here in the order they finish
+        CompletionQueue decodedImages;
+        ThreadPool threadPool(imageLoadingThreadCount);
         for (size_t i = 0; i < input.images.size(); i++) {
+            tinygltf::Image* glTFImage = &input.images[i];
+            const std::string& path = this->path;
+            threadPool.push([glTFImage, i, &path, &decodedImages]() {
+                decodeImageData(glTFImage, static_cast<int>(i), path);
+                decodedImages.push(i);
+            });
+        }
+
+        for (size_t n = 0; n < input.images.size(); n++) {
+            size_t i = decodedImages.pop();
             tinygltf::Image& glTFImage = input.images[i];
+            if (isKtxImage(glTFImage)) {
+                // KHR_texture_basisu images, transcoded to a format of this device
+                ktxTexture* ktxTexture = nullptr;
+                VkFormat format;
+                if (glTFImage.image.empty()
+                        || ktxTexture_CreateFromMemory(glTFImage.image.data(), glTFImage.image.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture) != KTX_SUCCESS
+                        || prepareKtxTexture(device, ktxTexture, VK_FORMAT_R8G8B8A8_SRGB, format) != KTX_SUCCESS) {
+                    if (ktxTexture) {
+                        ktxTexture_Destroy(ktxTexture);
+                    }
+                    throw std::runtime_error("KTX Texture :" + glTFImage.uri + " creation failed!");
+                }
+                images[i].texture.loadFromKTXTexture(ktxTexture, format, device, copyQueue);
+                ktxTexture_Destroy(ktxTexture);
+                std::vector<unsigned char>().swap(glTFImage.image);
+                continue;
+            }
             unsigned char* buffer = nullptr;
             VkDeviceSize bufferSize = 0;
             bool deleteBuffer = false;
@@ -25,13 +60,7 @@ namespace VulkanLearning {
             if (glTFImage.component == 3) {
                 bufferSize = glTFImage.width * glTFImage.height * 4;
                 buffer = new unsigned char[bufferSize];
-                unsigned char* rgba = buffer;
-                unsigned char* rgb = &glTFImage.image[0];
-                for (size_t i = 0; i < glTFImage.width * glTFImage.height; ++i) {
-                    memcpy(rgba, rgb, sizeof(unsigned char) * 3);
-                    rgba += 4;
-                    rgb += 3;
-                }
+                PixelKernels::rgbToRgba(&glTFImage.image[0], buffer, static_cast<size_t>(glTFImage.width) * glTFImage.height);
                 deleteBuffer = true;
             } else {
                 buffer = &glTFImage.image[0];
@@ -48,15 +77,22 @@ namespace VulkanLearning {
                     copyQueue);
 
             if (deleteBuffer) {
-                delete buffer;
+                delete[] buffer;
             }
+            std::vector<unsigned char>().swap(glTFImage.image);
+        }
+
+        auto tEnd = std::chrono::high_resolution_clock::now();
+        if (verbose) {
+            std::cout << "Loaded " << input.images.size() << " glTF images using " << threadPool.getThreadCount() << " threads in "
+                << std::chrono::duration<double, std::milli>(tEnd - tStart).count() << " ms" << std::endl;
         }
     }
 
     void VulkanglTFSimpleModel::loadTextures(tinygltf::Model& input) {
         textures.resize(input.textures.size());
         for (size_t i = 0; i < input.textures.size(); i++) {
-            textures[i].imageIndex = input.textures[i].source;
+            textures[i].imageIndex = getTextureSource(input.textures[i]);
         }
     }
 
@@ -106,77 +142,44 @@ namespace VulkanLearning {
                 uint32_t indexCount = 0;
 
                 // Vertices
-                const float* positionBuffer = nullptr;
-                const float* normalsBuffer = nullptr;
-                const float* texCoordsBuffer = nullptr;
                 size_t vertexCount = 0;
-
                 if (glTFPrimitive.attributes.find("POSITION") != glTFPrimitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.attributes.find("POSITION")->second];
-                    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
-                    positionBuffer = reinterpret_cast<const float*>(&(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                    vertexCount = accessor.count;
-                }
-                if (glTFPrimitive.attributes.find("NORMAL") != glTFPrimitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.attributes.find("NORMAL")->second];
-                    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
-                    normalsBuffer = reinterpret_cast<const float*>(&(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
-                }
-                if (glTFPrimitive.attributes.find("TEXCOORD_0") != glTFPrimitive.attributes.end()) {
-                    const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.attributes.find("TEXCOORD_0")->second];
-                    const tinygltf::BufferView& view = input.bufferViews[accessor.bufferView];
-                    texCoordsBuffer = reinterpret_cast<const float*>(&(input.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset]));
+                    vertexCount = input.accessors[glTFPrimitive.attributes.find("POSITION")->second].count;
                 }
 
-                for (size_t v = 0; v < vertexCount; v++) {
-                    Vertex vert{};
-                    vert.pos = glm::vec4(glm::make_vec3(&positionBuffer[v * 3]), 1.0f);
-                    vert.normal = glm::normalize(glm::vec3(normalsBuffer ? glm::make_vec3(&normalsBuffer[v * 3]) : glm::vec3(0.0f)));
-                    vert.uv = texCoordsBuffer ? glm::make_vec2(&texCoordsBuffer[v * 2]) : glm::vec3(0.0f);
-                    vert.color = glm::vec3(1.0f);
-                    vertexBuffer.push_back(vert);
+                Vertex defaultVertex;
+                defaultVertex.pos = glm::vec3(0.0f);
+                defaultVertex.normal = glm::vec3(0.0f);
+                defaultVertex.uv = glm::vec2(0.0f);
+                defaultVertex.color = glm::vec3(1.0f);
+                vertexBuffer.resize(vertexStart + vertexCount, defaultVertex);
+                Vertex* vertices = vertexBuffer.data() + vertexStart;
+
+                auto readAttribute = [&](const char* name, float* dst, uint32_t components) {
+                    auto attribute = glTFPrimitive.attributes.find(name);
+                    if (vertexCount == 0 || attribute == glTFPrimitive.attributes.end()) {
+                        return false;
+                    }
+                    return readAccessor(input, input.accessors[attribute->second], dst, sizeof(Vertex), components);
+                };
+
+                readAttribute("POSITION", glm::value_ptr(vertices[0].pos), 3);
+                if (readAttribute("NORMAL", glm::value_ptr(vertices[0].normal), 3)) {
+                    for (size_t v = 0; v < vertexCount; v++) {
+                        vertices[v].normal = glm::normalize(vertices[v].normal);
+                    }
                 }
+                readAttribute("TEXCOORD_0", glm::value_ptr(vertices[0].uv), 2);
 
 
                 // Indices
                 const tinygltf::Accessor& accessor = input.accessors[glTFPrimitive.indices];
-                const tinygltf::BufferView& bufferView = input.bufferViews[accessor.bufferView];
-                const tinygltf::Buffer& buffer = input.buffers[bufferView.buffer];
 
                 indexCount += static_cast<uint32_t>(accessor.count);
-
-                switch (accessor.componentType) {
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-                                                                   uint32_t* buf = new uint32_t[accessor.count];
-                                                                   memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint32_t));
-                                                                   for (size_t index = 0; index < accessor.count; index++) {
-                                                                       indexBuffer.push_back(buf[index] + vertexStart);
-                                                                   }
-                                                                   break;
-                                                               }
-
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-                                                                     uint16_t* buf = new uint16_t[accessor.count];
-                                                                     memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint16_t));
-                                                                     for (size_t index = 0; index < accessor.count; index++) {
-                                                                         indexBuffer.push_back(buf[index] + vertexStart);
-                                                                     }
-                                                                     break;
-                                                                 }
-
-                    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:  {
-                                                                     uint8_t* buf = new uint8_t[accessor.count];
-                                                                     memcpy(buf, &buffer.data[accessor.byteOffset + bufferView.byteOffset], accessor.count * sizeof(uint8_t));
-                                                                     for (size_t index = 0; index < accessor.count; index++) {
-                                                                         indexBuffer.push_back(buf[index] + vertexStart);
-                                                                     }
-                                                                     break;
-                                                                 }
-
-                    default:
-                                                                 std::cerr << "Index component type " << accessor.componentType << " not supported!" << std::endl;
-                                                                 return;
-
+                indexBuffer.resize(firstIndex + indexCount);
+                if (!readIndices(input, accessor, indexBuffer.data() + firstIndex, vertexStart)) {
+                    indexBuffer.resize(firstIndex);
+                    return;
                 }
 
                 Primitive primitive{};
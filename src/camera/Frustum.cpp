@@ -0,0 +1,116 @@
+#include "camera/Frustum.hpp"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define FRUSTUM_NEON
+#include <arm_neon.h>
+#endif
+
+namespace VulkanLearning {
+
+    Frustum::Frustum() {
+        update(glm::mat4(1.0f));
+    }
+
+    void Frustum::update(const glm::mat4& viewProjection) {
+        // Gribb/Hartmann, rows of the matrix are the columns of its transpose
+        const glm::mat4 m = glm::transpose(viewProjection);
+        planes[Left] = m[3] + m[0];
+        planes[Right] = m[3] - m[0];
+        planes[Bottom] = m[3] + m[1];
+        planes[Top] = m[3] - m[1];
+        planes[Near] = m[3] + m[2];
+        planes[Far] = m[3] - m[2];
+        for (glm::vec4& plane : planes) {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f) {
+                plane /= length;
+            }
+        }
+
+        for (uint32_t i = 0; i < 8; i++) {
+            const glm::vec4& plane = planes[i < 6 ? i : Far];
+            for (uint32_t component = 0; component < 4; component++) {
+                m_planeGroups[i / 4][component][i % 4] = plane[component];
+            }
+        }
+    }
+
+    bool Frustum::checkSphere(glm::vec3 center, float radius) const {
+        for (const glm::vec4& plane : planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Frustum::checkBox(glm::vec3 center, glm::vec3 extent) const {
+#if defined(FRUSTUM_SSE)
+        const __m128 signMask = _mm_set1_ps(-0.0f);
+        const __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+        const __m128 ex = _mm_set1_ps(extent.x), ey = _mm_set1_ps(extent.y), ez = _mm_set1_ps(extent.z);
+        int outside = 0;
+        for (uint32_t group = 0; group < 2; group++) {
+            const __m128 px = _mm_load_ps(m_planeGroups[group][0]);
+            const __m128 py = _mm_load_ps(m_planeGroups[group][1]);
+            const __m128 pz = _mm_load_ps(m_planeGroups[group][2]);
+            const __m128 pw = _mm_load_ps(m_planeGroups[group][3]);
+            // Signed distance of the center plus the box's projected radius onto each normal
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_add_ps(_mm_mul_ps(pz, cz), pw));
+            __m128 radius = _mm_add_ps(_mm_add_ps(
+                        _mm_mul_ps(_mm_andnot_ps(signMask, px), ex),
+                        _mm_mul_ps(_mm_andnot_ps(signMask, py), ey)),
+                    _mm_mul_ps(_mm_andnot_ps(signMask, pz), ez));
+            outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+        }
+        return outside == 0;
+#elif defined(FRUSTUM_NEON)
+        const float32x4_t cx = vdupq_n_f32(center.x), cy = vdupq_n_f32(center.y), cz = vdupq_n_f32(center.z);
+        const float32x4_t ex = vdupq_n_f32(extent.x), ey = vdupq_n_f32(extent.y), ez = vdupq_n_f32(extent.z);
+        uint32x4_t outside = vdupq_n_u32(0);
+        for (uint32_t group = 0; group < 2; group++) {
+            const float32x4_t px = vld1q_f32(m_planeGroups[group][0]);
+            const float32x4_t py = vld1q_f32(m_planeGroups[group][1]);
+            const float32x4_t pz = vld1q_f32(m_planeGroups[group][2]);
+            const float32x4_t pw = vld1q_f32(m_planeGroups[group][3]);
+            float32x4_t distance = vmlaq_f32(vmlaq_f32(vmlaq_f32(pw, px, cx), py, cy), pz, cz);
+            float32x4_t radius = vmlaq_f32(vmlaq_f32(vmulq_f32(vabsq_f32(px), ex), vabsq_f32(py), ey), vabsq_f32(pz), ez);
+            outside = vorrq_u32(outside, vcltq_f32(vaddq_f32(distance, radius), vdupq_n_f32(0.0f)));
+        }
+        uint32x2_t folded = vorr_u32(vget_low_u32(outside), vget_high_u32(outside));
+        return (vget_lane_u32(folded, 0) | vget_lane_u32(folded, 1)) == 0;
+#else
+        for (const glm::vec4& plane : planes) {
+            float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+            float radius = glm::dot(glm::abs(glm::vec3(plane)), extent);
+            if (distance + radius < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+#endif
+    }
+
+    size_t Frustum::checkBoxes(const glm::vec3* centers, const glm::vec3* extents, uint8_t* visible, size_t count) const {
+        size_t visibleCount = 0;
+        for (size_t i = 0; i < count; i++) {
+            visible[i] = checkBox(centers[i], extents[i]) ? 1 : 0;
+            visibleCount += visible[i];
+        }
+        return visibleCount;
+    }
+
+    void Frustum::transformBox(const glm::mat4& matrix, glm::vec3 min, glm::vec3 max, glm::vec3& center, glm::vec3& extent) {
+        // Arvo: the extent along each world axis is the absolute matrix applied to the local extent
+        const glm::vec3 localCenter = (min + max) * 0.5f;
+        const glm::vec3 localExtent = (max - min) * 0.5f;
+        center = glm::vec3(matrix * glm::vec4(localCenter, 1.0f));
+        const glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+        extent = absolute * localExtent;
+    }
+}
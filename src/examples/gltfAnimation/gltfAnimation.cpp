@@ -0,0 +1,471 @@
+#define TINYGLTF_IMPLEMENTATION
+#include "VulkanBase.hpp"
+#include "VulkanglTFModel.hpp"
+#include "VulkanComputeSkinning.hpp"
+
+namespace VulkanLearning {
+
+    class VulkanExample : public VulkanBase {
+
+        private:
+            VulkanglTFModel model;
+            // Skins CesiumMan's vertices every frame before the render pass draws them
+            VulkanComputeSkinning m_skinning{&m_device};
+
+            VulkanDescriptorSets m_descriptorSets;
+            VkPipelineLayout m_pipelineLayout;
+            VkPipeline m_pipeline;
+
+            bool m_animate = true;
+            float m_animationTime = 0.0f;
+
+            struct ubo {
+                VulkanBuffer buffer;
+                struct Values {
+                    glm::mat4 projection;
+                    glm::mat4 view;
+                    glm::vec4 lightPos = glm::vec4(3.0f, 3.0f, -3.0f, 1.0f);
+                } values;
+            } ubo;
+
+        public:
+            VulkanExample() {}
+            ~VulkanExample() {}
+
+            void run() {
+                VulkanBase::run();
+            }
+
+        private:
+            void initVulkan() override {
+                m_msaaSamples = 64;
+
+                VulkanBase::initVulkan();
+                m_window.setTitle("glTF Animation");
+
+                loadAssets();
+
+                createDescriptorSetLayout();
+                createGraphicsPipeline();
+
+                createUniformBuffers();
+                createDescriptorPool();
+                createDescriptorSets();
+                createCommandBuffers();
+            }
+
+            void drawFrame() override {
+                uint32_t imageIndex;
+                VulkanBase::acquireFrame(&imageIndex);
+                updateUniformBuffers();
+                updateAnimation();
+                // The image's previous submission is done, its region of the node matrices can be rewritten
+                model.updateNodeTransforms(imageIndex);
+                m_skinning.update(imageIndex);
+                VK_CHECK_RESULT(vkQueueSubmit(m_device.getGraphicsQueue(), 1, &m_submitInfo, m_syncObjects.getInFlightFences()[m_currentFrame]));
+                VulkanBase::presentFrame(imageIndex);
+            }
+
+            void createRenderPass() override {
+                VkAttachmentDescription colorAttachment{};
+                colorAttachment.format = m_swapChain.getImageFormat();
+                colorAttachment.samples = m_device.getMsaaSamples();
+                colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentDescription depthAttachment{};
+                depthAttachment.format = m_device.findDepthFormat();
+                depthAttachment.samples = m_device.getMsaaSamples();
+                depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentDescription colorAttachmentResolve{};
+                colorAttachmentResolve.format = m_swapChain.getImageFormat();
+                colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+                colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+                VkAttachmentReference colorAttachmentRef{};
+                colorAttachmentRef.attachment = 0;
+                colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentReference depthAttachmentRef{};
+                depthAttachmentRef.attachment = 1;
+                depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentReference colorAttachmentResolveRef{};
+                colorAttachmentResolveRef.attachment = 2;
+                colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkSubpassDescription subpass{};
+                subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+                subpass.colorAttachmentCount = 1;
+                subpass.pColorAttachments = &colorAttachmentRef;
+                subpass.pDepthStencilAttachment = &depthAttachmentRef;
+                subpass.pResolveAttachments = &colorAttachmentResolveRef;
+
+                const std::vector<VkAttachmentDescription> attachments = 
+                { colorAttachment, depthAttachment, colorAttachmentResolve };
+
+                m_renderPass = VulkanRenderPass(m_swapChain, m_device);
+                m_renderPass.create(attachments, subpass);
+            }
+
+            void createGraphicsPipeline() override {
+                // Set 0: scene uniforms, set 1: the model's node matrices
+                const std::array<VkDescriptorSetLayout, 2> setLayouts = {
+                    m_descriptorSetLayout.getDescriptorSetLayout(),
+                    descriptorSetLayoutNodeTransforms
+                };
+                VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+                pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+                pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+                vkCreatePipelineLayout(
+                        m_device.getLogicalDevice(), 
+                        &pipelineLayoutInfo, 
+                        nullptr, 
+                        &m_pipelineLayout);
+
+                VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+                inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+                inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+                inputAssembly.flags = 0;
+                inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+                VkPipelineRasterizationStateCreateInfo rasterizer = {};
+                rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+                rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+                rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+                rasterizer.flags = 0;
+                rasterizer.depthClampEnable = VK_FALSE;
+                rasterizer.lineWidth = 1.0f;
+
+                VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+                colorBlendAttachment.colorWriteMask = 0xf;
+                colorBlendAttachment.blendEnable = VK_FALSE;
+
+                VkPipelineColorBlendStateCreateInfo colorBlending{};
+                colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                colorBlending.attachmentCount = 1;
+                colorBlending.pAttachments = &colorBlendAttachment;
+
+                VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
+                depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depthStencilState.depthTestEnable = VK_TRUE;
+                depthStencilState.depthWriteEnable = VK_TRUE;
+                depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+                depthStencilState.back.compareOp = VK_COMPARE_OP_ALWAYS;
+
+                VkViewport viewport{};
+                viewport.x = 0.0f;
+                viewport.y = 0.0f;
+                viewport.width = (float) m_swapChain.getExtent().width;
+                viewport.height = (float) m_swapChain.getExtent().height;
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+
+                VkRect2D scissor{};
+                scissor.offset = {0, 0};
+                scissor.extent = m_swapChain.getExtent();
+
+                VkPipelineViewportStateCreateInfo viewportState{};
+                viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+                viewportState.viewportCount = 1;
+                viewportState.pViewports = &viewport;
+                viewportState.scissorCount = 1;
+                viewportState.pScissors = &scissor;
+
+                const std::vector<VkDynamicState> dynamicStates = {
+                    VK_DYNAMIC_STATE_VIEWPORT,
+                    VK_DYNAMIC_STATE_SCISSOR,
+                    VK_DYNAMIC_STATE_LINE_WIDTH
+                };
+
+                VkPipelineDynamicStateCreateInfo dynamicState{};
+                dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+                dynamicState.pDynamicStates = dynamicStates.data();
+                dynamicState.dynamicStateCount = 3;
+                dynamicState.flags = 0;
+
+                VkPipelineMultisampleStateCreateInfo multisampling{};
+                if (m_device.getMsaaSamples() > 1) {
+                    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                    multisampling.sampleShadingEnable = VK_TRUE;
+                    multisampling.minSampleShading = 0.2f;
+                    multisampling.rasterizationSamples = m_device.getMsaaSamples();
+                } else {
+                    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                    multisampling.sampleShadingEnable = VK_FALSE;
+                    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+                }
+
+                VulkanShaderModule vertShaderModule = 
+                    VulkanShaderModule(
+                            "src/shaders/glTFAnimationVert.spv", 
+                            &m_device, 
+                            VK_SHADER_STAGE_VERTEX_BIT);
+                VulkanShaderModule fragShaderModule = 
+                    VulkanShaderModule(
+                            "src/shaders/glTFCompleteLoaderFrag.spv", 
+                            &m_device, 
+                            VK_SHADER_STAGE_FRAGMENT_BIT);
+
+                VkPipelineShaderStageCreateInfo shaderStages[] = {
+                    vertShaderModule.getStageCreateInfo(), 
+                    fragShaderModule.getStageCreateInfo()
+                };
+
+                VkGraphicsPipelineCreateInfo pipelineInfo{};
+                pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+                pipelineInfo.stageCount = 2;
+                pipelineInfo.pStages = shaderStages;
+                pipelineInfo.pInputAssemblyState = &inputAssembly;
+                pipelineInfo.pViewportState = &viewportState;
+                pipelineInfo.pRasterizationState = &rasterizer;
+                pipelineInfo.pMultisampleState = &multisampling;
+                pipelineInfo.pDepthStencilState = &depthStencilState;
+                pipelineInfo.pColorBlendState = &colorBlending;
+                pipelineInfo.layout = m_pipelineLayout;
+                pipelineInfo.renderPass = m_renderPass.getRenderPass();
+                pipelineInfo.subpass = 0;
+                pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+                pipelineInfo.pDynamicState = &dynamicState;
+                const std::vector<VertexComponent> vertexComponents = {
+                    VertexComponent::Position,
+                    VertexComponent::Normal,
+                    VertexComponent::Color};
+                pipelineInfo.pVertexInputState = Vertex::getPipelineVertexInputState(vertexComponents);
+
+                VK_CHECK_RESULT(vkCreateGraphicsPipelines(
+                            m_device.getLogicalDevice(), 
+                            VK_NULL_HANDLE, 
+                            1, 
+                            &pipelineInfo, 
+                            nullptr, 
+                            &m_pipeline));
+
+                vkDestroyShaderModule(
+                        m_device.getLogicalDevice(), 
+                        vertShaderModule.getModule(), 
+                        nullptr);
+                vkDestroyShaderModule(
+                        m_device.getLogicalDevice(), 
+                        fragShaderModule.getModule(), 
+                        nullptr);
+            }
+
+            void createUniformBuffers() {
+                ubo.buffer = VulkanBuffer(m_device);
+                ubo.buffer.createBuffer(sizeof(ubo.values), 
+                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+                ubo.buffer.map();
+
+                updateUniformBuffers();
+            }
+
+            void createCommandBuffers() override {
+                // Called again whenever the recording changes, always with the device idle
+                freeCommandBuffers();
+                m_commandBuffers.resize(m_swapChain.getImages().size());
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = m_device.getCommandPool();
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount = (uint32_t) m_commandBuffers.size();
+
+                if (vkAllocateCommandBuffers(m_device.getLogicalDevice(), &allocInfo, m_commandBuffers.data()->getCommandBufferPointer()) != VK_SUCCESS) {
+                    throw std::runtime_error("Command buffers allocation failed!");
+                }
+
+                VkClearValue clearValues[2];
+                clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+                clearValues[1].depthStencil = { 1.0f, 0 };
+
+                VkViewport viewport = {};
+                viewport.width = m_swapChain.getExtent().width;
+                viewport.height = m_swapChain.getExtent().height;
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+
+                VkRect2D scissor = {};
+                scissor.extent.width = m_swapChain.getExtent().width;
+                scissor.extent.height = m_swapChain.getExtent().height;
+                scissor.offset.x = 0;
+                scissor.offset.y = 0;
+
+                for (uint32_t i = 0; i < m_commandBuffers.size(); ++i)
+                {
+                    VkCommandBuffer commandBuffer = m_commandBuffers[i].getCommandBuffer();
+
+                    VkCommandBufferBeginInfo beginInfo{};
+                    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    beginInfo.flags = 0;
+                    beginInfo.pInheritanceInfo = nullptr;
+
+                    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                        throw std::runtime_error("Begin recording of a command buffer failed!");
+                    }
+
+                    VkRenderPassBeginInfo renderPassBeginInfo = {};
+                    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    renderPassBeginInfo.renderPass = m_renderPass.getRenderPass();
+                    renderPassBeginInfo.renderArea.offset.x = 0;
+                    renderPassBeginInfo.renderArea.offset.y = 0;
+                    renderPassBeginInfo.renderArea.extent.width = m_swapChain.getExtent().width;
+                    renderPassBeginInfo.renderArea.extent.height = m_swapChain.getExtent().height;
+                    renderPassBeginInfo.clearValueCount = 2;
+                    renderPassBeginInfo.pClearValues = clearValues;
+                    renderPassBeginInfo.framebuffer = m_framebuffers[i];
+
+                    m_skinning.dispatch(commandBuffer, i);
+
+                    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+                    vkCmdBindDescriptorSets(
+                            commandBuffer, 
+                            VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                            m_pipelineLayout,
+                            0, 
+                            1, 
+                            &m_descriptorSets.getDescriptorSets()[i], 
+                            0, 
+                            nullptr);
+                    // Command buffers are recorded per swap chain image, so is the node matrices region.
+                    // Every draw passes its mesh's slot as first instance, the shader reads nodes[gl_InstanceIndex]
+                    model.bindNodeTransforms(commandBuffer, m_pipelineLayout, 1, i);
+                    m_skinning.bindBuffers(commandBuffer);
+                    model.draw(commandBuffer);
+
+                    drawUI(commandBuffer);
+
+                    vkCmdEndRenderPass(commandBuffer);
+                    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                        throw std::runtime_error("Recording of a command buffer failed!");
+                    }
+                }
+            }
+
+            void createDescriptorSetLayout() override {
+                m_descriptorSetLayout = VulkanDescriptorSetLayout(m_device);
+
+                VkDescriptorSetLayoutBinding uboLayoutBinding{};
+                uboLayoutBinding.binding = 0;
+                uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                uboLayoutBinding.descriptorCount = 1;
+                uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+                uboLayoutBinding.pImmutableSamplers = nullptr;
+
+                std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings = { 
+                    uboLayoutBinding
+                };
+
+                m_descriptorSetLayout.create(descriptorSetLayoutBindings);
+            }
+
+            void createDescriptorPool() override {
+                m_descriptorPool = VulkanDescriptorPool(m_device, m_swapChain);
+
+                std::vector<VkDescriptorPoolSize> poolSizes = std::vector<VkDescriptorPoolSize>(1);
+
+                poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                poolSizes[0].descriptorCount = static_cast<uint32_t>(
+                        m_swapChain.getImages().size());
+
+                m_descriptorPool.create(poolSizes);
+            }
+
+            void createDescriptorSets() override {
+                m_descriptorSets = VulkanDescriptorSets(
+                        m_device, 
+                        m_descriptorSetLayout,
+                        m_descriptorPool);
+
+                m_descriptorSets.create(static_cast<uint32_t>(m_swapChain.getImages().size()));
+
+                for (size_t i = 0; i < m_swapChain.getImages().size(); i++) {
+                    std::vector<VkWriteDescriptorSet> descriptorWrites(1);
+
+                    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[0].dstBinding = 0;
+                    descriptorWrites[0].dstArrayElement = 0;
+                    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    descriptorWrites[0].descriptorCount = 1;
+                    descriptorWrites[0].pBufferInfo = ubo.buffer.getDescriptorPointer();
+
+                    m_descriptorSets.update(descriptorWrites, i);
+                }
+
+            }
+
+            glm::mat4 getProjectionMatrix() {
+                glm::mat4 projection = glm::perspective(glm::radians(m_camera.getZoom()), 
+                        m_swapChain.getExtent().width / (float) m_swapChain.getExtent().height, 
+                        0.1f,  100.0f);
+                projection[1][1] *= -1;
+                return projection;
+            }
+
+            void updateUniformBuffers() {
+                ubo.values.projection = getProjectionMatrix();
+                ubo.values.view = m_camera.getViewMatrix();
+                memcpy(ubo.buffer.getMappedMemory(), &ubo.values, sizeof(ubo.values));
+            }
+
+            void updateAnimation() {
+                if (!m_animate || model.animations.empty()) {
+                    return;
+                }
+                const Animation& animation = model.animations[0];
+                m_animationTime += m_fpsCounter.getDeltaTime();
+                if (m_animationTime > animation.end) {
+                    m_animationTime = animation.start;
+                }
+                // Refreshes the world matrices and the node matrices of the meshes below the animated nodes
+                model.updateAnimation(0, m_animationTime);
+            }
+
+            void loadAssets() {
+                // Node matrices are applied by the vertex shader, not baked into the vertices
+                const uint32_t glTFLoadingFlags = FileLoadingFlags::PreMultiplyVertexColors;
+                model.loadFromFile(
+                        "src/models/CesiumMan/glTF/CesiumMan.gltf",
+                        &m_device,
+                        m_device.getGraphicsQueue(),
+                        glTFLoadingFlags);
+                // Joint matrices are written per swap chain image, like the node transforms
+                m_skinning.create(&model);
+                m_camera.setPosition(glm::vec3(0.0f, 0.0f, 2.5f * model.dimensions.radius));
+            }
+
+            void OnUpdateUI (UI *ui) override {
+                if (ui->header("Settings")) {
+                    ui->checkBox("Animate", &m_animate);
+                    ui->text("Joints: %u", m_skinning.getJointCount());
+                }
+            }
+
+    };
+
+}
+
+VULKAN_EXAMPLE_MAIN()
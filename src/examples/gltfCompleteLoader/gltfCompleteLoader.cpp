@@ -1,13 +1,16 @@
 #define TINYGLTF_IMPLEMENTATION
 #include "VulkanBase.hpp"
 #include "VulkanglTFModel.hpp"
+#include "VulkanMeshletCulling.hpp"
+#include "VulkanIndirectRenderer.hpp"
 
 namespace VulkanLearning {
 
     class VulkanExample : public VulkanBase {
 
         private:
-            VulkanglTFModel model;
+            // Replaced when a loading option changes
+            std::unique_ptr<VulkanglTFModel> model = std::make_unique<VulkanglTFModel>();
 
             VulkanDescriptorSets m_descriptorSets;
             VkPipelineLayout m_pipelineLayout;
@@ -15,6 +18,31 @@ namespace VulkanLearning {
             VkPipeline m_pipeline;
             VkPipeline m_wireframePipeline = VK_NULL_HANDLE;
             bool m_wireframe = false;
+            // Loads the model with 24 byte quantized vertices instead of the full layout
+            bool m_compactVertices = false;
+            // Reorders each primitive for the vertex cache, overdraw and vertex fetch at load time
+            bool m_optimizeMeshes = false;
+            // Builds a LOD chain per primitive and picks a level from its projected size every frame
+            bool m_generateLods = false;
+            // Draws the meshlets left by the GPU frustum and cone culling instead of the LOD selection
+            bool m_meshletCulling = false;
+            // Writes the processed geometry and mip chains next to the model on the first run, later runs map them
+            bool m_assetCache = false;
+            // Renders right away with placeholder textures and uploads their levels smallest first over the next frames
+            bool m_streamTextures = false;
+            // Cooks textures to BC7, the cache then holds the compressed chains
+            bool m_compressTextures = false;
+            // Keeps only the mip levels the visible primitives need in memory, within the device's budget
+            bool m_textureResidency = false;
+            // Set when one of the options above changes in the UI, the next UI update reloads the model
+            bool m_reloadModel = false;
+            // Skips primitives whose transformed bounds are outside the camera frustum
+            bool m_frustumCulling = false;
+            Frustum m_frustum;
+            VulkanMeshletCulling m_culling{&m_device};
+            // Culls primitives in a compute pass and draws each alpha mode with one indirect call
+            bool m_gpuDriven = false;
+            VulkanIndirectRenderer m_indirectRenderer{&m_device};
 
             struct ubo {
                 VulkanBuffer buffer;
@@ -22,6 +50,7 @@ namespace VulkanLearning {
                     glm::mat4 projection;
                     glm::mat4 model;
                     glm::vec4 lightPos = glm::vec4(3.0f, 3.0f, -3.0f, 1.0f);
+                    glm::vec4 dequantization = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
                 } values;
             } ubo;
 
@@ -203,7 +232,7 @@ namespace VulkanLearning {
 
                 VulkanShaderModule vertShaderModule = 
                     VulkanShaderModule(
-                            "src/shaders/glTFCompleteLoaderVert.spv", 
+                            model->compactVertices ? "src/shaders/glTFCompleteLoaderCompactVert.spv" : "src/shaders/glTFCompleteLoaderVert.spv", 
                             &m_device, 
                             VK_SHADER_STAGE_VERTEX_BIT);
                 VulkanShaderModule fragShaderModule = 
@@ -232,10 +261,13 @@ namespace VulkanLearning {
                 pipelineInfo.subpass = 0;
                 pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
                 pipelineInfo.pDynamicState = &dynamicState;
-                pipelineInfo.pVertexInputState = Vertex::getPipelineVertexInputState({
-                        VertexComponent::Position,
-                        VertexComponent::Normal,
-                        VertexComponent::Color});
+                const std::vector<VertexComponent> vertexComponents = {
+                    VertexComponent::Position,
+                    VertexComponent::Normal,
+                    VertexComponent::Color};
+                pipelineInfo.pVertexInputState = model->compactVertices ?
+                    CompactVertex::getPipelineVertexInputState(vertexComponents) :
+                    Vertex::getPipelineVertexInputState(vertexComponents);
 
                 VK_CHECK_RESULT(vkCreateGraphicsPipelines(
                             m_device.getLogicalDevice(), 
@@ -277,6 +309,8 @@ namespace VulkanLearning {
             }
 
             void createCommandBuffers() override {
+                // Called again whenever the recording changes, always with the device idle
+                freeCommandBuffers();
                 m_commandBuffers.resize(m_swapChain.getImages().size());
 
                 VkCommandBufferAllocateInfo allocInfo{};
@@ -319,6 +353,11 @@ namespace VulkanLearning {
                     if (vkBeginCommandBuffer(m_commandBuffers[i].getCommandBuffer(), &beginInfo) != VK_SUCCESS) {
                         throw std::runtime_error("Begin recording of a command buffer failed!");
                     }
+                    if (m_meshletCulling) {
+                        m_culling.dispatch(m_commandBuffers[i].getCommandBuffer());
+                    } else if (m_gpuDriven) {
+                        m_indirectRenderer.dispatch(m_commandBuffers[i].getCommandBuffer());
+                    }
                     VkRenderPassBeginInfo renderPassBeginInfo = {};
                     renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
                     renderPassBeginInfo.renderPass = m_renderPass.getRenderPass();
@@ -355,7 +394,13 @@ namespace VulkanLearning {
                             nullptr);
 
 
-                    model.draw(m_commandBuffers[i].getCommandBuffer());
+                    if (m_meshletCulling) {
+                        m_culling.draw(m_commandBuffers[i].getCommandBuffer());
+                    } else if (m_gpuDriven) {
+                        m_indirectRenderer.draw(m_commandBuffers[i].getCommandBuffer());
+                    } else {
+                        model->draw(m_commandBuffers[i].getCommandBuffer());
+                    }
 
                     drawUI(m_commandBuffers[i].getCommandBuffer());
 
@@ -418,25 +463,135 @@ namespace VulkanLearning {
 
             }
 
-            void updateUniformBuffers() {
-                ubo.values.projection = glm::perspective(glm::radians(m_camera.getZoom()), 
+            glm::mat4 getProjectionMatrix() {
+                glm::mat4 projection = glm::perspective(glm::radians(m_camera.getZoom()), 
                         m_swapChain.getExtent().width / (float) m_swapChain.getExtent().height, 
                         0.1f,  100.0f);
-                ubo.values.projection[1][1] *= -1;
+                projection[1][1] *= -1;
+                return projection;
+            }
+
+            void updateUniformBuffers() {
+                ubo.values.projection = getProjectionMatrix();
                 ubo.values.model = m_camera.getViewMatrix();
+                ubo.values.dequantization = model->dequantization;
                 memcpy(ubo.buffer.getMappedMemory(), &ubo.values, sizeof(ubo.values));
+
+                const glm::vec3 cameraPosition = glm::vec3(glm::inverse(ubo.values.model)[3]);
+                const float projectionScale = std::abs(ubo.values.projection[1][1]) * m_swapChain.getExtent().height * 0.5f;
+                // Texture usage is applied by the UI update, which runs with the device idle. GPU culling
+                // doesn't update the primitives' visibility, all of them ask for their textures then
+                if (m_meshletCulling) {
+                    m_culling.update(ubo.values.projection * ubo.values.model, cameraPosition);
+                } else if (m_gpuDriven) {
+                    m_indirectRenderer.update(ubo.values.projection * ubo.values.model);
+                }
+                model->updateTextureUsage(cameraPosition, projectionScale);
+            }
+
+            // Selections that change what the pre-recorded command buffers draw. They run before the
+            // UI update, which re-records with the device idle, so the change is in this frame's submission
+            void updateDrawSelection() {
+                if (m_meshletCulling || m_gpuDriven) {
+                    return;
+                }
+                const glm::mat4 view = m_camera.getViewMatrix();
+                const glm::vec3 cameraPosition = glm::vec3(glm::inverse(view)[3]);
+                const float projectionScale = std::abs(getProjectionMatrix()[1][1]) * m_swapChain.getExtent().height * 0.5f;
+                bool changed = false;
+                if (m_frustumCulling) {
+                    m_frustum.update(getProjectionMatrix() * view);
+                    changed |= model->updateVisibility(m_frustum);
+                }
+                if (m_generateLods) {
+                    changed |= model->selectLods(cameraPosition, projectionScale);
+                }
+                if (changed) {
+                    m_ui.updated = true;
+                }
+            }
+
+            void showAllPrimitives() {
+                for (Node* node : model->linearNodes) {
+                    if (!node->mesh) {
+                        continue;
+                    }
+                    for (Primitive* primitive : node->mesh->primitives) {
+                        primitive->visible = true;
+                    }
+                }
             }
 
             void loadAssets() {
                 uint32_t glTFLoadingFlags = 
                     FileLoadingFlags::PreTransformVertices 
                     | FileLoadingFlags::PreMultiplyVertexColors;
+                if (m_compactVertices) {
+                    glTFLoadingFlags |= FileLoadingFlags::CompactVertices;
+                }
+                if (m_optimizeMeshes) {
+                    glTFLoadingFlags |= FileLoadingFlags::OptimizeMeshes;
+                }
+                if (m_generateLods) {
+                    glTFLoadingFlags |= FileLoadingFlags::GenerateLods;
+                }
+                if (m_meshletCulling) {
+                    glTFLoadingFlags |= FileLoadingFlags::BuildMeshlets;
+                }
+                if (m_assetCache) {
+                    glTFLoadingFlags |= FileLoadingFlags::UseAssetCache;
+                }
+                if (m_streamTextures) {
+                    glTFLoadingFlags |= FileLoadingFlags::StreamTextures;
+                }
+                if (m_compressTextures) {
+                    glTFLoadingFlags |= FileLoadingFlags::CompressTextures;
+                }
+                if (m_textureResidency) {
+                    glTFLoadingFlags |= FileLoadingFlags::ManageTextureResidency;
+                }
 
-                    model.loadFromFile(
+                    model->loadFromFile(
                             "src/models/sphere.gltf", 
                             &m_device, 
                             m_device.getGraphicsQueue(), 
                             glTFLoadingFlags);
+                if (m_meshletCulling) {
+                    m_culling.create(model.get());
+                } else if (m_gpuDriven) {
+                    m_indirectRenderer.create(model.get());
+                }
+            }
+
+            void reloadModel() {
+                m_culling.cleanup();
+                m_indirectRenderer.cleanup();
+                vkDestroyPipeline(m_device.getLogicalDevice(), m_pipeline, nullptr);
+                vkDestroyPipeline(m_device.getLogicalDevice(), m_wireframePipeline, nullptr);
+                vkDestroyPipelineLayout(m_device.getLogicalDevice(), m_pipelineLayout, nullptr);
+
+                // The vertex layout may change with the options, so the pipelines are created again
+                model = std::make_unique<VulkanglTFModel>();
+                loadAssets();
+                createGraphicsPipeline();
+                m_ui.updated = true;
+            }
+
+            void updateUI() override {
+                // Views and descriptor sets of streamed and managed textures are replaced, nothing may be in flight
+                vkDeviceWaitIdle(m_device.getLogicalDevice());
+                if (m_reloadModel) {
+                    m_reloadModel = false;
+                    reloadModel();
+                }
+                if (model->updateTextureStreaming()) {
+                    m_ui.updated = true;
+                }
+                if (model->updateTextureResidency()) {
+                    m_ui.updated = true;
+                }
+                updateDrawSelection();
+                VulkanBase::updateUI();
             }
 
             void OnUpdateUI (UI *ui) override {
@@ -444,6 +599,43 @@ namespace VulkanLearning {
                     if (ui->checkBox("Wireframe", &m_wireframe)) {
                         createCommandBuffers();
                     }
+                    if (!m_meshletCulling && !m_gpuDriven && ui->checkBox("Frustum culling", &m_frustumCulling) && !m_frustumCulling) {
+                        showAllPrimitives();
+                    }
+                    if (m_meshletCulling) {
+                        ui->checkBox("Cone culling", &m_culling.coneCulling);
+                    } else if (m_generateLods) {
+                        ui->text("Triangles: %zu", model->selectedTriangleCount);
+                    }
+                    if (m_gpuDriven && !m_meshletCulling) {
+                        ui->text("Indirect draws: %u objects, %s", m_indirectRenderer.getObjectCount(),
+                                m_indirectRenderer.usesDrawIndirectCount() ? "draw count" : "multi draw");
+                    } else if (m_frustumCulling && !m_meshletCulling) {
+                        ui->text("Primitives: %u visible, %u culled", model->visiblePrimitiveCount, model->culledPrimitiveCount);
+                    }
+                    if (model->getTextureStreamingPendingBytes() > 0) {
+                        ui->text("Streaming textures: %.1f MB left", model->getTextureStreamingPendingBytes() / (1024.0 * 1024.0));
+                    }
+                    if (model->manageTextureResidency) {
+                        ui->text("Resident textures: %.1f / %.1f MB", model->getResidentTextureBytes() / (1024.0 * 1024.0),
+                                model->getTextureResidencyBudget() / (1024.0 * 1024.0));
+                    }
+                    ui->text("Samplers: %u", m_device.getSamplerCount());
+                }
+                if (ui->header("Loading")) {
+                    bool changed = false;
+                    changed |= ui->checkBox("Compact vertices", &m_compactVertices);
+                    changed |= ui->checkBox("Optimize meshes", &m_optimizeMeshes);
+                    changed |= ui->checkBox("Generate LODs", &m_generateLods);
+                    changed |= ui->checkBox("Meshlet culling", &m_meshletCulling);
+                    changed |= ui->checkBox("GPU driven", &m_gpuDriven);
+                    changed |= ui->checkBox("Asset cache", &m_assetCache);
+                    changed |= ui->checkBox("Stream textures", &m_streamTextures);
+                    changed |= ui->checkBox("Compress textures", &m_compressTextures);
+                    changed |= ui->checkBox("Texture residency", &m_textureResidency);
+                    if (changed) {
+                        m_reloadModel = true;
+                    }
                 }
             }
 
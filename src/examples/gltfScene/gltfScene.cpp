@@ -14,6 +14,10 @@ namespace VulkanLearning {
 
             bool m_wireframe = false;
             VkPipeline m_wireframePipeline = VK_NULL_HANDLE;
+            // Records the flattened draw list sorted by pass, pipeline, material and depth instead of walking the nodes
+            bool m_sortedDrawList = true;
+            // Time spent recording the scene into the last command buffer
+            double m_recordTime = 0.0;
 
             struct ubo {
                 VulkanBuffer buffer;
@@ -56,6 +60,7 @@ namespace VulkanLearning {
                 loadAssets();
                 createDescriptorSetLayout();
                 createGraphicsPipeline();
+                glTFScene.buildDrawList();
 
                 createUniformBuffers();
                 createDescriptorPool();
@@ -343,6 +348,8 @@ namespace VulkanLearning {
             }
 
             void createCommandBuffers() override {
+                // Called again whenever the recording changes, always with the device idle
+                freeCommandBuffers();
                 m_commandBuffers.resize(m_swapChain.getImages().size());
 
                 VkCommandBufferAllocateInfo allocInfo{};
@@ -409,7 +416,13 @@ namespace VulkanLearning {
                             0, 
                             nullptr);
 
-                    glTFScene.draw(m_commandBuffers[i].getCommandBuffer(), m_pipelineLayout); 
+                    auto recordStart = std::chrono::high_resolution_clock::now();
+                    if (m_sortedDrawList) {
+                        glTFScene.drawSorted(m_commandBuffers[i].getCommandBuffer(), m_pipelineLayout);
+                    } else {
+                        glTFScene.draw(m_commandBuffers[i].getCommandBuffer(), m_pipelineLayout); 
+                    }
+                    m_recordTime = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - recordStart).count();
 
                     drawUI(m_commandBuffers[i].getCommandBuffer());
 
@@ -555,6 +568,15 @@ namespace VulkanLearning {
                 memcpy(ubo.buffer.getMappedMemory(), &ubo.values, sizeof(ubo.values));
             }
 
+            void updateUI() override {
+                // Command buffers are recorded up front. A changed order is re-recorded by the UI update,
+                // with the device idle, before this frame is submitted
+                if (m_sortedDrawList && glTFScene.sortDrawList(m_camera.getViewMatrix())) {
+                    m_ui.updated = true;
+                }
+                VulkanBase::updateUI();
+            }
+
             void loadglTFFile(std::string filename) {
                 tinygltf::Model glTFInput;
                 tinygltf::TinyGLTF gltfContext;
@@ -575,6 +597,10 @@ namespace VulkanLearning {
                     glTFScene.loadMaterials(glTFInput);
                     glTFScene.loadTextures(glTFInput);
                     const tinygltf::Scene& scene = glTFInput.scenes[0];
+                    size_t vertexCount, indexCount;
+                    getSceneGeometrySize(glTFInput, scene, vertexCount, indexCount);
+                    vertexBuffer.reserve(vertexCount);
+                    indexBuffer.reserve(indexCount);
                     for (size_t i = 0; i < scene.nodes.size(); i++) {
                         const tinygltf::Node node = glTFInput.nodes[scene.nodes[i]];
                         glTFScene.loadNode(node, glTFInput, nullptr, indexBuffer, vertexBuffer);
@@ -646,17 +672,30 @@ namespace VulkanLearning {
             }
 
             void OnUpdateUI (UI *ui) override {
+                if (ui->header("Draw list")) {
+                    if (ui->checkBox("Sorted draw list", &m_sortedDrawList)) {
+                        glTFScene.sortDrawList(ubo.values.model);
+                        createCommandBuffers();
+                    }
+                    ui->text("Binds: %u pipelines, %u sets, %u push constants", glTFScene.bindStatistics.pipelineBinds,
+                            glTFScene.bindStatistics.descriptorSetBinds, glTFScene.bindStatistics.pushConstants);
+                    ui->text("Draws: %u, recorded in %.1f us", glTFScene.bindStatistics.draws, m_recordTime);
+                }
                 if (ui->header("Visibility")) {
 
                     if (ui->button("All")) {
                         std::for_each(glTFScene.nodes.begin(), glTFScene.nodes.end(), 
                                 [](VulkanglTFScene::Node &node) { node.visible = true; });
+                        glTFScene.buildDrawList();
+                        glTFScene.sortDrawList(ubo.values.model);
                         createCommandBuffers();
                     }
                     ImGui::SameLine();
                     if (ui->button("None")) {
                         std::for_each(glTFScene.nodes.begin(), glTFScene.nodes.end(), 
                                 [](VulkanglTFScene::Node &node) { node.visible = false; });
+                        glTFScene.buildDrawList();
+                        glTFScene.sortDrawList(ubo.values.model);
                         createCommandBuffers();
                     }
                     ImGui::NewLine();
@@ -666,6 +705,8 @@ namespace VulkanLearning {
                     {		
                         if (ui->checkBox(node.name.c_str(), &node.visible))
                         {
+                            glTFScene.buildDrawList();
+                            glTFScene.sortDrawList(ubo.values.model);
                             createCommandBuffers();
                         }
                     }
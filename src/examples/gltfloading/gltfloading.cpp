@@ -546,12 +546,16 @@ namespace VulkanLearning {
             void loadglTFFile(std::string filename) {
                 tinygltf::Model glTFInput;
                 tinygltf::TinyGLTF gltfContext;
+                // Defer image decoding so loadImages can spread it over worker threads
+                gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
                 std::string error, warning;
 
                 bool fileLoaded = gltfContext.LoadASCIIFromFile(&glTFInput, &error, &warning, filename);
 
                 glTFModel.device = &m_device;
                 glTFModel.copyQueue = m_device.getGraphicsQueue();
+                size_t pos = filename.find_last_of('/');
+                glTFModel.path = filename.substr(0, pos);
 
                 std::vector<uint32_t> indexBuffer;
                 std::vector<VulkanglTFSimpleModel::Vertex> vertexBuffer;
@@ -562,6 +566,10 @@ namespace VulkanLearning {
                     glTFModel.loadTextures(glTFInput);
 
                     const tinygltf::Scene& scene = glTFInput.scenes[0];
+                    size_t vertexCount, indexCount;
+                    getSceneGeometrySize(glTFInput, scene, vertexCount, indexCount);
+                    vertexBuffer.reserve(vertexCount);
+                    indexBuffer.reserve(indexCount);
                     for (size_t i = 0; i < scene.nodes.size(); i++) {
                         const tinygltf::Node node = glTFInput.nodes[scene.nodes[i]];
                         glTFModel.loadNode(node, glTFInput, nullptr, indexBuffer, vertexBuffer);
@@ -0,0 +1,624 @@
+#define TINYGLTF_IMPLEMENTATION
+#include "VulkanBase.hpp"
+#include "VulkanglTFModel.hpp"
+
+namespace VulkanLearning {
+
+    class VulkanExample : public VulkanBase {
+
+        private:
+            VulkanglTFModel model;
+
+            VulkanDescriptorSets m_descriptorSets;
+            VkPipelineLayout m_pipelineLayout;
+
+            // Reads the instance stream
+            VkPipeline m_pipeline;
+            // Reads the object's slice of the dynamic uniform buffer, as in dynamicUniformBuffers
+            VkPipeline m_dynamicPipeline;
+
+            // 0: one dynamic offset bind and full model traversal per object, 1: one instanced draw per primitive
+            int32_t m_drawMode = 1;
+            int32_t m_instanceCountIndex = 1;
+            const std::vector<uint32_t> m_instanceCounts = { 1000, 10000, 100000 };
+            const float m_spacing = 3.0f;
+
+            // Both sized for the largest count, host visible and rewritten every frame
+            VulkanBuffer m_instanceBuffer;
+            VulkanBuffer m_dynamicBuffer;
+            size_t m_dynamicAlignment = 0;
+
+            // MaterialData table indexed by InstanceData::materialIndex: the model's materials, then variations of the first one
+            VulkanBuffer m_materialBuffer;
+            uint32_t m_materialCount = 0;
+
+            struct Timings {
+                uint32_t frames = 0;
+                double frameMs = 0.0;
+                double updateMs = 0.0;
+                double recordMs = 0.0;
+                // Averages of the last 120 frames, shown in the UI
+                double averageFrameMs = 0.0;
+                double averageUpdateMs = 0.0;
+            } m_timings;
+
+            struct ubo {
+                VulkanBuffer buffer;
+                struct Values {
+                    glm::mat4 projection;
+                    glm::mat4 view;
+                    glm::vec4 lightPos = glm::vec4(3.0f, 3.0f, -3.0f, 1.0f);
+                } values;
+            } ubo;
+
+        public:
+            VulkanExample() {}
+            ~VulkanExample() {}
+
+            void run() {
+                VulkanBase::run();
+            }
+
+        private:
+            void initVulkan() override {
+                m_msaaSamples = 64;
+
+                VulkanBase::initVulkan();
+                m_window.setTitle("Instancing");
+
+                loadAssets();
+
+                createDescriptorSetLayout();
+                createGraphicsPipeline();
+
+                createUniformBuffers();
+                createMaterialBuffer();
+                createInstanceBuffers();
+                createDescriptorPool();
+                createDescriptorSets();
+                resetCamera();
+                createCommandBuffers();
+            }
+
+            void drawFrame() override {
+                auto tStart = std::chrono::high_resolution_clock::now();
+                uint32_t imageIndex;
+                VulkanBase::acquireFrame(&imageIndex);
+                updateUniformBuffers();
+                updateInstances();
+                VK_CHECK_RESULT(vkQueueSubmit(m_device.getGraphicsQueue(), 1, &m_submitInfo, m_syncObjects.getInFlightFences()[m_currentFrame]));
+                VulkanBase::presentFrame(imageIndex);
+                auto tEnd = std::chrono::high_resolution_clock::now();
+
+                m_timings.frameMs += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+                if (++m_timings.frames == 120) {
+                    m_timings.averageFrameMs = m_timings.frameMs / m_timings.frames;
+                    m_timings.averageUpdateMs = m_timings.updateMs / m_timings.frames;
+                    m_timings.frames = 0;
+                    m_timings.frameMs = 0.0;
+                    m_timings.updateMs = 0.0;
+                }
+            }
+
+            void createRenderPass() override {
+                VkAttachmentDescription colorAttachment{};
+                colorAttachment.format = m_swapChain.getImageFormat();
+                colorAttachment.samples = m_device.getMsaaSamples();
+                colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentDescription depthAttachment{};
+                depthAttachment.format = m_device.findDepthFormat();
+                depthAttachment.samples = m_device.getMsaaSamples();
+                depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentDescription colorAttachmentResolve{};
+                colorAttachmentResolve.format = m_swapChain.getImageFormat();
+                colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+                colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+                VkAttachmentReference colorAttachmentRef{};
+                colorAttachmentRef.attachment = 0;
+                colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentReference depthAttachmentRef{};
+                depthAttachmentRef.attachment = 1;
+                depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentReference colorAttachmentResolveRef{};
+                colorAttachmentResolveRef.attachment = 2;
+                colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkSubpassDescription subpass{};
+                subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+                subpass.colorAttachmentCount = 1;
+                subpass.pColorAttachments = &colorAttachmentRef;
+                subpass.pDepthStencilAttachment = &depthAttachmentRef;
+                subpass.pResolveAttachments = &colorAttachmentResolveRef;
+
+                const std::vector<VkAttachmentDescription> attachments =
+                { colorAttachment, depthAttachment, colorAttachmentResolve };
+
+                m_renderPass = VulkanRenderPass(m_swapChain, m_device);
+                m_renderPass.create(attachments, subpass);
+            }
+
+            void createGraphicsPipeline() override {
+                VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+                pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount = 1;
+                pipelineLayoutInfo.pSetLayouts = m_descriptorSetLayout.getDescriptorSetLayoutPointer();
+                vkCreatePipelineLayout(
+                        m_device.getLogicalDevice(),
+                        &pipelineLayoutInfo,
+                        nullptr,
+                        &m_pipelineLayout);
+
+                VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+                inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+                inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+                inputAssembly.flags = 0;
+                inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+                VkPipelineRasterizationStateCreateInfo rasterizer = {};
+                rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+                rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+                rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+                rasterizer.flags = 0;
+                rasterizer.depthClampEnable = VK_FALSE;
+                rasterizer.lineWidth = 1.0f;
+
+                VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+                colorBlendAttachment.colorWriteMask = 0xf;
+                colorBlendAttachment.blendEnable = VK_FALSE;
+
+                VkPipelineColorBlendStateCreateInfo colorBlending{};
+                colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                colorBlending.attachmentCount = 1;
+                colorBlending.pAttachments = &colorBlendAttachment;
+
+                VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
+                depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depthStencilState.depthTestEnable = VK_TRUE;
+                depthStencilState.depthWriteEnable = VK_TRUE;
+                depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+                depthStencilState.back.compareOp = VK_COMPARE_OP_ALWAYS;
+
+                VkViewport viewport{};
+                viewport.x = 0.0f;
+                viewport.y = 0.0f;
+                viewport.width = (float) m_swapChain.getExtent().width;
+                viewport.height = (float) m_swapChain.getExtent().height;
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+
+                VkRect2D scissor{};
+                scissor.offset = {0, 0};
+                scissor.extent = m_swapChain.getExtent();
+
+                VkPipelineViewportStateCreateInfo viewportState{};
+                viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+                viewportState.viewportCount = 1;
+                viewportState.pViewports = &viewport;
+                viewportState.scissorCount = 1;
+                viewportState.pScissors = &scissor;
+
+                const std::vector<VkDynamicState> dynamicStates = {
+                    VK_DYNAMIC_STATE_VIEWPORT,
+                    VK_DYNAMIC_STATE_SCISSOR,
+                    VK_DYNAMIC_STATE_LINE_WIDTH
+                };
+
+                VkPipelineDynamicStateCreateInfo dynamicState{};
+                dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+                dynamicState.pDynamicStates = dynamicStates.data();
+                dynamicState.dynamicStateCount = 3;
+                dynamicState.flags = 0;
+
+                VkPipelineMultisampleStateCreateInfo multisampling{};
+                if (m_device.getMsaaSamples() > 1) {
+                    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                    multisampling.sampleShadingEnable = VK_TRUE;
+                    multisampling.minSampleShading = 0.2f;
+                    multisampling.rasterizationSamples = m_device.getMsaaSamples();
+                } else {
+                    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                    multisampling.sampleShadingEnable = VK_FALSE;
+                    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+                }
+
+                VulkanShaderModule vertShaderModule =
+                    VulkanShaderModule(
+                            "src/shaders/instancingVert.spv",
+                            &m_device,
+                            VK_SHADER_STAGE_VERTEX_BIT);
+                VulkanShaderModule dynamicVertShaderModule =
+                    VulkanShaderModule(
+                            "src/shaders/instancingDynamicVert.spv",
+                            &m_device,
+                            VK_SHADER_STAGE_VERTEX_BIT);
+                VulkanShaderModule fragShaderModule =
+                    VulkanShaderModule(
+                            "src/shaders/instancingFrag.spv",
+                            &m_device,
+                            VK_SHADER_STAGE_FRAGMENT_BIT);
+
+                VkPipelineShaderStageCreateInfo shaderStages[] = {
+                    vertShaderModule.getStageCreateInfo(),
+                    fragShaderModule.getStageCreateInfo()
+                };
+
+                VkGraphicsPipelineCreateInfo pipelineInfo{};
+                pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+                pipelineInfo.stageCount = 2;
+                pipelineInfo.pStages = shaderStages;
+                pipelineInfo.pInputAssemblyState = &inputAssembly;
+                pipelineInfo.pViewportState = &viewportState;
+                pipelineInfo.pRasterizationState = &rasterizer;
+                pipelineInfo.pMultisampleState = &multisampling;
+                pipelineInfo.pDepthStencilState = &depthStencilState;
+                pipelineInfo.pColorBlendState = &colorBlending;
+                pipelineInfo.layout = m_pipelineLayout;
+                pipelineInfo.renderPass = m_renderPass.getRenderPass();
+                pipelineInfo.subpass = 0;
+                pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+                pipelineInfo.pDynamicState = &dynamicState;
+                const std::vector<VertexComponent> vertexComponents = {
+                    VertexComponent::Position,
+                    VertexComponent::Normal,
+                    VertexComponent::Color};
+                pipelineInfo.pVertexInputState = model.getInstancedInputState(vertexComponents);
+
+                VK_CHECK_RESULT(vkCreateGraphicsPipelines(
+                            m_device.getLogicalDevice(),
+                            VK_NULL_HANDLE,
+                            1,
+                            &pipelineInfo,
+                            nullptr,
+                            &m_pipeline));
+
+                shaderStages[0] = dynamicVertShaderModule.getStageCreateInfo();
+                pipelineInfo.pVertexInputState = Vertex::getPipelineVertexInputState(vertexComponents);
+                VK_CHECK_RESULT(vkCreateGraphicsPipelines(
+                            m_device.getLogicalDevice(),
+                            VK_NULL_HANDLE,
+                            1,
+                            &pipelineInfo,
+                            nullptr,
+                            &m_dynamicPipeline));
+
+                vertShaderModule.cleanup(&m_device);
+                dynamicVertShaderModule.cleanup(&m_device);
+                fragShaderModule.cleanup(&m_device);
+            }
+
+            void createUniformBuffers() {
+                ubo.buffer = VulkanBuffer(m_device);
+                ubo.buffer.createBuffer(sizeof(ubo.values),
+                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+                ubo.buffer.map();
+
+                updateUniformBuffers();
+            }
+
+            void createMaterialBuffer() {
+                std::vector<MaterialData> materials = model.getMaterialData();
+                const glm::vec3 colors[] = {
+                    { 1.0f, 0.3f, 0.3f }, { 0.3f, 1.0f, 0.3f }, { 0.3f, 0.3f, 1.0f }, { 1.0f, 1.0f, 0.3f },
+                    { 1.0f, 0.3f, 1.0f }, { 0.3f, 1.0f, 1.0f }, { 1.0f, 0.6f, 0.2f }, { 0.9f, 0.9f, 0.9f }
+                };
+                const MaterialData base = materials.front();
+                for (uint32_t i = 0; i < 8; i++) {
+                    MaterialData variant = base;
+                    variant.baseColorFactor = base.baseColorFactor * glm::vec4(colors[i], 1.0f);
+                    variant.metallicFactor = i < 4 ? 0.0f : 1.0f;
+                    variant.roughnessFactor = 0.25f * (i % 4 + 1);
+                    materials.push_back(variant);
+                }
+                m_materialCount = static_cast<uint32_t>(materials.size());
+
+                m_materialBuffer = VulkanBuffer(m_device);
+                m_materialBuffer.createWithStagingBuffer(materials, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+            }
+
+            void createInstanceBuffers() {
+                const uint32_t maxCount = m_instanceCounts.back();
+
+                m_instanceBuffer = VulkanBuffer(m_device);
+                m_instanceBuffer.createBuffer(maxCount * sizeof(InstanceData),
+                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                m_instanceBuffer.map();
+
+                size_t minUboAlignment = m_device.getMinUniformBufferOffsetAlignment();
+                m_dynamicAlignment = sizeof(InstanceData);
+                if (minUboAlignment > 0) {
+                    m_dynamicAlignment = (m_dynamicAlignment + minUboAlignment - 1)
+                        & ~(minUboAlignment - 1);
+                }
+                m_dynamicBuffer = VulkanBuffer(m_device);
+                m_dynamicBuffer.createBuffer(maxCount * m_dynamicAlignment,
+                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+                m_dynamicBuffer.map();
+
+                updateInstances();
+            }
+
+            void createCommandBuffers() override {
+                auto tStart = std::chrono::high_resolution_clock::now();
+
+                m_commandBuffers.resize(m_swapChain.getImages().size());
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = m_device.getCommandPool();
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount = (uint32_t) m_commandBuffers.size();
+
+                if (vkAllocateCommandBuffers(m_device.getLogicalDevice(), &allocInfo, m_commandBuffers.data()->getCommandBufferPointer()) != VK_SUCCESS) {
+                    throw std::runtime_error("Command buffers allocation failed!");
+                }
+
+                VkClearValue clearValues[2];
+                clearValues[0].color = { 0.0f, 0.0f, 0.0f, 1.0f };
+                clearValues[1].depthStencil = { 1.0f, 0 };
+
+                VkViewport viewport = {};
+                viewport.width = m_swapChain.getExtent().width;
+                viewport.height = m_swapChain.getExtent().height;
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+
+                VkRect2D scissor = {};
+                scissor.extent.width = m_swapChain.getExtent().width;
+                scissor.extent.height = m_swapChain.getExtent().height;
+                scissor.offset.x = 0;
+                scissor.offset.y = 0;
+
+                const uint32_t instanceCount = m_instanceCounts[m_instanceCountIndex];
+
+                for (int32_t i = 0; i < m_commandBuffers.size(); ++i)
+                {
+                    VkCommandBuffer commandBuffer = m_commandBuffers[i].getCommandBuffer();
+
+                    VkCommandBufferBeginInfo beginInfo{};
+                    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    beginInfo.flags = 0;
+                    beginInfo.pInheritanceInfo = nullptr;
+
+                    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+                        throw std::runtime_error("Begin recording of a command buffer failed!");
+                    }
+                    VkRenderPassBeginInfo renderPassBeginInfo = {};
+                    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    renderPassBeginInfo.renderPass = m_renderPass.getRenderPass();
+                    renderPassBeginInfo.renderArea.offset.x = 0;
+                    renderPassBeginInfo.renderArea.offset.y = 0;
+                    renderPassBeginInfo.renderArea.extent.width = m_swapChain.getExtent().width;
+                    renderPassBeginInfo.renderArea.extent.height = m_swapChain.getExtent().height;
+                    renderPassBeginInfo.clearValueCount = 2;
+                    renderPassBeginInfo.pClearValues = clearValues;
+                    renderPassBeginInfo.framebuffer = m_framebuffers[i];
+
+                    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+                    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+                    if (m_drawMode == 1) {
+                        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
+                        const uint32_t dynamicOffset = 0;
+                        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout,
+                                0, 1, &m_descriptorSets.getDescriptorSets()[i], 1, &dynamicOffset);
+                        model.drawInstanced(commandBuffer, m_instanceBuffer.getBuffer(), instanceCount);
+                    } else {
+                        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_dynamicPipeline);
+                        for (uint32_t j = 0; j < instanceCount; j++) {
+                            const uint32_t dynamicOffset = j * static_cast<uint32_t>(m_dynamicAlignment);
+                            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout,
+                                    0, 1, &m_descriptorSets.getDescriptorSets()[i], 1, &dynamicOffset);
+                            model.draw(commandBuffer);
+                        }
+                    }
+
+                    drawUI(commandBuffer);
+
+                    vkCmdEndRenderPass(commandBuffer);
+                    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+                        throw std::runtime_error("Recording of a command buffer failed!");
+                    }
+                }
+
+                auto tEnd = std::chrono::high_resolution_clock::now();
+                m_timings.recordMs = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+            }
+
+            void createDescriptorSetLayout() override {
+                m_descriptorSetLayout = VulkanDescriptorSetLayout(m_device);
+
+                VkDescriptorSetLayoutBinding uboLayoutBinding{};
+                uboLayoutBinding.binding = 0;
+                uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                uboLayoutBinding.descriptorCount = 1;
+                uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+                uboLayoutBinding.pImmutableSamplers = nullptr;
+
+                VkDescriptorSetLayoutBinding dynUboLayoutBinding{};
+                dynUboLayoutBinding.binding = 1;
+                dynUboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                dynUboLayoutBinding.descriptorCount = 1;
+                dynUboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+                dynUboLayoutBinding.pImmutableSamplers = nullptr;
+
+                VkDescriptorSetLayoutBinding materialLayoutBinding{};
+                materialLayoutBinding.binding = 2;
+                materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                materialLayoutBinding.descriptorCount = 1;
+                materialLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+                materialLayoutBinding.pImmutableSamplers = nullptr;
+
+                std::vector<VkDescriptorSetLayoutBinding> descriptorSetLayoutBindings = {
+                    uboLayoutBinding,
+                    dynUboLayoutBinding,
+                    materialLayoutBinding
+                };
+
+                m_descriptorSetLayout.create(descriptorSetLayoutBindings);
+            }
+
+            void createDescriptorPool() override {
+                m_descriptorPool = VulkanDescriptorPool(m_device, m_swapChain);
+
+                std::vector<VkDescriptorPoolSize> poolSizes = std::vector<VkDescriptorPoolSize>(3);
+
+                poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                poolSizes[0].descriptorCount = static_cast<uint32_t>(
+                        m_swapChain.getImages().size());
+
+                poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                poolSizes[1].descriptorCount = static_cast<uint32_t>(
+                        m_swapChain.getImages().size());
+
+                poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                poolSizes[2].descriptorCount = static_cast<uint32_t>(
+                        m_swapChain.getImages().size());
+
+                m_descriptorPool.create(poolSizes);
+            }
+
+            void createDescriptorSets() override {
+                m_descriptorSets = VulkanDescriptorSets(
+                        m_device,
+                        m_descriptorSetLayout,
+                        m_descriptorPool);
+
+                m_descriptorSets.create(static_cast<uint32_t>(m_swapChain.getImages().size()));
+
+                for (size_t i = 0; i < m_swapChain.getImages().size(); i++) {
+                    std::vector<VkWriteDescriptorSet> descriptorWrites(3);
+
+                    VkDescriptorBufferInfo dynamicBufferInfo{};
+                    dynamicBufferInfo.buffer = m_dynamicBuffer.getBuffer();
+                    dynamicBufferInfo.offset = 0;
+                    dynamicBufferInfo.range = sizeof(InstanceData);
+
+                    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[0].dstBinding = 0;
+                    descriptorWrites[0].dstArrayElement = 0;
+                    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    descriptorWrites[0].descriptorCount = 1;
+                    descriptorWrites[0].pBufferInfo = ubo.buffer.getDescriptorPointer();
+
+                    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[1].dstBinding = 1;
+                    descriptorWrites[1].dstArrayElement = 0;
+                    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+                    descriptorWrites[1].descriptorCount = 1;
+                    descriptorWrites[1].pBufferInfo = &dynamicBufferInfo;
+
+                    descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[2].dstBinding = 2;
+                    descriptorWrites[2].dstArrayElement = 0;
+                    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                    descriptorWrites[2].descriptorCount = 1;
+                    descriptorWrites[2].pBufferInfo = m_materialBuffer.getDescriptorPointer();
+
+                    m_descriptorSets.update(descriptorWrites, i);
+                }
+            }
+
+            void updateUniformBuffers() {
+                ubo.values.projection = glm::perspective(glm::radians(m_camera.getZoom()),
+                        m_swapChain.getExtent().width / (float) m_swapChain.getExtent().height,
+                        0.1f,  1000.0f);
+                ubo.values.projection[1][1] *= -1;
+                ubo.values.view = m_camera.getViewMatrix();
+                memcpy(ubo.buffer.getMappedMemory(), &ubo.values, sizeof(ubo.values));
+            }
+
+            // Same spinning grid in both modes, tightly packed for the instance stream, at the
+            // dynamic offset alignment for the uniform buffer
+            void updateInstances() {
+                auto tStart = std::chrono::high_resolution_clock::now();
+
+                const uint32_t instanceCount = m_instanceCounts[m_instanceCountIndex];
+                const uint32_t dim = static_cast<uint32_t>(std::ceil(std::cbrt(static_cast<double>(instanceCount))));
+                const float angle = static_cast<float>(glfwGetTime());
+                const glm::vec3 origin = glm::vec3(-0.5f * (dim - 1) * m_spacing);
+
+                char* instances = static_cast<char*>(m_drawMode == 1 ? m_instanceBuffer.getMappedMemory() : m_dynamicBuffer.getMappedMemory());
+                const size_t stride = m_drawMode == 1 ? sizeof(InstanceData) : m_dynamicAlignment;
+                for (uint32_t index = 0; index < instanceCount; index++) {
+                    const uint32_t x = index % dim;
+                    const uint32_t y = (index / dim) % dim;
+                    const uint32_t z = index / (dim * dim);
+                    InstanceData* instance = reinterpret_cast<InstanceData*>(instances + index * stride);
+                    instance->matrix = glm::rotate(
+                            glm::translate(glm::mat4(1.0f), origin + glm::vec3(x, y, z) * m_spacing),
+                            angle + index * 0.1f, glm::vec3(0.0f, 1.0f, 0.0f));
+                    // Brightness varies with the height, the material with the column
+                    instance->baseColorFactor = glm::vec4(glm::vec3(0.5f + 0.5f * static_cast<float>(y) / dim), 1.0f);
+                    instance->materialIndex = (x + z) % m_materialCount;
+                }
+
+                auto tEnd = std::chrono::high_resolution_clock::now();
+                m_timings.updateMs += std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+            }
+
+            void resetCamera() {
+                const uint32_t instanceCount = m_instanceCounts[m_instanceCountIndex];
+                const float extent = std::cbrt(static_cast<float>(instanceCount)) * m_spacing;
+                m_camera.setPosition(glm::vec3(0.0f, 0.0f, 1.5f * extent));
+                m_timings = Timings();
+            }
+
+            void loadAssets() {
+                uint32_t glTFLoadingFlags =
+                    FileLoadingFlags::PreTransformVertices
+                    | FileLoadingFlags::PreMultiplyVertexColors;
+
+                model.loadFromFile(
+                        "src/models/sphere.gltf",
+                        &m_device,
+                        m_device.getGraphicsQueue(),
+                        glTFLoadingFlags);
+            }
+
+            void OnUpdateUI (UI *ui) override {
+                if (ui->header("Settings")) {
+                    if (ui->comboBox("Objects", &m_instanceCountIndex, { "1000", "10000", "100000" })) {
+                        resetCamera();
+                        m_ui.updated = true;
+                    }
+                    if (ui->comboBox("Draw mode", &m_drawMode, { "Dynamic uniform buffer", "Instanced" })) {
+                        m_timings = Timings();
+                        m_ui.updated = true;
+                    }
+                    ui->text("Frame: %.2f ms", m_timings.averageFrameMs);
+                    ui->text("Update: %.2f ms", m_timings.averageUpdateMs);
+                    ui->text("Recording: %.2f ms", m_timings.recordMs);
+                }
+            }
+
+    };
+
+}
+
+VULKAN_EXAMPLE_MAIN()
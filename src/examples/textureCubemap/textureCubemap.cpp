@@ -716,7 +716,8 @@ namespace VulkanLearning {
                     sampler.maxAnisotropy = m_device.properties.limits.maxSamplerAnisotropy;
                     sampler.anisotropyEnable = VK_TRUE;
                 }
-                VK_CHECK_RESULT(vkCreateSampler(m_device.getLogicalDevice(), &sampler, nullptr, &m_cubeMapTexture.sampler));
+                // Owned by the device's sampler cache, Texture::destroy leaves it alone
+                m_cubeMapTexture.sampler = m_device.getSampler(sampler);
 
                 VkImageViewCreateInfo imageView = {};
                 imageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
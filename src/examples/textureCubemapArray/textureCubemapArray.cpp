@@ -743,11 +743,8 @@ namespace VulkanLearning {
                     sampler.anisotropyEnable = VK_TRUE;
                 }
 
-                VK_CHECK_RESULT(vkCreateSampler(
-                            m_device.getLogicalDevice(), 
-                            &sampler, 
-                            nullptr, 
-                            &m_cubeMapTextureArray.sampler));
+                // Owned by the device's sampler cache, Texture::destroy leaves it alone
+                m_cubeMapTextureArray.sampler = m_device.getSampler(sampler);
 
                 VkImageViewCreateInfo imageView = {};
                 imageView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
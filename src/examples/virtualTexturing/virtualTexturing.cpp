@@ -0,0 +1,702 @@
+#include "VulkanBase.hpp"
+#include "VulkanVirtualTexture.hpp"
+
+#include <cstring>
+#include <memory>
+#include <vulkan/vulkan_core.h>
+
+namespace VulkanLearning {
+
+    // Textures on a grid of quads, together far larger than the atlas they are paged into
+    const uint32_t TEXTURE_GRID = 3;
+    const uint32_t TEXTURE_SIZE = 2048;
+
+    struct Vertex {
+        glm::vec3 pos;
+        glm::vec2 uv;
+        glm::vec3 normal;
+    };
+
+    class VulkanExample : public VulkanBase {
+
+        private:
+            VulkanDescriptorSets m_descriptorSets;
+            VkPipeline m_pipeline;
+            VkPipeline m_feedbackPipeline;
+            VkPipelineLayout m_pipelineLayout;
+
+            std::unique_ptr<VulkanVirtualTexture> m_virtualTexture;
+            // RGBA8 mip chains the pages are built from, the virtual texture only points into them
+            std::vector<std::vector<uint8_t>> m_textureData;
+            std::vector<uint32_t> m_textureIndices;
+            // Prints the texture and atlas sizes on startup
+            bool m_verbose = false;
+
+        public:
+            VulkanExample() {}
+            ~VulkanExample() {
+                if (m_virtualTexture) {
+                    m_virtualTexture->cleanup();
+                }
+
+                cleanupSwapChain();
+
+                vkDestroyPipeline(m_device.getLogicalDevice(), m_pipeline, nullptr);
+                vkDestroyPipeline(m_device.getLogicalDevice(), m_feedbackPipeline, nullptr);
+                vkDestroyPipelineLayout(m_device.getLogicalDevice(), m_pipelineLayout, nullptr);
+
+                m_descriptorSetLayout.cleanup();
+
+                m_vertexBuffer.cleanup();
+                m_indexBuffer.cleanup();
+            }
+
+            void run() {
+                VulkanBase::run();
+            }
+
+        private:
+            std::vector<Vertex> m_vertices;
+            std::vector<uint32_t> m_indices;
+
+            void initVulkan() override {
+                m_msaaSamples = 64;
+                VulkanBase::initVulkan();
+
+                m_window.setTitle("Virtual Texturing");
+                m_camera.setPosition(glm::vec3(0.0f, 0.0f, 4.0f));
+
+                createVirtualTexture();
+                createQuads();
+                createVertexBuffer();
+                createIndexBuffer();
+
+                createDescriptorSetLayout();
+                createGraphicsPipeline();
+
+                createCoordinateSystemUniformBuffers();
+                createDescriptorPool();
+                createDescriptorSets();
+                createCommandBuffers();
+            }
+
+            void drawFrame() override {
+                uint32_t imageIndex;
+                VulkanBase::acquireFrame(&imageIndex);
+                // The image's last submission is done, so is the feedback its command buffer copied
+                m_virtualTexture->update(imageIndex);
+                updateUniformBuffers(imageIndex);
+                VK_CHECK_RESULT(vkQueueSubmit(m_device.getGraphicsQueue(), 1, &m_submitInfo, m_syncObjects.getInFlightFences()[m_currentFrame]));
+                VulkanBase::presentFrame(imageIndex);
+            }
+
+            void createFramebuffers() override {
+                VulkanBase::createFramebuffers();
+                // The feedback target follows the swap chain, it doesn't exist yet on the first call
+                if (m_virtualTexture) {
+                    m_virtualTexture->resize(m_swapChain.getExtent().width, m_swapChain.getExtent().height);
+                }
+            }
+
+            /* Procedural texture with a full mip chain, a color per texture so pages are easy to tell apart */
+            void generateTexture(uint32_t index, std::vector<uint8_t>& data) {
+                const glm::vec3 colors[] = {
+                    { 0.9f, 0.3f, 0.2f }, { 0.2f, 0.7f, 0.3f }, { 0.2f, 0.4f, 0.9f },
+                    { 0.9f, 0.8f, 0.2f }, { 0.7f, 0.3f, 0.8f }, { 0.2f, 0.8f, 0.8f },
+                    { 0.9f, 0.5f, 0.1f }, { 0.5f, 0.5f, 0.5f }, { 0.9f, 0.9f, 0.9f }
+                };
+                const glm::vec3 color = colors[index % 9];
+
+                size_t totalSize = 0;
+                for (uint32_t level = 0; (TEXTURE_SIZE >> level) > 0; level++) {
+                    totalSize += static_cast<size_t>(TEXTURE_SIZE >> level) * (TEXTURE_SIZE >> level) * 4;
+                }
+                data.resize(totalSize);
+
+                // Checkers of 256 texels with lines every 16, fine enough to need level 0 up close
+                for (uint32_t y = 0; y < TEXTURE_SIZE; y++) {
+                    for (uint32_t x = 0; x < TEXTURE_SIZE; x++) {
+                        float value = ((x / 256 + y / 256) % 2) ? 1.0f : 0.6f;
+                        if (x % 16 == 0 || y % 16 == 0) {
+                            value *= 0.4f;
+                        }
+                        if (x % 128 == 0 || y % 128 == 0) {
+                            value = 0.0f;
+                        }
+                        uint8_t* texel = &data[(static_cast<size_t>(y) * TEXTURE_SIZE + x) * 4];
+                        texel[0] = static_cast<uint8_t>(color.r * value * 255.0f);
+                        texel[1] = static_cast<uint8_t>(color.g * value * 255.0f);
+                        texel[2] = static_cast<uint8_t>(color.b * value * 255.0f);
+                        texel[3] = 255;
+                    }
+                }
+
+                size_t offset = 0;
+                for (uint32_t size = TEXTURE_SIZE; size > 1; size >>= 1) {
+                    const uint8_t* src = &data[offset];
+                    offset += static_cast<size_t>(size) * size * 4;
+                    uint8_t* dst = &data[offset];
+                    const uint32_t half = size >> 1;
+                    for (uint32_t y = 0; y < half; y++) {
+                        for (uint32_t x = 0; x < half; x++) {
+                            for (uint32_t c = 0; c < 4; c++) {
+                                const uint32_t sum =
+                                    src[((2 * y) * size + 2 * x) * 4 + c] + src[((2 * y) * size + 2 * x + 1) * 4 + c] +
+                                    src[((2 * y + 1) * size + 2 * x) * 4 + c] + src[((2 * y + 1) * size + 2 * x + 1) * 4 + c];
+                                dst[(y * half + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                            }
+                        }
+                    }
+                }
+            }
+
+            void createVirtualTexture() {
+                const uint32_t textureCount = TEXTURE_GRID * TEXTURE_GRID;
+                m_textureData.resize(textureCount);
+                ThreadPool threadPool;
+                for (uint32_t i = 0; i < textureCount; i++) {
+                    threadPool.push([this, i]() {
+                        generateTexture(i, m_textureData[i]);
+                    });
+                }
+                threadPool.wait();
+
+                m_virtualTexture = std::make_unique<VulkanVirtualTexture>(&m_device, m_device.getGraphicsQueue());
+                m_virtualTexture->virtualPageCount = 64;
+                m_virtualTexture->atlasPageCount = 16;
+                uint32_t mipLevels = 0;
+                while ((TEXTURE_SIZE >> mipLevels) > 0) {
+                    mipLevels++;
+                }
+                for (uint32_t i = 0; i < textureCount; i++) {
+                    m_textureIndices.push_back(m_virtualTexture->addTexture(m_textureData[i].data(), TEXTURE_SIZE, TEXTURE_SIZE, mipLevels));
+                }
+                m_virtualTexture->create(m_swapChain.getExtent().width, m_swapChain.getExtent().height);
+
+                if (m_verbose) {
+                    std::cout << "Virtual texturing: " << textureCount << " textures of " << TEXTURE_SIZE << "x" << TEXTURE_SIZE
+                        << " in an atlas of " << m_virtualTexture->getPhysicalPageCount() << " pages" << std::endl;
+                }
+            }
+
+            void createQuads() {
+                const float size = 2.0f;
+                const float spacing = 2.2f;
+                const float start = -spacing * (TEXTURE_GRID - 1) * 0.5f;
+                for (uint32_t y = 0; y < TEXTURE_GRID; y++) {
+                    for (uint32_t x = 0; x < TEXTURE_GRID; x++) {
+                        const glm::vec3 center(start + x * spacing, start + y * spacing, 0.0f);
+                        const uint32_t first = static_cast<uint32_t>(m_vertices.size());
+                        m_vertices.push_back({ center + glm::vec3( size,  size, 0.0f) * 0.5f, { 1.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } });
+                        m_vertices.push_back({ center + glm::vec3(-size,  size, 0.0f) * 0.5f, { 0.0f, 1.0f }, { 0.0f, 0.0f, 1.0f } });
+                        m_vertices.push_back({ center + glm::vec3(-size, -size, 0.0f) * 0.5f, { 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } });
+                        m_vertices.push_back({ center + glm::vec3( size, -size, 0.0f) * 0.5f, { 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } });
+                        for (uint32_t index : { 0u, 1u, 2u, 2u, 3u, 0u }) {
+                            m_indices.push_back(first + index);
+                        }
+                    }
+                }
+            }
+
+            void createRenderPass() override {
+                VkAttachmentDescription colorAttachment{};
+                colorAttachment.format = m_swapChain.getImageFormat();
+                colorAttachment.samples = m_device.getMsaaSamples();
+                colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentDescription depthAttachment{};
+                depthAttachment.format = m_device.findDepthFormat();
+                depthAttachment.samples = m_device.getMsaaSamples();
+                depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+                depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentDescription colorAttachmentResolve{};
+                colorAttachmentResolve.format = m_swapChain.getImageFormat();
+                colorAttachmentResolve.samples = VK_SAMPLE_COUNT_1_BIT;
+                colorAttachmentResolve.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachmentResolve.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+                colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+                colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+                VkAttachmentReference colorAttachmentRef{};
+                colorAttachmentRef.attachment = 0;
+                colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentReference depthAttachmentRef{};
+                depthAttachmentRef.attachment = 1;
+                depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+                VkAttachmentReference colorAttachmentResolveRef{};
+                colorAttachmentResolveRef.attachment = 2;
+                colorAttachmentResolveRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+                VkSubpassDescription subpass{};
+                subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+                subpass.colorAttachmentCount = 1;
+                subpass.pColorAttachments = &colorAttachmentRef;
+                subpass.pDepthStencilAttachment = &depthAttachmentRef;
+                subpass.pResolveAttachments = &colorAttachmentResolveRef;
+
+                const std::vector<VkAttachmentDescription> attachments =
+                    { colorAttachment, depthAttachment, colorAttachmentResolve };
+
+                m_renderPass = VulkanRenderPass(m_swapChain, m_device);
+                m_renderPass.create(attachments, subpass);
+            }
+
+            void createGraphicsPipeline() override {
+                VkPushConstantRange pushConstantRange{};
+                pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+                pushConstantRange.offset = 0;
+                pushConstantRange.size = sizeof(VulkanVirtualTexture::TextureInfo);
+
+                VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+                pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+                pipelineLayoutInfo.setLayoutCount = 1;
+                pipelineLayoutInfo.pSetLayouts = m_descriptorSetLayout.getDescriptorSetLayoutPointer();
+                pipelineLayoutInfo.pushConstantRangeCount = 1;
+                pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+                VK_CHECK_RESULT(vkCreatePipelineLayout(
+                        m_device.getLogicalDevice(),
+                        &pipelineLayoutInfo,
+                        nullptr,
+                        &m_pipelineLayout));
+
+                VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+                inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+                inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+                inputAssembly.flags = 0;
+                inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+                VkPipelineRasterizationStateCreateInfo rasterizer = {};
+                rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+                rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+                rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+                rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+                rasterizer.flags = 0;
+                rasterizer.depthClampEnable = VK_FALSE;
+                rasterizer.lineWidth = 1.0f;
+
+                VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+                colorBlendAttachment.colorWriteMask = 0xf;
+                colorBlendAttachment.blendEnable = VK_FALSE;
+
+                VkPipelineColorBlendStateCreateInfo colorBlending{};
+                colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+                colorBlending.attachmentCount = 1;
+                colorBlending.pAttachments = &colorBlendAttachment;
+
+                VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
+                depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+                depthStencilState.depthTestEnable = VK_TRUE;
+                depthStencilState.depthWriteEnable = VK_TRUE;
+                depthStencilState.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+                depthStencilState.back.compareOp = VK_COMPARE_OP_ALWAYS;
+
+                VkPipelineViewportStateCreateInfo viewportState{};
+                viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+                viewportState.viewportCount = 1;
+                viewportState.scissorCount = 1;
+
+                const std::vector<VkDynamicState> dynamicStates = {
+                    VK_DYNAMIC_STATE_VIEWPORT,
+                    VK_DYNAMIC_STATE_SCISSOR
+                };
+
+                VkPipelineDynamicStateCreateInfo dynamicState{};
+                dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+                dynamicState.pDynamicStates = dynamicStates.data();
+                dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+                dynamicState.flags = 0;
+
+                VkPipelineMultisampleStateCreateInfo multisampling{};
+                if (m_device.getMsaaSamples() > 1) {
+                    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                    multisampling.sampleShadingEnable = VK_TRUE;
+                    multisampling.minSampleShading = 0.2f;
+                    multisampling.rasterizationSamples = m_device.getMsaaSamples();
+                } else {
+                    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+                    multisampling.sampleShadingEnable = VK_FALSE;
+                    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+                }
+
+                VulkanShaderModule vertShaderModule =
+                    VulkanShaderModule("src/shaders/virtualTexturing/virtualTexturingVert.spv", &m_device, VK_SHADER_STAGE_VERTEX_BIT);
+                VulkanShaderModule fragShaderModule =
+                    VulkanShaderModule("src/shaders/virtualTexturing/virtualTexturingFrag.spv", &m_device, VK_SHADER_STAGE_FRAGMENT_BIT);
+                VulkanShaderModule feedbackShaderModule =
+                    VulkanShaderModule("src/shaders/virtualTexturing/virtualTexturingFeedbackFrag.spv", &m_device, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+                VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+                vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+                VkVertexInputBindingDescription vertexBindingDescription;
+                vertexBindingDescription.binding = 0;
+                vertexBindingDescription.stride = sizeof(Vertex);
+                vertexBindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+                std::vector<VkVertexInputAttributeDescription> vertexAttributeDescription;
+                vertexAttributeDescription.resize(3);
+                vertexAttributeDescription[0].binding = 0;
+                vertexAttributeDescription[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+                vertexAttributeDescription[0].location = 0;
+                vertexAttributeDescription[0].offset = offsetof(Vertex, pos);
+
+                vertexAttributeDescription[1].binding = 0;
+                vertexAttributeDescription[1].format = VK_FORMAT_R32G32_SFLOAT;
+                vertexAttributeDescription[1].location = 1;
+                vertexAttributeDescription[1].offset = offsetof(Vertex, uv);
+
+                vertexAttributeDescription[2].binding = 0;
+                vertexAttributeDescription[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+                vertexAttributeDescription[2].location = 2;
+                vertexAttributeDescription[2].offset = offsetof(Vertex, normal);
+
+                vertexInputInfo.vertexBindingDescriptionCount = 1;
+                vertexInputInfo.vertexAttributeDescriptionCount =
+                    static_cast<uint32_t>(vertexAttributeDescription.size());
+                vertexInputInfo.pVertexBindingDescriptions = &vertexBindingDescription;
+                vertexInputInfo.pVertexAttributeDescriptions = vertexAttributeDescription.data();
+
+                VkPipelineShaderStageCreateInfo shaderStages[] = {
+                    vertShaderModule.getStageCreateInfo(),
+                    fragShaderModule.getStageCreateInfo()
+                };
+
+                VkGraphicsPipelineCreateInfo pipelineInfo{};
+                pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+                pipelineInfo.stageCount = 2;
+                pipelineInfo.pStages = shaderStages;
+                pipelineInfo.pInputAssemblyState = &inputAssembly;
+                pipelineInfo.pViewportState = &viewportState;
+                pipelineInfo.pRasterizationState = &rasterizer;
+                pipelineInfo.pMultisampleState = &multisampling;
+                pipelineInfo.pDepthStencilState = &depthStencilState;
+                pipelineInfo.pColorBlendState = &colorBlending;
+                pipelineInfo.layout = m_pipelineLayout;
+                pipelineInfo.renderPass = m_renderPass.getRenderPass();
+                pipelineInfo.subpass = 0;
+                pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+                pipelineInfo.pDynamicState = &dynamicState;
+                pipelineInfo.pVertexInputState = &vertexInputInfo;
+
+                VK_CHECK_RESULT(vkCreateGraphicsPipelines(
+                            m_device.getLogicalDevice(),
+                            VK_NULL_HANDLE,
+                            1,
+                            &pipelineInfo,
+                            nullptr,
+                            &m_pipeline));
+
+                // Same geometry into the single sampled R32_UINT feedback target
+                shaderStages[1] = feedbackShaderModule.getStageCreateInfo();
+                multisampling.sampleShadingEnable = VK_FALSE;
+                multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+                pipelineInfo.renderPass = m_virtualTexture->getFeedbackRenderPass();
+
+                VK_CHECK_RESULT(vkCreateGraphicsPipelines(
+                            m_device.getLogicalDevice(),
+                            VK_NULL_HANDLE,
+                            1,
+                            &pipelineInfo,
+                            nullptr,
+                            &m_feedbackPipeline));
+
+                vkDestroyShaderModule(
+                        m_device.getLogicalDevice(),
+                        vertShaderModule.getModule(),
+                        nullptr);
+                vkDestroyShaderModule(
+                        m_device.getLogicalDevice(),
+                        fragShaderModule.getModule(),
+                        nullptr);
+                vkDestroyShaderModule(
+                        m_device.getLogicalDevice(),
+                        feedbackShaderModule.getModule(),
+                        nullptr);
+            }
+
+            void createVertexBuffer() override {
+                m_vertexBuffer = VulkanBuffer(m_device);
+                m_vertexBuffer.createWithStagingBuffer(m_vertices,
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+            }
+
+            void createIndexBuffer() override {
+                m_indexBuffer = VulkanBuffer(m_device);
+                m_indexBuffer.createWithStagingBuffer(m_indices,
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                        VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+            }
+
+            void createCoordinateSystemUniformBuffers() override {
+                VkDeviceSize bufferSize = sizeof(CoordinatesSystemUniformBufferObject);
+
+                m_coordinateSystemUniformBuffers.resize(m_swapChain.getImages().size());
+
+                for (size_t i = 0; i < m_swapChain.getImages().size(); i++) {
+                    m_coordinateSystemUniformBuffers[i] = VulkanBuffer(m_device);
+                    m_coordinateSystemUniformBuffers[i].createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, *m_coordinateSystemUniformBuffers[i].getBufferPointer(), *m_coordinateSystemUniformBuffers[i].getBufferMemoryPointer());
+                }
+            }
+
+            void drawQuads(VkCommandBuffer commandBuffer, VkPipeline pipeline, size_t imageIndex) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+                VkBuffer vertexBuffers[] = {m_vertexBuffer.getBuffer()};
+                VkDeviceSize offsets[] = {0};
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+                vkCmdBindIndexBuffer(commandBuffer, m_indexBuffer.getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+                vkCmdBindDescriptorSets(
+                        commandBuffer,
+                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        m_pipelineLayout,
+                        0,
+                        1,
+                        &m_descriptorSets.getDescriptorSets()[imageIndex],
+                        0,
+                        nullptr);
+
+                for (uint32_t i = 0; i < m_textureIndices.size(); i++) {
+                    VulkanVirtualTexture::TextureInfo textureInfo = m_virtualTexture->getTextureInfo(m_textureIndices[i]);
+                    vkCmdPushConstants(
+                            commandBuffer,
+                            m_pipelineLayout,
+                            VK_SHADER_STAGE_FRAGMENT_BIT,
+                            0,
+                            sizeof(textureInfo),
+                            &textureInfo);
+                    vkCmdDrawIndexed(commandBuffer, 6, 1, i * 6, 0, 0);
+                }
+            }
+
+            void createCommandBuffers() override {
+                // Called again whenever the recording changes, always with the device idle
+                freeCommandBuffers();
+                m_commandBuffers.resize(m_swapChain.getImages().size());
+
+                VkCommandBufferAllocateInfo allocInfo{};
+                allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                allocInfo.commandPool = m_device.getCommandPool();
+                allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                allocInfo.commandBufferCount = (uint32_t) m_commandBuffers.size();
+
+                if (vkAllocateCommandBuffers(m_device.getLogicalDevice(), &allocInfo, m_commandBuffers.data()->getCommandBufferPointer()) != VK_SUCCESS) {
+                    throw std::runtime_error("Command buffers allocation failed!");
+                }
+
+                std::array<VkClearValue, 2> clearValues{};
+                clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
+                clearValues[1].depthStencil = {1.0f, 0};
+
+                VkViewport viewport = {};
+                viewport.width = m_swapChain.getExtent().width;
+                viewport.height = m_swapChain.getExtent().height;
+                viewport.minDepth = 0.0f;
+                viewport.maxDepth = 1.0f;
+
+                VkRect2D scissor = {};
+                scissor.extent.width = m_swapChain.getExtent().width;
+                scissor.extent.height = m_swapChain.getExtent().height;
+                scissor.offset.x = 0;
+                scissor.offset.y = 0;
+
+                for (size_t i = 0; i < m_commandBuffers.size(); i++) {
+                    VkCommandBufferBeginInfo beginInfo{};
+                    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+                    beginInfo.flags = 0;
+                    beginInfo.pInheritanceInfo = nullptr;
+
+                    if (vkBeginCommandBuffer(m_commandBuffers[i].getCommandBuffer(), &beginInfo) != VK_SUCCESS) {
+                        throw std::runtime_error("Begin recording of a command buffer failed!");
+                    }
+
+                    // Pages needed by this frame, read back before the next one
+                    m_virtualTexture->beginFeedbackPass(m_commandBuffers[i].getCommandBuffer(), static_cast<uint32_t>(i));
+                    drawQuads(m_commandBuffers[i].getCommandBuffer(), m_feedbackPipeline, i);
+                    m_virtualTexture->endFeedbackPass(m_commandBuffers[i].getCommandBuffer(), static_cast<uint32_t>(i));
+
+                    VkRenderPassBeginInfo renderPassInfo{};
+                    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    renderPassInfo.renderPass = m_renderPass.getRenderPass();
+                    renderPassInfo.framebuffer = m_framebuffers[i];
+                    renderPassInfo.renderArea.offset = {0, 0};
+                    renderPassInfo.renderArea.extent = m_swapChain.getExtent();
+
+                    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+                    renderPassInfo.pClearValues = clearValues.data();
+
+                    vkCmdBeginRenderPass(
+                            m_commandBuffers[i].getCommandBuffer(),
+                            &renderPassInfo,
+                            VK_SUBPASS_CONTENTS_INLINE);
+                    vkCmdSetViewport(m_commandBuffers[i].getCommandBuffer(), 0, 1, &viewport);
+                    vkCmdSetScissor(m_commandBuffers[i].getCommandBuffer(), 0, 1, &scissor);
+
+                    drawQuads(m_commandBuffers[i].getCommandBuffer(), m_pipeline, i);
+
+                    drawUI(m_commandBuffers[i].getCommandBuffer());
+
+                    vkCmdEndRenderPass(m_commandBuffers[i].getCommandBuffer());
+
+                    if (vkEndCommandBuffer(m_commandBuffers[i].getCommandBuffer()) != VK_SUCCESS) {
+                        throw std::runtime_error("Recording of a command buffer failed!");
+                    }
+                }
+            }
+
+            void createDescriptorSetLayout() override {
+                m_descriptorSetLayout = VulkanDescriptorSetLayout(m_device);
+
+                VkDescriptorSetLayoutBinding uboLayoutBinding{};
+                uboLayoutBinding.binding = 0;
+                uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                uboLayoutBinding.descriptorCount = 1;
+                uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+                uboLayoutBinding.pImmutableSamplers = nullptr;
+
+                // Bindings 1 to 3 are the ones virtualTexture.glsl declares
+                VkDescriptorSetLayoutBinding virtualTextureLayoutBinding{};
+                virtualTextureLayoutBinding.binding = 1;
+                virtualTextureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                virtualTextureLayoutBinding.descriptorCount = 1;
+                virtualTextureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+                virtualTextureLayoutBinding.pImmutableSamplers = nullptr;
+
+                VkDescriptorSetLayoutBinding indirectionLayoutBinding{};
+                indirectionLayoutBinding.binding = 2;
+                indirectionLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                indirectionLayoutBinding.descriptorCount = 1;
+                indirectionLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+                indirectionLayoutBinding.pImmutableSamplers = nullptr;
+
+                VkDescriptorSetLayoutBinding atlasLayoutBinding{};
+                atlasLayoutBinding.binding = 3;
+                atlasLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                atlasLayoutBinding.descriptorCount = 1;
+                atlasLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+                atlasLayoutBinding.pImmutableSamplers = nullptr;
+
+                std::vector<VkDescriptorSetLayoutBinding> bindings =
+                {uboLayoutBinding, virtualTextureLayoutBinding, indirectionLayoutBinding, atlasLayoutBinding};
+
+                m_descriptorSetLayout.create(bindings);
+            }
+
+            void createDescriptorPool() override {
+                m_descriptorPool = VulkanDescriptorPool(m_device, m_swapChain);
+
+                std::vector<VkDescriptorPoolSize> poolSizes = std::vector<VkDescriptorPoolSize>(2);
+                poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                poolSizes[0].descriptorCount = static_cast<uint32_t>(
+                        m_swapChain.getImages().size() * 2);
+                poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                poolSizes[1].descriptorCount = static_cast<uint32_t>(
+                        m_swapChain.getImages().size() * 2);
+
+                m_descriptorPool.create(poolSizes);
+            }
+
+            void createDescriptorSets() override {
+                m_descriptorSets = VulkanDescriptorSets(
+                        m_device,
+                        m_descriptorSetLayout,
+                        m_descriptorPool);
+
+                m_descriptorSets.create(static_cast<uint32_t>(m_swapChain.getImages().size()));
+
+                // The atlas and the indirection texture are updated in place, the descriptors never change
+                VkDescriptorBufferInfo virtualTextureInfo = m_virtualTexture->getUniformDescriptor();
+                VkDescriptorImageInfo indirectionInfo = m_virtualTexture->getIndirectionDescriptor();
+                VkDescriptorImageInfo atlasInfo = m_virtualTexture->getAtlasDescriptor();
+
+                for (size_t i = 0; i < m_swapChain.getImages().size(); i++) {
+                    VkDescriptorBufferInfo bufferInfo{};
+                    bufferInfo.offset = 0;
+                    bufferInfo.buffer = m_coordinateSystemUniformBuffers[i].getBuffer();
+                    bufferInfo.range = sizeof(CoordinatesSystemUniformBufferObject);
+
+                    std::vector<VkWriteDescriptorSet> descriptorWrites =
+                        std::vector<VkWriteDescriptorSet>(4);
+
+                    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[0].dstBinding = 0;
+                    descriptorWrites[0].dstArrayElement = 0;
+                    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    descriptorWrites[0].descriptorCount = 1;
+                    descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+                    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[1].dstBinding = 1;
+                    descriptorWrites[1].dstArrayElement = 0;
+                    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+                    descriptorWrites[1].descriptorCount = 1;
+                    descriptorWrites[1].pBufferInfo = &virtualTextureInfo;
+
+                    descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[2].dstBinding = 2;
+                    descriptorWrites[2].dstArrayElement = 0;
+                    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    descriptorWrites[2].descriptorCount = 1;
+                    descriptorWrites[2].pImageInfo = &indirectionInfo;
+
+                    descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                    descriptorWrites[3].dstBinding = 3;
+                    descriptorWrites[3].dstArrayElement = 0;
+                    descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                    descriptorWrites[3].descriptorCount = 1;
+                    descriptorWrites[3].pImageInfo = &atlasInfo;
+
+                    m_descriptorSets.update(descriptorWrites, i);
+                }
+            }
+
+            void updateUniformBuffers(uint32_t currentImage) {
+                CoordinatesSystemUniformBufferObject ubo{};
+
+                ubo.model = glm::mat4(1.0f);
+
+                ubo.view = m_camera.getViewMatrix();
+
+                ubo.proj = glm::perspective(glm::radians(m_camera.getZoom()),
+                        m_swapChain.getExtent().width / (float) m_swapChain.getExtent().height,
+                        0.01f,  100.0f);
+
+                ubo.proj[1][1] *= -1;
+
+                ubo.camPos = m_camera.position();
+
+                m_coordinateSystemUniformBuffers[currentImage].map();
+                memcpy(m_coordinateSystemUniformBuffers[currentImage].getMappedMemory(),
+                        &ubo, sizeof(ubo));
+                m_coordinateSystemUniformBuffers[currentImage].unmap();
+            }
+
+            void OnUpdateUI (UI *ui) override {
+                if (ui->header("Virtual texture")) {
+                    ui->text("Resident pages: %u / %u", m_virtualTexture->getResidentPageCount(), m_virtualTexture->getPhysicalPageCount());
+                    ui->text("Requested pages: %u", m_virtualTexture->getRequestedPageCount());
+                    ui->text("Uploaded this frame: %u", m_virtualTexture->getLastUploadCount());
+                    ui->text("Uploaded: %llu, evicted: %llu",
+                            static_cast<unsigned long long>(m_virtualTexture->getUploadedPageCount()),
+                            static_cast<unsigned long long>(m_virtualTexture->getEvictedPageCount()));
+                }
+            }
+    };
+
+}
+
+VULKAN_EXAMPLE_MAIN()
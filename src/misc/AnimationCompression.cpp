@@ -0,0 +1,183 @@
+#include "AnimationCompression.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VulkanLearning {
+
+    namespace AnimationCompression {
+
+        // Components other than the largest of a unit quaternion are within +-1/sqrt(2)
+        static const float kSmallestThreeRange = 0.70710678f;
+        static const float kSmallestThreeScale = 32767.0f;
+        // Longest run of keys one interpolated segment may replace, bounds the quadratic search
+        static const size_t kMaxSegmentKeys = 256;
+
+        void interpolate(const float* a, const float* b, float u, uint32_t components, bool rotation, float* out)
+        {
+            if (!rotation) {
+                for (uint32_t c = 0; c < components; c++) {
+                    out[c] = a[c] + (b[c] - a[c]) * u;
+                }
+                return;
+            }
+            // Shortest path slerp, falls back to normalized lerp for nearly equal rotations
+            float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+            const float sign = dot < 0.0f ? -1.0f : 1.0f;
+            dot *= sign;
+            float wa = 1.0f - u;
+            float wb = u * sign;
+            if (dot < 0.9995f) {
+                const float angle = std::acos(dot);
+                const float sinAngle = std::sin(angle);
+                wa = std::sin((1.0f - u) * angle) / sinAngle;
+                wb = std::sin(u * angle) / sinAngle * sign;
+            }
+            float length = 0.0f;
+            for (uint32_t c = 0; c < 4; c++) {
+                out[c] = a[c] * wa + b[c] * wb;
+                length += out[c] * out[c];
+            }
+            length = std::sqrt(length);
+            for (uint32_t c = 0; c < 4; c++) {
+                out[c] /= length;
+            }
+        }
+
+        // Max component difference, quaternions q and -q are the same rotation
+        static float keyError(const float* a, const float* b, uint32_t components, bool rotation)
+        {
+            float sign = 1.0f;
+            if (rotation && a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f) {
+                sign = -1.0f;
+            }
+            float error = 0.0f;
+            for (uint32_t c = 0; c < components; c++) {
+                error = std::max(error, std::abs(a[c] - sign * b[c]));
+            }
+            return error;
+        }
+
+        std::vector<uint32_t> reduceKeys(const float* times, const float* values, size_t keyCount, uint32_t components, bool rotation, bool step, float tolerance)
+        {
+            std::vector<uint32_t> kept;
+            if (keyCount == 0) {
+                return kept;
+            }
+            kept.push_back(0);
+            if (step) {
+                for (size_t key = 1; key + 1 < keyCount; key++) {
+                    if (keyError(&values[kept.back() * components], &values[key * components], components, rotation) > tolerance) {
+                        kept.push_back(static_cast<uint32_t>(key));
+                    }
+                }
+            } else {
+                // Greedy: extend the segment from the last kept key for as long as it reproduces every key it spans
+                float interpolated[4];
+                size_t anchor = 0;
+                size_t key = 1;
+                while (key + 1 < keyCount) {
+                    const size_t end = key + 1;
+                    bool fits = true;
+                    for (size_t inner = anchor + 1; inner < end && fits; inner++) {
+                        const float span = times[end] - times[anchor];
+                        const float u = span > 0.0f ? (times[inner] - times[anchor]) / span : 0.0f;
+                        interpolate(&values[anchor * components], &values[end * components], u, components, rotation, interpolated);
+                        fits = keyError(interpolated, &values[inner * components], components, rotation) <= tolerance;
+                    }
+                    if (!fits || end - anchor > kMaxSegmentKeys) {
+                        kept.push_back(static_cast<uint32_t>(key));
+                        anchor = key;
+                    }
+                    key++;
+                }
+            }
+            if (keyCount > 1) {
+                kept.push_back(static_cast<uint32_t>(keyCount - 1));
+            }
+            return kept;
+        }
+
+        void encodeQuaternion(const float q[4], uint16_t out[3])
+        {
+            uint32_t largest = 0;
+            for (uint32_t c = 1; c < 4; c++) {
+                if (std::abs(q[c]) > std::abs(q[largest])) {
+                    largest = c;
+                }
+            }
+            // Store with a positive largest component so its sign needn't be kept
+            const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+            uint32_t packed[3];
+            for (uint32_t c = 0, slot = 0; c < 4; c++) {
+                if (c == largest) {
+                    continue;
+                }
+                const float normalized = std::min(std::max(q[c] * sign / kSmallestThreeRange, -1.0f), 1.0f);
+                packed[slot++] = static_cast<uint32_t>(std::lround((normalized * 0.5f + 0.5f) * kSmallestThreeScale));
+            }
+            // 15 bits per component plus the index spread over the top bits of the first two words
+            out[0] = static_cast<uint16_t>(packed[0] | ((largest & 1) << 15));
+            out[1] = static_cast<uint16_t>(packed[1] | ((largest >> 1) << 15));
+            out[2] = static_cast<uint16_t>(packed[2]);
+        }
+
+        void decodeQuaternion(const uint16_t in[3], float q[4])
+        {
+            const uint32_t largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+            const uint32_t packed[3] = { in[0] & 0x7FFFu, in[1] & 0x7FFFu, in[2] & 0x7FFFu };
+            float sum = 0.0f;
+            for (uint32_t c = 0, slot = 0; c < 4; c++) {
+                if (c == largest) {
+                    continue;
+                }
+                q[c] = (float(packed[slot++]) / kSmallestThreeScale * 2.0f - 1.0f) * kSmallestThreeRange;
+                sum += q[c] * q[c];
+            }
+            q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+        }
+
+        QuantizationRange computeRange(const float* values, size_t keyCount, uint32_t components)
+        {
+            QuantizationRange range{};
+            for (uint32_t c = 0; c < 3; c++) {
+                float min = keyCount ? values[c] : 0.0f;
+                float max = min;
+                for (size_t key = 1; key < keyCount; key++) {
+                    min = std::min(min, values[key * components + c]);
+                    max = std::max(max, values[key * components + c]);
+                }
+                range.min[c] = min;
+                range.extent[c] = max - min;
+            }
+            return range;
+        }
+
+        void encodeVector(const float v[3], const QuantizationRange& range, uint16_t out[3])
+        {
+            for (uint32_t c = 0; c < 3; c++) {
+                const float normalized = range.extent[c] > 0.0f ? (v[c] - range.min[c]) / range.extent[c] : 0.0f;
+                out[c] = static_cast<uint16_t>(std::lround(std::min(std::max(normalized, 0.0f), 1.0f) * 65535.0f));
+            }
+        }
+
+        void decodeVector(const uint16_t in[3], const QuantizationRange& range, float out[3])
+        {
+            for (uint32_t c = 0; c < 3; c++) {
+                out[c] = range.min[c] + float(in[c]) / 65535.0f * range.extent[c];
+            }
+        }
+
+        float quaternionAngle(const float a[4], const float b[4])
+        {
+            // From the chord between the quaternions, acos of their dot product is too coarse for small angles
+            const float sign = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f ? -1.0f : 1.0f;
+            float chord = 0.0f;
+            for (uint32_t c = 0; c < 4; c++) {
+                const float difference = a[c] - sign * b[c];
+                chord += difference * difference;
+            }
+            return 4.0f * std::asin(std::min(std::sqrt(chord) * 0.5f, 1.0f));
+        }
+    }
+}
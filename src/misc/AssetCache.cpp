@@ -0,0 +1,247 @@
+#include "AssetCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include <sys/stat.h>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace VulkanLearning {
+
+    namespace AssetCache {
+
+        uint64_t hash(const void* data, size_t size, uint64_t seed)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            uint64_t value = seed;
+            for (size_t i = 0; i < size; i++) {
+                value ^= bytes[i];
+                value *= 0x100000001b3ull;
+            }
+            return value;
+        }
+
+        bool fileStamp(const std::string& filename, uint64_t& size, int64_t& modificationTime)
+        {
+            struct stat info;
+            if (stat(filename.c_str(), &info) != 0) {
+                return false;
+            }
+            size = static_cast<uint64_t>(info.st_size);
+            modificationTime = static_cast<int64_t>(info.st_mtime);
+            return true;
+        }
+
+        std::string keyString(uint64_t key)
+        {
+            char text[17];
+            snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(key));
+            return text;
+        }
+
+        /*
+           Mapped file
+           */
+
+        MappedFile::~MappedFile()
+        {
+            close();
+        }
+
+        bool MappedFile::open(const std::string& filename)
+        {
+            close();
+#if defined(_WIN32)
+            HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return false;
+            }
+            LARGE_INTEGER fileSize;
+            if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+                CloseHandle(file);
+                return false;
+            }
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping == nullptr) {
+                CloseHandle(file);
+                return false;
+            }
+            void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (data == nullptr) {
+                CloseHandle(mapping);
+                CloseHandle(file);
+                return false;
+            }
+            m_file = file;
+            m_mapping = mapping;
+            m_data = static_cast<const uint8_t*>(data);
+            m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+            int file = ::open(filename.c_str(), O_RDONLY);
+            if (file < 0) {
+                return false;
+            }
+            struct stat info;
+            if (fstat(file, &info) != 0 || info.st_size == 0) {
+                ::close(file);
+                return false;
+            }
+            void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+            if (data == MAP_FAILED) {
+                ::close(file);
+                return false;
+            }
+            // Blobs are read front to back once, let the kernel read ahead
+            madvise(data, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+            m_file = file;
+            m_data = static_cast<const uint8_t*>(data);
+            m_size = static_cast<size_t>(info.st_size);
+#endif
+            return true;
+        }
+
+        void MappedFile::close()
+        {
+            if (m_data == nullptr) {
+                return;
+            }
+#if defined(_WIN32)
+            UnmapViewOfFile(m_data);
+            CloseHandle(m_mapping);
+            CloseHandle(m_file);
+            m_mapping = nullptr;
+            m_file = nullptr;
+#else
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+            ::close(m_file);
+            m_file = -1;
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        /*
+           Writer
+           */
+
+        Writer::~Writer()
+        {
+            discard();
+        }
+
+        bool Writer::open(const std::string& filename)
+        {
+            m_filename = filename;
+            m_offset = 0;
+            m_stream.open(filename + ".tmp", std::ios::binary | std::ios::trunc);
+            return m_stream.is_open();
+        }
+
+        bool Writer::finish()
+        {
+            const bool written = m_stream.good();
+            m_stream.close();
+            const std::string temporary = m_filename + ".tmp";
+            if (!written) {
+                std::remove(temporary.c_str());
+                return false;
+            }
+            // rename doesn't replace an existing file on Windows
+            std::remove(m_filename.c_str());
+            return std::rename(temporary.c_str(), m_filename.c_str()) == 0;
+        }
+
+        void Writer::discard()
+        {
+            if (m_stream.is_open()) {
+                m_stream.close();
+                std::remove((m_filename + ".tmp").c_str());
+            }
+        }
+
+        void Writer::write(const void* data, size_t size)
+        {
+            m_stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            m_offset += size;
+        }
+
+        void Writer::align(size_t alignment)
+        {
+            static const uint8_t zeros[64] = {};
+            size_t padding = static_cast<size_t>((alignment - m_offset % alignment) % alignment);
+            while (padding > 0) {
+                const size_t chunk = padding < sizeof(zeros) ? padding : sizeof(zeros);
+                write(zeros, chunk);
+                padding -= chunk;
+            }
+        }
+
+        void Writer::patch(uint64_t offset, const void* data, size_t size)
+        {
+            m_stream.seekp(static_cast<std::streamoff>(offset));
+            m_stream.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+            m_stream.seekp(static_cast<std::streamoff>(m_offset));
+        }
+
+        void Writer::writeString(const std::string& value)
+        {
+            writeValue(static_cast<uint32_t>(value.size()));
+            write(value.data(), value.size());
+        }
+
+        /*
+           Reader
+           */
+
+        bool Reader::seek(uint64_t offset)
+        {
+            if (offset > m_size) {
+                m_good = false;
+                return false;
+            }
+            m_offset = static_cast<size_t>(offset);
+            return true;
+        }
+
+        bool Reader::read(void* data, size_t size)
+        {
+            if (!m_good || size > m_size - m_offset) {
+                m_good = false;
+                return false;
+            }
+            memcpy(data, m_data + m_offset, size);
+            m_offset += size;
+            return true;
+        }
+
+        const uint8_t* Reader::view(uint64_t offset, uint64_t size)
+        {
+            if (offset > m_size || size > m_size - offset) {
+                m_good = false;
+                return nullptr;
+            }
+            return m_data + offset;
+        }
+
+        std::string Reader::readString()
+        {
+            const uint32_t length = readValue<uint32_t>();
+            if (!m_good || length > m_size - m_offset) {
+                m_good = false;
+                return std::string();
+            }
+            std::string value(reinterpret_cast<const char*>(m_data + m_offset), length);
+            m_offset += length;
+            return value;
+        }
+    }
+}
@@ -0,0 +1,595 @@
+#include "BlockCompression.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace VulkanLearning {
+    namespace BlockCompression {
+
+        // BC7 weights of 4 bit indices, out of 64
+        static const uint32_t kWeights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        // 128 bit block written and read from the least significant bit of byte 0 on
+        struct BitWriter {
+            uint8_t* data;
+            uint32_t position = 0;
+
+            void write(uint32_t value, uint32_t bits) {
+                for (uint32_t i = 0; i < bits; i++, position++) {
+                    data[position >> 3] |= static_cast<uint8_t>(((value >> i) & 1) << (position & 7));
+                }
+            }
+        };
+
+        struct BitReader {
+            const uint8_t* data;
+            uint32_t position = 0;
+
+            uint32_t read(uint32_t bits) {
+                uint32_t value = 0;
+                for (uint32_t i = 0; i < bits; i++, position++) {
+                    value |= static_cast<uint32_t>((data[position >> 3] >> (position & 7)) & 1) << i;
+                }
+                return value;
+            }
+        };
+
+        // 4x4 RGBA pixels of the block at (x, y), clamped to the image
+        static void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint8_t block[64]) {
+            for (uint32_t row = 0; row < 4; row++) {
+                const uint32_t srcY = std::min(y + row, height - 1);
+                for (uint32_t column = 0; column < 4; column++) {
+                    const uint32_t srcX = std::min(x + column, width - 1);
+                    memcpy(block + (row * 4 + column) * 4, rgba + (static_cast<size_t>(srcY) * width + srcX) * 4, 4);
+                }
+            }
+        }
+
+        static void storeBlock(const uint8_t block[64], uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint8_t* rgba) {
+            for (uint32_t row = 0; row < 4 && y + row < height; row++) {
+                for (uint32_t column = 0; column < 4 && x + column < width; column++) {
+                    memcpy(rgba + (static_cast<size_t>(y + row) * width + x + column) * 4, block + (row * 4 + column) * 4, 4);
+                }
+            }
+        }
+
+        // Ends of the line through the block colors along their principal axis, only the first
+        // channels channels of each pixel are taken into account
+        static void fitLine(const uint8_t block[64], uint32_t channels, float start[4], float end[4]) {
+            float mean[4] = {};
+            for (uint32_t i = 0; i < 16; i++) {
+                for (uint32_t c = 0; c < channels; c++) {
+                    mean[c] += block[i * 4 + c];
+                }
+            }
+            for (uint32_t c = 0; c < channels; c++) {
+                mean[c] /= 16.0f;
+            }
+
+            float covariance[4][4] = {};
+            for (uint32_t i = 0; i < 16; i++) {
+                float d[4];
+                for (uint32_t c = 0; c < channels; c++) {
+                    d[c] = block[i * 4 + c] - mean[c];
+                }
+                for (uint32_t r = 0; r < channels; r++) {
+                    for (uint32_t c = 0; c < channels; c++) {
+                        covariance[r][c] += d[r] * d[c];
+                    }
+                }
+            }
+
+            // A few power iterations are enough for a 4x4 block, the start is the largest diagonal
+            float axis[4] = {};
+            uint32_t largest = 0;
+            for (uint32_t c = 1; c < channels; c++) {
+                if (covariance[c][c] > covariance[largest][largest]) {
+                    largest = c;
+                }
+            }
+            axis[largest] = 1.0f;
+            for (uint32_t iteration = 0; iteration < 8; iteration++) {
+                float next[4] = {};
+                float length = 0.0f;
+                for (uint32_t r = 0; r < channels; r++) {
+                    for (uint32_t c = 0; c < channels; c++) {
+                        next[r] += covariance[r][c] * axis[c];
+                    }
+                    length = std::max(length, std::fabs(next[r]));
+                }
+                if (length == 0.0f) {
+                    break;
+                }
+                for (uint32_t c = 0; c < channels; c++) {
+                    axis[c] = next[c] / length;
+                }
+            }
+            float axisLength = 0.0f;
+            for (uint32_t c = 0; c < channels; c++) {
+                axisLength += axis[c] * axis[c];
+            }
+
+            float minT = 0.0f, maxT = 0.0f;
+            if (axisLength > 0.0f) {
+                for (uint32_t i = 0; i < 16; i++) {
+                    float t = 0.0f;
+                    for (uint32_t c = 0; c < channels; c++) {
+                        t += (block[i * 4 + c] - mean[c]) * axis[c];
+                    }
+                    t /= axisLength;
+                    minT = std::min(minT, t);
+                    maxT = std::max(maxT, t);
+                }
+            }
+            for (uint32_t c = 0; c < 4; c++) {
+                start[c] = c < channels ? std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minT)) : 255.0f;
+                end[c] = c < channels ? std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxT)) : 255.0f;
+            }
+        }
+
+        // Endpoints minimizing the squared error for the chosen indices, weights[i] is the share of
+        // end in pixel i. Returns false if all pixels use the same weight
+        static bool refineLine(const uint8_t block[64], uint32_t channels, const float weights[16], float start[4], float end[4]) {
+            float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+            float ax[4] = {}, bx[4] = {};
+            for (uint32_t i = 0; i < 16; i++) {
+                const float b = weights[i];
+                const float a = 1.0f - b;
+                aa += a * a;
+                bb += b * b;
+                ab += a * b;
+                for (uint32_t c = 0; c < channels; c++) {
+                    ax[c] += a * block[i * 4 + c];
+                    bx[c] += b * block[i * 4 + c];
+                }
+            }
+            const float determinant = aa * bb - ab * ab;
+            if (std::fabs(determinant) < 1e-6f) {
+                return false;
+            }
+            for (uint32_t c = 0; c < channels; c++) {
+                start[c] = std::min(255.0f, std::max(0.0f, (ax[c] * bb - bx[c] * ab) / determinant));
+                end[c] = std::min(255.0f, std::max(0.0f, (bx[c] * aa - ax[c] * ab) / determinant));
+            }
+            return true;
+        }
+
+        /* BC1 */
+
+        static uint16_t packRgb565(const float color[4]) {
+            const uint32_t r = static_cast<uint32_t>(color[0] * 31.0f / 255.0f + 0.5f);
+            const uint32_t g = static_cast<uint32_t>(color[1] * 63.0f / 255.0f + 0.5f);
+            const uint32_t b = static_cast<uint32_t>(color[2] * 31.0f / 255.0f + 0.5f);
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        static void unpackRgb565(uint16_t color, uint32_t rgb[3]) {
+            const uint32_t r = (color >> 11) & 31;
+            const uint32_t g = (color >> 5) & 63;
+            const uint32_t b = color & 31;
+            rgb[0] = (r << 3) | (r >> 2);
+            rgb[1] = (g << 2) | (g >> 4);
+            rgb[2] = (b << 3) | (b >> 2);
+        }
+
+        static void getBC1Palette(uint16_t color0, uint16_t color1, uint32_t palette[4][3]) {
+            unpackRgb565(color0, palette[0]);
+            unpackRgb565(color1, palette[1]);
+            for (uint32_t c = 0; c < 3; c++) {
+                if (color0 > color1) {
+                    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                } else {
+                    palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                    palette[3][c] = 0;
+                }
+            }
+        }
+
+        // Picks the closest of the four colors for every pixel, returns the squared error. Equal
+        // endpoints are a solid block that only uses index 0
+        static uint32_t selectBC1Indices(const uint8_t block[64], uint16_t color0, uint16_t color1, uint32_t& indices) {
+            uint32_t palette[4][3];
+            getBC1Palette(color0, color1, palette);
+            const uint32_t paletteSize = color0 == color1 ? 1 : 4;
+            indices = 0;
+            uint32_t error = 0;
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t best = 0, bestError = UINT32_MAX;
+                for (uint32_t p = 0; p < paletteSize; p++) {
+                    uint32_t e = 0;
+                    for (uint32_t c = 0; c < 3; c++) {
+                        const int32_t d = static_cast<int32_t>(block[i * 4 + c]) - static_cast<int32_t>(palette[p][c]);
+                        e += d * d;
+                    }
+                    if (e < bestError) {
+                        best = p;
+                        bestError = e;
+                    }
+                }
+                indices |= best << (i * 2);
+                error += bestError;
+            }
+            return error;
+        }
+
+        static void encodeBC1Block(const uint8_t block[64], uint8_t* dst) {
+            float start[4], end[4];
+            fitLine(block, 3, start, end);
+
+            uint16_t bestColor0 = 0, bestColor1 = 0;
+            uint32_t bestIndices = 0, bestError = UINT32_MAX;
+            for (uint32_t pass = 0; pass < 2; pass++) {
+                // The four color mode needs color0 > color1, equal endpoints are a solid block
+                uint16_t color0 = packRgb565(end);
+                uint16_t color1 = packRgb565(start);
+                if (color0 < color1) {
+                    std::swap(color0, color1);
+                }
+                uint32_t indices;
+                const uint32_t error = selectBC1Indices(block, color0, color1, indices);
+                if (error < bestError) {
+                    bestColor0 = color0;
+                    bestColor1 = color1;
+                    bestIndices = indices;
+                    bestError = error;
+                }
+                if (bestError == 0 || color0 == color1) {
+                    break;
+                }
+
+                // Refit the endpoints to the indices, color0 is the end the next pass starts from
+                static const float shares[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+                float weights[16];
+                for (uint32_t i = 0; i < 16; i++) {
+                    weights[i] = shares[(indices >> (i * 2)) & 3];
+                }
+                float refinedStart[4], refinedEnd[4];
+                if (!refineLine(block, 3, weights, refinedStart, refinedEnd)) {
+                    break;
+                }
+                // Weights are relative to color1, so the fitted start belongs to color0
+                memcpy(end, refinedStart, sizeof(end));
+                memcpy(start, refinedEnd, sizeof(start));
+            }
+
+            dst[0] = static_cast<uint8_t>(bestColor0);
+            dst[1] = static_cast<uint8_t>(bestColor0 >> 8);
+            dst[2] = static_cast<uint8_t>(bestColor1);
+            dst[3] = static_cast<uint8_t>(bestColor1 >> 8);
+            for (uint32_t i = 0; i < 4; i++) {
+                dst[4 + i] = static_cast<uint8_t>(bestIndices >> (i * 8));
+            }
+        }
+
+        static void decodeBC1Block(const uint8_t* src, uint8_t block[64]) {
+            const uint16_t color0 = static_cast<uint16_t>(src[0] | (src[1] << 8));
+            const uint16_t color1 = static_cast<uint16_t>(src[2] | (src[3] << 8));
+            const uint32_t indices = src[4] | (src[5] << 8) | (src[6] << 16) | (static_cast<uint32_t>(src[7]) << 24);
+            uint32_t palette[4][3];
+            getBC1Palette(color0, color1, palette);
+            for (uint32_t i = 0; i < 16; i++) {
+                const uint32_t index = (indices >> (i * 2)) & 3;
+                for (uint32_t c = 0; c < 3; c++) {
+                    block[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+                }
+                block[i * 4 + 3] = 255;
+            }
+        }
+
+        /* BC4, two of them make a BC5 block */
+
+        static void getBC4Palette(uint32_t value0, uint32_t value1, uint32_t palette[8]) {
+            palette[0] = value0;
+            palette[1] = value1;
+            for (uint32_t i = 2; i < 8; i++) {
+                palette[i] = ((8 - i) * value0 + (i - 1) * value1) / 7;
+            }
+        }
+
+        static void encodeBC4Block(const uint8_t block[64], uint32_t channel, uint8_t* dst) {
+            uint32_t minValue = 255, maxValue = 0;
+            for (uint32_t i = 0; i < 16; i++) {
+                minValue = std::min<uint32_t>(minValue, block[i * 4 + channel]);
+                maxValue = std::max<uint32_t>(maxValue, block[i * 4 + channel]);
+            }
+            // value0 > value1 selects the eight value mode, a solid block uses index 0 only
+            uint32_t palette[8];
+            getBC4Palette(maxValue, minValue, palette);
+            memset(dst, 0, 8);
+            dst[0] = static_cast<uint8_t>(maxValue);
+            dst[1] = static_cast<uint8_t>(minValue);
+            if (maxValue == minValue) {
+                return;
+            }
+            BitWriter writer{ dst + 2 };
+            for (uint32_t i = 0; i < 16; i++) {
+                const int32_t value = block[i * 4 + channel];
+                uint32_t best = 0;
+                int32_t bestError = INT32_MAX;
+                for (uint32_t p = 0; p < 8; p++) {
+                    const int32_t error = std::abs(value - static_cast<int32_t>(palette[p]));
+                    if (error < bestError) {
+                        best = p;
+                        bestError = error;
+                    }
+                }
+                writer.write(best, 3);
+            }
+        }
+
+        static void decodeBC4Block(const uint8_t* src, uint32_t channel, uint8_t block[64]) {
+            uint32_t palette[8];
+            if (src[0] > src[1]) {
+                getBC4Palette(src[0], src[1], palette);
+            } else {
+                // Six interpolated values plus 0 and 255
+                palette[0] = src[0];
+                palette[1] = src[1];
+                for (uint32_t i = 2; i < 6; i++) {
+                    palette[i] = ((6 - i) * src[0] + (i - 1) * src[1]) / 5;
+                }
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+            BitReader reader{ src + 2 };
+            for (uint32_t i = 0; i < 16; i++) {
+                block[i * 4 + channel] = static_cast<uint8_t>(palette[reader.read(3)]);
+            }
+        }
+
+        /* BC7 mode 6 */
+
+        struct BC7Endpoints {
+            uint32_t color[2][4];
+            uint32_t pbit[2];
+        };
+
+        // 8 bit endpoint value of a 7 bit channel and its p-bit
+        static uint32_t expandBC7(uint32_t value, uint32_t pbit) {
+            return (value << 1) | pbit;
+        }
+
+        static void quantizeBC7(const float start[4], const float end[4], uint32_t pbit0, uint32_t pbit1, BC7Endpoints& endpoints) {
+            endpoints.pbit[0] = pbit0;
+            endpoints.pbit[1] = pbit1;
+            for (uint32_t c = 0; c < 4; c++) {
+                endpoints.color[0][c] = static_cast<uint32_t>(std::min(127.0f, std::max(0.0f, std::floor((start[c] - pbit0) * 0.5f + 0.5f))));
+                endpoints.color[1][c] = static_cast<uint32_t>(std::min(127.0f, std::max(0.0f, std::floor((end[c] - pbit1) * 0.5f + 0.5f))));
+            }
+        }
+
+        static void getBC7Palette(const BC7Endpoints& endpoints, uint32_t palette[16][4]) {
+            for (uint32_t c = 0; c < 4; c++) {
+                const uint32_t e0 = expandBC7(endpoints.color[0][c], endpoints.pbit[0]);
+                const uint32_t e1 = expandBC7(endpoints.color[1][c], endpoints.pbit[1]);
+                for (uint32_t i = 0; i < 16; i++) {
+                    palette[i][c] = ((64 - kWeights4[i]) * e0 + kWeights4[i] * e1 + 32) >> 6;
+                }
+            }
+        }
+
+        // Closest palette entry per pixel, found by projecting onto the endpoint line and checking
+        // the neighbouring indices. Returns the squared error
+        static uint32_t selectBC7Indices(const uint8_t block[64], const BC7Endpoints& endpoints, uint8_t indices[16]) {
+            uint32_t palette[16][4];
+            getBC7Palette(endpoints, palette);
+            int32_t direction[4];
+            int32_t lengthSquared = 0;
+            for (uint32_t c = 0; c < 4; c++) {
+                direction[c] = static_cast<int32_t>(palette[15][c]) - static_cast<int32_t>(palette[0][c]);
+                lengthSquared += direction[c] * direction[c];
+            }
+
+            uint32_t error = 0;
+            for (uint32_t i = 0; i < 16; i++) {
+                const uint8_t* pixel = block + i * 4;
+                uint32_t guess = 0;
+                if (lengthSquared > 0) {
+                    int32_t dot = 0;
+                    for (uint32_t c = 0; c < 4; c++) {
+                        dot += (static_cast<int32_t>(pixel[c]) - static_cast<int32_t>(palette[0][c])) * direction[c];
+                    }
+                    const float t = std::min(1.0f, std::max(0.0f, static_cast<float>(dot) / lengthSquared));
+                    guess = static_cast<uint32_t>(t * 15.0f + 0.5f);
+                }
+                uint32_t best = guess, bestError = UINT32_MAX;
+                for (uint32_t index = guess > 0 ? guess - 1 : 0; index <= std::min(15u, guess + 1); index++) {
+                    uint32_t e = 0;
+                    for (uint32_t c = 0; c < 4; c++) {
+                        const int32_t d = static_cast<int32_t>(pixel[c]) - static_cast<int32_t>(palette[index][c]);
+                        e += d * d;
+                    }
+                    if (e < bestError) {
+                        best = index;
+                        bestError = e;
+                    }
+                }
+                indices[i] = static_cast<uint8_t>(best);
+                error += bestError;
+            }
+            return error;
+        }
+
+        // Each endpoint takes the p-bit that quantizes it closest, the indices are chosen for those
+        static uint32_t fitBC7Endpoints(const uint8_t block[64], const float start[4], const float end[4], BC7Endpoints& endpoints, uint8_t indices[16]) {
+            uint32_t pbits[2];
+            const float* colors[2] = { start, end };
+            for (uint32_t e = 0; e < 2; e++) {
+                float errors[2] = {};
+                for (uint32_t pbit = 0; pbit < 2; pbit++) {
+                    BC7Endpoints quantized;
+                    quantizeBC7(colors[e], colors[e], pbit, pbit, quantized);
+                    for (uint32_t c = 0; c < 4; c++) {
+                        const float d = colors[e][c] - static_cast<float>(expandBC7(quantized.color[0][c], pbit));
+                        errors[pbit] += d * d;
+                    }
+                }
+                pbits[e] = errors[1] < errors[0] ? 1 : 0;
+            }
+            quantizeBC7(start, end, pbits[0], pbits[1], endpoints);
+            return selectBC7Indices(block, endpoints, indices);
+        }
+
+        static void encodeBC7Block(const uint8_t block[64], uint8_t* dst) {
+            float start[4], end[4];
+            fitLine(block, 4, start, end);
+
+            BC7Endpoints endpoints;
+            uint8_t indices[16];
+            uint32_t error = fitBC7Endpoints(block, start, end, endpoints, indices);
+            for (uint32_t pass = 0; pass < 2 && error > 0; pass++) {
+                float weights[16];
+                for (uint32_t i = 0; i < 16; i++) {
+                    weights[i] = kWeights4[indices[i]] / 64.0f;
+                }
+                if (!refineLine(block, 4, weights, start, end)) {
+                    break;
+                }
+                BC7Endpoints refinedEndpoints;
+                uint8_t refinedIndices[16];
+                const uint32_t refinedError = fitBC7Endpoints(block, start, end, refinedEndpoints, refinedIndices);
+                if (refinedError >= error) {
+                    break;
+                }
+                endpoints = refinedEndpoints;
+                memcpy(indices, refinedIndices, sizeof(indices));
+                error = refinedError;
+            }
+
+            // The first index is stored without its top bit, which has to be zero
+            if (indices[0] & 8) {
+                std::swap(endpoints.color[0], endpoints.color[1]);
+                std::swap(endpoints.pbit[0], endpoints.pbit[1]);
+                for (uint32_t i = 0; i < 16; i++) {
+                    indices[i] = static_cast<uint8_t>(15 - indices[i]);
+                }
+            }
+
+            memset(dst, 0, 16);
+            BitWriter writer{ dst };
+            writer.write(1 << 6, 7);
+            for (uint32_t c = 0; c < 4; c++) {
+                writer.write(endpoints.color[0][c], 7);
+                writer.write(endpoints.color[1][c], 7);
+            }
+            writer.write(endpoints.pbit[0], 1);
+            writer.write(endpoints.pbit[1], 1);
+            writer.write(indices[0], 3);
+            for (uint32_t i = 1; i < 16; i++) {
+                writer.write(indices[i], 4);
+            }
+        }
+
+        static void decodeBC7Block(const uint8_t* src, uint8_t block[64]) {
+            BitReader reader{ src };
+            if (reader.read(7) != (1 << 6)) {
+                // Other modes are never written by encode
+                memset(block, 0, 64);
+                return;
+            }
+            BC7Endpoints endpoints;
+            for (uint32_t c = 0; c < 4; c++) {
+                endpoints.color[0][c] = reader.read(7);
+                endpoints.color[1][c] = reader.read(7);
+            }
+            endpoints.pbit[0] = reader.read(1);
+            endpoints.pbit[1] = reader.read(1);
+            uint32_t palette[16][4];
+            getBC7Palette(endpoints, palette);
+            for (uint32_t i = 0; i < 16; i++) {
+                const uint32_t index = reader.read(i == 0 ? 3 : 4);
+                for (uint32_t c = 0; c < 4; c++) {
+                    block[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+                }
+            }
+        }
+
+        /* Images */
+
+        const char* getFormatName(Format format) {
+            switch (format) {
+                case Format::BC1: return "BC1";
+                case Format::BC5: return "BC5";
+                case Format::BC7: return "BC7";
+            }
+            return "";
+        }
+
+        uint32_t getBlockSize(Format format) {
+            return format == Format::BC1 ? 8 : 16;
+        }
+
+        size_t getImageSize(Format format, uint32_t width, uint32_t height) {
+            return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+        }
+
+        void encode(Format format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* dst) {
+            const uint32_t blockSize = getBlockSize(format);
+            uint8_t block[64];
+            for (uint32_t y = 0; y < height; y += 4) {
+                for (uint32_t x = 0; x < width; x += 4) {
+                    loadBlock(rgba, width, height, x, y, block);
+                    switch (format) {
+                        case Format::BC1:
+                            encodeBC1Block(block, dst);
+                            break;
+                        case Format::BC5:
+                            encodeBC4Block(block, 0, dst);
+                            encodeBC4Block(block, 1, dst + 8);
+                            break;
+                        case Format::BC7:
+                            encodeBC7Block(block, dst);
+                            break;
+                    }
+                    dst += blockSize;
+                }
+            }
+        }
+
+        void decode(Format format, const uint8_t* src, uint32_t width, uint32_t height, uint8_t* rgba) {
+            const uint32_t blockSize = getBlockSize(format);
+            uint8_t block[64];
+            for (uint32_t y = 0; y < height; y += 4) {
+                for (uint32_t x = 0; x < width; x += 4) {
+                    switch (format) {
+                        case Format::BC1:
+                            decodeBC1Block(src, block);
+                            break;
+                        case Format::BC5:
+                            for (uint32_t i = 0; i < 16; i++) {
+                                block[i * 4 + 2] = 0;
+                                block[i * 4 + 3] = 255;
+                            }
+                            decodeBC4Block(src, 0, block);
+                            decodeBC4Block(src + 8, 1, block);
+                            break;
+                        case Format::BC7:
+                            decodeBC7Block(src, block);
+                            break;
+                    }
+                    storeBlock(block, width, height, x, y, rgba);
+                    src += blockSize;
+                }
+            }
+        }
+
+        double psnr(Format format, const uint8_t* reference, const uint8_t* decoded, uint32_t width, uint32_t height) {
+            const uint32_t channels = format == Format::BC1 ? 3 : (format == Format::BC5 ? 2 : 4);
+            const size_t pixelCount = static_cast<size_t>(width) * height;
+            double squaredError = 0.0;
+            for (size_t i = 0; i < pixelCount; i++) {
+                for (uint32_t c = 0; c < channels; c++) {
+                    const double d = static_cast<double>(reference[i * 4 + c]) - decoded[i * 4 + c];
+                    squaredError += d * d;
+                }
+            }
+            if (squaredError == 0.0 || pixelCount == 0) {
+                return 99.0;
+            }
+            const double mse = squaredError / (static_cast<double>(pixelCount) * channels);
+            return 10.0 * std::log10(255.0 * 255.0 / mse);
+        }
+    }
+}
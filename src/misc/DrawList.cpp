@@ -0,0 +1,73 @@
+#include "DrawList.hpp"
+
+#include <cstring>
+#include <utility>
+
+namespace VulkanLearning {
+
+    namespace DrawList {
+
+        // Non negative floats keep their order when compared as unsigned integers
+        static uint32_t depthBits(float depth)
+        {
+            if (!(depth > 0.0f)) {
+                return 0;
+            }
+            uint32_t bits;
+            memcpy(&bits, &depth, sizeof(bits));
+            return bits;
+        }
+
+        uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, bool backToFront)
+        {
+            const uint64_t passBits = uint64_t(pass & 0xF) << 60;
+            const uint64_t pipelineBits = pipeline & 0xFFF;
+            const uint64_t materialBits = material & 0xFFFF;
+            if (backToFront) {
+                const uint64_t farFirst = uint64_t(~depthBits(depth)) << 28;
+                return passBits | farFirst | (pipelineBits << 16) | materialBits;
+            }
+            return passBits | (pipelineBits << 48) | (materialBits << 32) | depthBits(depth);
+        }
+
+        void sort(std::vector<DrawItem>& items, std::vector<DrawItem>& scratch)
+        {
+            const size_t count = items.size();
+            if (count < 2) {
+                return;
+            }
+            scratch.resize(count);
+
+            // All eight histograms in one pass over the keys
+            uint32_t histograms[8][256] = {};
+            for (const DrawItem& item : items) {
+                for (uint32_t byte = 0; byte < 8; byte++) {
+                    histograms[byte][(item.key >> (byte * 8)) & 0xFF]++;
+                }
+            }
+
+            DrawItem* source = items.data();
+            DrawItem* destination = scratch.data();
+            for (uint32_t byte = 0; byte < 8; byte++) {
+                uint32_t* histogram = histograms[byte];
+                const uint32_t shift = byte * 8;
+                if (histogram[(source[0].key >> shift) & 0xFF] == count) {
+                    continue;
+                }
+                uint32_t offset = 0;
+                for (uint32_t bucket = 0; bucket < 256; bucket++) {
+                    const uint32_t bucketCount = histogram[bucket];
+                    histogram[bucket] = offset;
+                    offset += bucketCount;
+                }
+                for (size_t i = 0; i < count; i++) {
+                    destination[histogram[(source[i].key >> shift) & 0xFF]++] = source[i];
+                }
+                std::swap(source, destination);
+            }
+            if (source != items.data()) {
+                memcpy(items.data(), source, count * sizeof(DrawItem));
+            }
+        }
+    }
+}
@@ -0,0 +1,753 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+
+namespace VulkanLearning {
+
+    namespace MeshOptimizer {
+
+        static const uint32_t kInvalidIndex = ~0u;
+
+        VertexCacheStatistics& VertexCacheStatistics::operator+=(const VertexCacheStatistics& other)
+        {
+            verticesTransformed += other.verticesTransformed;
+            triangleCount += other.triangleCount;
+            vertexCount += other.vertexCount;
+            return *this;
+        }
+
+        VertexCacheStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+        {
+            VertexCacheStatistics statistics;
+            statistics.triangleCount = indexCount / 3;
+
+            // A vertex is cached if fewer than cacheSize misses happened since it was loaded
+            std::vector<size_t> loadedAt(vertexCount, 0);
+            size_t timestamp = cacheSize + 1;
+            for (size_t i = 0; i < indexCount; i++) {
+                uint32_t index = indices[i];
+                if (loadedAt[index] == 0) {
+                    statistics.vertexCount++;
+                }
+                if (timestamp - loadedAt[index] > cacheSize) {
+                    loadedAt[index] = timestamp++;
+                    statistics.verticesTransformed++;
+                }
+            }
+            return statistics;
+        }
+
+        static uint32_t hashVertex(const unsigned char* vertex, size_t vertexSize)
+        {
+            // FNV-1a
+            uint32_t hash = 2166136261u;
+            for (size_t i = 0; i < vertexSize; i++) {
+                hash ^= vertex[i];
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        size_t generateVertexRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexSize)
+        {
+            const unsigned char* data = static_cast<const unsigned char*>(vertices);
+            std::fill(remap, remap + vertexCount, kInvalidIndex);
+
+            // Open addressing table of vertex indices, at most half full
+            size_t tableSize = 1;
+            while (tableSize < vertexCount * 2) {
+                tableSize *= 2;
+            }
+            std::vector<uint32_t> table(tableSize, kInvalidIndex);
+
+            size_t uniqueCount = 0;
+            for (size_t i = 0; i < indexCount; i++) {
+                uint32_t index = indices[i];
+                if (remap[index] != kInvalidIndex) {
+                    continue;
+                }
+                const unsigned char* vertex = data + index * vertexSize;
+                size_t slot = hashVertex(vertex, vertexSize) & (tableSize - 1);
+                while (table[slot] != kInvalidIndex && memcmp(data + table[slot] * vertexSize, vertex, vertexSize) != 0) {
+                    slot = (slot + 1) & (tableSize - 1);
+                }
+                if (table[slot] == kInvalidIndex) {
+                    table[slot] = index;
+                    remap[index] = static_cast<uint32_t>(uniqueCount++);
+                } else {
+                    remap[index] = remap[table[slot]];
+                }
+            }
+            return uniqueCount;
+        }
+
+        size_t generateVertexFetchRemap(uint32_t* remap, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+        {
+            std::fill(remap, remap + vertexCount, kInvalidIndex);
+            size_t referencedCount = 0;
+            for (size_t i = 0; i < indexCount; i++) {
+                if (remap[indices[i]] == kInvalidIndex) {
+                    remap[indices[i]] = static_cast<uint32_t>(referencedCount++);
+                }
+            }
+            return referencedCount;
+        }
+
+        void remapIndexBuffer(uint32_t* dst, const uint32_t* indices, size_t indexCount, const uint32_t* remap)
+        {
+            for (size_t i = 0; i < indexCount; i++) {
+                dst[i] = remap[indices[i]];
+            }
+        }
+
+        void remapVertexBuffer(void* dst, const void* vertices, size_t vertexCount, size_t vertexSize, const uint32_t* remap)
+        {
+            unsigned char* out = static_cast<unsigned char*>(dst);
+            const unsigned char* in = static_cast<const unsigned char*>(vertices);
+            for (size_t i = 0; i < vertexCount; i++) {
+                if (remap[i] != kInvalidIndex) {
+                    memcpy(out + remap[i] * vertexSize, in + i * vertexSize, vertexSize);
+                }
+            }
+        }
+
+        /*
+           Vertex cache ordering
+           Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+           */
+
+        static const uint32_t kCacheSize = 32;
+
+        static float getVertexScore(int32_t cachePosition, uint32_t liveTriangles)
+        {
+            if (liveTriangles == 0) {
+                return -1.0f;
+            }
+            float score = 0.0f;
+            if (cachePosition >= 0) {
+                if (cachePosition < 3) {
+                    // The last triangle's vertices get a fixed score so it isn't reused right away
+                    score = 0.75f;
+                } else {
+                    float t = 1.0f - float(cachePosition - 3) / float(kCacheSize - 3);
+                    score = std::pow(t, 1.5f);
+                }
+            }
+            // Favour vertices with few remaining triangles to finish them off
+            return score + 2.0f / std::sqrt(float(liveTriangles));
+        }
+
+        void optimizeVertexCache(uint32_t* dst, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+        {
+            const size_t triangleCount = indexCount / 3;
+            std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+
+            // Triangles using each vertex, the live ones are kept at the front of each list
+            std::vector<uint32_t> liveTriangles(vertexCount, 0);
+            for (uint32_t index : source) {
+                liveTriangles[index]++;
+            }
+            std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+            for (size_t v = 0; v < vertexCount; v++) {
+                adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+            }
+            std::vector<uint32_t> adjacency(source.size());
+            {
+                std::vector<uint32_t> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+                for (size_t t = 0; t < triangleCount; t++) {
+                    for (size_t k = 0; k < 3; k++) {
+                        adjacency[cursor[source[t * 3 + k]]++] = static_cast<uint32_t>(t);
+                    }
+                }
+            }
+
+            std::vector<int32_t> cachePositions(vertexCount, -1);
+            std::vector<float> vertexScores(vertexCount);
+            for (size_t v = 0; v < vertexCount; v++) {
+                vertexScores[v] = getVertexScore(-1, liveTriangles[v]);
+            }
+            std::vector<float> triangleScores(triangleCount);
+            std::vector<bool> emitted(triangleCount, false);
+            uint32_t bestTriangle = kInvalidIndex;
+            float bestScore = -1.0f;
+            for (size_t t = 0; t < triangleCount; t++) {
+                triangleScores[t] = vertexScores[source[t * 3]] + vertexScores[source[t * 3 + 1]] + vertexScores[source[t * 3 + 2]];
+                if (triangleScores[t] > bestScore) {
+                    bestScore = triangleScores[t];
+                    bestTriangle = static_cast<uint32_t>(t);
+                }
+            }
+
+            uint32_t cache[kCacheSize + 3];
+            uint32_t newCache[kCacheSize + 3];
+            size_t cacheCount = 0;
+            size_t inputCursor = 0;
+
+            for (size_t output = 0; output < triangleCount; output++) {
+                if (bestTriangle == kInvalidIndex) {
+                    // Nothing adjacent to the cache is left, restart from the first unemitted triangle
+                    while (emitted[inputCursor]) {
+                        inputCursor++;
+                    }
+                    bestTriangle = static_cast<uint32_t>(inputCursor);
+                }
+                const uint32_t* triangle = &source[bestTriangle * 3];
+                memcpy(&dst[output * 3], triangle, 3 * sizeof(uint32_t));
+                emitted[bestTriangle] = true;
+
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t v = triangle[k];
+                    uint32_t* list = &adjacency[adjacencyOffsets[v]];
+                    uint32_t count = liveTriangles[v];
+                    for (uint32_t i = 0; i < count; i++) {
+                        if (list[i] == bestTriangle) {
+                            list[i] = list[count - 1];
+                            break;
+                        }
+                    }
+                    liveTriangles[v]--;
+                }
+
+                // The triangle's vertices move to the front of the cache
+                size_t newCacheCount = 0;
+                newCache[newCacheCount++] = triangle[0];
+                newCache[newCacheCount++] = triangle[1];
+                newCache[newCacheCount++] = triangle[2];
+                for (size_t i = 0; i < cacheCount; i++) {
+                    uint32_t v = cache[i];
+                    if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                        newCache[newCacheCount++] = v;
+                    }
+                }
+
+                // Rescore the cached vertices and their live triangles, vertices past the cache size were evicted
+                bestTriangle = kInvalidIndex;
+                bestScore = -1.0f;
+                for (size_t i = 0; i < newCacheCount; i++) {
+                    uint32_t v = newCache[i];
+                    int32_t position = i < kCacheSize ? static_cast<int32_t>(i) : -1;
+                    cachePositions[v] = position;
+                    float score = getVertexScore(position, liveTriangles[v]);
+                    float delta = score - vertexScores[v];
+                    vertexScores[v] = score;
+                    const uint32_t* list = &adjacency[adjacencyOffsets[v]];
+                    for (uint32_t j = 0; j < liveTriangles[v]; j++) {
+                        uint32_t t = list[j];
+                        triangleScores[t] += delta;
+                        if (position >= 0 && triangleScores[t] > bestScore) {
+                            bestScore = triangleScores[t];
+                            bestTriangle = t;
+                        }
+                    }
+                }
+                cacheCount = std::min(newCacheCount, static_cast<size_t>(kCacheSize));
+                memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+            }
+        }
+
+        /*
+           Overdraw ordering
+           Sander, Nehab, Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+           */
+
+        struct Cluster {
+            size_t firstTriangle;
+            size_t triangleCount;
+            float sortKey;
+        };
+
+        void optimizeOverdraw(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount)
+        {
+            const size_t triangleCount = indexCount / 3;
+            std::vector<uint32_t> source(indices, indices + triangleCount * 3);
+            auto position = [&](uint32_t index) {
+                return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + index * positionStride);
+            };
+
+            // Split where a triangle misses the cache with all three vertices, moving those clusters around costs nothing
+            std::vector<Cluster> clusters;
+            {
+                std::vector<size_t> loadedAt(vertexCount, 0);
+                size_t timestamp = kCacheSize + 1;
+                for (size_t t = 0; t < triangleCount; t++) {
+                    uint32_t misses = 0;
+                    for (size_t k = 0; k < 3; k++) {
+                        uint32_t index = source[t * 3 + k];
+                        if (timestamp - loadedAt[index] > kCacheSize) {
+                            loadedAt[index] = timestamp++;
+                            misses++;
+                        }
+                    }
+                    if (clusters.empty() || misses == 3) {
+                        clusters.push_back({ t, 0, 0.0f });
+                    }
+                    clusters.back().triangleCount++;
+                }
+            }
+
+            // Area weighted centroids and normals
+            std::vector<float> clusterData(clusters.size() * 7, 0.0f);
+            float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+            float meshArea = 0.0f;
+            for (size_t c = 0; c < clusters.size(); c++) {
+                float* data = &clusterData[c * 7];
+                for (size_t t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; t++) {
+                    const float* p0 = position(source[t * 3]);
+                    const float* p1 = position(source[t * 3 + 1]);
+                    const float* p2 = position(source[t * 3 + 2]);
+                    float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+                    float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+                    float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+                    float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                    for (size_t k = 0; k < 3; k++) {
+                        float centroid = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                        data[k] += centroid * area;
+                        data[3 + k] += n[k];
+                    }
+                    data[6] += area;
+                }
+                for (size_t k = 0; k < 3; k++) {
+                    meshCentroid[k] += data[k];
+                }
+                meshArea += data[6];
+            }
+            if (meshArea > 0.0f) {
+                for (size_t k = 0; k < 3; k++) {
+                    meshCentroid[k] /= meshArea;
+                }
+            }
+
+            // Clusters facing away from the mesh center occlude the rest and go first
+            for (size_t c = 0; c < clusters.size(); c++) {
+                const float* data = &clusterData[c * 7];
+                float normalLength = std::sqrt(data[3] * data[3] + data[4] * data[4] + data[5] * data[5]);
+                if (data[6] <= 0.0f || normalLength <= 0.0f) {
+                    continue;
+                }
+                float key = 0.0f;
+                for (size_t k = 0; k < 3; k++) {
+                    key += (data[k] / data[6] - meshCentroid[k]) * data[3 + k];
+                }
+                clusters[c].sortKey = key / normalLength;
+            }
+            std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+                    return a.sortKey > b.sortKey;
+                    });
+
+            size_t output = 0;
+            for (const Cluster& cluster : clusters) {
+                memcpy(&dst[output], &source[cluster.firstTriangle * 3], cluster.triangleCount * 3 * sizeof(uint32_t));
+                output += cluster.triangleCount * 3;
+            }
+        }
+
+        /*
+           Simplification
+           Garland, Heckbert, "Surface Simplification Using Quadric Error Metrics", restricted to
+           half edge collapses so no new vertices are created
+           */
+
+        // Symmetric 4x4 plane quadric, a holds the upper triangle of the 3x3 part
+        struct Quadric {
+            double a00 = 0.0, a01 = 0.0, a02 = 0.0, a11 = 0.0, a12 = 0.0, a22 = 0.0;
+            double b0 = 0.0, b1 = 0.0, b2 = 0.0, c = 0.0;
+            double weight = 0.0;
+
+            void addPlane(double nx, double ny, double nz, double d, double w) {
+                a00 += w * nx * nx; a01 += w * nx * ny; a02 += w * nx * nz;
+                a11 += w * ny * ny; a12 += w * ny * nz; a22 += w * nz * nz;
+                b0 += w * nx * d; b1 += w * ny * d; b2 += w * nz * d;
+                c += w * d * d;
+                weight += w;
+            }
+
+            void add(const Quadric& q) {
+                a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+                b0 += q.b0; b1 += q.b1; b2 += q.b2; c += q.c;
+                weight += q.weight;
+            }
+
+            // Area weighted mean of the squared distances to the accumulated planes
+            double evaluate(const float* p) const {
+                double x = p[0], y = p[1], z = p[2];
+                double r = a00 * x * x + a11 * y * y + a22 * z * z
+                    + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z)
+                    + 2.0 * (b0 * x + b1 * y + b2 * z) + c;
+                return r > 0.0 && weight > 0.0 ? r / weight : 0.0;
+            }
+        };
+
+        struct Collapse {
+            uint32_t from;
+            uint32_t to;
+            double cost;
+        };
+
+        static void cross(const float* p0, const float* p1, const float* p2, double* n)
+        {
+            double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        }
+
+        size_t simplify(uint32_t* dst, const uint32_t* indices, size_t indexCount, const float* positions, size_t positionStride, size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError)
+        {
+            auto position = [&](uint32_t index) {
+                return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + index * positionStride);
+            };
+            std::vector<uint32_t> result(indices, indices + indexCount / 3 * 3);
+            if (resultError) {
+                *resultError = 0.0f;
+            }
+
+            // Vertices sharing a position (attribute seams) are welded to the first one for topology and error
+            std::vector<uint32_t> canonical(vertexCount, kInvalidIndex);
+            std::vector<uint32_t> sharedCount(vertexCount, 0);
+            float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+            float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+            {
+                size_t tableSize = 1;
+                while (tableSize < vertexCount * 2) {
+                    tableSize *= 2;
+                }
+                std::vector<uint32_t> table(tableSize, kInvalidIndex);
+                for (uint32_t index : result) {
+                    if (canonical[index] != kInvalidIndex) {
+                        continue;
+                    }
+                    const float* p = position(index);
+                    for (size_t k = 0; k < 3; k++) {
+                        boundsMin[k] = std::min(boundsMin[k], p[k]);
+                        boundsMax[k] = std::max(boundsMax[k], p[k]);
+                    }
+                    size_t slot = hashVertex(reinterpret_cast<const unsigned char*>(p), 3 * sizeof(float)) & (tableSize - 1);
+                    while (table[slot] != kInvalidIndex && memcmp(position(table[slot]), p, 3 * sizeof(float)) != 0) {
+                        slot = (slot + 1) & (tableSize - 1);
+                    }
+                    if (table[slot] == kInvalidIndex) {
+                        table[slot] = index;
+                    }
+                    canonical[index] = table[slot];
+                    sharedCount[table[slot]]++;
+                }
+            }
+            if (result.empty()) {
+                return 0;
+            }
+            double radius = 0.0;
+            for (size_t k = 0; k < 3; k++) {
+                radius += double(boundsMax[k] - boundsMin[k]) * double(boundsMax[k] - boundsMin[k]);
+            }
+            radius = std::sqrt(radius) * 0.5;
+            const double maxCost = radius > 0.0 ? double(targetError) * radius * double(targetError) * radius : 0.0;
+
+            // Border edges only have one direction in the welded topology, their vertices stay in place
+            std::vector<bool> locked(vertexCount, false);
+            {
+                std::unordered_set<uint64_t> edges;
+                edges.reserve(result.size());
+                for (size_t i = 0; i < result.size(); i += 3) {
+                    for (size_t k = 0; k < 3; k++) {
+                        uint64_t a = canonical[result[i + k]];
+                        uint64_t b = canonical[result[i + (k + 1) % 3]];
+                        edges.insert((a << 32) | b);
+                    }
+                }
+                for (size_t i = 0; i < result.size(); i += 3) {
+                    for (size_t k = 0; k < 3; k++) {
+                        uint32_t a = result[i + k];
+                        uint32_t b = result[i + (k + 1) % 3];
+                        if (edges.count((uint64_t(canonical[b]) << 32) | canonical[a]) == 0) {
+                            locked[a] = true;
+                            locked[b] = true;
+                        }
+                    }
+                }
+                for (size_t v = 0; v < vertexCount; v++) {
+                    if (canonical[v] != kInvalidIndex && sharedCount[canonical[v]] > 1) {
+                        locked[v] = true;
+                    }
+                }
+            }
+
+            std::vector<Quadric> quadrics(vertexCount);
+            for (size_t i = 0; i < result.size(); i += 3) {
+                double n[3];
+                cross(position(result[i]), position(result[i + 1]), position(result[i + 2]), n);
+                double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length <= 0.0) {
+                    continue;
+                }
+                const float* p0 = position(result[i]);
+                double d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]) / length;
+                for (size_t k = 0; k < 3; k++) {
+                    quadrics[canonical[result[i + k]]].addPlane(n[0] / length, n[1] / length, n[2] / length, d, length * 0.5);
+                }
+            }
+
+            double maxAppliedCost = 0.0;
+            std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+            std::vector<uint32_t> adjacency;
+            std::vector<Collapse> collapses;
+            std::vector<uint32_t> collapseTarget(vertexCount);
+            std::vector<bool> touched(vertexCount);
+
+            while (result.size() > targetIndexCount) {
+                // Triangles around each vertex
+                std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+                for (uint32_t index : result) {
+                    triangleOffsets[index + 1]++;
+                }
+                for (size_t v = 0; v < vertexCount; v++) {
+                    triangleOffsets[v + 1] += triangleOffsets[v];
+                }
+                adjacency.resize(result.size());
+                {
+                    std::vector<uint32_t> cursor(triangleOffsets.begin(), triangleOffsets.end() - 1);
+                    for (size_t i = 0; i < result.size(); i++) {
+                        adjacency[cursor[result[i]]++] = static_cast<uint32_t>(i / 3);
+                    }
+                }
+
+                collapses.clear();
+                for (size_t i = 0; i < result.size(); i += 3) {
+                    for (size_t k = 0; k < 3; k++) {
+                        uint32_t a = result[i + k];
+                        uint32_t b = result[i + (k + 1) % 3];
+                        if (canonical[a] == canonical[b]) {
+                            continue;
+                        }
+                        Quadric q = quadrics[canonical[a]];
+                        q.add(quadrics[canonical[b]]);
+                        if (!locked[a]) {
+                            collapses.push_back({ a, b, q.evaluate(position(b)) });
+                        }
+                        if (!locked[b]) {
+                            collapses.push_back({ b, a, q.evaluate(position(a)) });
+                        }
+                    }
+                }
+                std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+                        return x.cost < y.cost;
+                        });
+
+                // Cheapest collapses first, a vertex whose neighbourhood changed waits for the next pass
+                for (size_t v = 0; v < vertexCount; v++) {
+                    collapseTarget[v] = static_cast<uint32_t>(v);
+                }
+                std::fill(touched.begin(), touched.end(), false);
+                const size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+                size_t trianglesRemoved = 0;
+                size_t collapseCount = 0;
+                for (const Collapse& collapse : collapses) {
+                    if (trianglesRemoved >= trianglesToRemove || collapse.cost > maxCost) {
+                        break;
+                    }
+                    if (touched[collapse.from] || touched[collapse.to]) {
+                        continue;
+                    }
+
+                    // Reject collapses that flip a remaining triangle
+                    bool flipped = false;
+                    size_t removed = 0;
+                    for (uint32_t j = triangleOffsets[collapse.from]; j < triangleOffsets[collapse.from + 1] && !flipped; j++) {
+                        const uint32_t* triangle = &result[adjacency[j] * 3];
+                        if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                            removed++;
+                            continue;
+                        }
+                        const float* before[3];
+                        const float* after[3];
+                        for (size_t k = 0; k < 3; k++) {
+                            before[k] = position(triangle[k]);
+                            after[k] = triangle[k] == collapse.from ? position(collapse.to) : before[k];
+                        }
+                        double n0[3], n1[3];
+                        cross(before[0], before[1], before[2], n0);
+                        cross(after[0], after[1], after[2], n1);
+                        flipped = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0;
+                    }
+                    if (flipped) {
+                        continue;
+                    }
+
+                    collapseTarget[collapse.from] = collapse.to;
+                    quadrics[canonical[collapse.to]].add(quadrics[canonical[collapse.from]]);
+                    maxAppliedCost = std::max(maxAppliedCost, collapse.cost);
+                    for (uint32_t j = triangleOffsets[collapse.from]; j < triangleOffsets[collapse.from + 1]; j++) {
+                        const uint32_t* triangle = &result[adjacency[j] * 3];
+                        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+                    }
+                    trianglesRemoved += removed;
+                    collapseCount++;
+                }
+                if (collapseCount == 0) {
+                    break;
+                }
+
+                size_t output = 0;
+                for (size_t i = 0; i < result.size(); i += 3) {
+                    uint32_t a = collapseTarget[result[i]];
+                    uint32_t b = collapseTarget[result[i + 1]];
+                    uint32_t c = collapseTarget[result[i + 2]];
+                    if (a != b && b != c && a != c) {
+                        result[output++] = a;
+                        result[output++] = b;
+                        result[output++] = c;
+                    }
+                }
+                result.resize(output);
+            }
+
+            if (resultError && radius > 0.0) {
+                *resultError = static_cast<float>(std::sqrt(maxAppliedCost) / radius);
+            }
+            memcpy(dst, result.data(), result.size() * sizeof(uint32_t));
+            return result.size();
+        }
+
+        /*
+           Meshlets
+           */
+
+        size_t buildMeshlets(std::vector<Meshlet>& meshlets, std::vector<uint32_t>& meshletVertices, std::vector<uint8_t>& meshletTriangles, const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t maxVertices, uint32_t maxTriangles)
+        {
+            maxVertices = std::min(maxVertices, 256u);
+            const size_t firstMeshlet = meshlets.size();
+
+            // Local index of every vertex in the meshlet being built
+            std::vector<uint32_t> localIndices(vertexCount, kInvalidIndex);
+            Meshlet meshlet = { static_cast<uint32_t>(meshletVertices.size()), static_cast<uint32_t>(meshletTriangles.size() / 3), 0, 0 };
+
+            auto finish = [&]() {
+                for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+                    localIndices[meshletVertices[meshlet.vertexOffset + i]] = kInvalidIndex;
+                }
+                meshlets.push_back(meshlet);
+                meshlet = { static_cast<uint32_t>(meshletVertices.size()), static_cast<uint32_t>(meshletTriangles.size() / 3), 0, 0 };
+            };
+
+            for (size_t i = 0; i + 2 < indexCount; i += 3) {
+                uint32_t newVertices = 0;
+                for (size_t k = 0; k < 3; k++) {
+                    newVertices += localIndices[indices[i + k]] == kInvalidIndex ? 1 : 0;
+                }
+                // Repeated vertices within the triangle are counted twice, which only wastes a slot
+                if (meshlet.vertexCount + newVertices > maxVertices || meshlet.triangleCount + 1 > maxTriangles) {
+                    finish();
+                }
+                for (size_t k = 0; k < 3; k++) {
+                    uint32_t index = indices[i + k];
+                    if (localIndices[index] == kInvalidIndex) {
+                        localIndices[index] = meshlet.vertexCount++;
+                        meshletVertices.push_back(index);
+                    }
+                    meshletTriangles.push_back(static_cast<uint8_t>(localIndices[index]));
+                }
+                meshlet.triangleCount++;
+            }
+            if (meshlet.triangleCount > 0) {
+                finish();
+            }
+            return meshlets.size() - firstMeshlet;
+        }
+
+        MeshletBounds computeMeshletBounds(const Meshlet& meshlet, const uint32_t* meshletVertices, const uint8_t* meshletTriangles, const float* positions, size_t positionStride)
+        {
+            auto position = [&](uint32_t localIndex) {
+                uint32_t index = meshletVertices[meshlet.vertexOffset + localIndex];
+                return reinterpret_cast<const float*>(reinterpret_cast<const unsigned char*>(positions) + index * positionStride);
+            };
+            MeshletBounds bounds = {};
+
+            // Sphere around the box center, not minimal but cheap and conservative
+            float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+            float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+            for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+                const float* p = position(i);
+                for (size_t k = 0; k < 3; k++) {
+                    boundsMin[k] = std::min(boundsMin[k], p[k]);
+                    boundsMax[k] = std::max(boundsMax[k], p[k]);
+                }
+            }
+            for (size_t k = 0; k < 3; k++) {
+                bounds.center[k] = (boundsMin[k] + boundsMax[k]) * 0.5f;
+            }
+            float radiusSquared = 0.0f;
+            for (uint32_t i = 0; i < meshlet.vertexCount; i++) {
+                const float* p = position(i);
+                float dx = p[0] - bounds.center[0], dy = p[1] - bounds.center[1], dz = p[2] - bounds.center[2];
+                radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+            }
+            bounds.radius = std::sqrt(radiusSquared);
+
+            // Normal cone around the average triangle normal
+            std::vector<float> normals;
+            normals.reserve(meshlet.triangleCount * 3);
+            double axis[3] = { 0.0, 0.0, 0.0 };
+            for (uint32_t t = 0; t < meshlet.triangleCount; t++) {
+                const uint8_t* triangle = &meshletTriangles[(meshlet.triangleOffset + t) * 3];
+                double n[3];
+                cross(position(triangle[0]), position(triangle[1]), position(triangle[2]), n);
+                double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length <= 0.0) {
+                    continue;
+                }
+                for (size_t k = 0; k < 3; k++) {
+                    normals.push_back(static_cast<float>(n[k] / length));
+                    axis[k] += n[k] / length;
+                }
+            }
+            double axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            float minDot = 1.0f;
+            if (axisLength > 0.0) {
+                for (size_t k = 0; k < 3; k++) {
+                    bounds.coneAxis[k] = static_cast<float>(axis[k] / axisLength);
+                }
+                for (size_t i = 0; i < normals.size(); i += 3) {
+                    float d = normals[i] * bounds.coneAxis[0] + normals[i + 1] * bounds.coneAxis[1] + normals[i + 2] * bounds.coneAxis[2];
+                    minDot = std::min(minDot, d);
+                }
+            } else {
+                minDot = -1.0f;
+            }
+            // Cones wider than ~85 degrees can't be culled, a cutoff of 1 never passes the test
+            bounds.coneCutoff = minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+            return bounds;
+        }
+
+        size_t optimizeMesh(uint32_t* indices, size_t indexCount, void* vertices, size_t vertexCount, size_t vertexSize, size_t positionOffset, VertexCacheStatistics* before, VertexCacheStatistics* after)
+        {
+            if (before) {
+                *before = analyzeVertexCache(indices, indexCount, vertexCount);
+            }
+
+            std::vector<uint32_t> remap(vertexCount);
+            std::vector<unsigned char> scratch(vertexCount * vertexSize);
+
+            size_t uniqueCount = generateVertexRemap(remap.data(), indices, indexCount, vertices, vertexCount, vertexSize);
+            remapIndexBuffer(indices, indices, indexCount, remap.data());
+            remapVertexBuffer(scratch.data(), vertices, vertexCount, vertexSize, remap.data());
+
+            const float* positions = reinterpret_cast<const float*>(scratch.data() + positionOffset);
+            optimizeVertexCache(indices, indices, indexCount, uniqueCount);
+            optimizeOverdraw(indices, indices, indexCount, positions, vertexSize, uniqueCount);
+
+            size_t referencedCount = generateVertexFetchRemap(remap.data(), indices, indexCount, uniqueCount);
+            remapIndexBuffer(indices, indices, indexCount, remap.data());
+            remapVertexBuffer(vertices, scratch.data(), uniqueCount, vertexSize, remap.data());
+
+            if (after) {
+                *after = analyzeVertexCache(indices, indexCount, referencedCount);
+            }
+            return referencedCount;
+        }
+    }
+}
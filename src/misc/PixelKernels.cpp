@@ -0,0 +1,606 @@
+#include "PixelKernels.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define PIXEL_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define PIXEL_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// AVX2 code is built per function so the rest of the library keeps running on older CPUs
+#if defined(PIXEL_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PIXEL_KERNELS_TARGET_SSE2 __attribute__((target("sse2")))
+#define PIXEL_KERNELS_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PIXEL_KERNELS_TARGET_SSE2
+#define PIXEL_KERNELS_TARGET_AVX2
+#endif
+
+namespace VulkanLearning {
+    namespace PixelKernels {
+
+        // Downsamples two rows of 2 * dstPixels RGBA pixels into dstPixels pixels
+        typedef void (*DownsampleRowFunc)(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t dstPixels);
+
+        struct KernelTable {
+            Isa isa;
+            void (*rgbToRgba)(const uint8_t*, uint8_t*, size_t, uint8_t);
+            void (*swizzleRgba)(const uint8_t*, uint8_t*, size_t, const std::array<uint8_t, 4>&);
+            void (*premultiplyAlpha)(const uint8_t*, uint8_t*, size_t);
+            DownsampleRowFunc downsampleRow;
+        };
+
+        /* Scalar */
+
+        static inline uint8_t mulDiv255(uint32_t c, uint32_t a) {
+            // Exact round(c * a / 255) without a division
+            uint32_t t = c * a + 128;
+            return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+        }
+
+        static void rgbToRgbaScalar(const uint8_t* src, uint8_t* dst, size_t pixelCount, uint8_t alpha) {
+            for (size_t i = 0; i < pixelCount; i++) {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                dst[3] = alpha;
+                src += 3;
+                dst += 4;
+            }
+        }
+
+        static void swizzleRgbaScalar(const uint8_t* src, uint8_t* dst, size_t pixelCount, const std::array<uint8_t, 4>& order) {
+            for (size_t i = 0; i < pixelCount; i++) {
+                uint8_t pixel[4] = { src[0], src[1], src[2], src[3] };
+                dst[0] = pixel[order[0]];
+                dst[1] = pixel[order[1]];
+                dst[2] = pixel[order[2]];
+                dst[3] = pixel[order[3]];
+                src += 4;
+                dst += 4;
+            }
+        }
+
+        static void premultiplyAlphaScalar(const uint8_t* src, uint8_t* dst, size_t pixelCount) {
+            for (size_t i = 0; i < pixelCount; i++) {
+                uint8_t a = src[3];
+                dst[0] = mulDiv255(src[0], a);
+                dst[1] = mulDiv255(src[1], a);
+                dst[2] = mulDiv255(src[2], a);
+                dst[3] = a;
+                src += 4;
+                dst += 4;
+            }
+        }
+
+        static void downsampleRowScalar(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t dstPixels) {
+            for (size_t i = 0; i < dstPixels; i++) {
+                for (uint32_t c = 0; c < 4; c++) {
+                    uint32_t sum = row0[c] + row0[4 + c] + row1[c] + row1[4 + c];
+                    dst[c] = static_cast<uint8_t>((sum + 2) >> 2);
+                }
+                row0 += 8;
+                row1 += 8;
+                dst += 4;
+            }
+        }
+
+#if defined(PIXEL_KERNELS_X86)
+
+        /* SSE2 */
+
+        PIXEL_KERNELS_TARGET_SSE2
+        static void rgbToRgbaSSE2(const uint8_t* src, uint8_t* dst, size_t pixelCount, uint8_t alpha) {
+            // No byte shuffle in SSE2, pixels are gathered with 32 bit loads and stored 4 at a time
+            const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+            const __m128i rgbMask = _mm_set1_epi32(0x00FFFFFF);
+            size_t i = 0;
+            // The load of the 4th pixel reads one byte past it
+            for (; i + 5 <= pixelCount; i += 4) {
+                uint32_t p[4];
+                std::memcpy(&p[0], src, 4);
+                std::memcpy(&p[1], src + 3, 4);
+                std::memcpy(&p[2], src + 6, 4);
+                std::memcpy(&p[3], src + 9, 4);
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+                v = _mm_or_si128(_mm_and_si128(v, rgbMask), alphaMask);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+                src += 12;
+                dst += 16;
+            }
+            rgbToRgbaScalar(src, dst, pixelCount - i, alpha);
+        }
+
+        PIXEL_KERNELS_TARGET_SSE2
+        static void swizzleRgbaSSE2(const uint8_t* src, uint8_t* dst, size_t pixelCount, const std::array<uint8_t, 4>& order) {
+            const __m128i byteMask = _mm_set1_epi32(0xFF);
+            __m128i srcShift[4];
+            __m128i dstShift[4];
+            for (uint32_t c = 0; c < 4; c++) {
+                srcShift[c] = _mm_cvtsi32_si128(8 * order[c]);
+                dstShift[c] = _mm_cvtsi32_si128(8 * c);
+            }
+
+            size_t i = 0;
+            for (; i + 4 <= pixelCount; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+                __m128i result = _mm_setzero_si128();
+                for (uint32_t c = 0; c < 4; c++) {
+                    __m128i channel = _mm_and_si128(_mm_srl_epi32(v, srcShift[c]), byteMask);
+                    result = _mm_or_si128(result, _mm_sll_epi32(channel, dstShift[c]));
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), result);
+                src += 16;
+                dst += 16;
+            }
+            swizzleRgbaScalar(src, dst, pixelCount - i, order);
+        }
+
+        PIXEL_KERNELS_TARGET_SSE2
+        static inline __m128i mulDiv255SSE2(__m128i c16) {
+            // Broadcast each pixel's alpha over its four 16 bit lanes
+            __m128i a16 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c16, 0xFF), 0xFF);
+            __m128i t = _mm_add_epi16(_mm_mullo_epi16(c16, a16), _mm_set1_epi16(128));
+            return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        }
+
+        PIXEL_KERNELS_TARGET_SSE2
+        static void premultiplyAlphaSSE2(const uint8_t* src, uint8_t* dst, size_t pixelCount) {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000));
+            size_t i = 0;
+            for (; i + 4 <= pixelCount; i += 4) {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+                __m128i lo = mulDiv255SSE2(_mm_unpacklo_epi8(v, zero));
+                __m128i hi = mulDiv255SSE2(_mm_unpackhi_epi8(v, zero));
+                __m128i result = _mm_packus_epi16(lo, hi);
+                result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, v));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), result);
+                src += 16;
+                dst += 16;
+            }
+            premultiplyAlphaScalar(src, dst, pixelCount - i);
+        }
+
+        PIXEL_KERNELS_TARGET_SSE2
+        static inline __m128i boxFilterSSE2(__m128i a, __m128i b) {
+            // 4 pixels of each row in, 2 pixels out as 16 bit lanes
+            const __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+            return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+        }
+
+        PIXEL_KERNELS_TARGET_SSE2
+        static void downsampleRowSSE2(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t dstPixels) {
+            size_t i = 0;
+            for (; i + 4 <= dstPixels; i += 4) {
+                __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+                __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 16));
+                __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+                __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 16));
+                __m128i result = _mm_packus_epi16(boxFilterSSE2(a0, b0), boxFilterSSE2(a1, b1));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), result);
+                row0 += 32;
+                row1 += 32;
+                dst += 16;
+            }
+            downsampleRowScalar(row0, row1, dst, dstPixels - i);
+        }
+
+        /* AVX2 */
+
+        PIXEL_KERNELS_TARGET_AVX2
+        static void rgbToRgbaAVX2(const uint8_t* src, uint8_t* dst, size_t pixelCount, uint8_t alpha) {
+            // Each 128 bit lane expands 4 pixels out of the first 12 bytes it loaded
+            const __m256i shuffle = _mm256_setr_epi8(
+                    0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                    0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+            size_t i = 0;
+            // The upper lane loads 16 bytes starting at the 5th pixel
+            for (; i + 10 <= pixelCount; i += 8) {
+                __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+                __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 12));
+                __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+                v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alphaMask);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v);
+                src += 24;
+                dst += 32;
+            }
+            rgbToRgbaScalar(src, dst, pixelCount - i, alpha);
+        }
+
+        PIXEL_KERNELS_TARGET_AVX2
+        static void swizzleRgbaAVX2(const uint8_t* src, uint8_t* dst, size_t pixelCount, const std::array<uint8_t, 4>& order) {
+            alignas(32) int8_t indices[32];
+            for (uint32_t byte = 0; byte < 32; byte++) {
+                indices[byte] = static_cast<int8_t>((byte & 12) + order[byte & 3]);
+            }
+            const __m256i shuffle = _mm256_load_si256(reinterpret_cast<const __m256i*>(indices));
+
+            size_t i = 0;
+            for (; i + 8 <= pixelCount; i += 8) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_shuffle_epi8(v, shuffle));
+                src += 32;
+                dst += 32;
+            }
+            swizzleRgbaScalar(src, dst, pixelCount - i, order);
+        }
+
+        PIXEL_KERNELS_TARGET_AVX2
+        static inline __m256i mulDiv255AVX2(__m256i c16) {
+            __m256i a16 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(c16, 0xFF), 0xFF);
+            __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(c16, a16), _mm256_set1_epi16(128));
+            return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+        }
+
+        PIXEL_KERNELS_TARGET_AVX2
+        static void premultiplyAlphaAVX2(const uint8_t* src, uint8_t* dst, size_t pixelCount) {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000));
+            size_t i = 0;
+            for (; i + 8 <= pixelCount; i += 8) {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+                // Unpack and pack both work per lane, so the pixel order is preserved
+                __m256i lo = mulDiv255AVX2(_mm256_unpacklo_epi8(v, zero));
+                __m256i hi = mulDiv255AVX2(_mm256_unpackhi_epi8(v, zero));
+                __m256i result = _mm256_packus_epi16(lo, hi);
+                result = _mm256_or_si256(_mm256_andnot_si256(alphaMask, result), _mm256_and_si256(alphaMask, v));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), result);
+                src += 32;
+                dst += 32;
+            }
+            premultiplyAlphaScalar(src, dst, pixelCount - i);
+        }
+
+        PIXEL_KERNELS_TARGET_AVX2
+        static inline __m256i boxFilterAVX2(__m256i a, __m256i b) {
+            // 8 pixels of each row in, lane 0 holds output pixels 0 and 1, lane 1 pixels 2 and 3
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero));
+            __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero));
+            __m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+            return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(2)), 2);
+        }
+
+        PIXEL_KERNELS_TARGET_AVX2
+        static void downsampleRowAVX2(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t dstPixels) {
+            size_t i = 0;
+            for (; i + 8 <= dstPixels; i += 8) {
+                __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0));
+                __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 32));
+                __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1));
+                __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 32));
+                // Packing leaves the 64 bit pixel pairs as 0, 2, 1, 3
+                __m256i result = _mm256_packus_epi16(boxFilterAVX2(a0, b0), boxFilterAVX2(a1, b1));
+                result = _mm256_permute4x64_epi64(result, 0xD8);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), result);
+                row0 += 64;
+                row1 += 64;
+                dst += 32;
+            }
+            downsampleRowScalar(row0, row1, dst, dstPixels - i);
+        }
+
+#endif
+
+#if defined(PIXEL_KERNELS_NEON)
+
+        /* NEON */
+
+        static void rgbToRgbaNEON(const uint8_t* src, uint8_t* dst, size_t pixelCount, uint8_t alpha) {
+            size_t i = 0;
+            for (; i + 16 <= pixelCount; i += 16) {
+                uint8x16x3_t rgb = vld3q_u8(src);
+                uint8x16x4_t rgba;
+                rgba.val[0] = rgb.val[0];
+                rgba.val[1] = rgb.val[1];
+                rgba.val[2] = rgb.val[2];
+                rgba.val[3] = vdupq_n_u8(alpha);
+                vst4q_u8(dst, rgba);
+                src += 48;
+                dst += 64;
+            }
+            rgbToRgbaScalar(src, dst, pixelCount - i, alpha);
+        }
+
+        static void swizzleRgbaNEON(const uint8_t* src, uint8_t* dst, size_t pixelCount, const std::array<uint8_t, 4>& order) {
+            size_t i = 0;
+            for (; i + 16 <= pixelCount; i += 16) {
+                uint8x16x4_t in = vld4q_u8(src);
+                uint8x16x4_t out;
+                out.val[0] = in.val[order[0]];
+                out.val[1] = in.val[order[1]];
+                out.val[2] = in.val[order[2]];
+                out.val[3] = in.val[order[3]];
+                vst4q_u8(dst, out);
+                src += 64;
+                dst += 64;
+            }
+            swizzleRgbaScalar(src, dst, pixelCount - i, order);
+        }
+
+        static inline uint8x8_t mulDiv255NEON(uint8x8_t c, uint8x8_t a) {
+            // (t + ((t + 128) >> 8) + 128) >> 8, the same rounding as the scalar path
+            uint16x8_t t = vmull_u8(c, a);
+            return vrshrn_n_u16(vrsraq_n_u16(t, t, 8), 8);
+        }
+
+        static void premultiplyAlphaNEON(const uint8_t* src, uint8_t* dst, size_t pixelCount) {
+            size_t i = 0;
+            for (; i + 16 <= pixelCount; i += 16) {
+                uint8x16x4_t v = vld4q_u8(src);
+                uint8x8_t aLo = vget_low_u8(v.val[3]);
+                uint8x8_t aHi = vget_high_u8(v.val[3]);
+                for (uint32_t c = 0; c < 3; c++) {
+                    v.val[c] = vcombine_u8(
+                            mulDiv255NEON(vget_low_u8(v.val[c]), aLo),
+                            mulDiv255NEON(vget_high_u8(v.val[c]), aHi));
+                }
+                vst4q_u8(dst, v);
+                src += 64;
+                dst += 64;
+            }
+            premultiplyAlphaScalar(src, dst, pixelCount - i);
+        }
+
+        static void downsampleRowNEON(const uint8_t* row0, const uint8_t* row1, uint8_t* dst, size_t dstPixels) {
+            size_t i = 0;
+            for (; i + 8 <= dstPixels; i += 8) {
+                uint8x16x4_t a = vld4q_u8(row0);
+                uint8x16x4_t b = vld4q_u8(row1);
+                uint8x8x4_t out;
+                for (uint32_t c = 0; c < 4; c++) {
+                    uint16x8_t sum = vpadalq_u8(vpaddlq_u8(a.val[c]), b.val[c]);
+                    out.val[c] = vrshrn_n_u16(sum, 2);
+                }
+                vst4_u8(dst, out);
+                row0 += 64;
+                row1 += 64;
+                dst += 32;
+            }
+            downsampleRowScalar(row0, row1, dst, dstPixels - i);
+        }
+
+#endif
+
+        /* Dispatch */
+
+        static const KernelTable* getKernelTable(Isa isa) {
+            static const KernelTable scalar = { Isa::Scalar, rgbToRgbaScalar, swizzleRgbaScalar, premultiplyAlphaScalar, downsampleRowScalar };
+#if defined(PIXEL_KERNELS_X86)
+            static const KernelTable sse2 = { Isa::SSE2, rgbToRgbaSSE2, swizzleRgbaSSE2, premultiplyAlphaSSE2, downsampleRowSSE2 };
+            static const KernelTable avx2 = { Isa::AVX2, rgbToRgbaAVX2, swizzleRgbaAVX2, premultiplyAlphaAVX2, downsampleRowAVX2 };
+#endif
+#if defined(PIXEL_KERNELS_NEON)
+            static const KernelTable neon = { Isa::NEON, rgbToRgbaNEON, swizzleRgbaNEON, premultiplyAlphaNEON, downsampleRowNEON };
+#endif
+            switch (isa) {
+#if defined(PIXEL_KERNELS_X86)
+                case Isa::SSE2:
+                    return &sse2;
+                case Isa::AVX2:
+                    return &avx2;
+#endif
+#if defined(PIXEL_KERNELS_NEON)
+                case Isa::NEON:
+                    return &neon;
+#endif
+                default:
+                    return &scalar;
+            }
+        }
+
+        // The tables themselves never change, switching paths only swaps this pointer,
+        // so loader threads calling the kernels during a switch use either path safely
+        static std::atomic<const KernelTable*>& activeKernels() {
+            static std::atomic<const KernelTable*> kernels(getKernelTable(
+                    isSupported(Isa::AVX2) ? Isa::AVX2 :
+                    isSupported(Isa::NEON) ? Isa::NEON :
+                    isSupported(Isa::SSE2) ? Isa::SSE2 : Isa::Scalar));
+            return kernels;
+        }
+
+        static const KernelTable& kernels() {
+            return *activeKernels().load(std::memory_order_acquire);
+        }
+
+        bool isSupported(Isa isa) {
+            switch (isa) {
+                case Isa::Scalar:
+                    return true;
+#if defined(PIXEL_KERNELS_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+                case Isa::SSE2: {
+                    int info[4];
+                    __cpuid(info, 1);
+                    return (info[3] & (1 << 26)) != 0;
+                }
+                case Isa::AVX2: {
+                    int info[4];
+                    __cpuid(info, 1);
+                    // The OS has to save the ymm registers as well
+                    bool osxsave = (info[2] & (1 << 27)) != 0;
+                    if (!osxsave || (_xgetbv(0) & 6) != 6) {
+                        return false;
+                    }
+                    __cpuidex(info, 7, 0);
+                    return (info[1] & (1 << 5)) != 0;
+                }
+#else
+                case Isa::SSE2:
+                    return __builtin_cpu_supports("sse2");
+                case Isa::AVX2:
+                    return __builtin_cpu_supports("avx2");
+#endif
+#endif
+#if defined(PIXEL_KERNELS_NEON)
+                case Isa::NEON:
+                    return true;
+#endif
+                default:
+                    return false;
+            }
+        }
+
+        const char* getIsaName(Isa isa) {
+            switch (isa) {
+                case Isa::SSE2: return "SSE2";
+                case Isa::AVX2: return "AVX2";
+                case Isa::NEON: return "NEON";
+                default: return "Scalar";
+            }
+        }
+
+        Isa getActiveIsa() {
+            return kernels().isa;
+        }
+
+        bool setActiveIsa(Isa isa) {
+            if (!isSupported(isa)) {
+                return false;
+            }
+            activeKernels().store(getKernelTable(isa), std::memory_order_release);
+            return true;
+        }
+
+        void rgbToRgba(const uint8_t* src, uint8_t* dst, size_t pixelCount, uint8_t alpha) {
+            kernels().rgbToRgba(src, dst, pixelCount, alpha);
+        }
+
+        void swizzleRgba(const uint8_t* src, uint8_t* dst, size_t pixelCount, const std::array<uint8_t, 4>& order) {
+            kernels().swizzleRgba(src, dst, pixelCount, order);
+        }
+
+        void premultiplyAlpha(const uint8_t* src, uint8_t* dst, size_t pixelCount) {
+            kernels().premultiplyAlpha(src, dst, pixelCount);
+        }
+
+        // Rounded average of the xCount x yCount texels at (x, y), for the edges the row kernels don't cover
+        static void filterTexel(const uint8_t* src, size_t srcPitch, uint32_t x, uint32_t y, uint32_t xCount, uint32_t yCount, uint8_t* dst) {
+            const uint32_t count = xCount * yCount;
+            for (uint32_t c = 0; c < 4; c++) {
+                uint32_t sum = 0;
+                for (uint32_t j = 0; j < yCount; j++) {
+                    const uint8_t* row = src + (y + j) * srcPitch + static_cast<size_t>(x) * 4;
+                    for (uint32_t i = 0; i < xCount; i++) {
+                        sum += row[4 * i + c];
+                    }
+                }
+                dst[c] = static_cast<uint8_t>((sum + count / 2) / count);
+            }
+        }
+
+        void downsample2x2(const uint8_t* src, uint32_t width, uint32_t height, uint8_t* dst) {
+            uint32_t dstWidth = std::max(1u, width / 2);
+            uint32_t dstHeight = std::max(1u, height / 2);
+            size_t srcPitch = static_cast<size_t>(width) * 4;
+
+            // The last texel of each axis covers 1, 2 or 3 source texels, so odd sizes lose nothing
+            uint32_t lastColumns = width - 2 * (dstWidth - 1);
+            uint32_t lastRows = height - 2 * (dstHeight - 1);
+
+            DownsampleRowFunc downsampleRow = kernels().downsampleRow;
+            for (uint32_t y = 0; y < dstHeight; y++) {
+                const uint8_t* row0 = src + 2 * y * srcPitch;
+                uint8_t* dstRow = dst + static_cast<size_t>(y) * dstWidth * 4;
+                uint32_t rows = (y + 1 == dstHeight) ? lastRows : 2;
+                if (rows == 2) {
+                    uint32_t pairs = lastColumns == 2 ? dstWidth : dstWidth - 1;
+                    downsampleRow(row0, row0 + srcPitch, dstRow, pairs);
+                    if (pairs < dstWidth) {
+                        filterTexel(src, srcPitch, 2 * pairs, 2 * y, lastColumns, 2, dstRow + pairs * 4);
+                    }
+                } else {
+                    for (uint32_t x = 0; x < dstWidth; x++) {
+                        uint32_t columns = (x + 1 == dstWidth) ? lastColumns : 2;
+                        filterTexel(src, srcPitch, 2 * x, 2 * y, columns, rows, dstRow + x * 4);
+                    }
+                }
+            }
+        }
+
+        void benchmark(uint32_t width, uint32_t height, uint32_t iterations) {
+            size_t pixelCount = static_cast<size_t>(width) * height;
+            std::vector<uint8_t> rgb(pixelCount * 3);
+            std::vector<uint8_t> rgba(pixelCount * 4);
+            std::vector<uint8_t> result(pixelCount * 4);
+
+            // Deterministic noise so every path works on the same data
+            uint32_t seed = 0x12345678;
+            for (uint8_t& value : rgb) {
+                seed = seed * 1664525u + 1013904223u;
+                value = static_cast<uint8_t>(seed >> 24);
+            }
+            for (uint8_t& value : rgba) {
+                seed = seed * 1664525u + 1013904223u;
+                value = static_cast<uint8_t>(seed >> 24);
+            }
+
+            const std::array<uint8_t, 4> bgra = { 2, 1, 0, 3 };
+            Isa previousIsa = getActiveIsa();
+
+            struct Kernel {
+                const char* name;
+                size_t bytes;
+                std::function<void()> run;
+            };
+            std::vector<Kernel> kernels = {
+                { "rgbToRgba", rgb.size(), [&]() { rgbToRgba(rgb.data(), result.data(), pixelCount); } },
+                { "swizzleRgba", rgba.size(), [&]() { swizzleRgba(rgba.data(), result.data(), pixelCount, bgra); } },
+                { "premultiplyAlpha", rgba.size(), [&]() { premultiplyAlpha(rgba.data(), result.data(), pixelCount); } },
+                { "downsample2x2", rgba.size(), [&]() { downsample2x2(rgba.data(), width, height, result.data()); } },
+            };
+
+            // Scalar results are the reference every other path has to match
+            std::vector<std::vector<uint8_t>> references;
+            setActiveIsa(Isa::Scalar);
+            for (Kernel& kernel : kernels) {
+                std::fill(result.begin(), result.end(), 0);
+                kernel.run();
+                references.push_back(result);
+            }
+
+            std::cout << "Pixel kernels on " << width << "x" << height << " pixels, " << iterations << " iterations" << std::endl;
+            for (Isa isa : { Isa::Scalar, Isa::SSE2, Isa::AVX2, Isa::NEON }) {
+                if (!setActiveIsa(isa)) {
+                    continue;
+                }
+                for (size_t k = 0; k < kernels.size(); k++) {
+                    Kernel& kernel = kernels[k];
+                    std::fill(result.begin(), result.end(), 0);
+                    kernel.run();
+                    bool matches = result == references[k];
+
+                    auto tStart = std::chrono::high_resolution_clock::now();
+                    for (uint32_t i = 0; i < iterations; i++) {
+                        kernel.run();
+                    }
+                    auto tEnd = std::chrono::high_resolution_clock::now();
+                    double seconds = std::chrono::duration<double>(tEnd - tStart).count();
+                    double megabytesPerSecond = (static_cast<double>(kernel.bytes) * iterations) / (seconds * 1024.0 * 1024.0);
+
+                    std::cout << "  " << getIsaName(isa) << " " << kernel.name << ": "
+                        << megabytesPerSecond << " MB/s" << (matches ? "" : " (MISMATCH with scalar)") << std::endl;
+                }
+            }
+
+            setActiveIsa(previousIsa);
+        }
+    }
+}
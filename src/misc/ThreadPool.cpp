@@ -0,0 +1,92 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace VulkanLearning {
+
+    ThreadPool::ThreadPool(uint32_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        m_workers.reserve(threadCount);
+        for (uint32_t i = 0; i < threadCount; i++) {
+            m_workers.emplace_back(&ThreadPool::workerLoop, this);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_jobAvailable.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::push(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.push_back(std::move(job));
+        }
+        m_jobAvailable.notify_one();
+    }
+
+    void ThreadPool::wait() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobsDone.wait(lock, [this] { return m_jobs.empty() && m_activeJobs == 0; });
+    }
+
+    void ThreadPool::workerLoop() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+                if (m_stopping && m_jobs.empty()) {
+                    return;
+                }
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+                m_activeJobs++;
+            }
+
+            job();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_activeJobs--;
+                if (m_jobs.empty() && m_activeJobs == 0) {
+                    m_jobsDone.notify_all();
+                }
+            }
+        }
+    }
+
+    void CompletionQueue::push(size_t index) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_completed.push_back(index);
+        }
+        m_available.notify_one();
+    }
+
+    size_t CompletionQueue::pop() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_available.wait(lock, [this] { return !m_completed.empty(); });
+        size_t index = m_completed.front();
+        m_completed.pop_front();
+        return index;
+    }
+
+    bool CompletionQueue::tryPop(size_t& index) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_completed.empty()) {
+            return false;
+        }
+        index = m_completed.front();
+        m_completed.pop_front();
+        return true;
+    }
+}
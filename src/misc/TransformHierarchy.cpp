@@ -0,0 +1,138 @@
+#include "TransformHierarchy.hpp"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TRANSFORM_NEON
+#include <arm_neon.h>
+#endif
+
+namespace VulkanLearning {
+
+    uint32_t TransformHierarchy::add(int32_t parent, glm::vec3 translation, glm::quat rotation, glm::vec3 scale, const glm::mat4& matrix) {
+        const uint32_t index = static_cast<uint32_t>(parents.size());
+        parents.push_back(parent < static_cast<int32_t>(index) ? parent : -1);
+        translations.push_back(translation);
+        rotations.push_back(rotation);
+        scales.push_back(scale);
+        matrices.push_back(matrix);
+        worldMatrices.push_back(glm::mat4(1.0f));
+        dirty.push_back(1);
+        changed.push_back(0);
+        m_hasMatrix.push_back(matrix != glm::mat4(1.0f) ? 1 : 0);
+        return index;
+    }
+
+    void TransformHierarchy::clear() {
+        parents.clear();
+        translations.clear();
+        rotations.clear();
+        scales.clear();
+        matrices.clear();
+        worldMatrices.clear();
+        dirty.clear();
+        changed.clear();
+        m_hasMatrix.clear();
+    }
+
+    size_t TransformHierarchy::size() const {
+        return parents.size();
+    }
+
+    void TransformHierarchy::setTranslation(uint32_t index, glm::vec3 translation) {
+        translations[index] = translation;
+        dirty[index] = 1;
+    }
+
+    void TransformHierarchy::setRotation(uint32_t index, glm::quat rotation) {
+        rotations[index] = rotation;
+        dirty[index] = 1;
+    }
+
+    void TransformHierarchy::setScale(uint32_t index, glm::vec3 scale) {
+        scales[index] = scale;
+        dirty[index] = 1;
+    }
+
+    void TransformHierarchy::setMatrix(uint32_t index, const glm::mat4& matrix) {
+        matrices[index] = matrix;
+        m_hasMatrix[index] = matrix != glm::mat4(1.0f) ? 1 : 0;
+        dirty[index] = 1;
+    }
+
+    glm::mat4 TransformHierarchy::localMatrix(uint32_t index) const {
+        // Same as translate * mat4(rotation) * scale, built directly
+        const glm::mat3 rotation = glm::mat3_cast(rotations[index]);
+        const glm::vec3& scale = scales[index];
+        glm::mat4 local(
+                glm::vec4(rotation[0] * scale.x, 0.0f),
+                glm::vec4(rotation[1] * scale.y, 0.0f),
+                glm::vec4(rotation[2] * scale.z, 0.0f),
+                glm::vec4(translations[index], 1.0f));
+        if (m_hasMatrix[index]) {
+            multiply(local, matrices[index], local);
+        }
+        return local;
+    }
+
+    size_t TransformHierarchy::update() {
+        size_t updated = 0;
+        const size_t count = parents.size();
+        for (size_t i = 0; i < count; i++) {
+            const int32_t parent = parents[i];
+            // Parents were visited first, a changed parent invalidates the whole subtree
+            const bool recompute = dirty[i] || (parent >= 0 && changed[parent]);
+            changed[i] = recompute ? 1 : 0;
+            if (!recompute) {
+                continue;
+            }
+            const glm::mat4 local = localMatrix(static_cast<uint32_t>(i));
+            if (parent >= 0) {
+                multiply(worldMatrices[parent], local, worldMatrices[i]);
+            } else {
+                worldMatrices[i] = local;
+            }
+            updated++;
+        }
+        memset(dirty.data(), 0, dirty.size());
+        return updated;
+    }
+
+    void TransformHierarchy::multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+        // Column major, every result column is a combination of a's columns weighted by b's column
+#if defined(TRANSFORM_SSE)
+        const float* pa = &a[0][0];
+        const float* pb = &b[0][0];
+        const __m128 a0 = _mm_loadu_ps(pa), a1 = _mm_loadu_ps(pa + 4), a2 = _mm_loadu_ps(pa + 8), a3 = _mm_loadu_ps(pa + 12);
+        __m128 columns[4];
+        for (int c = 0; c < 4; c++) {
+            const float* column = pb + c * 4;
+            columns[c] = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(a0, _mm_set1_ps(column[0])), _mm_mul_ps(a1, _mm_set1_ps(column[1]))),
+                    _mm_add_ps(_mm_mul_ps(a2, _mm_set1_ps(column[2])), _mm_mul_ps(a3, _mm_set1_ps(column[3]))));
+        }
+        float* po = &out[0][0];
+        for (int c = 0; c < 4; c++) {
+            _mm_storeu_ps(po + c * 4, columns[c]);
+        }
+#elif defined(TRANSFORM_NEON)
+        const float* pa = &a[0][0];
+        const float* pb = &b[0][0];
+        const float32x4_t a0 = vld1q_f32(pa), a1 = vld1q_f32(pa + 4), a2 = vld1q_f32(pa + 8), a3 = vld1q_f32(pa + 12);
+        float32x4_t columns[4];
+        for (int c = 0; c < 4; c++) {
+            const float* column = pb + c * 4;
+            columns[c] = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(a0, column[0]), a1, column[1]), a2, column[2]), a3, column[3]);
+        }
+        float* po = &out[0][0];
+        for (int c = 0; c < 4; c++) {
+            vst1q_f32(po + c * 4, columns[c]);
+        }
+#else
+        out = a * b;
+#endif
+    }
+}
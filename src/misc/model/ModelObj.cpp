@@ -1,12 +1,15 @@
 #include "misc/model/ModelObj.hpp"
 
 #include "tiny_obj_loader.h"
+#include "MeshOptimizer.hpp"
+
+#include <iostream>
 
 namespace VulkanLearning {
 
     ModelObj::ModelObj() {}
 
-    ModelObj::ModelObj(std::string modelPath) : m_modelPath(modelPath) {
+    ModelObj::ModelObj(std::string modelPath, bool optimize, bool verbose) : m_modelPath(modelPath), m_optimize(optimize), m_verbose(verbose) {
         load();
     }
 
@@ -56,5 +59,17 @@ namespace VulkanLearning {
                 m_indices.push_back(uniqueVertices[vertex]);
             }
         }
+
+        if (m_optimize && !m_indices.empty()) {
+            MeshOptimizer::VertexCacheStatistics before, after;
+            size_t vertexCount = MeshOptimizer::optimizeMesh(m_indices.data(), m_indices.size(),
+                    m_vertices.data(), m_vertices.size(), sizeof(VertexTextured), offsetof(VertexTextured, pos),
+                    m_verbose ? &before : nullptr, m_verbose ? &after : nullptr);
+            m_vertices.resize(vertexCount);
+            if (m_verbose) {
+                std::cout << "Mesh optimization: ACMR " << before.acmr() << " -> " << after.acmr()
+                    << ", ATVR " << before.atvr() << " -> " << after.atvr() << std::endl;
+            }
+        }
     }
 }
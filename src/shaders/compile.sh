@@ -42,6 +42,13 @@ $GLSLC_PATH glTFScene.frag -o glTFSceneFrag.spv
 
 $GLSLC_PATH glTFCompleteLoader.vert -o glTFCompleteLoaderVert.spv
 $GLSLC_PATH glTFCompleteLoader.frag -o glTFCompleteLoaderFrag.spv
+$GLSLC_PATH glTFCompleteLoaderCompact.vert -o glTFCompleteLoaderCompactVert.spv
+
+$GLSLC_PATH glTFAnimation.vert -o glTFAnimationVert.spv
+
+$GLSLC_PATH instancing.vert -o instancingVert.spv
+$GLSLC_PATH instancing.frag -o instancingFrag.spv
+$GLSLC_PATH instancingDynamic.vert -o instancingDynamicVert.spv
 
 $GLSLC_PATH ui.vert -o uiVert.spv
 $GLSLC_PATH ui.frag -o uiFrag.spv
@@ -65,3 +72,13 @@ $GLSLC_PATH inputAttachments/inputAttachmentsWrite.vert -o inputAttachments/inpu
 $GLSLC_PATH inputAttachments/inputAttachmentsWrite.frag -o inputAttachments/inputAttachmentsWriteFrag.spv
 $GLSLC_PATH inputAttachments/inputAttachmentsRead.vert -o inputAttachments/inputAttachmentsReadVert.spv
 $GLSLC_PATH inputAttachments/inputAttachmentsRead.frag -o inputAttachments/inputAttachmentsReadFrag.spv
+
+$GLSLC_PATH mipmapDownsample.comp -o mipmapDownsampleComp.spv
+
+$GLSLC_PATH meshletCull.comp -o meshletCullComp.spv
+$GLSLC_PATH indirectCull.comp -o indirectCullComp.spv
+$GLSLC_PATH skinning.comp -o skinningComp.spv
+
+$GLSLC_PATH virtualTexturing/virtualTexturing.vert -o virtualTexturing/virtualTexturingVert.spv
+$GLSLC_PATH virtualTexturing/virtualTexturing.frag -o virtualTexturing/virtualTexturingFrag.spv
+$GLSLC_PATH virtualTexturing/virtualTexturingFeedback.frag -o virtualTexturing/virtualTexturingFeedbackFrag.spv
@@ -0,0 +1,38 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+layout (set = 0, binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+    vec3 lightPos;
+} ubo;
+
+// Matrix of every mesh node, drawn with its slot as first instance
+layout (set = 1, binding = 0) readonly buffer NodeTransforms
+{
+    mat4 nodes[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+
+void main() 
+{
+    outColor = inColor;
+
+    mat4 modelView = ubo.view * nodes[gl_InstanceIndex];
+    vec4 pos = modelView * vec4(inPos, 1.0);
+	gl_Position = ubo.projection * pos;
+
+    outNormal = mat3(modelView) * inNormal;
+    vec3 lPos = mat3(ubo.view) * ubo.lightPos.xyz;
+
+    outLightVec = lPos - pos.xyz;
+    outViewVec = -pos.xyz;
+}
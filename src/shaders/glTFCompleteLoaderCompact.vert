@@ -0,0 +1,44 @@
+#version 450
+
+// Variant of glTFCompleteLoader.vert reading the CompactVertex layout
+layout (location = 0) in vec4 inPos;
+layout (location = 1) in vec2 inNormal;
+layout (location = 2) in vec4 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 model;
+    vec3 lightPos;
+    // Offset (xyz) and scale (w) of the quantized positions
+    vec4 dequantization;
+} ubo;
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+void main() 
+{
+    outColor = inColor.rgb;
+
+    vec3 position = ubo.dequantization.xyz + inPos.xyz * ubo.dequantization.w;
+
+	gl_Position = ubo.projection * ubo.model * vec4(position, 1.0);
+
+    vec4 pos = ubo.model * vec4(position, 1.0f);
+    outNormal = mat3(ubo.model) * octahedralDecode(inNormal);
+    vec3 lPos = mat3(ubo.model) * ubo.lightPos.xyz;
+
+    outLightVec = lPos - pos.xyz;
+    outViewVec = -pos.xyz;
+}
@@ -0,0 +1,28 @@
+#version 450
+
+layout (location = 0) in vec3 inNormal;
+layout (location = 1) in vec3 inColor;
+layout (location = 2) in vec3 inViewVec;
+layout (location = 3) in vec3 inLightVec;
+layout (location = 4) in vec2 inMetallicRoughness;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{		
+    vec3 N = normalize(inNormal);
+    vec3 L = normalize(inLightVec);
+    vec3 V = normalize(inViewVec);
+    vec3 R = reflect(-L, N);
+
+    // Rough materials get a wide, dim highlight, metals tint it with their color and lose the diffuse part
+    float metallic = inMetallicRoughness.x;
+    float roughness = max(inMetallicRoughness.y, 0.05);
+    float shininess = 2.0 / (roughness * roughness);
+    vec3 specularColor = mix(vec3(0.75), inColor, metallic) * (1.0 - 0.75 * roughness);
+
+    vec3 diffuse = max(dot(N, L), 0.15) * inColor * (1.0 - 0.8 * metallic);
+    vec3 specular = pow(max(dot(R, V), 0.0), shininess) * specularColor;
+
+    outFragColor = vec4(diffuse + specular, 1.0);
+}
@@ -0,0 +1,57 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inColor;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 projection;
+	mat4 view;
+    vec4 lightPos;
+} ubo;
+
+// One object per dynamic offset, same layout as VulkanLearning::InstanceData
+layout (binding = 1) uniform Instance
+{
+    mat4 matrix;
+    vec4 color;
+    uint materialIndex;
+} instance;
+
+// See VulkanLearning::MaterialData
+struct Material {
+    vec4 baseColorFactor;
+    float metallicFactor;
+    float roughnessFactor;
+    float alphaCutoff;
+    uint alphaMode;
+};
+
+layout (std430, binding = 2) readonly buffer Materials
+{
+    Material materials[];
+};
+
+layout (location = 0) out vec3 outNormal;
+layout (location = 1) out vec3 outColor;
+layout (location = 2) out vec3 outViewVec;
+layout (location = 3) out vec3 outLightVec;
+layout (location = 4) out vec2 outMetallicRoughness;
+
+void main() 
+{
+    Material material = materials[instance.materialIndex];
+    outColor = inColor * material.baseColorFactor.rgb * instance.color.rgb;
+    outMetallicRoughness = vec2(material.metallicFactor, material.roughnessFactor);
+
+    mat4 modelView = ubo.view * instance.matrix;
+    vec4 pos = modelView * vec4(inPos, 1.0);
+	gl_Position = ubo.projection * pos;
+
+    outNormal = mat3(modelView) * inNormal;
+    vec3 lPos = mat3(ubo.view) * ubo.lightPos.xyz;
+
+    outLightVec = lPos - pos.xyz;
+    outViewVec = -pos.xyz;
+}
@@ -0,0 +1,64 @@
+// Sampling and feedback for VulkanVirtualTexture. Define VIRTUAL_TEXTURE_SET and
+// VIRTUAL_TEXTURE_BINDING before including, the uniform block, the indirection texture
+// and the atlas take that binding and the two following ones.
+
+#ifndef VIRTUAL_TEXTURE_SET
+#define VIRTUAL_TEXTURE_SET 0
+#endif
+#ifndef VIRTUAL_TEXTURE_BINDING
+#define VIRTUAL_TEXTURE_BINDING 0
+#endif
+
+layout (set = VIRTUAL_TEXTURE_SET, binding = VIRTUAL_TEXTURE_BINDING) uniform VirtualTexture
+{
+    // Virtual texels per side at level 0, page size, border, physical page size
+    vec4 virtualSize;
+    // Atlas texels per side, level count, log2 of the feedback downscale, unused
+    vec4 atlasSize;
+} virtualTexture;
+
+layout (set = VIRTUAL_TEXTURE_SET, binding = VIRTUAL_TEXTURE_BINDING + 1) uniform usampler2D virtualTextureIndirection;
+layout (set = VIRTUAL_TEXTURE_SET, binding = VIRTUAL_TEXTURE_BINDING + 2) uniform sampler2D virtualTextureAtlas;
+
+// Level the texture is seen at, from the screen space derivatives of its texels. Derivatives
+// are taken before wrapping so they don't jump at the texture edges
+float virtualTextureLevel(vec4 transform, uint maxLevel, vec2 uv, float bias)
+{
+    vec2 texel = uv * transform.zw * virtualTexture.virtualSize.x;
+    vec2 dx = dFdx(texel);
+    vec2 dy = dFdy(texel);
+    float level = 0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + bias;
+    return clamp(floor(level), 0.0, float(maxLevel));
+}
+
+// Level 0 virtual texel of uv, wrapped inside the texture's own square
+vec2 virtualTextureTexel(vec4 transform, vec2 uv)
+{
+    return (transform.xy + fract(uv) * transform.zw) * virtualTexture.virtualSize.x;
+}
+
+vec4 sampleVirtualTexture(vec4 transform, uint maxLevel, vec2 uv)
+{
+    float pageSize = virtualTexture.virtualSize.y;
+    vec2 texel = virtualTextureTexel(transform, uv);
+    int level = int(virtualTextureLevel(transform, maxLevel, uv, 0.0));
+
+    // The entry is the page itself or its closest resident parent, at the level it holds
+    ivec2 page = ivec2(texel / pageSize) >> level;
+    uvec4 entry = texelFetch(virtualTextureIndirection, page, level);
+
+    vec2 levelTexel = texel / exp2(float(entry.z));
+    vec2 inPage = levelTexel - floor(levelTexel / pageSize) * pageSize;
+    vec2 atlasTexel = vec2(entry.xy) * virtualTexture.virtualSize.w + virtualTexture.virtualSize.z + inPage;
+    return textureLod(virtualTextureAtlas, atlasTexel / virtualTexture.atlasSize.x, 0.0);
+}
+
+// Page key written to the feedback target, level << 28 | y << 14 | x. The target is smaller than
+// the screen, its derivatives are larger by the downscale which the bias takes back out
+uint virtualTextureRequest(vec4 transform, uint maxLevel, vec2 uv)
+{
+    vec2 texel = virtualTextureTexel(transform, uv);
+    uint level = uint(virtualTextureLevel(transform, maxLevel, uv, -virtualTexture.atlasSize.z));
+    uvec2 page = uvec2(texel / virtualTexture.virtualSize.y) >> level;
+    return (level << 28) | (page.y << 14) | page.x;
+}
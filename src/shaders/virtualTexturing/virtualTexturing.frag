@@ -0,0 +1,23 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define VIRTUAL_TEXTURE_BINDING 1
+#include "../virtualTexture.glsl"
+
+layout (push_constant) uniform TextureInfo
+{
+    vec4 transform;
+    uint maxLevel;
+} textureInfo;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec3 inNormal;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main() 
+{
+    vec4 color = sampleVirtualTexture(textureInfo.transform, textureInfo.maxLevel, inUV);
+    float diffuse = max(dot(normalize(inNormal), vec3(0.0, 0.0, 1.0)), 0.25);
+    outFragColor = vec4(diffuse * color.rgb, 1.0);
+}
@@ -0,0 +1,28 @@
+#version 450
+
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec2 inUV;
+layout (location = 2) in vec3 inNormal;
+
+layout (binding = 0) uniform UBO 
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+    vec3 camPos;
+} ubo;
+
+layout (location = 0) out vec2 outUV;
+layout (location = 1) out vec3 outNormal;
+
+out gl_PerVertex 
+{
+    vec4 gl_Position;   
+};
+
+void main() 
+{
+    outUV = inUV;
+    outNormal = mat3(inverse(transpose(ubo.model))) * inNormal;
+	gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPos.xyz, 1.0);
+}
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define VIRTUAL_TEXTURE_BINDING 1
+#include "../virtualTexture.glsl"
+
+layout (push_constant) uniform TextureInfo
+{
+    vec4 transform;
+    uint maxLevel;
+} textureInfo;
+
+layout (location = 0) in vec2 inUV;
+layout (location = 1) in vec3 inNormal;
+
+layout (location = 0) out uint outRequest;
+
+void main() 
+{
+    outRequest = virtualTextureRequest(textureInfo.transform, textureInfo.maxLevel, inUV);
+}
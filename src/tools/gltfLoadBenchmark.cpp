@@ -0,0 +1,156 @@
+// The library's stb_image implementation lives in VulkanTexture.cpp, which needs Vulkan
+#define STB_IMAGE_IMPLEMENTATION
+#define TINYGLTF_IMPLEMENTATION
+#define TINYGLTF_NO_STB_IMAGE_WRITE
+#include "tiny_gltf.h"
+#include "VulkanglTFImageLoader.hpp"
+#include "VulkanglTFAccessor.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+
+using namespace VulkanLearning;
+
+// Same layout as the glTF model's Vertex, so strides and copies match the loader
+struct BenchmarkVertex {
+    float pos[3];
+    float normal[3];
+    float uv[2];
+    float color[4];
+    float joint0[4];
+    float weight0[4];
+    float tangent[4];
+};
+
+static double elapsedMs(std::chrono::high_resolution_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+// Decodes every primitive of the file into pre-sized arrays, as the loaders do, and returns the source bytes read
+static size_t decodeAccessors(const tinygltf::Model& model, std::vector<BenchmarkVertex>& vertexBuffer, std::vector<uint32_t>& indexBuffer)
+{
+    struct Attribute {
+        const char* name;
+        size_t offset;
+        uint32_t components;
+    };
+    const Attribute attributes[] = {
+        { "POSITION", offsetof(BenchmarkVertex, pos), 3 },
+        { "NORMAL", offsetof(BenchmarkVertex, normal), 3 },
+        { "TEXCOORD_0", offsetof(BenchmarkVertex, uv), 2 },
+        { "COLOR_0", offsetof(BenchmarkVertex, color), 4 },
+        { "JOINTS_0", offsetof(BenchmarkVertex, joint0), 4 },
+        { "WEIGHTS_0", offsetof(BenchmarkVertex, weight0), 4 },
+        { "TANGENT", offsetof(BenchmarkVertex, tangent), 4 },
+    };
+
+    size_t decodedBytes = 0;
+    vertexBuffer.clear();
+    indexBuffer.clear();
+    for (const tinygltf::Mesh& mesh : model.meshes) {
+        for (const tinygltf::Primitive& primitive : mesh.primitives) {
+            auto position = primitive.attributes.find("POSITION");
+            if (primitive.indices < 0 || position == primitive.attributes.end()) {
+                continue;
+            }
+            const size_t vertexStart = vertexBuffer.size();
+            vertexBuffer.resize(vertexStart + model.accessors[position->second].count);
+            for (const Attribute& attribute : attributes) {
+                auto accessor = primitive.attributes.find(attribute.name);
+                if (accessor == primitive.attributes.end()) {
+                    continue;
+                }
+                float* dst = reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(&vertexBuffer[vertexStart]) + attribute.offset);
+                if (!readAccessor(model, model.accessors[accessor->second], dst, sizeof(BenchmarkVertex), attribute.components, &decodedBytes)) {
+                    return 0;
+                }
+            }
+            const tinygltf::Accessor& indices = model.accessors[primitive.indices];
+            const size_t indexStart = indexBuffer.size();
+            indexBuffer.resize(indexStart + indices.count);
+            if (!readIndices(model, indices, &indexBuffer[indexStart], static_cast<uint32_t>(vertexStart), &decodedBytes)) {
+                return 0;
+            }
+        }
+    }
+    return decodedBytes;
+}
+
+// Decodes all images with the given number of workers, as loadImages does before uploading them
+static double decodeImages(const std::vector<tinygltf::Image>& encodedImages, const std::string& path, uint32_t threadCount)
+{
+    std::vector<tinygltf::Image> images = encodedImages;
+    auto tStart = std::chrono::high_resolution_clock::now();
+    ThreadPool threadPool(threadCount);
+    for (size_t i = 0; i < images.size(); i++) {
+        threadPool.push([&images, &path, i] {
+            decodeImageData(&images[i], static_cast<int>(i), path);
+        });
+    }
+    threadPool.wait();
+    return elapsedMs(tStart);
+}
+
+// Usage: gltfLoadBenchmark file.gltf [iterations]
+// Times the CPU side of a glTF model load, uploads need a device and aren't covered
+int main(const int argc, const char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " file.gltf [iterations]" << std::endl;
+        return 1;
+    }
+    const std::string filename = argv[1];
+    const uint32_t iterations = argc >= 3 ? std::max(1u, static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10))) : 10;
+    const size_t pos = filename.find_last_of("/\\");
+    const std::string path = pos == std::string::npos ? "." : filename.substr(0, pos);
+
+    tinygltf::Model model;
+    tinygltf::TinyGLTF gltfContext;
+    // Images are kept encoded and decoded later on the pool, as the loaders do
+    gltfContext.SetImageLoader(loadImageDataFunc, nullptr);
+    std::string error, warning;
+    const bool binary = filename.size() > 4 && filename.substr(filename.size() - 4) == ".glb";
+    const bool loaded = binary ? gltfContext.LoadBinaryFromFile(&model, &error, &warning, filename)
+        : gltfContext.LoadASCIIFromFile(&model, &error, &warning, filename);
+    if (!loaded) {
+        std::cerr << "Could not load " << filename << ": " << error << std::endl;
+        return 1;
+    }
+
+    std::vector<BenchmarkVertex> vertexBuffer;
+    std::vector<uint32_t> indexBuffer;
+    size_t decodedBytes = 0;
+    double bestMs = 0.0;
+    for (uint32_t i = 0; i < iterations; i++) {
+        auto tStart = std::chrono::high_resolution_clock::now();
+        decodedBytes = decodeAccessors(model, vertexBuffer, indexBuffer);
+        const double ms = elapsedMs(tStart);
+        bestMs = i == 0 ? ms : std::min(bestMs, ms);
+    }
+    if (decodedBytes == 0) {
+        std::cerr << "Could not decode the accessors of " << filename << std::endl;
+        return 1;
+    }
+    std::cout << "Accessors: " << vertexBuffer.size() << " vertices, " << indexBuffer.size() << " indices, "
+        << decodedBytes / (1024.0 * 1024.0) << " MB in " << bestMs << " ms ("
+        << (decodedBytes / (1024.0 * 1024.0)) / (bestMs / 1000.0) << " MB/s, best of " << iterations << ")" << std::endl;
+
+    if (model.images.empty()) {
+        return 0;
+    }
+    std::cout << "Images: " << model.images.size() << ", " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    for (uint32_t threadCount : { 1u, 4u, 16u }) {
+        double best = 0.0;
+        for (uint32_t i = 0; i < iterations; i++) {
+            const double ms = decodeImages(model.images, path, threadCount);
+            best = i == 0 ? ms : std::min(best, ms);
+        }
+        std::cout << "  " << threadCount << " threads: " << best << " ms (best of " << iterations << ")" << std::endl;
+    }
+    return 0;
+}
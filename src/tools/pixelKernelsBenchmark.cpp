@@ -0,0 +1,26 @@
+#include "PixelKernels.hpp"
+
+#include <cstdlib>
+#include <iostream>
+
+// Usage: pixelKernelsBenchmark [width height [iterations]]
+int main(const int argc, const char *argv[])
+{
+    uint32_t width = 4096;
+    uint32_t height = 4096;
+    uint32_t iterations = 10;
+    if (argc >= 3) {
+        width = static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10));
+        height = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+    }
+    if (argc >= 4) {
+        iterations = static_cast<uint32_t>(std::strtoul(argv[3], nullptr, 10));
+    }
+    if (width == 0 || height == 0 || iterations == 0) {
+        std::cerr << "Usage: " << argv[0] << " [width height [iterations]]" << std::endl;
+        return 1;
+    }
+
+    VulkanLearning::PixelKernels::benchmark(width, height, iterations);
+    return 0;
+}